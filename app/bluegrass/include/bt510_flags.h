@@ -32,6 +32,19 @@ extern "C" {
 #define FLAG_RATE_OF_CHANGE_TEMP_ALARM 0x1, 13
 #define FLAG_MOVEMENT_ALARM            0x1, 14
 #define FLAG_MAGNET_STATE              0x1, 15
+
+/* Shadow key of each flag.  X(key, flag) */
+#define BT510_FLAG_TABLE(X)                                                    \
+	X("rtcSet",                       FLAG_TIME_WAS_SET)                   \
+	X("activeMode",                   FLAG_ACTIVE_MODE)                    \
+	X("anyAlarm",                     FLAG_ANY_ALARM)                      \
+	X("lowBatteryAlarm",              FLAG_LOW_BATTERY_ALARM)              \
+	X("highTemperatureAlarm",         FLAG_HIGH_TEMP_ALARM)                \
+	X("lowTemperatureAlarm",          FLAG_LOW_TEMP_ALARM)                 \
+	X("deltaTemperatureAlarm",        FLAG_DELTA_TEMP_ALARM)               \
+	X("rateOfChangeTemperatureAlarm", FLAG_RATE_OF_CHANGE_TEMP_ALARM)      \
+	X("movementAlarm",                FLAG_MOVEMENT_ALARM)                 \
+	X("magnetState",                  FLAG_MAGNET_STATE)
 /* clang-format on */
 
 #define ANY_ALARM_MASK 0x00007F10
@@ -0,0 +1,98 @@
+/**
+ * @file bt510_records.h
+ * @brief Shadow values generated for each BT510 advertisement record type.
+ *
+ * Each table entry is X(recordType, VALUE, key).  The value is one of
+ * TEMPERATURE (signed hundredths of a degree C), BATTERY (unsigned mV) or
+ * RESET_REASON (string) and is taken from the data field of the
+ * advertisement.  A record type that isn't in a table doesn't generate
+ * a value.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __BT510_RECORDS_H__
+#define __BT510_RECORDS_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include "lcz_sensor_event.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+/* Many events are replicated in flags (and don't generate a value). */
+/* clang-format off */
+#define BT510_RECORD_TABLE(X)                                                  \
+	X(SENSOR_EVENT_TEMPERATURE,                                            \
+	  TEMPERATURE, "tempCc")                                               \
+	X(SENSOR_EVENT_ALARM_HIGH_TEMP_1,                                      \
+	  TEMPERATURE, "tempCc")                                               \
+	X(SENSOR_EVENT_ALARM_HIGH_TEMP_2,                                      \
+	  TEMPERATURE, "tempCc")                                               \
+	X(SENSOR_EVENT_ALARM_HIGH_TEMP_CLEAR,                                  \
+	  TEMPERATURE, "tempCc")                                               \
+	X(SENSOR_EVENT_ALARM_LOW_TEMP_1,                                       \
+	  TEMPERATURE, "tempCc")                                               \
+	X(SENSOR_EVENT_ALARM_LOW_TEMP_2,                                       \
+	  TEMPERATURE, "tempCc")                                               \
+	X(SENSOR_EVENT_ALARM_LOW_TEMP_CLEAR,                                   \
+	  TEMPERATURE, "tempCc")                                               \
+	X(SENSOR_EVENT_ALARM_DELTA_TEMP,                                       \
+	  TEMPERATURE, "tempCc")                                               \
+	X(SENSOR_EVENT_ALARM_TEMPERATURE_RATE_OF_CHANGE,                       \
+	  TEMPERATURE, "tempCc")                                               \
+	X(SENSOR_EVENT_BATTERY_GOOD,                                           \
+	  BATTERY,     "batteryVoltageMv")                                     \
+	X(SENSOR_EVENT_BATTERY_BAD,                                            \
+	  BATTERY,     "batteryVoltageMv")                                     \
+	X(SENSOR_EVENT_RESET,                                                  \
+	  RESET_REASON, "resetReason")
+
+/* These are additional events that the IG60 generates.
+ * The purpose of these is have a persistent value in shadow because
+ * the event log is limited.  If the app is closed, then this is one
+ * method of preventing lost events.
+ * The names are taken from the bt510_cli project and bt510.schema.json.
+ */
+#define BT510_IG60_RECORD_TABLE(X)                                             \
+	X(SENSOR_EVENT_ALARM_HIGH_TEMP_1, TEMPERATURE,                         \
+	  IG60_GENERATED_EVENT_STR_ALARM_HIGH_TEMP_1)                          \
+	X(SENSOR_EVENT_ALARM_HIGH_TEMP_2, TEMPERATURE,                         \
+	  IG60_GENERATED_EVENT_STR_ALARM_HIGH_TEMP_2)                          \
+	X(SENSOR_EVENT_ALARM_HIGH_TEMP_CLEAR, TEMPERATURE,                     \
+	  IG60_GENERATED_EVENT_STR_ALARM_HIGH_TEMP_CLEAR)                      \
+	X(SENSOR_EVENT_ALARM_LOW_TEMP_1, TEMPERATURE,                          \
+	  IG60_GENERATED_EVENT_STR_ALARM_LOW_TEMP_1)                           \
+	X(SENSOR_EVENT_ALARM_LOW_TEMP_2, TEMPERATURE,                          \
+	  IG60_GENERATED_EVENT_STR_ALARM_LOW_TEMP_2)                           \
+	X(SENSOR_EVENT_ALARM_LOW_TEMP_CLEAR, TEMPERATURE,                      \
+	  IG60_GENERATED_EVENT_STR_ALARM_LOW_TEMP_CLEAR)                       \
+	X(SENSOR_EVENT_ALARM_DELTA_TEMP, TEMPERATURE,                          \
+	  IG60_GENERATED_EVENT_STR_ALARM_DELTA_TEMP)                           \
+	X(SENSOR_EVENT_BATTERY_GOOD, BATTERY,                                  \
+	  IG60_GENERATED_EVENT_STR_BATTERY_GOOD)                               \
+	X(SENSOR_EVENT_BATTERY_BAD, BATTERY,                                   \
+	  IG60_GENERATED_EVENT_STR_BATTERY_BAD)                                \
+	X(SENSOR_EVENT_ADV_ON_BUTTON, BATTERY,                                 \
+	  IG60_GENERATED_EVENT_STR_ADVERTISE_ON_BUTTON)
+
+/* When everything is sent to a single topic, each key is prefixed with
+ * "<sensor name>-".  X(member, key)
+ */
+#define BT510_SINGLE_TOPIC_KEY_TABLE(X)                                        \
+	X(temperature, "temperature")                                          \
+	X(rssi,        "rssi")
+/* clang-format on */
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __BT510_RECORDS_H__ */
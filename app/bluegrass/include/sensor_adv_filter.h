@@ -0,0 +1,74 @@
+/**
+ * @file sensor_adv_filter.h
+ * @brief Rejects repeated BT510 event advertisements in the BT RX callback.
+ *
+ * A BT510 repeats the same event id for many advertisement intervals.  A
+ * small direct-mapped cache of the last event id seen for each address allows
+ * repeats to be discarded before they are copied to the sensor task.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __SENSOR_ADV_FILTER_H__
+#define __SENSOR_ADV_FILTER_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr/types.h>
+#include <stdbool.h>
+#include <bluetooth/bluetooth.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+typedef struct SensorAdvFilterStats {
+	uint32_t forwarded;
+	uint32_t filtered;
+} SensorAdvFilterStats_t;
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Determine if an advertisement should be passed to the sensor task.
+ * Ads without an event id (scan responses) are always forwarded.  A repeat
+ * of the last event is forwarded once every
+ * CONFIG_SENSOR_ADV_FILTER_REFRESH_SECONDS so that time-to-live and
+ * connection state in the sensor table are refreshed.
+ *
+ * @note Called from BT RX thread context.
+ *
+ * @retval true if the advertisement should be processed
+ */
+bool SensorAdvFilter_Forward(const bt_addr_le_t *pAddr, uint8_t *pData,
+			     size_t Length);
+
+/**
+ * @brief Forward every advertisement from a sensor (for example, when
+ * a configuration request is waiting for the sensor to be seen).
+ * Calls must be balanced.
+ */
+void SensorAdvFilter_Bypass(const bt_addr_t *pAddr, bool Enable);
+
+/**
+ * @brief Forget the last event of a sensor so that its next advertisement is
+ * forwarded (for example, when it is added to the sensor table).
+ */
+void SensorAdvFilter_Forget(const bt_addr_t *pAddr);
+
+/**
+ * @brief Read (and optionally clear) filter statistics.
+ */
+void SensorAdvFilter_GetStats(SensorAdvFilterStats_t *pStats, bool Clear);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SENSOR_ADV_FILTER_H__ */
@@ -9,10 +9,26 @@
 #ifndef __SENSOR_GATEWAY_PARSER_H__
 #define __SENSOR_GATEWAY_PARSER_H__
 
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr/types.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+typedef struct SensorGatewayParserStats {
+	/* Documents that were tokenized and dispatched to the parsers */
+	uint32_t parsed;
+	/* Deltas with a version that was already processed */
+	uint32_t duplicates;
+	uint32_t duplicateBytes;
+} SensorGatewayParserStats_t;
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -26,6 +42,14 @@ extern "C" {
  */
 void SensorGatewayParser(const char *pTopic, const char *pJson);
 
+/**
+ * @brief Get the number of documents parsed and the number of deltas that
+ * weren't parsed because their version had already been processed.
+ *
+ * @note Values are read without locking and are for diagnostics only.
+ */
+void SensorGatewayParser_GetStats(SensorGatewayParserStats_t *pStats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,86 @@
+/**
+ * @file sensor_index.h
+ * @brief Map a Bluetooth address to its position in a table.
+ *
+ * The index uses open addressing with linear probing.  Only table indices
+ * are stored.  The addresses are read from the table, which is described by
+ * the location of the first address and the size of an entry.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __SENSOR_INDEX_H__
+#define __SENSOR_INDEX_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr/types.h>
+#include <stddef.h>
+#include <bluetooth/bluetooth.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+#define SENSOR_INDEX_EMPTY UINT16_MAX
+
+/* The number of slots is a power of two that is at least twice the table
+ * size so that the load factor never exceeds 0.5 and probe sequences stay
+ * short.
+ */
+#define SENSOR_INDEX_SLOTS(TableSize)                                          \
+	((2 * (TableSize) <= 16)   ? 16 :                                      \
+	 (2 * (TableSize) <= 64)   ? 64 :                                      \
+	 (2 * (TableSize) <= 256)  ? 256 :                                     \
+	 (2 * (TableSize) <= 1024) ? 1024 :                                    \
+				     2048)
+
+typedef struct SensorIndex {
+	uint16_t *pSlots;
+	uint32_t mask;
+	const uint8_t *pTable;
+	size_t stride;
+} SensorIndex_t;
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Set up an empty index.
+ *
+ * @param pSlots storage for SENSOR_INDEX_SLOTS(table size) entries
+ * @param Slots number of slots (a power of two)
+ * @param pFirstAddr address of the first table entry
+ * @param Stride size of a table entry
+ */
+void SensorIndex_Initialize(SensorIndex_t *pIndex, uint16_t *pSlots,
+			    size_t Slots, const bt_addr_t *pFirstAddr,
+			    size_t Stride);
+
+/**
+ * @retval table index of the address, SENSOR_INDEX_EMPTY if it isn't found
+ */
+size_t SensorIndex_Find(const SensorIndex_t *pIndex, const bt_addr_t *pAddr);
+
+/**
+ * @brief Add a table entry.  Its address must be set and must not already
+ * be in the index.
+ */
+void SensorIndex_Insert(SensorIndex_t *pIndex, size_t TableIndex);
+
+/**
+ * @brief Remove a table entry.  Its address must not have been changed
+ * since it was inserted.
+ */
+void SensorIndex_Remove(SensorIndex_t *pIndex, size_t TableIndex);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __SENSOR_INDEX_H__ */
@@ -33,7 +33,7 @@ typedef struct SensorLogEvent {
 
 typedef struct SensorLog SensorLog_t;
 
-/* ["1234",4294967295,"1234"] */
+/* ["12",4294967295,"1234"], */
 #define SENSOR_LOG_ENTRY_JSON_STR_SIZE 26
 
 /******************************************************************************/
@@ -60,6 +60,9 @@ void SensorLog_Add(SensorLog_t *pLog, SensorLogEvent_t *pEvent);
 
 /**
  * @brief Add sensor log to JSON message.
+ *
+ * @note The JSON of each entry is generated when it is added to the log, so
+ * the cost of a publish doesn't depend on formatting the whole log.
  */
 void SensorLog_GenerateJson(SensorLog_t *pLog, JsonMsg_t *pMsg);
 
@@ -68,6 +71,14 @@ void SensorLog_GenerateJson(SensorLog_t *pLog, JsonMsg_t *pMsg);
  */
 size_t SensorLog_GetSize(SensorLog_t *pLog);
 
+/**
+ * @brief Copy log entries (oldest first).
+ *
+ * @retval number of entries copied
+ */
+size_t SensorLog_Read(SensorLog_t *pLog, SensorLogEvent_t *pEvents,
+		      size_t Max);
+
 #ifdef __cplusplus
 }
 #endif
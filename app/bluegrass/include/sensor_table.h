@@ -29,6 +29,20 @@ extern "C" {
 /******************************************************************************/
 /* Global Constants, Macros and Type Definitions                              */
 /******************************************************************************/
+/* The gateway sensor list is split into pages of table slots so that its
+ * size isn't limited by a single shadow document.  The first page uses the
+ * key "sensors" and the pages that follow use "sensors1", "sensors2", ...
+ */
+#define SENSOR_GATEWAY_SHADOW_PAGES                                            \
+	((CONFIG_SENSOR_TABLE_SIZE + CONFIG_SENSOR_GATEWAY_SHADOW_PAGE_SIZE -  \
+	  1) /                                                                 \
+	 CONFIG_SENSOR_GATEWAY_SHADOW_PAGE_SIZE)
+#define SENSOR_GATEWAY_SHADOW_PAGE_KEY "sensors"
+#define SENSOR_GATEWAY_SHADOW_PAGE_KEY_SIZE sizeof("sensors65535")
+
+/* A greenlist request is split into as many messages as required. */
+#define SENSOR_GREENLIST_MSG_MAX_SENSORS MIN(CONFIG_SENSOR_TABLE_SIZE, 16)
+
 typedef struct SensorGreenlist {
 	char addrString[SENSOR_ADDR_STR_SIZE];
 	bool greenlist;
@@ -36,8 +50,9 @@ typedef struct SensorGreenlist {
 
 typedef struct SensorGreenlistMsg {
 	FwkMsgHeader_t header;
-	SensorGreenlist_t sensors[CONFIG_SENSOR_TABLE_SIZE];
+	SensorGreenlist_t sensors[SENSOR_GREENLIST_MSG_MAX_SENSORS];
 	size_t sensorCount;
+	bool more; /** another message of the same request follows */
 } SensorGreenlistMsg_t;
 CHECK_FWK_MSG_SIZE(SensorGreenlistMsg_t);
 
@@ -59,6 +74,12 @@ typedef struct SubscribeMsg {
 	char topic[CONFIG_AWS_TOPIC_MAX_SIZE];
 } SubscribeMsg_t;
 
+/* Sent to the sensor task when a sensor shadow has been acknowledged */
+typedef struct SensorPublishAckMsg {
+	FwkMsgHeader_t header;
+	uint32_t publishId;
+} SensorPublishAckMsg_t;
+
 typedef struct SensorCmdMsg {
 	FwkMsgHeader_t header;
 	uint32_t attempts;
@@ -77,6 +98,26 @@ typedef struct SensorCmdMsg {
 	char cmd[]; /** JSON string */
 } SensorCmdMsg_t;
 
+typedef struct SensorTableStats {
+	uint32_t count;
+	uint32_t greenlisted;
+	uint32_t details;
+	uint32_t evictions;
+	uint32_t dropsUntracked;
+	uint32_t shadowFullPublishes;
+	uint32_t shadowDeltaPublishes;
+	uint32_t shadowBytesSaved;
+	uint32_t gatewayShadowPublishes;
+	uint32_t gatewayShadowSkipped;
+	uint32_t gatewayShadowPages;
+	uint32_t snapshotWrites;
+} SensorTableStats_t;
+
+typedef struct SensorTableDrops {
+	char addrString[SENSOR_ADDR_STR_SIZE];
+	uint32_t dropped;
+} SensorTableDrops_t;
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -91,21 +132,48 @@ void SensorTable_Initialize(void);
 
 /**
  * @brief Advertisement parser
+ *
+ * @param pData advertisement data
+ * @param Length of advertisement data
  */
 void SensorTable_AdvertisementHandler(const bt_addr_le_t *pAddr, int8_t rssi,
-				      uint8_t type, Ad_t *pAd);
+				      uint8_t type, uint8_t *pData,
+				      size_t Length);
 
 /**
- * @brief Only greenlisted sensors are allowed to send their data to the cloud.
+ * @brief Account for an advertisement that was dropped before it could be
+ * processed because the sensor task was busy.
  */
-void SensorTable_ProcessGreenlistRequest(SensorGreenlistMsg_t *pMsg);
+void SensorTable_AdvertisementDropped(const bt_addr_t *pAddr);
 
 /**
- * @brief Whitlisted sensors can subscribe to receive config data from AWs.
+ * @brief Get the number of advertisements dropped for each sensor that has
+ * a detail entry.  Drops of other sensors are counted in the table stats.
+ *
+ * @param pIndex where to continue the search (start at 0)
+ * @param pDrops filled in when a sensor is found
  *
- * @note This also handles un-subscription.
+ * @retval true if a sensor with drops was found
+ *
+ * @note Values are read without locking and are for diagnostics only.
+ */
+bool SensorTable_GetNextDrops(size_t *pIndex, SensorTableDrops_t *pDrops);
+
+/**
+ * @brief Get table occupancy, the number of sensors that have been
+ * replaced because the table was full and shadow publish statistics.
+ *
+ * @note Values are read without locking and are for diagnostics only.
  */
-void SensorTable_SubscriptionHandler(void);
+void SensorTable_GetStats(SensorTableStats_t *pStats);
+
+/**
+ * @brief Only greenlisted sensors are allowed to send their data to the cloud.
+ *
+ * @note The gateway shadow is published once the last message of a request
+ * has been processed.
+ */
+void SensorTable_ProcessGreenlistRequest(SensorGreenlistMsg_t *pMsg);
 
 /**
  * @brief Update subscription status in sensor table,
@@ -155,35 +223,55 @@ void SensorTable_EnableGatewayShadowGeneration(void);
 void SensorTable_DisableGatewayShadowGeneration(void);
 
 /**
- * @brief If a sensor hasn't been seen (its ttl count is zero),
- * then remove it from the table.  Don't remove sensor
- * if it has been greenlisted by AWS.
+ * @brief Get the gateway shadow key of a sensor list page.
  */
-void SensorTable_TimeToLiveHandler(void);
+void SensorTable_GatewayShadowPageKey(char *pKey, size_t Size, size_t Page);
 
 /**
- * @brief When decommissioned from AWS all sensors must be disabled
- * because the shadow is deleted on AWS.
+ * @brief Publish the gateway shadow pages that have changed if the minimum
+ * interval has elapsed.
  */
-void SensorTable_DecomissionHandler(void);
+void SensorTable_GatewayShadowHandler(void);
 
 /**
- * @brief When disconnected from AWS all sensors must have their state set
- * to unsubscribed.
+ * @brief Save greenlisted sensors and their event logs to the file system
+ * if they have changed and the snapshot interval has elapsed.
  */
-void SensorTable_UnsubscribeAll(void);
+void SensorTable_SnapshotHandler(void);
 
 /**
- * @brief After reset or disconnect read shadow to re-populate event log.
+ * @brief Process table entries whose deadline has passed.
  *
- * @note This also handles un-subscription.
+ * If a sensor hasn't been seen (its TTL has expired), then it is removed
+ * from the table unless it has been greenlisted by AWS.  Greenlisted
+ * sensors subscribe to (and unsubscribe from) config data from AWS,
+ * request their shadow after a reset or disconnect and are configured.
+ *
+ * @note This shouldn't be called if the system isn't ready to send
+ * data to AWS.
  */
-void SensorTable_GetAcceptedSubscriptionHandler(void);
+void SensorTable_ScheduledHandler(void);
 
 /**
- * @brief Request sensor shadow until it is received.
+ * @brief Get the uptime (in milliseconds) when
+ * SensorTable_ScheduledHandler, SensorTable_GatewayShadowHandler or
+ * SensorTable_SnapshotHandler should next be called.
+ *
+ * @retval false if nothing is pending
  */
-void SensorTable_InitShadowHandler(void);
+bool SensorTable_GetNextDeadline(int64_t *pDeadline);
+
+/**
+ * @brief When decommissioned from AWS all sensors must be disabled
+ * because the shadow is deleted on AWS.
+ */
+void SensorTable_DecomissionHandler(void);
+
+/**
+ * @brief When disconnected from AWS all sensors must have their state set
+ * to unsubscribed.
+ */
+void SensorTable_UnsubscribeAll(void);
 
 /**
  * @brief After publishing a message to get accepted, then sensor table
@@ -192,14 +280,10 @@ void SensorTable_InitShadowHandler(void);
 void SensorTable_ProcessShadowInitMsg(SensorShadowInitMsg_t *pMsg);
 
 /**
- * @brief Config requests that send shadow are delayed and handled
- * by this function.  The delay is because AWS will disconnect when
- * a sensor is created in Bluegrass.
- *
- * @note This shouldn't be called if they system isn't ready to send
- * data to AWS.
+ * @brief What was sent in an acknowledged sensor shadow becomes what
+ * following shadows are compared to.
  */
-void SensorTable_ConfigRequestHandler(void);
+void SensorTable_ShadowAckHandler(SensorPublishAckMsg_t *pMsg);
 
 #ifdef __cplusplus
 }
@@ -9,10 +9,24 @@
 #ifndef __SENSOR_TASK_H__
 #define __SENSOR_TASK_H__
 
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr/types.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+typedef struct SensorTaskAdStats {
+	uint32_t processed;
+	uint32_t dropped;
+	uint32_t queued;
+} SensorTaskAdStats_t;
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -21,6 +35,11 @@ extern "C" {
  */
 void SensorTask_Initialize(void);
 
+/**
+ * @brief Read advertisement statistics (for shell).
+ */
+void SensorTask_GetAdStats(SensorTaskAdStats_t *pStats);
+
 #ifdef __cplusplus
 }
 #endif
@@ -30,12 +30,60 @@ extern "C" {
 #define SB_IS_NOT_STRING true
 #define SB_IS_STRING false
 
+/* Output format of a message.  JSON is used unless another encoding is
+ * selected before the message is started.
+ */
+typedef enum ShadowEncoding {
+	SHADOW_ENCODING_JSON = 0,
+	SHADOW_ENCODING_CBOR,
+	SHADOW_ENCODING_COUNT
+} ShadowEncoding_t;
+
+/* Each encoding implements the builder functions below. */
+typedef struct ShadowEncoder {
+	void (*start)(JsonMsg_t *pJsonMsg, bool ClearBuffer);
+	void (*finalize)(JsonMsg_t *pJsonMsg);
+	void (*addUint32)(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			  uint32_t Value);
+	void (*addSigned32)(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			    int32_t Value);
+	void (*addPair)(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			const char *restrict pValue, bool IsNotString);
+	void (*addVersion)(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			   uint8_t Major, uint8_t Minor, uint8_t Build);
+	void (*addNull)(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+	void (*addTrue)(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+	void (*addFalse)(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+	void (*startGroup)(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+	void (*endGroup)(JsonMsg_t *pJsonMsg);
+	void (*startArray)(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+	void (*endArray)(JsonMsg_t *pJsonMsg);
+	void (*addSensorTableArrayEntry)(JsonMsg_t *pJsonMsg,
+					 const char *restrict pAddrStr,
+					 uint32_t Epoch, bool Greenlisted);
+	void (*addEventLogEntry)(JsonMsg_t *pJsonMsg, SensorLogEvent_t *p);
+	void (*addString)(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			  const char *restrict pStr);
+} ShadowEncoder_t;
+
+extern const ShadowEncoder_t SHADOW_ENCODER_JSON;
+#ifdef CONFIG_SHADOW_BUILDER_CBOR
+extern const ShadowEncoder_t SHADOW_ENCODER_CBOR;
+#endif
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
 
+/**
+ * @brief Select the output format of a message.  Must be called before
+ * ShadowBuilder_Start.  JSON is used if the encoding isn't supported.
+ */
+void ShadowBuilder_SetEncoding(JsonMsg_t *pJsonMsg, ShadowEncoding_t Encoding);
+
 /**
  * @brief Reset the JSON buffer and add open brace '{'
+ * @note An encoding that is invalid or not built is replaced by JSON.
  * @note If buffer was allocated from buffer pool then memset can be skipped.
  */
 void ShadowBuilder_Start(JsonMsg_t *pJsonMsg, bool ClearBuffer);
@@ -125,6 +173,25 @@ void ShadowBuilder_AddString(JsonMsg_t *pJsonMsg, const char *restrict pKey,
  */
 void ShadowBuilder_AddEventLogEntry(JsonMsg_t *pJsonMsg, SensorLogEvent_t *p);
 
+/**
+ * @brief Format an event log entry as JSON (including the trailing comma).
+ *
+ * @param pStr buffer of at least SENSOR_LOG_ENTRY_JSON_STR_SIZE bytes
+ *
+ * @retval length of entry (the string isn't terminated)
+ */
+size_t ShadowBuilder_FormatEventLogEntry(char *pStr, const SensorLogEvent_t *p);
+
+/**
+ * @brief Add event log entries that were formatted by
+ * ShadowBuilder_FormatEventLogEntry to the buffer.
+ *
+ * @note Only valid for the JSON encoding.
+ */
+void ShadowBuilder_AddEventLogEntries(JsonMsg_t *pJsonMsg,
+				      const char *restrict pEntries,
+				      size_t Length);
+
 #ifdef __cplusplus
 }
 #endif
@@ -25,6 +25,7 @@ extern "C" {
 /* Global Constants, Macros and Type Definitions                              */
 /******************************************************************************/
 #define MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT 11 /* Includes the NUL character */
+#define MAXIMUM_LENGTH_OF_TO_STRING_SIGNED_OUTPUT 12 /* "-2147483648" */
 
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
@@ -33,10 +34,22 @@ extern "C" {
 /**
  * @brief Converts Value into decimal string.
  * The output string will be at least 2 bytes.
+ * Smaller types (uint8_t, uint16_t) can be passed directly.
  * @note Max output size is 11 bytes.
+ *
+ * @retval number of characters written (NUL not included)
  */
 uint8_t ToString_Dec(char *pString, uint32_t Value);
 
+/**
+ * @brief Converts signed Value into decimal string.
+ * Smaller types (int8_t, int16_t) can be passed directly.
+ * @note Max output size is 12 bytes.
+ *
+ * @retval number of characters written (NUL not included)
+ */
+uint8_t ToString_Signed(char *pString, int32_t Value);
+
 /**
  * @brief Converts Value into a hexadecimal string.
  * Output is 9 bytes.  NUL included.
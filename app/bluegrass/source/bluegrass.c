@@ -14,10 +14,12 @@ LOG_MODULE_REGISTER(bluegrass, CONFIG_BLUEGRASS_LOG_LEVEL);
 /* Includes                                                                   */
 /******************************************************************************/
 #include <kernel.h>
+#include <string.h>
 
 #include "aws.h"
 #include "sensor_task.h"
 #include "sensor_table.h"
+#include "shadow_builder.h"
 #include "lte.h"
 #include "lcz_memfault.h"
 #include "led_configuration.h"
@@ -27,6 +29,10 @@ LOG_MODULE_REGISTER(bluegrass, CONFIG_BLUEGRASS_LOG_LEVEL);
 #include "ct_ble.h"
 #endif
 
+#ifdef CONFIG_LCZ_PUBLISH_QUEUE
+#include "lcz_publish_queue.h"
+#endif
+
 #include "bluegrass.h"
 
 /******************************************************************************/
@@ -38,6 +44,16 @@ LOG_MODULE_REGISTER(bluegrass, CONFIG_BLUEGRASS_LOG_LEVEL);
 
 #define CONNECT_TO_SUBSCRIBE_DELAY 4
 
+#ifdef CONFIG_LCZ_PUBLISH_QUEUE
+/* A shadow get request is only meaningful while connected. */
+#define SHADOW_GET_SUFFIX "/get"
+
+#define DRAIN_INTERVAL K_MSEC(CONFIG_LCZ_PUBLISH_QUEUE_DRAIN_INTERVAL_MS)
+
+/* Status of a queued publish that hasn't been acknowledged yet */
+#define DRAIN_PENDING 1
+#endif
+
 /******************************************************************************/
 /* Local Data Definitions                                                     */
 /******************************************************************************/
@@ -48,6 +64,14 @@ static struct {
 	bool get_shadow_processed;
 	struct k_work_delayable heartbeat;
 	uint32_t subscription_delay;
+#ifdef CONFIG_LCZ_PUBLISH_QUEUE
+	struct k_work_delayable drain;
+	/* The publish at the head of the queue */
+	struct lcz_publish_queue_entry drain_entry;
+	bool draining;
+	atomic_t drain_status;
+	uint32_t drain_attempts;
+#endif
 } bg;
 
 /******************************************************************************/
@@ -55,6 +79,16 @@ static struct {
 /******************************************************************************/
 static void heartbeat_work_handler(struct k_work *work);
 static void aws_init_shadow(void);
+static int publish(JsonMsg_t *pJsonMsg);
+static void publish_ack_callback(int status, void *context);
+
+#ifdef CONFIG_LCZ_PUBLISH_QUEUE
+static void drain_work_handler(struct k_work *work);
+static void queue_publish(JsonMsg_t *pJsonMsg);
+static void drain_send(void);
+static void drain_complete(int status);
+static void drain_callback(int status, void *context);
+#endif
 
 static FwkMsgHandler_t sensor_publish_msg_handler;
 static FwkMsgHandler_t gateway_publish_msg_handler;
@@ -62,6 +96,9 @@ static FwkMsgHandler_t subscription_msg_handler;
 static FwkMsgHandler_t get_accepted_msg_handler;
 static FwkMsgHandler_t ess_sensor_msg_handler;
 static FwkMsgHandler_t heartbeat_msg_handler;
+#ifdef CONFIG_LCZ_PUBLISH_QUEUE
+static FwkMsgHandler_t publish_queue_msg_handler;
+#endif
 
 /******************************************************************************/
 /* Global Function Definitions                                                */
@@ -69,6 +106,9 @@ static FwkMsgHandler_t heartbeat_msg_handler;
 void bluegrass_initialize(void)
 {
 	k_work_init_delayable(&bg.heartbeat, heartbeat_work_handler);
+#ifdef CONFIG_LCZ_PUBLISH_QUEUE
+	k_work_init_delayable(&bg.drain, drain_work_handler);
+#endif
 
 #ifdef CONFIG_SENSOR_TASK
 	SensorTask_Initialize();
@@ -123,6 +163,11 @@ DispatchResult_t bluegrass_msg_handler(FwkMsgReceiver_t *pMsgRxer,
 				       FwkMsg_t *pMsg)
 {
 	if (!awsConnected()) {
+#ifdef CONFIG_LCZ_PUBLISH_QUEUE
+		if (pMsg->header.msgCode == FMC_SENSOR_PUBLISH) {
+			queue_publish((JsonMsg_t *)pMsg);
+		}
+#endif
 		return DISPATCH_OK;
 	}
 
@@ -135,6 +180,9 @@ DispatchResult_t bluegrass_msg_handler(FwkMsgReceiver_t *pMsgRxer,
 	case FMC_AWS_GET_ACCEPTED_RECEIVED: return get_accepted_msg_handler(pMsgRxer, pMsg);
 	case FMC_ESS_SENSOR_EVENT:          return ess_sensor_msg_handler(pMsgRxer, pMsg);
 	case FMC_AWS_HEARTBEAT:             return heartbeat_msg_handler(pMsgRxer, pMsg);
+#ifdef CONFIG_LCZ_PUBLISH_QUEUE
+	case FMC_PUBLISH_QUEUE_DRAIN:       return publish_queue_msg_handler(pMsgRxer, pMsg);
+#endif
 	default:                            return DISPATCH_OK;
 	}
 	/* clang-format on */
@@ -176,6 +224,10 @@ int bluegrass_subscription_handler(void)
 
 			FRAMEWORK_MSG_CREATE_AND_BROADCAST(FWK_ID_CLOUD,
 							   FMC_BLUEGRASS_READY);
+
+#ifdef CONFIG_LCZ_PUBLISH_QUEUE
+			k_work_schedule(&bg.drain, K_NO_WAIT);
+#endif
 		}
 	}
 
@@ -220,22 +272,79 @@ static DispatchResult_t sensor_publish_msg_handler(FwkMsgReceiver_t *pMsgRxer,
 	ARG_UNUSED(pMsgRxer);
 	JsonMsg_t *pJsonMsg = (JsonMsg_t *)pMsg;
 
+#ifdef CONFIG_LCZ_PUBLISH_QUEUE
+	/* Publishes are queued until the queue has been drained so that
+	 * they are sent in order.
+	 */
+	if (!bluegrass_ready_for_publish() || !lcz_publish_queue_empty()) {
+		queue_publish(pJsonMsg);
+	} else if (publish(pJsonMsg) != 0) {
+		queue_publish(pJsonMsg);
+	}
+#else
 	if (bluegrass_ready_for_publish()) {
-		awsSendData(pJsonMsg->buffer, CONFIG_USE_SINGLE_AWS_TOPIC ?
-							    GATEWAY_TOPIC :
-							    pJsonMsg->topic);
+		publish(pJsonMsg);
 	}
+#endif
 
 	return DISPATCH_OK;
 }
 
+/* A callback is only requested if the sender wants to know about the
+ * PUBACK because the AWS task has to keep a copy of the publish.
+ */
+static int publish(JsonMsg_t *pJsonMsg)
+{
+	aws_publish_callback_t callback = NULL;
+	void *context = (void *)(uintptr_t)pJsonMsg->publishId;
+
+	if (pJsonMsg->publishId != 0) {
+		callback = publish_ack_callback;
+	}
+
+	if (pJsonMsg->encoding != SHADOW_ENCODING_JSON) {
+		return awsSendBinDataCallback(pJsonMsg->buffer,
+					      pJsonMsg->length,
+					      pJsonMsg->topic, callback,
+					      context);
+	} else {
+		return awsSendDataLengthCallback(pJsonMsg->buffer,
+						 pJsonMsg->length,
+						 CONFIG_USE_SINGLE_AWS_TOPIC ?
+							 GATEWAY_TOPIC :
+							 pJsonMsg->topic,
+						 callback, context);
+	}
+}
+
+/* Called from the AWS receive thread */
+static void publish_ack_callback(int status, void *context)
+{
+	SensorPublishAckMsg_t *pMsg;
+
+	if (status != 0) {
+		return;
+	}
+
+	pMsg = BP_TRY_TO_TAKE(sizeof(SensorPublishAckMsg_t));
+	if (pMsg == NULL) {
+		return;
+	}
+
+	pMsg->header.msgCode = FMC_SENSOR_PUBLISH_ACK;
+	pMsg->header.txId = FWK_ID_CLOUD;
+	pMsg->header.rxId = FWK_ID_SENSOR_TASK;
+	pMsg->publishId = (uint32_t)(uintptr_t)context;
+	FRAMEWORK_MSG_SEND(pMsg);
+}
+
 static DispatchResult_t gateway_publish_msg_handler(FwkMsgReceiver_t *pMsgRxer,
 						    FwkMsg_t *pMsg)
 {
 	ARG_UNUSED(pMsgRxer);
 	JsonMsg_t *pJsonMsg = (JsonMsg_t *)pMsg;
 
-	awsSendData(pJsonMsg->buffer, GATEWAY_TOPIC);
+	awsSendDataLength(pJsonMsg->buffer, pJsonMsg->length, GATEWAY_TOPIC);
 
 	return DISPATCH_OK;
 }
@@ -296,3 +405,139 @@ static DispatchResult_t heartbeat_msg_handler(FwkMsgReceiver_t *pMsgRxer,
 
 	return DISPATCH_OK;
 }
+
+#ifdef CONFIG_LCZ_PUBLISH_QUEUE
+static void drain_work_handler(struct k_work *work)
+{
+	ARG_UNUSED(work);
+
+	FRAMEWORK_MSG_CREATE_AND_SEND(FWK_ID_CLOUD, FWK_ID_CLOUD,
+				      FMC_PUBLISH_QUEUE_DRAIN);
+}
+
+static void queue_publish(JsonMsg_t *pJsonMsg)
+{
+	bool binary = (pJsonMsg->encoding != SHADOW_ENCODING_JSON);
+	const char *topic = pJsonMsg->topic;
+	size_t length = strlen(topic);
+	size_t suffix = strlen(SHADOW_GET_SUFFIX);
+	int r;
+
+	if (length >= suffix &&
+	    strcmp(&topic[length - suffix], SHADOW_GET_SUFFIX) == 0) {
+		return;
+	}
+
+	if ((CONFIG_USE_SINGLE_AWS_TOPIC && !binary) || length == 0) {
+		topic = GATEWAY_TOPIC;
+	}
+
+	r = lcz_publish_queue_put(topic, pJsonMsg->buffer, pJsonMsg->length,
+				  binary);
+	if (r < 0) {
+		LOG_WRN("Publish not queued (%d)", r);
+	}
+}
+
+/* Queued publishes are sent one at a time.  The next one is sent one drain
+ * interval after the previous one has been acknowledged, so the queue is
+ * drained in order without filling the publish window.
+ */
+static DispatchResult_t publish_queue_msg_handler(FwkMsgReceiver_t *pMsgRxer,
+						  FwkMsg_t *pMsg)
+{
+	ARG_UNUSED(pMsgRxer);
+	ARG_UNUSED(pMsg);
+	int status;
+
+	if (bg.draining) {
+		status = atomic_get(&bg.drain_status);
+		if (status == DRAIN_PENDING) {
+			return DISPATCH_OK;
+		}
+		bg.draining = false;
+		drain_complete(status);
+	} else {
+		if (!bluegrass_ready_for_publish()) {
+			return DISPATCH_OK;
+		}
+		drain_send();
+	}
+
+	if (!bg.draining && !lcz_publish_queue_empty()) {
+		k_work_schedule(&bg.drain, DRAIN_INTERVAL);
+	}
+
+	return DISPATCH_OK;
+}
+
+static void drain_send(void)
+{
+	struct lcz_publish_queue_entry *entry = &bg.drain_entry;
+	uint32_t seq = entry->seq;
+	uint8_t *topic;
+	int r;
+
+	r = lcz_publish_queue_get(entry);
+	if (r < 0) {
+		return;
+	}
+
+	if (entry->seq != seq) {
+		bg.drain_attempts = 0;
+	}
+
+	topic = (uint8_t *)entry->topic;
+	atomic_set(&bg.drain_status, DRAIN_PENDING);
+	if (entry->binary) {
+		r = awsSendBinDataCallback((char *)entry->data, entry->length,
+					   topic, drain_callback, NULL);
+	} else {
+		r = awsSendDataLengthCallback((char *)entry->data,
+					      entry->length, topic,
+					      drain_callback, NULL);
+	}
+
+	/* The AWS task copies the publish if it may have to be retransmitted.
+	 * The sequence number is kept so that the entry can be removed.
+	 */
+	lcz_publish_queue_release(entry);
+
+	if (r == 0) {
+		bg.draining = true;
+	} else {
+		drain_complete(r);
+	}
+}
+
+/* A full publish window doesn't count as an attempt. */
+static void drain_complete(int status)
+{
+	struct lcz_publish_queue_entry *entry = &bg.drain_entry;
+
+	if (status != 0 && status != -EBUSY) {
+		bg.drain_attempts += 1;
+	}
+
+	if (status == 0) {
+		lcz_publish_queue_remove(entry);
+		bg.drain_attempts = 0;
+	} else if (bg.drain_attempts >= CONFIG_LCZ_PUBLISH_QUEUE_MAX_ATTEMPTS) {
+		LOG_ERR("Queued publish dropped after %u attempts (%d)",
+			bg.drain_attempts, status);
+		lcz_publish_queue_discard(entry);
+		bg.drain_attempts = 0;
+	} else {
+		LOG_WRN("Unable to send queued publish (%d)", status);
+	}
+}
+
+/* Called from the AWS receive thread */
+static void drain_callback(int status, void *context)
+{
+	ARG_UNUSED(context);
+
+	atomic_set(&bg.drain_status, status);
+	k_work_reschedule(&bg.drain, K_NO_WAIT);
+}
+#endif
@@ -0,0 +1,145 @@
+/**
+ * @file sensor_adv_filter.c
+ * @brief
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <sys/byteorder.h>
+
+#include "ad_find.h"
+#include "lcz_sensor_adv_format.h"
+#include "lcz_sensor_adv_match.h"
+#include "sensor_adv_filter.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define FILTER_MASK (CONFIG_SENSOR_ADV_FILTER_SIZE - 1)
+BUILD_ASSERT((CONFIG_SENSOR_ADV_FILTER_SIZE & FILTER_MASK) == 0,
+	     "Filter size must be a power of two");
+
+#define REFRESH_MS (CONFIG_SENSOR_ADV_FILTER_REFRESH_SECONDS * MSEC_PER_SEC)
+
+typedef struct FilterSlot {
+	bt_addr_t addr;
+	bool valid;
+	/* A pinned slot forwards everything that maps to it and
+	 * is never given to a different sensor.
+	 */
+	uint8_t pins;
+	uint16_t id;
+	uint32_t forwardTime;
+} FilterSlot_t;
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static FilterSlot_t slots[CONFIG_SENSOR_ADV_FILTER_SIZE];
+static struct k_spinlock lock;
+static atomic_t forwarded;
+static atomic_t filtered;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static FilterSlot_t *GetSlot(const bt_addr_t *pAddr);
+static bool Forward(FilterSlot_t *p, const bt_addr_t *pAddr, uint16_t Id);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+bool SensorAdvFilter_Forward(const bt_addr_le_t *pAddr, uint8_t *pData,
+			     size_t Length)
+{
+	AdHandle_t manHandle = AdFind_Type(pData, Length,
+					   BT_DATA_MANUFACTURER_DATA,
+					   BT_DATA_INVALID);
+	LczSensorAdEvent_t *pEvent = NULL;
+	if (manHandle.pPayload == NULL) {
+		/* Let the sensor table decide */
+	} else if (lcz_sensor_adv_match_1m(&manHandle)) {
+		pEvent = (LczSensorAdEvent_t *)manHandle.pPayload;
+	} else if (lcz_sensor_adv_match_coded(&manHandle)) {
+		pEvent = &((LczSensorAdCoded_t *)manHandle.pPayload)->ad;
+	}
+
+	bool result = true;
+	if (pEvent != NULL) {
+		k_spinlock_key_t key = k_spin_lock(&lock);
+		result = Forward(GetSlot(&pAddr->a), &pAddr->a, pEvent->id);
+		k_spin_unlock(&lock, key);
+	}
+
+	atomic_inc(result ? &forwarded : &filtered);
+	return result;
+}
+
+void SensorAdvFilter_Bypass(const bt_addr_t *pAddr, bool Enable)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	FilterSlot_t *p = GetSlot(pAddr);
+	if (Enable) {
+		__ASSERT_NO_MSG(p->pins < UINT8_MAX);
+		p->pins += 1;
+	} else if (p->pins > 0) {
+		p->pins -= 1;
+	}
+	k_spin_unlock(&lock, key);
+}
+
+void SensorAdvFilter_Forget(const bt_addr_t *pAddr)
+{
+	k_spinlock_key_t key = k_spin_lock(&lock);
+	FilterSlot_t *p = GetSlot(pAddr);
+	if (p->valid && bt_addr_cmp(&p->addr, pAddr) == 0) {
+		p->valid = false;
+	}
+	k_spin_unlock(&lock, key);
+}
+
+void SensorAdvFilter_GetStats(SensorAdvFilterStats_t *pStats, bool Clear)
+{
+	if (Clear) {
+		pStats->forwarded = atomic_clear(&forwarded);
+		pStats->filtered = atomic_clear(&filtered);
+	} else {
+		pStats->forwarded = atomic_get(&forwarded);
+		pStats->filtered = atomic_get(&filtered);
+	}
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static FilterSlot_t *GetSlot(const bt_addr_t *pAddr)
+{
+	const uint8_t *a = pAddr->val;
+	uint32_t h = sys_get_le32(a) ^ ((uint32_t)sys_get_le16(&a[4]) << 7);
+	return &slots[(h * 2654435761U) >> 16 & FILTER_MASK];
+}
+
+static bool Forward(FilterSlot_t *p, const bt_addr_t *pAddr, uint16_t Id)
+{
+	uint32_t now = k_uptime_get_32();
+	bool match = p->valid && (bt_addr_cmp(&p->addr, pAddr) == 0);
+
+	if (match && (p->pins == 0) && (p->id == Id) &&
+	    ((now - p->forwardTime) < REFRESH_MS)) {
+		return false;
+	}
+
+	if (match || p->pins == 0) {
+		bt_addr_copy(&p->addr, pAddr);
+		p->valid = true;
+		p->id = Id;
+		p->forwardTime = now;
+	}
+	return true;
+}
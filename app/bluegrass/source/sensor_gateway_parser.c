@@ -23,6 +23,7 @@ LOG_MODULE_REGISTER(sensor_gateway_parser,
 #include <stdlib.h>
 #include <string.h>
 #include <stdbool.h>
+#include <ctype.h>
 
 #include "aws.h"
 
@@ -41,6 +42,7 @@ LOG_MODULE_REGISTER(sensor_gateway_parser,
 #include "jsmn.h"
 #include "jsmn_json.h"
 
+#include "sensor_gateway_parser.h"
 #include "sensor_cmd.h"
 #include "sensor_table.h"
 #include "shadow_builder.h"
@@ -68,10 +70,142 @@ LOG_MODULE_REGISTER(sensor_gateway_parser,
 #define GATEWAY_TOPIC_SUB_STR "deviceId-"
 #define GET_ACCEPTED_SUB_STR "/get/accepted"
 #define SENSOR_SHADOW_PREFIX "$aws/things/"
+#define DELTA_SUB_STR "/update/delta"
+
+#define SHADOW_VERSION_KEY "version"
+#ifdef CONFIG_SENSOR_TASK
+#define SHADOW_VERSION_SLOTS (CONFIG_SENSOR_GREENLIST_SIZE + 1)
+#else
+#define SHADOW_VERSION_SLOTS 1
+#endif
+
+#define FNV_OFFSET_BASIS 2166136261U
+#define FNV_PRIME 16777619U
+
+/* A delta that is redelivered or arrives out of order is at most this many
+ * versions older than the last one processed.  A shadow that is deleted and
+ * created again starts over at version 1, so a version that is older than
+ * this starts a new history.
+ */
+#define SHADOW_VERSION_STALE_WINDOW 64
+
+/* The delta topic of each shadow and the last version that was processed */
+typedef struct ShadowVersion {
+	uint32_t topicHash;
+	uint32_t version;
+	uint32_t lastUsed;
+	bool valid;
+} ShadowVersion_t;
 
 #define MAX_CONVERSION_STR_SIZE 11
 #define MAX_CONVERSION_STR_LEN (MAX_CONVERSION_STR_SIZE - 1)
 
+/* A field of the gateway shadow.  The path is relative to "state" in a delta
+ * and to "state.reported" in get accepted.  Numbers outside of the range
+ * are ignored.  An object is passed to its parser with the index at the
+ * object.
+ */
+typedef enum ShadowFieldType {
+	SHADOW_FIELD_STRING = 0,
+	SHADOW_FIELD_NUMBER,
+	SHADOW_FIELD_IMAGE_STRING,
+	SHADOW_FIELD_IMAGE_NUMBER,
+	SHADOW_FIELD_OBJECT
+} ShadowFieldType_t;
+
+/* Don't overwrite a value that the gateway reports (such as a count) */
+#define SHADOW_FIELD_DELTA_ONLY BIT(0)
+
+typedef struct ShadowField {
+	const char *path;
+	ShadowFieldType_t type;
+	uint8_t flags;
+	uint32_t min;
+	uint32_t max;
+#if defined(CONFIG_COAP_FOTA) || defined(CONFIG_HTTP_FOTA)
+	enum fota_image_type image;
+#endif
+	union {
+		void (*string)(const char *p, size_t length);
+		void (*number)(uint32_t value);
+#if defined(CONFIG_COAP_FOTA) || defined(CONFIG_HTTP_FOTA)
+		void (*imageString)(enum fota_image_type type, const char *p,
+				    size_t length);
+		void (*imageNumber)(enum fota_image_type type, uint32_t value);
+#endif
+		void (*object)(void);
+	} set;
+} ShadowField_t;
+
+#define STRING_FIELD(_path, _set)                                              \
+	{                                                                      \
+		.path = _path, .type = SHADOW_FIELD_STRING,                    \
+		.set.string = _set                                             \
+	}
+
+#define NUMBER_FIELD(_path, _min, _max, _set)                                  \
+	{                                                                      \
+		.path = _path, .type = SHADOW_FIELD_NUMBER, .min = _min,       \
+		.max = _max, .set.number = _set                                \
+	}
+
+#define OBJECT_FIELD(_path, _set)                                              \
+	{                                                                      \
+		.path = _path, .type = SHADOW_FIELD_OBJECT,                    \
+		.set.object = _set                                             \
+	}
+
+#if defined(CONFIG_COAP_FOTA) || defined(CONFIG_HTTP_FOTA)
+#ifdef CONFIG_COAP_FOTA
+#define FOTA_SET(x) coap_fota_set_##x
+#else
+#define FOTA_SET(x) http_fota_set_##x
+#endif
+
+#define IMAGE_STRING_FIELD(_name, _image, _key, _set)                          \
+	{                                                                      \
+		.path = _name "." _key, .type = SHADOW_FIELD_IMAGE_STRING,     \
+		.image = _image, .set.imageString = FOTA_SET(_set)             \
+	}
+
+#define IMAGE_NUMBER_FIELD(_name, _image, _key, _set, _flags)                  \
+	{                                                                      \
+		.path = _name "." _key, .type = SHADOW_FIELD_IMAGE_NUMBER,     \
+		.flags = _flags, .max = UINT32_MAX, .image = _image,           \
+		.set.imageNumber = FOTA_SET(_set)                              \
+	}
+
+/* "state":{"app":{"desired":"2.1.0","switchover":10}} */
+#ifdef CONFIG_COAP_FOTA
+#define FOTA_IMAGE_FIELDS(_name, _image)                                       \
+	IMAGE_STRING_FIELD(_name, _image, SHADOW_FOTA_DESIRED_STR,             \
+			   desired_version),                                   \
+	IMAGE_STRING_FIELD(_name, _image, SHADOW_FOTA_DESIRED_FILENAME_STR,    \
+			   desired_filename),                                  \
+	FOTA_IMAGE_SCHEDULE_FIELDS(_name, _image)
+#else
+#define FOTA_IMAGE_FIELDS(_name, _image)                                       \
+	IMAGE_STRING_FIELD(_name, _image, SHADOW_FOTA_DESIRED_STR,             \
+			   desired_version),                                   \
+	IMAGE_STRING_FIELD(_name, _image, SHADOW_FOTA_DOWNLOAD_HOST_STR,       \
+			   download_host),                                     \
+	IMAGE_STRING_FIELD(_name, _image, SHADOW_FOTA_DOWNLOAD_FILE_STR,       \
+			   download_file),                                     \
+	IMAGE_STRING_FIELD(_name, _image, SHADOW_FOTA_HASH_STR, hash),         \
+	FOTA_IMAGE_SCHEDULE_FIELDS(_name, _image)
+#endif
+
+#define FOTA_IMAGE_SCHEDULE_FIELDS(_name, _image)                              \
+	IMAGE_NUMBER_FIELD(_name, _image, SHADOW_FOTA_SWITCHOVER_STR,          \
+			   switchover, 0),                                     \
+	IMAGE_NUMBER_FIELD(_name, _image, SHADOW_FOTA_START_STR, start, 0),    \
+	IMAGE_NUMBER_FIELD(_name, _image, SHADOW_FOTA_ERROR_STR, error_count,  \
+			   SHADOW_FIELD_DELTA_ONLY)
+#endif /* COAP || HTTP FOTA */
+
+/* The block size is an enumeration (0 is 16 bytes, 6 is 1024 bytes). */
+#define FOTA_BLOCK_SIZE_ENUM_MAX 6
+
 #ifdef CONFIG_BOARD_MG100
 #define MAX_WRITEABLE_LOCAL_OBJECTS 11
 
@@ -111,6 +245,27 @@ BUILD_ASSERT((JSON_DEFAULT_BUF_SIZE * 2) + 256 < CONFIG_BUFFER_POOL_SIZE,
 /******************************************************************************/
 static bool getAcceptedTopic;
 
+static ShadowVersion_t shadowVersions[SHADOW_VERSION_SLOTS];
+static uint32_t shadowVersionUses;
+static SensorGatewayParserStats_t parserStats;
+
+/* The metadata and timestamp are removed by the subscription filter before
+ * the parser sees the document.  The version can't be removed there because
+ * duplicate deltas are found with it (before the document is tokenized).
+ */
+#ifdef CONFIG_BOARD_MG100
+/* The MG100 uses the version to detect a delta. */
+JSMN_JSON_DEFINE(json, CONFIG_JSMN_NUMBER_OF_TOKENS);
+#else
+static const jsmn_json_skip_t SHADOW_SKIP_KEYS[] = {
+	{ "version", 1 },
+};
+
+/* Shadows are only parsed by the AWS receive thread. */
+JSMN_JSON_DEFINE_SKIP(json, CONFIG_JSMN_NUMBER_OF_TOKENS, SHADOW_SKIP_KEYS,
+		      ARRAY_SIZE(SHADOW_SKIP_KEYS));
+#endif
+
 #ifdef CONFIG_BOARD_MG100
 static uint16_t local_updates = 0;
 
@@ -176,22 +331,22 @@ static int (*LocalConfigGet[MAX_WRITEABLE_LOCAL_OBJECTS])() = {
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
-#if defined(CONFIG_COAP_FOTA) || defined(CONFIG_HTTP_FOTA)
-static void FotaParser(const char *pTopic, enum fota_image_type Type);
-#endif
-#ifdef CONFIG_COAP_FOTA
-static void FotaHostParser(const char *pTopic);
-static void FotaBlockSizeParser(const char *pTopic);
-#endif
+static void GatewayFieldParser(void);
+static int FindField(const ShadowField_t *pField);
+static void SetField(const ShadowField_t *pField, int location);
+static bool IsNumber(int location);
 static void UnsubscribeToGetAcceptedHandler(void);
+static ShadowVersion_t *FindShadowVersion(const char *pTopic, uint32_t Version);
+static uint32_t TopicHash(const char *pTopic);
 
 #ifdef CONFIG_SENSOR_TASK
-static void GatewayParser(const char *pTopic);
+static void GatewayParser(void);
 static void SensorParser(const char *pTopic);
 static void SensorDeltaParser(const char *pTopic);
 static void SensorEventLogParser(const char *pTopic);
 static void ParseEventArray(const char *pTopic);
-static void ParseArray(int ExpectedSensors);
+static int ParseArray(SensorGreenlistMsg_t **ppMsg, int ExpectedSensors);
+static SensorGreenlistMsg_t *NextGreenlistMsg(SensorGreenlistMsg_t **ppMsg);
 #endif
 
 #if defined(CONFIG_SENSOR_TASK) || defined(CONFIG_BOARD_MG100)
@@ -206,41 +361,71 @@ static void BuildAndSendLocalConfigResponse(void);
 static void BuildAndSendLocalConfigNullResponse(void);
 #endif /* CONFIG_BOARD_MG100 */
 
+/* Adding a configurable field to the gateway shadow only requires an entry
+ * in this table.
+ */
+static const ShadowField_t GATEWAY_FIELDS[] = {
+#ifdef CONFIG_SENSOR_TASK
+	/* {"state": {"bt510": {"sensors": */
+	OBJECT_FIELD("bt510", GatewayParser),
+#endif
+#if defined(CONFIG_COAP_FOTA) || defined(CONFIG_HTTP_FOTA)
+	FOTA_IMAGE_FIELDS(SHADOW_FOTA_APP_STR, APP_IMAGE_TYPE),
+#ifdef CONFIG_MODEM_HL7800
+	FOTA_IMAGE_FIELDS(SHADOW_FOTA_MODEM_STR, MODEM_IMAGE_TYPE),
+#endif
+#endif
+#ifdef CONFIG_COAP_FOTA
+	/* "state":{"fwBridge":"something.com"}} */
+	STRING_FIELD(SHADOW_FOTA_BRIDGE_STR, coap_fota_set_host),
+	NUMBER_FIELD(SHADOW_FOTA_BLOCKSIZE_STR, 0, FOTA_BLOCK_SIZE_ENUM_MAX,
+		     coap_fota_set_blocksize),
+#endif
+};
+
 /******************************************************************************/
 /* Global Function Definitions                                                */
 /******************************************************************************/
 void SensorGatewayParser(const char *pTopic, const char *pJson)
 {
-	jsmn_start(pJson);
-	if (!jsmn_valid()) {
-		LOG_ERR("Unable to parse subscription %d", jsmn_tokens_found());
+	ShadowVersion_t *pDelta = NULL;
+	uint32_t version = 0;
+
+	/* A delta is repeated when a QoS 1 publish is redelivered.
+	 * Get accepted is always processed because it is requested to
+	 * (re)initialize the gateway and sensors.
+	 */
+	if (strstr(pTopic, DELTA_SUB_STR) != NULL &&
+	    jsmn_peek_uint(pJson, SHADOW_VERSION_KEY, &version)) {
+		pDelta = FindShadowVersion(pTopic, version);
+		if (pDelta == NULL) {
+			parserStats.duplicates += 1;
+			parserStats.duplicateBytes += strlen(pJson);
+			LOG_DBG("Version %u of %s already processed", version,
+				log_strdup(pTopic));
+			return;
+		}
+	}
+
+	jsmn_start(&json, pJson);
+	if (!jsmn_valid(&json)) {
+		LOG_ERR("Unable to parse subscription %d",
+			jsmn_tokens_found(&json));
 		return;
 	}
 
+	parserStats.parsed += 1;
+
 	getAcceptedTopic = strstr(pTopic, GET_ACCEPTED_SUB_STR) != NULL;
 	if (strstr(pTopic, GATEWAY_TOPIC_SUB_STR) != NULL) {
-#ifdef CONFIG_SENSOR_TASK
-		GatewayParser(pTopic);
-#endif
+		GatewayFieldParser();
 
 #ifdef CONFIG_BOARD_MG100
 		MiniGatewayParser(pTopic);
 #endif
 
-#if defined(CONFIG_COAP_FOTA) || defined(CONFIG_HTTP_FOTA)
-		FotaParser(pTopic, APP_IMAGE_TYPE);
-		if (IS_ENABLED(CONFIG_MODEM_HL7800)) {
-			FotaParser(pTopic, MODEM_IMAGE_TYPE);
-		}
-#endif
-
-#ifdef CONFIG_COAP_FOTA
-		FotaHostParser(pTopic);
-		FotaBlockSizeParser(pTopic);
-#endif
-
 #ifdef CONFIG_CONTACT_TRACING
-		rpc_params_gateway_parser(getAcceptedTopic);
+		rpc_params_gateway_parser(&json, getAcceptedTopic);
 #endif
 
 		UnsubscribeToGetAcceptedHandler();
@@ -250,7 +435,23 @@ void SensorGatewayParser(const char *pTopic, const char *pJson)
 #endif
 	}
 
-	jsmn_end();
+	jsmn_end(&json);
+
+	/* Duplicates are only detected once the document has been processed. */
+	if (pDelta != NULL) {
+		pDelta->topicHash = TopicHash(pTopic);
+		pDelta->version = version;
+		pDelta->lastUsed = ++shadowVersionUses;
+		pDelta->valid = true;
+	}
+}
+
+void SensorGatewayParser_GetStats(SensorGatewayParserStats_t *pStats)
+{
+	if (pStats != NULL) {
+		memcpy(pStats, &parserStats,
+		       sizeof(SensorGatewayParserStats_t));
+	}
 }
 
 /******************************************************************************/
@@ -395,32 +596,47 @@ static void MiniGatewayParser(const char *pTopic)
  *
  * @note This function assumes that the AWS task acknowledges the publish so
  * that it isn't repeatedly sent to the gateway.
+ *
+ * @note The index is at the "bt510" object.
  */
 #ifdef CONFIG_SENSOR_TASK
-static void GatewayParser(const char *pTopic)
+static void GatewayParser(void)
 {
-	jsmn_reset_index();
+	SensorGreenlistMsg_t *pMsg = NULL;
+	char key[SENSOR_GATEWAY_SHADOW_PAGE_KEY_SIZE];
+	int expectedSensors = 0;
+	int sensorsFound = 0;
+	size_t page;
 
-	/* Now try to find {"state": {"bt510": {"sensors": */
-	jsmn_find_type("state", JSMN_OBJECT, NEXT_PARENT);
-	if (getAcceptedTopic) {
-		/* Add to heirarchy {"state":{"reported": ... */
-		jsmn_find_type("reported", JSMN_OBJECT, NEXT_PARENT);
+	/* The list is split into pages ("sensors", "sensors1", ...).
+	 * Pages that aren't present haven't changed.
+	 */
+	jsmn_save_index(&json);
+	for (page = 0; page < SENSOR_GATEWAY_SHADOW_PAGES; page++) {
+		jsmn_restore_index(&json);
+		SensorTable_GatewayShadowPageKey(key, sizeof(key), page);
+		jsmn_find_type(&json, key, JSMN_ARRAY, NEXT_PARENT);
+		if (jsmn_index(&json) > 0) {
+			/* Backup one token to get the number of arrays
+			 * (sensors).
+			 */
+			int expected = jsmn_size(&json, jsmn_index(&json) - 1);
+			expectedSensors += expected;
+			sensorsFound += ParseArray(&pMsg, expected);
+		}
 	}
-	jsmn_find_type("bt510", JSMN_OBJECT, NEXT_PARENT);
-	jsmn_find_type("sensors", JSMN_ARRAY, NEXT_PARENT);
 
-	if (jsmn_index() > 0) {
-		/* Backup one token to get the number of arrays (sensors). */
-		int expectedSensors = jsmn_size(jsmn_index() - 1);
-		ParseArray(expectedSensors);
-	} else {
-		LOG_DBG("Did not find sensor array");
-		/* It is okay for the list to be empty or non-existant.
-		 * When rebooting after talking to sensors - then it
-		 * shouldn't be.
-		 */
+	/* It is okay for the list to be empty or non-existant.
+	 * When rebooting after talking to sensors - then it
+	 * shouldn't be.
+	 */
+	if (pMsg != NULL) {
+		pMsg->more = false;
+		FRAMEWORK_MSG_SEND(pMsg);
 	}
+
+	LOG_INF("Processed %d of %d sensors in desired list from AWS",
+		sensorsFound, expectedSensors);
 }
 #endif
 
@@ -433,162 +649,158 @@ static void UnsubscribeToGetAcceptedHandler(void)
 	}
 }
 
-#if defined(CONFIG_COAP_FOTA) || defined(CONFIG_HTTP_FOTA)
-static void FotaParser(const char *pTopic, enum fota_image_type Type)
+/**
+ * @brief Each shadow (gateway and greenlisted sensors) has a slot.  The least
+ * recently used slot is replaced when a new shadow is seen.
+ *
+ * @retval NULL if the version (or a newer one) has already been processed,
+ * otherwise the slot that is updated after the document is processed
+ */
+static ShadowVersion_t *FindShadowVersion(const char *pTopic, uint32_t Version)
 {
-	UNUSED_PARAMETER(pTopic);
-	const char *img_name;
-	int location = 0;
-
-	jsmn_reset_index();
-
-	/* Try to find "state":{"app":{"desired":"2.1.0","switchover":10}} */
-	jsmn_find_type("state", JSMN_OBJECT, NEXT_PARENT);
-	if (getAcceptedTopic) {
-		jsmn_find_type("reported", JSMN_OBJECT, NEXT_PARENT);
+	uint32_t hash = TopicHash(pTopic);
+	ShadowVersion_t *pOldest = &shadowVersions[0];
+	size_t i;
+
+	for (i = 0; i < SHADOW_VERSION_SLOTS; i++) {
+		ShadowVersion_t *p = &shadowVersions[i];
+		if (p->valid && p->topicHash == hash) {
+			/* Unsigned difference so that the version can wrap */
+			if ((uint32_t)(p->version - Version) <
+			    SHADOW_VERSION_STALE_WINDOW) {
+				p->lastUsed = ++shadowVersionUses;
+				return NULL;
+			}
+			return p;
+		}
+		if (!p->valid ||
+		    (pOldest->valid && p->lastUsed < pOldest->lastUsed)) {
+			pOldest = p;
+		}
 	}
 
-#ifdef CONFIG_COAP_FOTA
-	img_name = coap_fota_get_image_name(Type);
-#else
-	img_name = http_fota_get_image_name(Type);
-#endif
-
-	jsmn_find_type(img_name, JSMN_OBJECT, NEXT_PARENT);
-
-	if (jsmn_index() > 0) {
-		jsmn_save_index();
+	return pOldest;
+}
 
-		location = jsmn_find_type(SHADOW_FOTA_DESIRED_STR, JSMN_STRING,
-					  NEXT_PARENT);
-		if (location > 0) {
-#ifdef CONFIG_COAP_FOTA
-			coap_fota_set_desired_version(Type,
-						      jsmn_string(location),
-						      jsmn_strlen(location));
-#else
-			http_fota_set_desired_version(Type,
-						      jsmn_string(location),
-						      jsmn_strlen(location));
-#endif
-		}
+static uint32_t TopicHash(const char *pTopic)
+{
+	uint32_t hash = FNV_OFFSET_BASIS;
 
-		jsmn_restore_index();
-#ifdef CONFIG_COAP_FOTA
-		location = jsmn_find_type(SHADOW_FOTA_DESIRED_FILENAME_STR,
-					  JSMN_STRING, NEXT_PARENT);
-		if (location > 0) {
-			coap_fota_set_desired_filename(Type,
-						       jsmn_string(location),
-						       jsmn_strlen(location));
-		}
-#else
-		location = jsmn_find_type(SHADOW_FOTA_DOWNLOAD_HOST_STR,
-					  JSMN_STRING, NEXT_PARENT);
-		if (location > 0) {
-			http_fota_set_download_host(Type, jsmn_string(location),
-						    jsmn_strlen(location));
-		}
+	while (*pTopic) {
+		hash ^= (uint8_t)*pTopic++;
+		hash *= FNV_PRIME;
+	}
 
-		jsmn_restore_index();
-		location = jsmn_find_type(SHADOW_FOTA_DOWNLOAD_FILE_STR,
-					  JSMN_STRING, NEXT_PARENT);
-		if (location > 0) {
-			http_fota_set_download_file(Type, jsmn_string(location),
-						    jsmn_strlen(location));
-		}
+	return hash;
+}
 
-		jsmn_restore_index();
-		location = jsmn_find_type(SHADOW_FOTA_HASH_STR, JSMN_STRING,
-					  NEXT_PARENT);
-		if (location > 0) {
-			http_fota_set_hash(Type, jsmn_string(location),
-					   jsmn_strlen(location));
-		}
-#endif
+/**
+ * @brief Find each field of the gateway shadow and pass its value to its
+ * target.  Keys are found using the index that is built when the document
+ * is tokenized, so each field costs the same wherever it is.
+ */
+static void GatewayFieldParser(void)
+{
+	const ShadowField_t *pField;
+	int location;
+	size_t i;
 
-		jsmn_restore_index();
-		location = jsmn_find_type(SHADOW_FOTA_SWITCHOVER_STR,
-					  JSMN_PRIMITIVE, NEXT_PARENT);
-		if (location > 0) {
-#ifdef CONFIG_COAP_FOTA
-			coap_fota_set_switchover(Type,
-						 jsmn_convert_uint(location));
-#else
-			http_fota_set_switchover(Type,
-						 jsmn_convert_uint(location));
-#endif
+	for (i = 0; i < ARRAY_SIZE(GATEWAY_FIELDS); i++) {
+		pField = &GATEWAY_FIELDS[i];
+		if (getAcceptedTopic &&
+		    (pField->flags & SHADOW_FIELD_DELTA_ONLY) != 0) {
+			continue;
 		}
 
-		jsmn_restore_index();
-		location = jsmn_find_type(SHADOW_FOTA_START_STR, JSMN_PRIMITIVE,
-					  NEXT_PARENT);
+		location = FindField(pField);
 		if (location > 0) {
-#ifdef CONFIG_COAP_FOTA
-			coap_fota_set_start(Type, jsmn_convert_uint(location));
-#else
-			http_fota_set_start(Type, jsmn_convert_uint(location));
-#endif
-		}
-
-		/* Don't overwrite error count when reading shadow. */
-		if (!getAcceptedTopic) {
-			jsmn_restore_index();
-			location = jsmn_find_type(SHADOW_FOTA_ERROR_STR,
-						  JSMN_PRIMITIVE, NEXT_PARENT);
-			if (location > 0) {
-#ifdef CONFIG_COAP_FOTA
-				coap_fota_set_error_count(
-					Type, jsmn_convert_uint(location));
-#else
-				http_fota_set_error_count(
-					Type, jsmn_convert_uint(location));
-#endif
-			}
+			SetField(pField, location);
+		} else {
+			LOG_DBG("%s not found", log_strdup(pField->path));
 		}
 	}
 }
-#endif /* COAP || HTTP FOTA */
 
-#ifdef CONFIG_COAP_FOTA
-static void FotaHostParser(const char *pTopic)
+/* @retval location of the value of a field */
+static int FindField(const ShadowField_t *pField)
 {
-	UNUSED_PARAMETER(pTopic);
-
-	jsmn_reset_index();
+	jsmntype_t type;
+
+	switch (pField->type) {
+	case SHADOW_FIELD_NUMBER:
+	case SHADOW_FIELD_IMAGE_NUMBER:
+		type = JSMN_PRIMITIVE;
+		break;
+	case SHADOW_FIELD_OBJECT:
+		type = JSMN_OBJECT;
+		break;
+	default:
+		type = JSMN_STRING;
+		break;
+	}
 
-	/* Try to find "state":{"fwBridge":"something.com"}} */
-	jsmn_find_type("state", JSMN_OBJECT, NEXT_PARENT);
+	jsmn_reset_index(&json);
 	if (getAcceptedTopic) {
-		jsmn_find_type("reported", JSMN_OBJECT, NEXT_PARENT);
-	}
-	int location = jsmn_find_type(SHADOW_FOTA_BRIDGE_STR, JSMN_STRING,
-				      NEXT_PARENT);
-	if (location > 0) {
-		coap_fota_set_host(jsmn_string(location),
-				   jsmn_strlen(location));
+		jsmn_find_path(&json, "state.reported", JSMN_OBJECT);
+	} else {
+		jsmn_find_type(&json, "state", JSMN_OBJECT, NEXT_PARENT);
 	}
+
+	return jsmn_find_path(&json, pField->path, type);
 }
 
-static void FotaBlockSizeParser(const char *pTopic)
+static void SetField(const ShadowField_t *pField, int location)
 {
-	UNUSED_PARAMETER(pTopic);
-	int location;
-
-	jsmn_reset_index();
-
-	jsmn_find_type("state", JSMN_OBJECT, NEXT_PARENT);
-	if (getAcceptedTopic) {
-		jsmn_find_type("reported", JSMN_OBJECT, NEXT_PARENT);
+	const char *p = jsmn_string(&json, location);
+	size_t length = jsmn_strlen(&json, location);
+	uint32_t value = 0;
+
+	if (pField->type == SHADOW_FIELD_NUMBER ||
+	    pField->type == SHADOW_FIELD_IMAGE_NUMBER) {
+		if (!IsNumber(location)) {
+			LOG_WRN("%s isn't an unsigned number",
+				log_strdup(pField->path));
+			return;
+		}
+		value = jsmn_convert_uint(&json, location);
+		if (value < pField->min || value > pField->max) {
+			LOG_WRN("%s %u is out of range",
+				log_strdup(pField->path), value);
+			return;
+		}
 	}
 
-	location = jsmn_find_type(SHADOW_FOTA_BLOCKSIZE_STR, JSMN_PRIMITIVE,
-				  NEXT_PARENT);
-	if (location > 0) {
-		coap_fota_set_blocksize(jsmn_convert_uint(location));
+	switch (pField->type) {
+	case SHADOW_FIELD_STRING:
+		pField->set.string(p, length);
+		break;
+	case SHADOW_FIELD_NUMBER:
+		pField->set.number(value);
+		break;
+#if defined(CONFIG_COAP_FOTA) || defined(CONFIG_HTTP_FOTA)
+	case SHADOW_FIELD_IMAGE_STRING:
+		pField->set.imageString(pField->image, p, length);
+		break;
+	case SHADOW_FIELD_IMAGE_NUMBER:
+		pField->set.imageNumber(pField->image, value);
+		break;
+#endif
+	case SHADOW_FIELD_OBJECT:
+		pField->set.object();
+		break;
+	default:
+		break;
 	}
 }
-#endif /* CONFIG_COAP_FOTA */
+
+/* Rejects true, false, null and negative numbers. */
+static bool IsNumber(int location)
+{
+	size_t length = jsmn_strlen(&json, location);
+
+	return (length > 0) && (length <= MAX_CONVERSION_STR_LEN) &&
+	       isdigit((int)jsmn_string(&json, location)[0]);
+}
 
 #ifdef CONFIG_SENSOR_TASK
 static void SensorParser(const char *pTopic)
@@ -609,7 +821,7 @@ static void SensorDeltaParser(const char *pTopic)
 	}
 
 	/* The state object contains a string of the values that need to be set. */
-	size_t stateLength = jsmn_strlen(stateIndex);
+	size_t stateLength = jsmn_strlen(&json, stateIndex);
 	size_t bufSize = stateLength + strlen(SENSOR_CMD_SET_PREFIX) +
 			 strlen(SENSOR_CMD_SUFFIX) + 1;
 
@@ -633,7 +845,7 @@ static void SensorDeltaParser(const char *pTopic)
 		/* Format AWS data into a JSON-RPC set command */
 		strcat(pMsg->cmd, SENSOR_CMD_SET_PREFIX);
 		/* JSON string isn't null terminated */
-		strncat(pMsg->cmd, jsmn_string(stateIndex), stateLength);
+		strncat(pMsg->cmd, jsmn_string(&json, stateIndex), stateLength);
 		strcat(pMsg->cmd, SENSOR_CMD_SUFFIX);
 		FRAMEWORK_DEBUG_ASSERT(strlen(pMsg->cmd) == bufSize - 1);
 		FRAMEWORK_MSG_SEND(pMsg);
@@ -642,15 +854,13 @@ static void SensorDeltaParser(const char *pTopic)
 
 static void SensorEventLogParser(const char *pTopic)
 {
-	jsmn_reset_index();
+	jsmn_reset_index(&json);
 
 	/* Now try to find {"state":{"reported": ... "eventLog":
 	 * Parents are required because shadow contains timestamps
 	 * ("eventLog" wont be unique).
 	 */
-	(void)jsmn_find_type("state", JSMN_OBJECT, NEXT_PARENT);
-	(void)jsmn_find_type("reported", JSMN_OBJECT, NEXT_PARENT);
-	(void)jsmn_find_type("eventLog", JSMN_ARRAY, NEXT_PARENT);
+	(void)jsmn_find_path(&json, "state.reported.eventLog", JSMN_ARRAY);
 
 	ParseEventArray(pTopic);
 }
@@ -660,42 +870,51 @@ static void SensorEventLogParser(const char *pTopic)
  * (Zephyr library can't handle anonymous arrays.)
  * ["addrString", epoch, greenlist (boolean)]
  * The epoch isn't used.
+ *
+ * @retval number of sensors added to greenlist messages
  */
-static void ParseArray(int ExpectedSensors)
+static int ParseArray(SensorGreenlistMsg_t **ppMsg, int ExpectedSensors)
 {
-	if (jsmn_index() <= 0) {
-		return;
-	}
-
-	SensorGreenlistMsg_t *pMsg =
-		BP_TRY_TO_TAKE(sizeof(SensorGreenlistMsg_t));
-	if (pMsg == NULL) {
-		return;
+	if (jsmn_index(&json) <= 0) {
+		return 0;
 	}
 
-	size_t maxSensors = MIN(ExpectedSensors, CONFIG_SENSOR_TABLE_SIZE);
 	int sensorsFound = 0;
-	size_t i = jsmn_index();
-	while (((i + CHILD_ARRAY_SIZE) < jsmn_tokens_found()) &&
-	       (sensorsFound < maxSensors)) {
-		int addrLength = jsmn_strlen(i);
-		if ((jsmn_type(i + CHILD_ARRAY_INDEX) == JSMN_ARRAY) &&
-		    (jsmn_size(i + CHILD_ARRAY_INDEX) == CHILD_ARRAY_SIZE) &&
-		    (jsmn_type(i + ARRAY_NAME_INDEX) == JSMN_STRING) &&
-		    (jsmn_size(i + ARRAY_NAME_INDEX) == JSMN_NO_CHILDREN) &&
-		    (jsmn_type(i + ARRAY_EPOCH_INDEX) == JSMN_PRIMITIVE) &&
-		    (jsmn_size(i + ARRAY_EPOCH_INDEX) == JSMN_NO_CHILDREN) &&
-		    (jsmn_type(i + ARRAY_WLIST_INDEX) == JSMN_PRIMITIVE) &&
-		    (jsmn_size(i + ARRAY_WLIST_INDEX) == JSMN_NO_CHILDREN)) {
+	size_t i = jsmn_index(&json);
+	while (((i + CHILD_ARRAY_SIZE) < jsmn_tokens_found(&json)) &&
+	       (sensorsFound < ExpectedSensors)) {
+		int addrLength = jsmn_strlen(&json, i);
+		if ((jsmn_type(&json, i + CHILD_ARRAY_INDEX) == JSMN_ARRAY) &&
+		    (jsmn_size(&json, i + CHILD_ARRAY_INDEX) ==
+		     CHILD_ARRAY_SIZE) &&
+		    (jsmn_type(&json, i + ARRAY_NAME_INDEX) == JSMN_STRING) &&
+		    (jsmn_size(&json, i + ARRAY_NAME_INDEX) ==
+		     JSMN_NO_CHILDREN) &&
+		    (jsmn_type(&json, i + ARRAY_EPOCH_INDEX) ==
+		     JSMN_PRIMITIVE) &&
+		    (jsmn_size(&json, i + ARRAY_EPOCH_INDEX) ==
+		     JSMN_NO_CHILDREN) &&
+		    (jsmn_type(&json, i + ARRAY_WLIST_INDEX) ==
+		     JSMN_PRIMITIVE) &&
+		    (jsmn_size(&json, i + ARRAY_WLIST_INDEX) ==
+		     JSMN_NO_CHILDREN)) {
 			LOG_DBG("Found array at %d", i);
-			strncpy(pMsg->sensors[sensorsFound].addrString,
-				jsmn_string(i + ARRAY_NAME_INDEX),
+			SensorGreenlistMsg_t *pMsg = NextGreenlistMsg(ppMsg);
+			if (pMsg == NULL) {
+				break;
+			}
+			SensorGreenlist_t *pSensor =
+				&pMsg->sensors[pMsg->sensorCount];
+			strncpy(pSensor->addrString,
+				jsmn_string(&json, i + ARRAY_NAME_INDEX),
 				MIN(addrLength, SENSOR_ADDR_STR_LEN));
 			/* The 't' in true is used to determine true/false.
 			 * This is safe because primitives are
 			 * numbers, true, false, and null. */
-			pMsg->sensors[sensorsFound].greenlist =
-				(jsmn_string(i + ARRAY_WLIST_INDEX)[0] == 't');
+			pSensor->greenlist =
+				(jsmn_string(&json, i + ARRAY_WLIST_INDEX)[0] ==
+				 't');
+			pMsg->sensorCount += 1;
 			sensorsFound += 1;
 			i += CHILD_ARRAY_SIZE + 1;
 		} else {
@@ -703,14 +922,38 @@ static void ParseArray(int ExpectedSensors)
 			break;
 		}
 	}
+	return sensorsFound;
+}
 
-	pMsg->header.msgCode = FMC_GREENLIST_REQUEST;
-	pMsg->header.rxId = FWK_ID_SENSOR_TASK;
-	pMsg->sensorCount = sensorsFound;
-	FRAMEWORK_MSG_SEND(pMsg);
+/**
+ * @brief Get a greenlist message with room for another sensor.  A full
+ * message is sent once the next one has been allocated.
+ *
+ * @retval NULL if a message couldn't be allocated
+ */
+static SensorGreenlistMsg_t *NextGreenlistMsg(SensorGreenlistMsg_t **ppMsg)
+{
+	SensorGreenlistMsg_t *pMsg = *ppMsg;
+	if ((pMsg != NULL) &&
+	    (pMsg->sensorCount < SENSOR_GREENLIST_MSG_MAX_SENSORS)) {
+		return pMsg;
+	}
 
-	LOG_INF("Processed %d of %d sensors in desired list from AWS",
-		sensorsFound, ExpectedSensors);
+	SensorGreenlistMsg_t *pNext =
+		BP_TRY_TO_TAKE(sizeof(SensorGreenlistMsg_t));
+	if (pNext == NULL) {
+		return NULL;
+	}
+	pNext->header.msgCode = FMC_GREENLIST_REQUEST;
+	pNext->header.rxId = FWK_ID_SENSOR_TASK;
+	pNext->sensorCount = 0;
+
+	if (pMsg != NULL) {
+		pMsg->more = true;
+		FRAMEWORK_MSG_SEND(pMsg);
+	}
+	*ppMsg = pNext;
+	return pNext;
 }
 
 static void ParseEventArray(const char *pTopic)
@@ -722,34 +965,39 @@ static void ParseEventArray(const char *pTopic)
 	}
 
 	/* If the event log isn't found a message still needs to be sent. */
-	int expectedLogs = jsmn_size(jsmn_index() - 1);
+	int expectedLogs = jsmn_size(&json, jsmn_index(&json) - 1);
 	int maxLogs = 0;
-	if (jsmn_index() <= 0) {
+	if (jsmn_index(&json) <= 0) {
 		LOG_DBG("Could not find event log");
 	} else {
 		maxLogs = MIN(expectedLogs, CONFIG_SENSOR_LOG_MAX_SIZE);
 	}
 
 	/* 1st and 3rd items are hex. {"eventLog":[["01",466280,"0899"]] */
-	size_t i = jsmn_index();
+	size_t i = jsmn_index(&json);
 	size_t j = 0;
-	while (((i + CHILD_ARRAY_SIZE) < jsmn_tokens_found()) &&
+	while (((i + CHILD_ARRAY_SIZE) < jsmn_tokens_found(&json)) &&
 	       (j < maxLogs)) {
-		if ((jsmn_type(i + CHILD_ARRAY_INDEX) == JSMN_ARRAY) &&
-		    (jsmn_size(i + CHILD_ARRAY_INDEX) == CHILD_ARRAY_SIZE) &&
-		    (jsmn_type(i + RECORD_TYPE_INDEX) == JSMN_STRING) &&
-		    (jsmn_size(i + RECORD_TYPE_INDEX) == JSMN_NO_CHILDREN) &&
-		    (jsmn_type(i + ARRAY_EPOCH_INDEX) == JSMN_PRIMITIVE) &&
-		    (jsmn_size(i + ARRAY_EPOCH_INDEX) == JSMN_NO_CHILDREN) &&
-		    (jsmn_type(i + EVENT_DATA_INDEX) == JSMN_STRING) &&
-		    (jsmn_size(i + EVENT_DATA_INDEX) == JSMN_NO_CHILDREN)) {
+		if ((jsmn_type(&json, i + CHILD_ARRAY_INDEX) == JSMN_ARRAY) &&
+		    (jsmn_size(&json, i + CHILD_ARRAY_INDEX) ==
+		     CHILD_ARRAY_SIZE) &&
+		    (jsmn_type(&json, i + RECORD_TYPE_INDEX) == JSMN_STRING) &&
+		    (jsmn_size(&json, i + RECORD_TYPE_INDEX) ==
+		     JSMN_NO_CHILDREN) &&
+		    (jsmn_type(&json, i + ARRAY_EPOCH_INDEX) ==
+		     JSMN_PRIMITIVE) &&
+		    (jsmn_size(&json, i + ARRAY_EPOCH_INDEX) ==
+		     JSMN_NO_CHILDREN) &&
+		    (jsmn_type(&json, i + EVENT_DATA_INDEX) == JSMN_STRING) &&
+		    (jsmn_size(&json, i + EVENT_DATA_INDEX) ==
+		     JSMN_NO_CHILDREN)) {
 			LOG_DBG("Found array at %d", i);
 			pMsg->events[j].recordType =
-				jsmn_convert_hex(i + RECORD_TYPE_INDEX);
+				jsmn_convert_hex(&json, i + RECORD_TYPE_INDEX);
 			pMsg->events[j].epoch =
-				jsmn_convert_uint(i + ARRAY_EPOCH_INDEX);
+				jsmn_convert_uint(&json, i + ARRAY_EPOCH_INDEX);
 			pMsg->events[j].data =
-				jsmn_convert_hex(i + EVENT_DATA_INDEX);
+				jsmn_convert_hex(&json, i + EVENT_DATA_INDEX);
 			LOG_DBG("%u %x,%d,%x", j, pMsg->events[j].recordType,
 				pMsg->events[j].epoch, pMsg->events[j].data);
 			j += 1;
@@ -779,8 +1027,8 @@ static void ParseEventArray(const char *pTopic)
  */
 static int FindState(void)
 {
-	jsmn_reset_index();
-	return jsmn_find_type("state", JSMN_OBJECT, NO_PARENT);
+	jsmn_reset_index(&json);
+	return jsmn_find_type(&json, "state", JSMN_OBJECT, NO_PARENT);
 }
 
 /**
@@ -793,10 +1041,10 @@ static int FindState(void)
  */
 static bool FindUint(uint32_t *pValue, const char *key)
 {
-	jsmn_reset_index();
-	int location = jsmn_find_type(key, JSMN_PRIMITIVE, NO_PARENT);
+	jsmn_reset_index(&json);
+	int location = jsmn_find_type(&json, key, JSMN_PRIMITIVE, NO_PARENT);
 	if (location > 0) {
-		*pValue = jsmn_convert_uint(location);
+		*pValue = jsmn_convert_uint(&json, location);
 		return true;
 	} else {
 		*pValue = 0;
@@ -0,0 +1,124 @@
+/**
+ * @file sensor_index.c
+ * @brief Map a Bluetooth address to its position in a table.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <string.h>
+#include <sys/byteorder.h>
+
+#include "sensor_index.h"
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static uint32_t Hash(const SensorIndex_t *pIndex, const bt_addr_t *pAddr);
+static const bt_addr_t *AddrOf(const SensorIndex_t *pIndex,
+			       size_t TableIndex);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void SensorIndex_Initialize(SensorIndex_t *pIndex, uint16_t *pSlots,
+			    size_t Slots, const bt_addr_t *pFirstAddr,
+			    size_t Stride)
+{
+	size_t i;
+
+	__ASSERT_NO_MSG((Slots & (Slots - 1)) == 0);
+	pIndex->pSlots = pSlots;
+	pIndex->mask = Slots - 1;
+	pIndex->pTable = (const uint8_t *)pFirstAddr;
+	pIndex->stride = Stride;
+
+	for (i = 0; i < Slots; i++) {
+		pSlots[i] = SENSOR_INDEX_EMPTY;
+	}
+}
+
+size_t SensorIndex_Find(const SensorIndex_t *pIndex, const bt_addr_t *pAddr)
+{
+	uint32_t slot = Hash(pIndex, pAddr);
+	size_t probes;
+	for (probes = 0; probes <= pIndex->mask; probes++) {
+		uint16_t i = pIndex->pSlots[slot];
+		if (i == SENSOR_INDEX_EMPTY) {
+			break;
+		}
+		if (memcmp(pAddr->val, AddrOf(pIndex, i)->val,
+			   sizeof(bt_addr_t)) == 0) {
+			return i;
+		}
+		slot = (slot + 1) & pIndex->mask;
+	}
+	return SENSOR_INDEX_EMPTY;
+}
+
+void SensorIndex_Insert(SensorIndex_t *pIndex, size_t TableIndex)
+{
+	uint32_t slot = Hash(pIndex, AddrOf(pIndex, TableIndex));
+	while (pIndex->pSlots[slot] != SENSOR_INDEX_EMPTY) {
+		slot = (slot + 1) & pIndex->mask;
+	}
+	pIndex->pSlots[slot] = (uint16_t)TableIndex;
+}
+
+/* Backward shift deletion keeps probe sequences intact without tombstones. */
+void SensorIndex_Remove(SensorIndex_t *pIndex, size_t TableIndex)
+{
+	uint16_t *pSlots = pIndex->pSlots;
+	uint32_t mask = pIndex->mask;
+	uint32_t slot = Hash(pIndex, AddrOf(pIndex, TableIndex));
+	while (pSlots[slot] != TableIndex) {
+		if (pSlots[slot] == SENSOR_INDEX_EMPTY) {
+			__ASSERT(false, "Entry not in index");
+			return;
+		}
+		slot = (slot + 1) & mask;
+	}
+
+	uint32_t next = slot;
+	while (true) {
+		next = (next + 1) & mask;
+		uint16_t i = pSlots[next];
+		if (i == SENSOR_INDEX_EMPTY) {
+			break;
+		}
+		/* An entry can move into the hole only if its home slot is not
+		 * cyclically between the hole and its current position.
+		 */
+		uint32_t home = Hash(pIndex, AddrOf(pIndex, i));
+		if (((next - home) & mask) >= ((next - slot) & mask)) {
+			pSlots[slot] = i;
+			slot = next;
+		}
+	}
+	pSlots[slot] = SENSOR_INDEX_EMPTY;
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/* Random static addresses are already well distributed, but the upper bits
+ * of the address are constant for a given vendor range so all six bytes
+ * are mixed before the multiplicative hash.
+ */
+static uint32_t Hash(const SensorIndex_t *pIndex, const bt_addr_t *pAddr)
+{
+	const uint8_t *a = pAddr->val;
+	uint32_t h = sys_get_le32(a) ^ ((uint32_t)sys_get_le16(&a[4]) << 7);
+	return (h * 2654435761U) & pIndex->mask;
+}
+
+static const bt_addr_t *AddrOf(const SensorIndex_t *pIndex, size_t TableIndex)
+{
+	return (const bt_addr_t *)(pIndex->pTable +
+				   (TableIndex * pIndex->stride));
+}
@@ -21,11 +21,25 @@ LOG_MODULE_REGISTER(sensor_log);
 /******************************************************************************/
 /* Local Constant, Macro and Type Definitions                                 */
 /******************************************************************************/
+/* Extra room in the JSON cache so that entries are only moved to the start
+ * of the buffer after several events have been added.
+ */
+#define JSON_CACHE_SLACK(size) (((size) / 4) + 1)
+
 struct SensorLog {
 	size_t size;
 	size_t writeIndex;
 	bool wrapped;
 	SensorLogEvent_t *pData;
+	/* The JSON of the entries (oldest first) is in
+	 * pJson[jsonStart, jsonEnd).  The length of each entry is kept in
+	 * the same slot as its event.
+	 */
+	char *pJson;
+	uint8_t *pJsonLength;
+	size_t jsonCapacity;
+	size_t jsonStart;
+	size_t jsonEnd;
 };
 
 /******************************************************************************/
@@ -33,6 +47,8 @@ struct SensorLog {
 /******************************************************************************/
 static size_t GetNumberOfEntries(SensorLog_t *pLog);
 static void IncrementIndices(SensorLog_t *pLog);
+static void AllocateJsonCache(SensorLog_t *pLog);
+static void AddToJsonCache(SensorLog_t *pLog, SensorLogEvent_t *pEvent);
 static void IncrementIndex(size_t *pIndex, size_t Max);
 
 /******************************************************************************/
@@ -50,12 +66,15 @@ SensorLog_t *SensorLog_Allocate(size_t Size)
 		size_t bytes = Size * sizeof(SensorLogEvent_t);
 		p->pData = k_malloc(bytes);
 		memset(p->pData, 0, bytes);
+		AllocateJsonCache(p);
 	}
 	return p;
 }
 
 void SensorLog_Free(SensorLog_t *pLog)
 {
+	k_free(pLog->pJson);
+	k_free(pLog->pJsonLength);
 	k_free(pLog->pData);
 	k_free(pLog);
 }
@@ -66,6 +85,9 @@ void SensorLog_Add(SensorLog_t *pLog, SensorLogEvent_t *pEvent)
 		return;
 	}
 
+	if (pLog->pJson != NULL) {
+		AddToJsonCache(pLog, pEvent);
+	}
 	memcpy(&pLog->pData[pLog->writeIndex], pEvent,
 	       sizeof(SensorLogEvent_t));
 	IncrementIndices(pLog);
@@ -84,11 +106,18 @@ void SensorLog_GenerateJson(SensorLog_t *pLog, JsonMsg_t *pMsg)
 	}
 
 	ShadowBuilder_StartArray(pMsg, "eventLog");
-	size_t readIndex = pLog->wrapped ? pLog->writeIndex : 0;
-	size_t i;
-	for (i = 0; i < entries; i++) {
-		ShadowBuilder_AddEventLogEntry(pMsg, &pLog->pData[readIndex]);
-		IncrementIndex(&readIndex, pLog->size);
+	if ((pMsg->encoding == SHADOW_ENCODING_JSON) && (pLog->pJson != NULL)) {
+		ShadowBuilder_AddEventLogEntries(
+			pMsg, &pLog->pJson[pLog->jsonStart],
+			pLog->jsonEnd - pLog->jsonStart);
+	} else {
+		size_t readIndex = pLog->wrapped ? pLog->writeIndex : 0;
+		size_t i;
+		for (i = 0; i < entries; i++) {
+			ShadowBuilder_AddEventLogEntry(
+				pMsg, &pLog->pData[readIndex]);
+			IncrementIndex(&readIndex, pLog->size);
+		}
 	}
 	ShadowBuilder_EndArray(pMsg);
 }
@@ -98,6 +127,29 @@ size_t SensorLog_GetSize(SensorLog_t *pLog)
 	return (pLog == NULL) ? 0 : pLog->size;
 }
 
+size_t SensorLog_Read(SensorLog_t *pLog, SensorLogEvent_t *pEvents,
+		      size_t Max)
+{
+	if (pLog == NULL) {
+		return 0;
+	}
+
+	size_t total = GetNumberOfEntries(pLog);
+	size_t entries = MIN(total, Max);
+	size_t readIndex = pLog->wrapped ? pLog->writeIndex : 0;
+	size_t i;
+	/* Keep the newest entries. */
+	for (i = entries; i < total; i++) {
+		IncrementIndex(&readIndex, pLog->size);
+	}
+	for (i = 0; i < entries; i++) {
+		memcpy(&pEvents[i], &pLog->pData[readIndex],
+		       sizeof(SensorLogEvent_t));
+		IncrementIndex(&readIndex, pLog->size);
+	}
+	return entries;
+}
+
 /******************************************************************************/
 /* Local Function Definitions                                                 */
 /******************************************************************************/
@@ -114,6 +166,48 @@ static void IncrementIndices(SensorLog_t *pLog)
 	IncrementIndex(&pLog->writeIndex, pLog->size);
 }
 
+/* If the cache can't be allocated, then the JSON is generated from the
+ * events when the log is published.
+ */
+static void AllocateJsonCache(SensorLog_t *pLog)
+{
+	pLog->jsonStart = 0;
+	pLog->jsonEnd = 0;
+	pLog->jsonCapacity = (pLog->size + JSON_CACHE_SLACK(pLog->size)) *
+			     SENSOR_LOG_ENTRY_JSON_STR_SIZE;
+	pLog->pJson = k_malloc(pLog->jsonCapacity);
+	pLog->pJsonLength = k_malloc(pLog->size * sizeof(uint8_t));
+	if (pLog->pJson == NULL || pLog->pJsonLength == NULL) {
+		LOG_WRN("Sensor log JSON cache not allocated");
+		k_free(pLog->pJson);
+		k_free(pLog->pJsonLength);
+		pLog->pJson = NULL;
+		pLog->pJsonLength = NULL;
+	}
+}
+
+/* Must be called before the write index is incremented. */
+static void AddToJsonCache(SensorLog_t *pLog, SensorLogEvent_t *pEvent)
+{
+	/* The oldest entry is being replaced. */
+	if (pLog->wrapped) {
+		pLog->jsonStart += pLog->pJsonLength[pLog->writeIndex];
+	}
+
+	if ((pLog->jsonEnd + SENSOR_LOG_ENTRY_JSON_STR_SIZE) >
+	    pLog->jsonCapacity) {
+		size_t length = pLog->jsonEnd - pLog->jsonStart;
+		memmove(pLog->pJson, &pLog->pJson[pLog->jsonStart], length);
+		pLog->jsonStart = 0;
+		pLog->jsonEnd = length;
+	}
+
+	size_t n = ShadowBuilder_FormatEventLogEntry(
+		&pLog->pJson[pLog->jsonEnd], pEvent);
+	pLog->pJsonLength[pLog->writeIndex] = (uint8_t)n;
+	pLog->jsonEnd += n;
+}
+
 static void IncrementIndex(size_t *pIndex, size_t Max)
 {
 	(*pIndex)++;
@@ -0,0 +1,104 @@
+/**
+ * @file sensor_shell.c
+ * @brief
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <shell/shell.h>
+#include <init.h>
+
+#include "sensor_task.h"
+#include "sensor_table.h"
+#include "sensor_gateway_parser.h"
+#ifdef CONFIG_SENSOR_ADV_FILTER
+#include "sensor_adv_filter.h"
+#endif
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static int shell_sensor_stats_cmd(const struct shell *shell, size_t argc,
+				  char **argv)
+{
+	SensorTaskAdStats_t ads;
+	SensorTask_GetAdStats(&ads);
+	shell_print(shell, "ads processed: %u", ads.processed);
+	shell_print(shell, "ads dropped: %u", ads.dropped);
+	shell_print(shell, "ads queued: %u", ads.queued);
+
+#ifdef CONFIG_SENSOR_ADV_FILTER
+	SensorAdvFilterStats_t filter;
+	SensorAdvFilter_GetStats(&filter, false);
+	uint32_t total = filter.forwarded + filter.filtered;
+	shell_print(shell, "ads forwarded: %u", filter.forwarded);
+	shell_print(shell, "ads filtered: %u (%u%%)", filter.filtered,
+		    (total == 0) ? 0 : (uint32_t)((100ULL * filter.filtered) /
+						  total));
+#endif
+
+	SensorTableStats_t table;
+	SensorTable_GetStats(&table);
+	shell_print(shell, "sensors: %u/%u", table.count,
+		    CONFIG_SENSOR_TABLE_SIZE);
+	shell_print(shell, "greenlisted: %u", table.greenlisted);
+	shell_print(shell, "details in use: %u", table.details);
+	shell_print(shell, "evictions: %u", table.evictions);
+	shell_print(shell, "drops of untracked sensors: %u",
+		    table.dropsUntracked);
+	shell_print(shell, "shadow full publishes: %u",
+		    table.shadowFullPublishes);
+	shell_print(shell, "shadow delta publishes: %u",
+		    table.shadowDeltaPublishes);
+	shell_print(shell, "shadow bytes saved: %u", table.shadowBytesSaved);
+	shell_print(shell, "gateway shadow publishes: %u",
+		    table.gatewayShadowPublishes);
+	shell_print(shell, "gateway shadow unchanged: %u",
+		    table.gatewayShadowSkipped);
+	shell_print(shell, "gateway shadow pages: %u",
+		    table.gatewayShadowPages);
+	shell_print(shell, "snapshot writes: %u", table.snapshotWrites);
+
+	SensorGatewayParserStats_t parser;
+	SensorGatewayParser_GetStats(&parser);
+	shell_print(shell, "shadow documents parsed: %u", parser.parsed);
+	shell_print(shell, "shadow duplicates skipped: %u (%u bytes)",
+		    parser.duplicates, parser.duplicateBytes);
+
+	return 0;
+}
+
+static int shell_sensor_drops_cmd(const struct shell *shell, size_t argc,
+				  char **argv)
+{
+	SensorTableDrops_t drops;
+	size_t index = 0;
+	uint32_t n = 0;
+	while (SensorTable_GetNextDrops(&index, &drops)) {
+		shell_print(shell, "%s %u", drops.addrString, drops.dropped);
+		n += 1;
+	}
+	shell_print(shell, "sensors with drops: %u", n);
+
+	return 0;
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+SHELL_STATIC_SUBCMD_SET_CREATE(
+	sensor_cmds,
+	SHELL_CMD(stats, NULL, "Sensor advertisement and table statistics",
+		  shell_sensor_stats_cmd),
+	SHELL_CMD(drops, NULL, "Advertisements dropped for each sensor",
+		  shell_sensor_drops_cmd),
+	SHELL_SUBCMD_SET_END /* Array terminated. */
+);
+
+SHELL_CMD_REGISTER(sensor, &sensor_cmds, "Sensor commands", NULL);
@@ -18,6 +18,7 @@ LOG_MODULE_REGISTER(sensor_table, CONFIG_SENSOR_TABLE_LOG_LEVEL);
 #include <string.h>
 #include <zephyr.h>
 #include <bluetooth/bluetooth.h>
+#include <sys/crc.h>
 
 #include "lcz_bluetooth.h"
 #include "lcz_qrtc.h"
@@ -29,8 +30,17 @@ LOG_MODULE_REGISTER(sensor_table, CONFIG_SENSOR_TABLE_LOG_LEVEL);
 #include "lcz_sensor_adv_match.h"
 #include "sensor_log.h"
 #include "bt510_flags.h"
+#include "bt510_records.h"
 #include "sensor_table.h"
+#include "sensor_index.h"
 #include "attr.h"
+#ifdef CONFIG_SENSOR_ADV_FILTER
+#include "sensor_adv_filter.h"
+#endif
+
+#ifdef CONFIG_SENSOR_TABLE_SNAPSHOT
+#include "file_system_utilities.h"
+#endif
 
 #ifdef CONFIG_SD_CARD_LOG
 #include "sdcard_log.h"
@@ -84,35 +94,98 @@ BUILD_ASSERT(((sizeof(SENSOR_SUBSCRIPTION_TOPIC_FMT_STR) +
 	       SENSOR_ADDR_STR_LEN) < CONFIG_AWS_TOPIC_MAX_SIZE),
 	     "Topic too small");
 
-#define MAX_KEY_STR_LEN 64
-#define MANGLED_NAME_MAX_STR_LEN                                               \
-	(SENSOR_NAME_MAX_SIZE + sizeof('-') + MAX_KEY_STR_LEN)
-#define MANGLED_NAME_MAX_SIZE (MANGLED_NAME_MAX_STR_LEN + 1)
 
-/* {"reported":{"bt510":{"sensors":[["c13a7e4118a2",<epoch>,false], .... */
-#define SENSOR_GATEWAY_SHADOW_MAX_SIZE 600
+/* {"state":{"desired":null,"reported":{"bt510":{"sensorPages":<pages>,
+ * "sensors<page>":[["c13a7e4118a2",<epoch>,false], ...
+ */
+#define SENSOR_GATEWAY_SHADOW_HEADER_SIZE 128
+#define SENSOR_GATEWAY_SHADOW_ENTRY_SIZE                                       \
+	sizeof("[\"c13a7e4118a2\",4294967295,false],")
+#define SENSOR_GATEWAY_SHADOW_MAX_SIZE                                         \
+	(SENSOR_GATEWAY_SHADOW_HEADER_SIZE +                                   \
+	 (CONFIG_SENSOR_GATEWAY_SHADOW_PAGE_SIZE *                             \
+	  SENSOR_GATEWAY_SHADOW_ENTRY_SIZE))
 CHECK_BUFFER_SIZE(FWK_BUFFER_MSG_SIZE(JsonMsg_t,
 				      SENSOR_GATEWAY_SHADOW_MAX_SIZE));
 
+#define RSSI_UNKNOWN -127
+
+BUILD_ASSERT(CONFIG_SENSOR_TTL_SECONDS <= UINT16_MAX, "TTL too large");
+
+/* Pending actions that can't be completed (or that must be repeated until
+ * the cloud responds) are retried at this rate.  At 1 second there are
+ * duplicate requests for shadow information.
+ */
+#define SENSOR_ACTION_RETRY_MS (3 * MSEC_PER_SEC)
+
+/* Hot state is touched for every advertisement and is kept for every
+ * tracked sensor.  It is kept small so that the table can hold hundreds
+ * of sensors.
+ */
 typedef struct SensorEntry {
+	bt_addr_t addr;
+	uint16_t id; /* of last event */
+	uint16_t flags; /* of last event */
+	uint16_t detail; /* index into detail pool */
+	int8_t rssi;
+	uint8_t inUse : 1;
+	uint8_t validAd : 1;
+	uint8_t validRsp : 1;
+	uint8_t greenlisted : 1;
+	uint8_t expired : 1; /* TTL elapsed while greenlisted */
+	uint32_t rxEpoch;
+#ifdef CONFIG_SENSOR_TABLE_REPLACEMENT_LRU
+	uint16_t lruPrev;
+	uint16_t lruNext;
+	uint16_t lastSeen; /* uptime in seconds (modulo 2^16) */
+#endif
+} SensorEntry_t;
+
+/* What the cloud was last told about a sensor.  A full shadow is sent when
+ * the snapshot isn't valid; otherwise only the fields that changed are sent.
+ */
+typedef struct ShadowSnapshot {
+	bool valid;
+	int8_t rssi;
+	uint16_t publishes;
+	uint32_t networkId;
+	uint32_t flags;
+	uint32_t resetCount;
+	/* The scan response and name are compared by their CRC */
+	uint32_t rspCrc;
+	uint32_t nameCrc;
+	int64_t refreshTime;
+	size_t fullLength;
+} ShadowSnapshot_t;
+
+#if CONFIG_USE_SINGLE_AWS_TOPIC
+/* Keys are generated when the name of the sensor changes. */
+typedef struct SingleTopicKeys {
+#define X(member, key) char member[SENSOR_NAME_MAX_STR_LEN + sizeof("-" key)];
+	BT510_SINGLE_TOPIC_KEY_TABLE(X)
+#undef X
+} SingleTopicKeys_t;
+#endif
+
+/* Cold state is only required for sensors that send data to the cloud
+ * (greenlisted) or that can be connected to.  When using a single topic,
+ * every sensor publishes (name is required).
+ */
+typedef struct SensorDetail {
 	bool inUse;
-	bool validAd;
-	bool validRsp;
+	/* The single topic keys are generated from the name */
 	bool updatedName;
-	bool updatedRsp;
+	uint16_t tableIndex;
 	char name[SENSOR_NAME_MAX_SIZE];
 	char addrString[SENSOR_ADDR_STR_SIZE];
 	LczSensorAdEvent_t ad;
 	LczSensorRsp_t rsp;
 	int8_t rssi;
 	uint8_t lastRecordType;
-	uint32_t rxEpoch;
-	bool greenlisted;
 	bool subscribed;
 	bool getAcceptedSubscribed;
 	bool shadowInitReceived;
 	uint64_t subscriptionDispatchTime;
-	uint32_t ttl;
 	void *pCmd;
 	void *pSecondCmd;
 	uint64_t configDispatchTime;
@@ -122,11 +195,68 @@ typedef struct SensorEntry {
 	bool dumpBusy;
 	bool firstDumpComplete;
 	uint32_t adCount;
-	uint16_t lastFlags;
+	uint32_t adsDropped;
+	bool adFilterBypass;
 	SensorLog_t *pLog;
-} SensorEntry_t;
+	ShadowSnapshot_t reported;
+	/* Becomes the reported snapshot when the shadow is acknowledged */
+	ShadowSnapshot_t sent;
+	uint32_t sentId;
+#if CONFIG_USE_SINGLE_AWS_TOPIC
+	SingleTopicKeys_t keys;
+#endif
+} SensorDetail_t;
 
-#define RSSI_UNKNOWN -127
+#ifdef CONFIG_SENSOR_TABLE_SNAPSHOT
+/* Greenlisted sensors and their event logs are saved so that they don't
+ * have to be read from the cloud after a reset.
+ */
+#define SNAPSHOT_FILE_NAME CONFIG_FSU_MOUNT_POINT "/sensor_table.bin"
+#define SNAPSHOT_MAGIC 0x53544231 /* STB1 */
+#define SNAPSHOT_VERSION 1
+
+typedef struct SnapshotHeader {
+	uint32_t magic;
+	uint16_t version;
+	uint16_t count;
+	uint16_t recordSize;
+	uint16_t logSize;
+	uint32_t crc; /* of records */
+} SnapshotHeader_t;
+
+typedef struct SnapshotRecord {
+	bt_addr_t addr;
+	uint16_t id;
+	uint16_t flags;
+	uint8_t validAd;
+	uint8_t validRsp;
+	uint8_t firstDumpComplete;
+	uint8_t logCount;
+	uint32_t rxEpoch;
+	char name[SENSOR_NAME_MAX_SIZE];
+	LczSensorAdEvent_t ad;
+	LczSensorRsp_t rsp;
+	SensorLogEvent_t log[CONFIG_SENSOR_LOG_MAX_SIZE];
+} SnapshotRecord_t;
+#endif
+
+/* A sensor that is removed from the greenlist keeps its detail until it
+ * has been unsubscribed.  Twice the greenlist size leaves room for this.
+ */
+#if CONFIG_USE_SINGLE_AWS_TOPIC
+#define SENSOR_DETAIL_POOL_SIZE CONFIG_SENSOR_TABLE_SIZE
+#else
+#define SENSOR_DETAIL_POOL_SIZE                                                \
+	MIN(2 * CONFIG_SENSOR_GREENLIST_SIZE, CONFIG_SENSOR_TABLE_SIZE)
+#endif
+
+#define SENSOR_DETAIL_NONE UINT16_MAX
+
+BUILD_ASSERT(SENSOR_INDEX_SLOTS(CONFIG_SENSOR_TABLE_SIZE) >=
+		     (2 * CONFIG_SENSOR_TABLE_SIZE),
+	     "Sensor table too large for address index");
+BUILD_ASSERT(CONFIG_SENSOR_TABLE_SIZE < SENSOR_INDEX_EMPTY,
+	     "Sensor table index must fit in 16 bits");
 
 /******************************************************************************/
 /* Local Data Definitions                                                     */
@@ -134,17 +264,95 @@ typedef struct SensorEntry {
 static size_t tableCount;
 static SensorEntry_t sensorTable[CONFIG_SENSOR_TABLE_SIZE];
 static char queryCmd[CONFIG_SENSOR_QUERY_CMD_MAX_SIZE];
-static uint64_t ttlUptime;
 static bool allowGatewayShadowGeneration;
+
+/* Gateway shadow changes are collected and published at most once per
+ * minimum interval.  Only the pages that contain changed table slots are
+ * published.
+ */
+static struct {
+	bool dirty;
+	bool greenlistProcessed;
+	int64_t publishTime;
+	uint32_t publishes;
+	uint32_t skipped;
+} gatewayShadow;
+
+typedef struct GatewayShadowPage {
+	bool dirty;
+	bool crcValid;
+	uint32_t crc;
+} GatewayShadowPage_t;
+
+static GatewayShadowPage_t gatewayShadowPages[SENSOR_GATEWAY_SHADOW_PAGES];
+static size_t greenlistChanged;
 static size_t greenCount;
 
+/* Maps a Bluetooth address to a sensor table index (O(1) lookup per ad). */
+static SensorIndex_t addrIndex;
+static uint16_t addrIndexSlots[SENSOR_INDEX_SLOTS(CONFIG_SENSOR_TABLE_SIZE)];
+/* Stack of unused table entries */
+static uint16_t freeList[CONFIG_SENSOR_TABLE_SIZE];
+static size_t freeCount;
+
+static SensorDetail_t detailPool[SENSOR_DETAIL_POOL_SIZE];
+static uint16_t detailFreeList[SENSOR_DETAIL_POOL_SIZE];
+static size_t detailFreeCount;
+
+/* Deadlines are kept in a min-heap so that only entries that are due are
+ * visited.  Each table entry has a node for its time-to-live and each
+ * detail has a node for its next pending cloud action.  Deadlines are
+ * uptime in milliseconds (modulo 2^32).
+ */
+#define SCHED_NODES (CONFIG_SENSOR_TABLE_SIZE + SENSOR_DETAIL_POOL_SIZE)
+#define SCHED_TTL_NODE(tableIndex) (tableIndex)
+#define SCHED_DETAIL_NODE(detailIndex)                                         \
+	(CONFIG_SENSOR_TABLE_SIZE + (detailIndex))
+#define SCHED_NONE UINT16_MAX
+BUILD_ASSERT(SCHED_NODES < SCHED_NONE, "Too many scheduler nodes");
+
+static uint16_t schedHeap[SCHED_NODES];
+static uint16_t schedPos[SCHED_NODES];
+static uint32_t schedDeadline[SCHED_NODES];
+static size_t schedCount;
+
+/* Most recently seen sensor is at the head of the list. */
+#ifdef CONFIG_SENSOR_TABLE_REPLACEMENT_LRU
+static uint16_t lruHead;
+static uint16_t lruTail;
+#endif
+static uint32_t evictions;
+/* Drops of sensors without a detail entry */
+static uint32_t dropsUntracked;
+
+#ifdef CONFIG_SENSOR_TABLE_SNAPSHOT
+static struct {
+	bool dirty;
+	bool crcValid;
+	uint16_t count;
+	uint32_t crc;
+	int64_t saveTime;
+	uint32_t writes;
+} snapshot;
+#endif
+
+static uint32_t shadowFullPublishes;
+static uint32_t shadowDeltaPublishes;
+static uint32_t shadowPublishId;
+static uint32_t shadowBytesSaved;
+
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
 static void ClearTable(void);
-static void ClearEntry(SensorEntry_t *pEntry);
-static void FreeCmdBuffers(SensorEntry_t *pEntry);
-static void FreeEntryBuffers(SensorEntry_t *pEntry);
+static void FreeCmdBuffers(SensorDetail_t *pDetail);
+static void UpdateAdFilter(SensorDetail_t *pDetail);
+static void FreeDetailBuffers(SensorDetail_t *pDetail);
+
+static SensorDetail_t *AllocateDetail(size_t TableIndex);
+static void FreeDetail(SensorEntry_t *pEntry);
+static SensorDetail_t *DetailOf(SensorEntry_t *pEntry);
+static SensorEntry_t *EntryOf(SensorDetail_t *pDetail);
 
 static size_t AddByScanResponse(const bt_addr_le_t *pAddr,
 				AdHandle_t *pNameHandle, LczSensorRsp_t *pRsp,
@@ -152,46 +360,99 @@ static size_t AddByScanResponse(const bt_addr_le_t *pAddr,
 static size_t AddByAddress(const bt_addr_t *pAddr);
 static void AddEntry(SensorEntry_t *pEntry, const bt_addr_t *pAddr,
 		     int8_t Rssi);
+static void RemoveEntry(SensorEntry_t *pEntry);
 static size_t FindTableIndex(const bt_addr_le_t *pAddr);
+static size_t FindTableIndexByString(const char *pAddrString);
 static size_t FindFirstFree(void);
+static size_t FindOrEvict(void);
+
+static void LruTouch(size_t Index);
+static void LruInsert(size_t Index);
+static void LruRemove(size_t Index);
+static bool Evictable(SensorEntry_t *pEntry);
+static size_t EvictEntry(void);
+
+static bool DeadlineBefore(uint32_t A, uint32_t B);
+static void SchedSwap(size_t A, size_t B);
+static void SchedSiftUp(size_t Pos);
+static void SchedSiftDown(size_t Pos);
+static void SchedSet(size_t Node, uint32_t Deadline);
+static void SchedRemove(size_t Node);
+static void ScheduleDetail(SensorDetail_t *pDetail, uint32_t NotBefore);
+static uint32_t DueTime(uint64_t DispatchTime);
+static void TimeToLiveExpired(SensorEntry_t *pEntry);
+static void DetailActionHandler(SensorDetail_t *pDetail, bool *pInitShadow);
+
+static void SnapshotMarkDirty(void);
+#ifdef CONFIG_SENSOR_TABLE_SNAPSHOT
+static void SnapshotSave(void);
+static void SnapshotRestore(void);
+static void SnapshotRestoreRecord(SnapshotRecord_t *pRecord);
+#endif
+static void SubscriptionHandler(SensorDetail_t *pDetail);
+static void ConfigRequestHandler(SensorDetail_t *pDetail);
+static void GetAcceptedSubscriptionHandler(SensorDetail_t *pDetail);
+static bool InitShadowHandler(SensorDetail_t *pDetail);
+
+static size_t IndexFind(const bt_addr_t *pAddr);
 static void AdEventHandler(LczSensorAdEvent_t *p, int8_t Rssi, uint32_t Index);
 
-static bool AddrMatch(const void *p, size_t Index);
-static bool AddrStringMatch(const char *str, size_t Index);
-static bool NameMatch(const char *p, size_t Index);
-static bool RspMatch(const LczSensorRsp_t *p, size_t Index);
-static bool NewEvent(uint16_t Id, size_t Index);
+static bool NameMatch(const char *p, SensorDetail_t *pDetail);
+static bool RspMatch(const LczSensorRsp_t *p, SensorDetail_t *pDetail);
+static bool NewEvent(uint16_t Id, SensorEntry_t *pEntry);
 
-static void SensorAddrToString(SensorEntry_t *pEntry);
+static void AddrToString(const bt_addr_t *pAddr, char *pStr);
 static bt_addr_t BtAddrStringToStruct(const char *pAddrString);
 
-static void ShadowMaker(SensorEntry_t *pEntry);
-static void ShadowTemperatureHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry);
-static void ShadowEventHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry);
-static void ShadowIg60EventHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry);
-static void ShadowBtHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry);
-static void ShadowAdHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry);
-static void ShadowRspHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry);
-static void ShadowFlagHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry);
-static void ShadowLogHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry);
-static void ShadowSpecialHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry);
+static void ShadowMaker(SensorDetail_t *pDetail);
+static bool ShadowFullRefreshRequired(SensorDetail_t *pDetail);
+static uint32_t ShadowPublished(SensorDetail_t *pDetail, bool Full,
+				size_t Length);
+static void ShadowCommit(SensorDetail_t *pDetail);
+static void ShadowInvalidate(SensorDetail_t *pDetail);
+static uint32_t RspCrc(SensorDetail_t *pDetail);
+static uint32_t NameCrc(SensorDetail_t *pDetail);
+static void ShadowRecordHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail);
+static void ShadowIg60RecordHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail);
+static void ShadowAddTEMPERATURE(JsonMsg_t *pMsg, const char *pKey,
+				 SensorDetail_t *pDetail);
+static void ShadowAddBATTERY(JsonMsg_t *pMsg, const char *pKey,
+			     SensorDetail_t *pDetail);
+static void ShadowAddRESET_REASON(JsonMsg_t *pMsg, const char *pKey,
+				  SensorDetail_t *pDetail);
+#if CONFIG_USE_SINGLE_AWS_TOPIC
+static void ShadowSingleTopicHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail);
+#endif
+static void ShadowBtHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail,
+			    bool Full);
+static void ShadowAdHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail,
+			    bool Full);
+static void ShadowRspHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail,
+			     bool Full);
+static void ShadowFlagHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail,
+			      bool Full);
+static void ShadowLogHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail,
+			     bool Full);
+static void ShadowSpecialHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail);
+static void GatewayShadowChanged(size_t TableIndex);
 static void GatewayShadowMaker(bool GreenlistProcessed);
+static void GatewayShadowPublish(void);
+static int GatewayShadowPublishPage(size_t Page, bool DesiredNull);
 
-static char *MangleKey(const char *pKey, const char *pName);
 static size_t GreenlistByAddress(const char *pAddrString, bool NextState);
 static void Greenlist(SensorEntry_t *pEntry, bool Enable);
 
-static int32_t GetTemperature(SensorEntry_t *pEntry);
-static uint32_t GetBattery(SensorEntry_t *pEntry);
+static int32_t GetTemperature(SensorDetail_t *pDetail);
+static uint32_t GetBattery(SensorDetail_t *pDetail);
 static bool LowBatteryAlarm(SensorEntry_t *pEntry);
 
 static void ConnectRequestHandler(size_t Index, bool Coded);
-static void CreateDumpRequest(SensorEntry_t *pEntry);
-static void CreateConfigRequest(SensorEntry_t *pEntry);
+static void CreateDumpRequest(SensorDetail_t *pDetail);
+static void CreateConfigRequest(SensorDetail_t *pDetail);
 
 static uint32_t GetFlag(uint16_t Value, uint32_t Mask, uint8_t Position);
 
-static void PublishToGetAccepted(SensorEntry_t *pEntry);
+static void PublishToGetAccepted(SensorDetail_t *pDetail);
 
 static bool IsBt510(uint8_t productId);
 
@@ -203,27 +464,40 @@ void SensorTable_Initialize(void)
 	ClearTable();
 	strncpy(queryCmd, SENSOR_CMD_DEFAULT_QUERY,
 		CONFIG_SENSOR_QUERY_CMD_MAX_SIZE - 1);
+
+#ifdef CONFIG_SENSOR_TABLE_SNAPSHOT
+	SnapshotRestore();
+#endif
+
+	LOG_INF("Sensor table: %u sensors, %u bytes each; %u details, %u bytes each",
+		CONFIG_SENSOR_TABLE_SIZE,
+		(sizeof(sensorTable) + sizeof(addrIndexSlots) +
+		 sizeof(freeList)) /
+			CONFIG_SENSOR_TABLE_SIZE,
+		SENSOR_DETAIL_POOL_SIZE,
+		sizeof(SensorDetail_t) + sizeof(uint16_t));
 }
 
 /* If a new event has occurred then generate a message to send sensor event
  * data to AWS.
  */
 void SensorTable_AdvertisementHandler(const bt_addr_le_t *pAddr, int8_t rssi,
-				      uint8_t type, Ad_t *pAd)
+				      uint8_t type, uint8_t *pData,
+				      size_t Length)
 
 {
 	ARG_UNUSED(type);
 	bool coded = false;
 
 	/* Filter on presence of manufacturer specific data */
-	AdHandle_t manHandle =
-		AdFind_Type(pAd->data, pAd->len, BT_DATA_MANUFACTURER_DATA,
-			    BT_DATA_INVALID);
+	AdHandle_t manHandle = AdFind_Type(pData, Length,
+					   BT_DATA_MANUFACTURER_DATA,
+					   BT_DATA_INVALID);
 	if (manHandle.pPayload == NULL) {
 		return;
 	}
 
-	AdHandle_t nameHandle = AdFind_Name(pAd->data, pAd->len);
+	AdHandle_t nameHandle = AdFind_Name(pData, Length);
 	size_t tableIndex = CONFIG_SENSOR_TABLE_SIZE;
 	/* Take name from scan response and use it to populate table.
 	 * If device is already in table,
@@ -249,7 +523,7 @@ void SensorTable_AdvertisementHandler(const bt_addr_le_t *pAddr, int8_t rssi,
 		size_t tableIndex = FindTableIndex(pAddr);
 		if (tableIndex < CONFIG_SENSOR_TABLE_SIZE) {
 			FRAMEWORK_DEBUG_ASSERT(
-				memcmp(sensorTable[tableIndex].ad.addr.val,
+				memcmp(sensorTable[tableIndex].addr.val,
 				       pAddr->a.val, sizeof(bt_addr_t)) == 0);
 		}
 		/* Filtering out the BT610 requires using the product ID.
@@ -283,10 +557,84 @@ void SensorTable_AdvertisementHandler(const bt_addr_le_t *pAddr, int8_t rssi,
 
 	if (tableIndex < CONFIG_SENSOR_TABLE_SIZE) {
 		ConnectRequestHandler(tableIndex, coded);
-		sensorTable[tableIndex].adCount += 1;
-		VERBOSE_AD_LOG("'%s' %u",
-			       log_strdup(sensorTable[tableIndex].name),
-			       sensorTable[tableIndex].adCount);
+		SensorDetail_t *pDetail = DetailOf(&sensorTable[tableIndex]);
+		if (pDetail != NULL) {
+			pDetail->adCount += 1;
+			VERBOSE_AD_LOG("'%s' %u", log_strdup(pDetail->name),
+				       pDetail->adCount);
+		}
+	}
+}
+
+void SensorTable_AdvertisementDropped(const bt_addr_t *pAddr)
+{
+	size_t i = IndexFind(pAddr);
+	if (i < CONFIG_SENSOR_TABLE_SIZE) {
+		SensorDetail_t *pDetail = DetailOf(&sensorTable[i]);
+		if (pDetail != NULL) {
+			pDetail->adsDropped += 1;
+			VERBOSE_AD_LOG("'%s' dropped %u",
+				       log_strdup(pDetail->name),
+				       pDetail->adsDropped);
+			return;
+		}
+	}
+	dropsUntracked += 1;
+}
+
+bool SensorTable_GetNextDrops(size_t *pIndex, SensorTableDrops_t *pDrops)
+{
+	while (*pIndex < SENSOR_DETAIL_POOL_SIZE) {
+		SensorDetail_t *p = &detailPool[*pIndex];
+		*pIndex += 1;
+		if (p->inUse && p->adsDropped > 0) {
+			strncpy(pDrops->addrString, p->addrString,
+				SENSOR_ADDR_STR_SIZE - 1);
+			pDrops->addrString[SENSOR_ADDR_STR_SIZE - 1] = 0;
+			pDrops->dropped = p->adsDropped;
+			return true;
+		}
+	}
+	return false;
+}
+
+void SensorTable_GetStats(SensorTableStats_t *pStats)
+{
+	pStats->count = tableCount;
+	pStats->greenlisted = greenCount;
+	pStats->details = SENSOR_DETAIL_POOL_SIZE - detailFreeCount;
+	pStats->evictions = evictions;
+	pStats->dropsUntracked = dropsUntracked;
+	pStats->shadowFullPublishes = shadowFullPublishes;
+	pStats->shadowDeltaPublishes = shadowDeltaPublishes;
+	pStats->shadowBytesSaved = shadowBytesSaved;
+	pStats->gatewayShadowPublishes = gatewayShadow.publishes;
+	pStats->gatewayShadowSkipped = gatewayShadow.skipped;
+	pStats->gatewayShadowPages = SENSOR_GATEWAY_SHADOW_PAGES;
+#ifdef CONFIG_SENSOR_TABLE_SNAPSHOT
+	pStats->snapshotWrites = snapshot.writes;
+#else
+	pStats->snapshotWrites = 0;
+#endif
+}
+
+void SensorTable_GatewayShadowPageKey(char *pKey, size_t Size, size_t Page)
+{
+	if (Page == 0) {
+		snprintk(pKey, Size, "%s", SENSOR_GATEWAY_SHADOW_PAGE_KEY);
+	} else {
+		snprintk(pKey, Size, "%s%u", SENSOR_GATEWAY_SHADOW_PAGE_KEY,
+			 Page);
+	}
+}
+
+void SensorTable_GatewayShadowHandler(void)
+{
+	if (gatewayShadow.dirty &&
+	    (k_uptime_get() - gatewayShadow.publishTime) >=
+		    (CONFIG_SENSOR_GATEWAY_SHADOW_MIN_INTERVAL_SECONDS *
+		     MSEC_PER_SEC)) {
+		GatewayShadowPublish();
 	}
 }
 
@@ -300,29 +648,34 @@ void SensorTable_ProcessGreenlistRequest(SensorGreenlistMsg_t *pMsg)
 	}
 	LOG_DBG("Greenlist setting changed for %u sensors", changed);
 
+	/* A large request is split into several messages.  The
+	 * acknowledgement is sent after the last one.
+	 */
+	greenlistChanged += changed;
+	if (pMsg->more) {
+		return;
+	}
+
 	/* Filter out deltas due to timestamp changing. */
-	if (changed > 0) {
+	if (greenlistChanged > 0) {
 		GatewayShadowMaker(true);
 	}
+	greenlistChanged = 0;
 }
 
 DispatchResult_t SensorTable_AddConfigRequest(SensorCmdMsg_t *pMsg)
 {
-	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		if (AddrStringMatch(pMsg->addrString, i)) {
-			break;
-		}
+	size_t i = FindTableIndexByString(pMsg->addrString);
+	SensorDetail_t *p = NULL;
+	if (i < CONFIG_SENSOR_TABLE_SIZE) {
+		p = DetailOf(&sensorTable[i]);
 	}
-
-	if (i >= CONFIG_SENSOR_TABLE_SIZE) {
+	if (p == NULL) {
 		LOG_ERR("Config request sensor not found");
 		return DISPATCH_ERROR;
 	}
 
-	SensorEntry_t *p = &sensorTable[i];
-
-	if (LowBatteryAlarm(p)) {
+	if (LowBatteryAlarm(&sensorTable[i])) {
 		/* A sensor in low battery mode is unable to write flash. */
 		LOG_WRN("Unable to accept config for sensor in low battery mode");
 		return DISPATCH_OK;
@@ -371,6 +724,7 @@ DispatchResult_t SensorTable_AddConfigRequest(SensorCmdMsg_t *pMsg)
 					pMsg->configVersion);
 			}
 			p->pCmd = pMsg;
+			UpdateAdFilter(p);
 			return DISPATCH_DO_NOT_FREE;
 		}
 	}
@@ -388,11 +742,16 @@ DispatchResult_t SensorTable_RetryConfigRequest(SensorCmdMsg_t *pMsg)
 	FRAMEWORK_ASSERT(pMsg->tableIndex < CONFIG_SENSOR_TABLE_SIZE);
 
 	if (pMsg->tableIndex < CONFIG_SENSOR_TABLE_SIZE) {
-		SensorEntry_t *pEntry = &sensorTable[pMsg->tableIndex];
+		SensorDetail_t *pDetail =
+			DetailOf(&sensorTable[pMsg->tableIndex]);
 
-		if (pEntry->pCmd == NULL) {
-			pEntry->configBusy = false;
-			pEntry->pCmd = pMsg;
+		if (pDetail == NULL) {
+			LOG_ERR("Discarding config request: Sensor not greenlisted");
+			return DISPATCH_OK;
+		} else if (pDetail->pCmd == NULL) {
+			pDetail->configBusy = false;
+			pDetail->pCmd = pMsg;
+			UpdateAdFilter(pDetail);
 			return DISPATCH_DO_NOT_FREE;
 		} else {
 			LOG_ERR("Discarding config request: Command not empty");
@@ -409,20 +768,26 @@ void SensorTable_AckConfigRequest(SensorCmdMsg_t *pMsg)
 	FRAMEWORK_ASSERT(pMsg != NULL);
 	FRAMEWORK_ASSERT(pMsg->tableIndex < CONFIG_SENSOR_TABLE_SIZE);
 
+	SensorDetail_t *pDetail = NULL;
 	if (pMsg->tableIndex < CONFIG_SENSOR_TABLE_SIZE) {
-		SensorEntry_t *pEntry = &sensorTable[pMsg->tableIndex];
+		pDetail = DetailOf(&sensorTable[pMsg->tableIndex]);
+	}
+
+	if (pDetail != NULL) {
 		/* After AWS config was written and sensor was reset,
 		 * send dump request to read state.
 		 */
-		pEntry->configBusy = false;
-		if (pEntry->pSecondCmd != NULL) {
-			pEntry->pCmd = pEntry->pSecondCmd;
-			pEntry->pSecondCmd = NULL;
+		pDetail->configBusy = false;
+		if (pDetail->pSecondCmd != NULL) {
+			pDetail->pCmd = pDetail->pSecondCmd;
+			pDetail->pSecondCmd = NULL;
+			UpdateAdFilter(pDetail);
 		} else if (pMsg->dumpRequest) {
-			pEntry->dumpBusy = false;
-			pEntry->firstDumpComplete = true;
+			pDetail->dumpBusy = false;
+			pDetail->firstDumpComplete = true;
+			SnapshotMarkDirty();
 		} else {
-			CreateDumpRequest(pEntry);
+			CreateDumpRequest(pDetail);
 		}
 	} else {
 		LOG_ERR("Invalid Ack request: Invalid sensor table index");
@@ -434,6 +799,11 @@ void SensorTable_AckConfigRequest(SensorCmdMsg_t *pMsg)
 void SensorTable_EnableGatewayShadowGeneration(void)
 {
 	allowGatewayShadowGeneration = true;
+	/* The cloud may have missed the last update. */
+	size_t page;
+	for (page = 0; page < SENSOR_GATEWAY_SHADOW_PAGES; page++) {
+		gatewayShadowPages[page].crcValid = false;
+	}
 }
 
 void SensorTable_DisableGatewayShadowGeneration(void)
@@ -446,106 +816,111 @@ void SensorTable_DecomissionHandler(void)
 	size_t i;
 	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
 		Greenlist(&sensorTable[i], false);
-		sensorTable[i].shadowInitReceived = false;
-		sensorTable[i].firstDumpComplete = false;
+	}
+
+	for (i = 0; i < SENSOR_DETAIL_POOL_SIZE; i++) {
+		detailPool[i].shadowInitReceived = false;
+		detailPool[i].firstDumpComplete = false;
+		if (detailPool[i].inUse) {
+			ScheduleDetail(&detailPool[i], k_uptime_get_32());
+		}
 	}
 }
 
 void SensorTable_UnsubscribeAll(void)
 {
 	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		sensorTable[i].subscribed = false;
-		sensorTable[i].getAcceptedSubscribed = false;
+	for (i = 0; i < SENSOR_DETAIL_POOL_SIZE; i++) {
+		SensorDetail_t *p = &detailPool[i];
+		if (p->inUse) {
+			p->subscribed = false;
+			p->getAcceptedSubscribed = false;
+			/* Publishes that were in flight may have been lost. */
+			ShadowInvalidate(p);
+			/* Detail was only kept so that it could be unsubscribed. */
+			if (!CONFIG_USE_SINGLE_AWS_TOPIC &&
+			    !EntryOf(p)->greenlisted) {
+				FreeDetail(EntryOf(p));
+			} else {
+				ScheduleDetail(p, k_uptime_get_32());
+			}
+		}
 	}
 }
 
-void SensorTable_ConfigRequestHandler(void)
+void SensorTable_ScheduledHandler(void)
 {
-	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		SensorEntry_t *p = &sensorTable[i];
-		if (p->configRequest &&
-		    (p->configDispatchTime <= k_uptime_get())) {
-			p->configRequest = false;
-			if (p->rsp.configVersion == 0) {
-				CreateConfigRequest(p);
-			} else if (!p->firstDumpComplete) {
-				CreateDumpRequest(p);
-			}
+	uint32_t now = k_uptime_get_32();
+	bool initShadow = false;
+	while (schedCount > 0 &&
+	       !DeadlineBefore(now, schedDeadline[schedHeap[0]])) {
+		size_t node = schedHeap[0];
+		SchedRemove(node);
+		if (node < CONFIG_SENSOR_TABLE_SIZE) {
+			TimeToLiveExpired(&sensorTable[node]);
+		} else {
+			DetailActionHandler(
+				&detailPool[node - CONFIG_SENSOR_TABLE_SIZE],
+				&initShadow);
 		}
 	}
 }
 
-void SensorTable_SubscriptionHandler(void)
+bool SensorTable_GetNextDeadline(int64_t *pDeadline)
 {
-	char *fmt = SENSOR_SUBSCRIPTION_TOPIC_FMT_STR;
-	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		SensorEntry_t *pEntry = &sensorTable[i];
-		/* Waiting until AD and RSP are valid makes things easier for config.
-		 * When subscribing there must be a delay to allow AWS to configure
-		 * permissions.
-		 */
-		if (pEntry->validAd && pEntry->validRsp &&
-		    (pEntry->greenlisted != pEntry->subscribed) &&
-		    (pEntry->subscriptionDispatchTime <= k_uptime_get())) {
-			SubscribeMsg_t *pMsg =
-				BP_TRY_TO_TAKE(sizeof(SubscribeMsg_t));
-			if (pMsg != NULL) {
-				pMsg->header.msgCode = FMC_SUBSCRIBE;
-				pMsg->header.rxId = FWK_ID_CLOUD;
-				pMsg->header.txId = FWK_ID_SENSOR_TASK;
-				pMsg->subscribe = pEntry->greenlisted;
-				pMsg->tableIndex = i;
-				pMsg->length =
-					snprintk(pMsg->topic,
-						 CONFIG_AWS_TOPIC_MAX_SIZE, fmt,
-						 pEntry->addrString);
-				FRAMEWORK_MSG_SEND(pMsg);
-				/* For now, assume the subscription will work. */
-				pEntry->subscribed = pEntry->greenlisted;
-			}
+	bool pending = false;
+	int64_t now = k_uptime_get();
+	if (schedCount > 0) {
+		int32_t delta = (int32_t)(schedDeadline[schedHeap[0]] -
+					  k_uptime_get_32());
+		*pDeadline = now + MAX(delta, 0);
+		pending = true;
+	}
+
+	if (gatewayShadow.dirty && allowGatewayShadowGeneration) {
+		int64_t t = gatewayShadow.publishTime +
+			    (CONFIG_SENSOR_GATEWAY_SHADOW_MIN_INTERVAL_SECONDS *
+			     MSEC_PER_SEC);
+		if (!pending || t < *pDeadline) {
+			*pDeadline = t;
 		}
+		pending = true;
 	}
+
+#ifdef CONFIG_SENSOR_TABLE_SNAPSHOT
+	if (snapshot.dirty) {
+		int64_t t = snapshot.saveTime +
+			    (CONFIG_SENSOR_TABLE_SNAPSHOT_INTERVAL_SECONDS *
+			     MSEC_PER_SEC);
+		if (!pending || t < *pDeadline) {
+			*pDeadline = t;
+		}
+		pending = true;
+	}
+#endif
+	return pending;
 }
 
-void SensorTable_GetAcceptedSubscriptionHandler(void)
+void SensorTable_SnapshotHandler(void)
 {
-	char *fmt = SENSOR_GET_ACCEPTED_TOPIC_FMT_STR;
-	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		SensorEntry_t *pEntry = &sensorTable[i];
-		if (pEntry->subscribed && !pEntry->getAcceptedSubscribed &&
-		    !pEntry->shadowInitReceived &&
-		    (pEntry->subscriptionDispatchTime <= k_uptime_get())) {
-			SubscribeMsg_t *pMsg =
-				BP_TRY_TO_TAKE(sizeof(SubscribeMsg_t));
-			if (pMsg != NULL) {
-				pMsg->header.msgCode = FMC_SUBSCRIBE;
-				pMsg->header.rxId = FWK_ID_CLOUD;
-				pMsg->header.txId = FWK_ID_SENSOR_TASK;
-				pMsg->subscribe = true;
-				pMsg->tableIndex = i;
-				pMsg->length =
-					snprintk(pMsg->topic,
-						 CONFIG_AWS_TOPIC_MAX_SIZE, fmt,
-						 pEntry->addrString);
-				FRAMEWORK_MSG_SEND(pMsg);
-			}
-		}
+#ifdef CONFIG_SENSOR_TABLE_SNAPSHOT
+	if (snapshot.dirty &&
+	    (k_uptime_get() - snapshot.saveTime) >=
+		    (CONFIG_SENSOR_TABLE_SNAPSHOT_INTERVAL_SECONDS *
+		     MSEC_PER_SEC)) {
+		SnapshotSave();
 	}
+#endif
 }
 
-void SensorTable_InitShadowHandler(void)
+void SensorTable_ShadowAckHandler(SensorPublishAckMsg_t *pMsg)
 {
 	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		SensorEntry_t *pEntry = &sensorTable[i];
-		if (pEntry->getAcceptedSubscribed &&
-		    !pEntry->shadowInitReceived) {
-			PublishToGetAccepted(pEntry);
-			/* Limit to one because it is memory intensive. */
+	for (i = 0; i < SENSOR_DETAIL_POOL_SIZE; i++) {
+		SensorDetail_t *p = &detailPool[i];
+		if (p->inUse && p->sentId != 0 &&
+		    p->sentId == pMsg->publishId) {
+			ShadowCommit(p);
 			return;
 		}
 	}
@@ -553,20 +928,20 @@ void SensorTable_InitShadowHandler(void)
 
 void SensorTable_ProcessShadowInitMsg(SensorShadowInitMsg_t *pMsg)
 {
-	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		if (AddrStringMatch(pMsg->addrString, i)) {
-			break;
-		}
+	size_t i = FindTableIndexByString(pMsg->addrString);
+	SensorDetail_t *p = NULL;
+	if (i < CONFIG_SENSOR_TABLE_SIZE) {
+		p = DetailOf(&sensorTable[i]);
 	}
-
-	if (i >= CONFIG_SENSOR_TABLE_SIZE) {
+	if (p == NULL) {
 		LOG_ERR("Shadow Init sensor not found");
 		return;
 	}
 
-	SensorEntry_t *p = &sensorTable[i];
 	p->shadowInitReceived = true;
+	ShadowInvalidate(p);
+	ScheduleDetail(p, k_uptime_get_32());
+	SnapshotMarkDirty();
 
 	/* To keep things simple, throw away the table. */
 	if (pMsg->eventCount > 0) {
@@ -582,9 +957,12 @@ void SensorTable_ProcessShadowInitMsg(SensorShadowInitMsg_t *pMsg)
 
 void SensorTable_SubscriptionAckHandler(SubscribeMsg_t *pMsg)
 {
+	SensorDetail_t *p = NULL;
 	if (pMsg->tableIndex < CONFIG_SENSOR_TABLE_SIZE) {
-		SensorEntry_t *p = &sensorTable[pMsg->tableIndex];
+		p = DetailOf(&sensorTable[pMsg->tableIndex]);
+	}
 
+	if (p != NULL) {
 		if (strstr(pMsg->topic, SENSOR_GET_ACCEPTED_SUB_STR) != NULL) {
 			if (pMsg->success) {
 				p->getAcceptedSubscribed = true;
@@ -603,6 +981,7 @@ void SensorTable_SubscriptionAckHandler(SubscribeMsg_t *pMsg)
 				p->subscribed = !pMsg->subscribe;
 			}
 		}
+		ScheduleDetail(p, k_uptime_get_32());
 	}
 }
 
@@ -634,26 +1013,6 @@ void SensorTable_CreateShadowFromDumpResponse(FwkBufMsg_t *pRsp,
 	FRAMEWORK_MSG_SEND(pMsg);
 }
 
-void SensorTable_TimeToLiveHandler(void)
-{
-	int64_t deltaS = k_uptime_delta(&ttlUptime) / (1 * MSEC_PER_SEC);
-	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		SensorEntry_t *p = &sensorTable[i];
-		if (p->inUse) {
-			p->ttl = (p->ttl > deltaS) ? (p->ttl - deltaS) : 0;
-			if (p->ttl == 0 && !p->greenlisted) {
-				LOG_DBG("Removing '%s' sensor %s from table",
-					log_strdup(p->name),
-					log_strdup(p->addrString));
-				ClearEntry(p);
-				FRAMEWORK_DEBUG_ASSERT(tableCount > 0);
-				tableCount -= 1;
-			}
-		}
-	}
-}
-
 /******************************************************************************/
 /* Local Function Definitions                                                 */
 /******************************************************************************/
@@ -664,67 +1023,186 @@ void SensorTable_TimeToLiveHandler(void)
 static void ClearTable(void)
 {
 	size_t i;
+	for (i = 0; i < SENSOR_DETAIL_POOL_SIZE; i++) {
+		if (detailPool[i].inUse) {
+			FreeDetailBuffers(&detailPool[i]);
+		}
+	}
+	memset(detailPool, 0, sizeof(detailPool));
+	detailFreeCount = SENSOR_DETAIL_POOL_SIZE;
+	for (i = 0; i < SENSOR_DETAIL_POOL_SIZE; i++) {
+		detailFreeList[i] = (SENSOR_DETAIL_POOL_SIZE - 1) - i;
+	}
+
+	memset(sensorTable, 0, sizeof(sensorTable));
 	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		ClearEntry(&sensorTable[i]);
+		sensorTable[i].detail = SENSOR_DETAIL_NONE;
 	}
 	tableCount = 0;
+#ifdef CONFIG_SENSOR_TABLE_REPLACEMENT_LRU
+	lruHead = SENSOR_INDEX_EMPTY;
+	lruTail = SENSOR_INDEX_EMPTY;
+#endif
+
+	for (i = 0; i < SCHED_NODES; i++) {
+		schedPos[i] = SCHED_NONE;
+	}
+	schedCount = 0;
+
+	SensorIndex_Initialize(&addrIndex, addrIndexSlots,
+			       ARRAY_SIZE(addrIndexSlots), &sensorTable[0].addr,
+			       sizeof(SensorEntry_t));
+
+	/* Lowest index is on top of the stack so that the table fills in order */
+	freeCount = CONFIG_SENSOR_TABLE_SIZE;
+	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
+		freeList[i] = (CONFIG_SENSOR_TABLE_SIZE - 1) - i;
+	}
 }
 
-static void ClearEntry(SensorEntry_t *pEntry)
+static void FreeCmdBuffers(SensorDetail_t *pDetail)
 {
-	FreeEntryBuffers(pEntry);
-	memset(pEntry, 0, sizeof(SensorEntry_t));
+	if (pDetail->pCmd != NULL) {
+		BufferPool_Free(pDetail->pCmd);
+		pDetail->pCmd = NULL;
+	}
+	if (pDetail->pSecondCmd != NULL) {
+		BufferPool_Free(pDetail->pSecondCmd);
+		pDetail->pSecondCmd = NULL;
+	}
+	UpdateAdFilter(pDetail);
 }
 
-static void FreeCmdBuffers(SensorEntry_t *pEntry)
+/* Every ad is required while a command is waiting for the sensor
+ * to be seen (connection is made on the PHY the ad was received on).
+ */
+static void UpdateAdFilter(SensorDetail_t *pDetail)
 {
-	if (pEntry->pCmd != NULL) {
-		BufferPool_Free(pEntry->pCmd);
-		pEntry->pCmd = NULL;
+#ifdef CONFIG_SENSOR_ADV_FILTER
+	bool bypass = (pDetail->pCmd != NULL);
+	if (bypass != pDetail->adFilterBypass) {
+		pDetail->adFilterBypass = bypass;
+		SensorAdvFilter_Bypass(&EntryOf(pDetail)->addr, bypass);
 	}
-	if (pEntry->pSecondCmd != NULL) {
-		BufferPool_Free(pEntry->pSecondCmd);
-		pEntry->pSecondCmd = NULL;
+#else
+	ARG_UNUSED(pDetail);
+#endif
+}
+
+static void FreeDetailBuffers(SensorDetail_t *pDetail)
+{
+	FreeCmdBuffers(pDetail);
+
+	if (pDetail->pLog != NULL) {
+		SensorLog_Free(pDetail->pLog);
+		pDetail->pLog = NULL;
 	}
 }
 
-static void FreeEntryBuffers(SensorEntry_t *pEntry)
+static SensorDetail_t *AllocateDetail(size_t TableIndex)
 {
-	FreeCmdBuffers(pEntry);
+	if (detailFreeCount == 0) {
+		return NULL;
+	}
+
+	detailFreeCount -= 1;
+	uint16_t d = detailFreeList[detailFreeCount];
+	SensorDetail_t *pDetail = &detailPool[d];
+	SensorEntry_t *pEntry = &sensorTable[TableIndex];
+	memset(pDetail, 0, sizeof(SensorDetail_t));
+	pDetail->inUse = true;
+	pDetail->tableIndex = TableIndex;
+	pDetail->rssi = pEntry->rssi;
+	/* The address is duplicated in the advertisement payload because
+	 * some operating systems don't provide the Bluetooth address to
+	 * the application.  The address is copied into the AD field
+	 * because the two formats are the same.
+	 */
+	memcpy(pDetail->ad.addr.val, pEntry->addr.val, sizeof(bt_addr_t));
+	AddrToString(&pEntry->addr, pDetail->addrString);
+	pEntry->detail = d;
+
+	/* The name, scan response and event are only stored in the detail.
+	 * Wait for them to be received again.
+	 */
+	pEntry->validAd = false;
+	pEntry->validRsp = false;
+#ifdef CONFIG_SENSOR_ADV_FILTER
+	SensorAdvFilter_Forget(&pEntry->addr);
+#endif
+	return pDetail;
+}
 
-	if (pEntry->pLog != NULL) {
-		SensorLog_Free(pEntry->pLog);
-		pEntry->pLog = NULL;
+static void FreeDetail(SensorEntry_t *pEntry)
+{
+	SensorDetail_t *pDetail = DetailOf(pEntry);
+	if (pDetail != NULL) {
+		FreeDetailBuffers(pDetail);
+		pDetail->inUse = false;
+		SchedRemove(SCHED_DETAIL_NODE(pEntry->detail));
+		detailFreeList[detailFreeCount++] = pEntry->detail;
+		pEntry->detail = SENSOR_DETAIL_NONE;
 	}
 }
 
-static void AdEventHandler(LczSensorAdEvent_t *p, int8_t Rssi, uint32_t Index)
+static SensorDetail_t *DetailOf(SensorEntry_t *pEntry)
 {
-	if (sensorTable[Index].greenlisted) {
-		sensorTable[Index].ttl = CONFIG_SENSOR_TTL_SECONDS;
+	if (pEntry->detail < SENSOR_DETAIL_POOL_SIZE) {
+		return &detailPool[pEntry->detail];
+	} else {
+		return NULL;
 	}
+}
 
-	if (NewEvent(p->id, Index)) {
-		sensorTable[Index].validAd = true;
-		sensorTable[Index].lastRecordType =
-			sensorTable[Index].ad.recordType;
-		memcpy(&sensorTable[Index].ad, p, sizeof(LczSensorAdEvent_t));
-		sensorTable[Index].rssi = Rssi;
+static SensorEntry_t *EntryOf(SensorDetail_t *pDetail)
+{
+	return &sensorTable[pDetail->tableIndex];
+}
+
+static void AdEventHandler(LczSensorAdEvent_t *p, int8_t Rssi, uint32_t Index)
+{
+	SensorEntry_t *pEntry = &sensorTable[Index];
+	if (pEntry->greenlisted) {
+		pEntry->expired = false;
+		SchedSet(SCHED_TTL_NODE(Index),
+			 k_uptime_get_32() +
+				 (CONFIG_SENSOR_TTL_SECONDS * MSEC_PER_SEC));
+	}
+	LruTouch(Index);
+
+	if (NewEvent(p->id, pEntry)) {
+		pEntry->validAd = true;
+		pEntry->id = p->id;
+		pEntry->flags = p->flags;
+		pEntry->rssi = Rssi;
 		/* If event occurs before epoch is set, then AWS shows ~1970. */
-		sensorTable[Index].rxEpoch = lcz_qrtc_get_epoch();
-		ShadowMaker(&sensorTable[Index]);
+		pEntry->rxEpoch = lcz_qrtc_get_epoch();
+
+		SensorDetail_t *pDetail = DetailOf(pEntry);
+		if (pDetail != NULL) {
+			pDetail->lastRecordType = pDetail->ad.recordType;
+			memcpy(&pDetail->ad, p, sizeof(LczSensorAdEvent_t));
+			pDetail->rssi = Rssi;
+			ShadowMaker(pDetail);
+			ScheduleDetail(pDetail, k_uptime_get_32());
+		}
 
-		LOG_EVT("%s event %u for [%u] '%s' (%s) RSSI: %d",
-			lcz_sensor_event_get_string(
-				sensorTable[Index].ad.recordType),
-			sensorTable[Index].ad.id, Index,
-			log_strdup(sensorTable[Index].name),
-			log_strdup(sensorTable[Index].addrString), Rssi);
+		if (IS_ENABLED(CONFIG_LOG)) {
+			char addrString[SENSOR_ADDR_STR_SIZE];
+			AddrToString(&pEntry->addr, addrString);
+			LOG_EVT("%s event %u for [%u] '%s' (%s) RSSI: %d",
+				lcz_sensor_event_get_string(p->recordType),
+				p->id, Index,
+				log_strdup((pDetail != NULL) ? pDetail->name :
+							       ""),
+				log_strdup(addrString), Rssi);
+		}
 
 #ifdef CONFIG_SD_CARD_LOG
 		sdCardLogAdEvent(p);
 #endif
 		/* The cloud uses the RX epoch (in the table) for filtering. */
+		GatewayShadowChanged(Index);
 		GatewayShadowMaker(false);
 	}
 }
@@ -741,51 +1219,39 @@ static size_t AddByScanResponse(const bt_addr_le_t *pAddr,
 		return CONFIG_SENSOR_TABLE_SIZE;
 	}
 
-	/* The first free entry will be used after entire table is searched. */
-	bool add = false;
-	bool updateRsp = false;
-	bool updateName = false;
-	SensorEntry_t *pEntry = NULL;
 	size_t i = FindTableIndex(pAddr);
-	if (i < CONFIG_SENSOR_TABLE_SIZE) {
-		pEntry = &sensorTable[i];
-		if (!NameMatch(pNameHandle->pPayload, i)) {
-			updateName = true;
-		}
-		if (!RspMatch(pRsp, i)) {
-			updateRsp = true;
+	if (i >= CONFIG_SENSOR_TABLE_SIZE) {
+		i = FindOrEvict();
+		if (i >= CONFIG_SENSOR_TABLE_SIZE) {
+			return CONFIG_SENSOR_TABLE_SIZE;
 		}
+		AddEntry(&sensorTable[i], &pAddr->a, Rssi);
 	} else {
-		i = FindFirstFree();
-		if (i < CONFIG_SENSOR_TABLE_SIZE) {
-			pEntry = &sensorTable[i];
-			add = true;
-		}
+		LruTouch(i);
 	}
 
-	if ((pEntry != NULL) && (add || updateRsp || updateName)) {
-		pEntry->validRsp = true;
-		if (add || updateRsp) {
-			pEntry->updatedRsp = true;
-			memcpy(&pEntry->rsp, pRsp, sizeof(LczSensorRsp_t));
+	/* Name and scan response are only kept for sensors with detail. */
+	sensorTable[i].validRsp = true;
+	SensorDetail_t *pDetail = DetailOf(&sensorTable[i]);
+	if (pDetail != NULL) {
+		ScheduleDetail(pDetail, k_uptime_get_32());
+		if (!RspMatch(pRsp, pDetail)) {
+			memcpy(&pDetail->rsp, pRsp, sizeof(LczSensorRsp_t));
 		}
-		if (add || updateName) {
-			pEntry->updatedName = true;
-			memset(pEntry->name, 0, SENSOR_NAME_MAX_SIZE);
-			strncpy(pEntry->name, pNameHandle->pPayload,
+		if (!NameMatch(pNameHandle->pPayload, pDetail)) {
+			pDetail->updatedName = true;
+			memset(pDetail->name, 0, SENSOR_NAME_MAX_SIZE);
+			strncpy(pDetail->name, pNameHandle->pPayload,
 				MIN(SENSOR_NAME_MAX_STR_LEN,
 				    pNameHandle->size));
 		}
-		if (add) {
-			AddEntry(pEntry, &pAddr->a, Rssi);
-		}
 	}
 	return i;
 }
 
 static size_t AddByAddress(const bt_addr_t *pAddr)
 {
-	size_t i = FindFirstFree();
+	size_t i = FindOrEvict();
 	if (i < CONFIG_SENSOR_TABLE_SIZE) {
 		AddEntry(&sensorTable[i], pAddr, RSSI_UNKNOWN);
 	}
@@ -794,119 +1260,691 @@ static size_t AddByAddress(const bt_addr_t *pAddr)
 
 static void AddEntry(SensorEntry_t *pEntry, const bt_addr_t *pAddr, int8_t Rssi)
 {
+	size_t i = pEntry - sensorTable;
+	FRAMEWORK_ASSERT(freeCount > 0);
+	FRAMEWORK_ASSERT(freeList[freeCount - 1] == i);
+	freeCount -= 1;
 	tableCount += 1;
-	pEntry->ttl = CONFIG_SENSOR_TTL_SECONDS;
 	pEntry->inUse = true;
 	pEntry->rssi = Rssi;
-	memcpy(pEntry->ad.addr.val, pAddr->val, sizeof(bt_addr_t));
-	/* The address is duplicated in the advertisement payload because
-	 * some operating systems don't provide the Bluetooth address to
-	 * the application.  The address is copied into the AD field
-	 * because the two formats are the same.
+	pEntry->detail = SENSOR_DETAIL_NONE;
+	bt_addr_copy(&pEntry->addr, pAddr);
+	SensorIndex_Insert(&addrIndex, i);
+	LruInsert(i);
+	SchedSet(SCHED_TTL_NODE(i),
+		 k_uptime_get_32() + (CONFIG_SENSOR_TTL_SECONDS * MSEC_PER_SEC));
+#ifdef CONFIG_SENSOR_ADV_FILTER
+	/* The filter may have seen the current event before the sensor
+	 * could be added to the table.
 	 */
-	SensorAddrToString(pEntry);
-	LOG_DBG("Added BT510 sensor %s '%s' RSSI: %d",
-		log_strdup(pEntry->addrString), log_strdup(pEntry->name),
-		pEntry->rssi);
+	SensorAdvFilter_Forget(pAddr);
+#endif
+	if (CONFIG_USE_SINGLE_AWS_TOPIC) {
+		AllocateDetail(i);
+	}
+	LOG_DBG("Added BT510 sensor [%u] RSSI: %d", i, pEntry->rssi);
+	GatewayShadowChanged(i);
 	GatewayShadowMaker(false);
 }
 
+static void RemoveEntry(SensorEntry_t *pEntry)
+{
+	size_t i = pEntry - sensorTable;
+	FRAMEWORK_DEBUG_ASSERT(pEntry->inUse);
+	FRAMEWORK_DEBUG_ASSERT(tableCount > 0);
+	LOG_DBG("Removing sensor [%u] from table", i);
+	FreeDetail(pEntry);
+	SensorIndex_Remove(&addrIndex, i);
+	LruRemove(i);
+	SchedRemove(SCHED_TTL_NODE(i));
+	GatewayShadowChanged(i);
+	memset(pEntry, 0, sizeof(SensorEntry_t));
+	pEntry->detail = SENSOR_DETAIL_NONE;
+	freeList[freeCount++] = i;
+	tableCount -= 1;
+}
+
 /* Find index of advertiser's address in the sensor table */
 static size_t FindTableIndex(const bt_addr_le_t *pAddr)
 {
-	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		if (sensorTable[i].inUse) {
-			if (AddrMatch(pAddr->a.val, i)) {
-				return i;
-			}
-		}
-	}
-	return CONFIG_SENSOR_TABLE_SIZE;
+	return IndexFind(&pAddr->a);
+}
+
+static size_t FindTableIndexByString(const char *pAddrString)
+{
+	bt_addr_t addr = BtAddrStringToStruct(pAddrString);
+	return IndexFind(&addr);
 }
 
 static size_t FindFirstFree(void)
 {
-	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		if (!sensorTable[i].inUse) {
-			return i;
-		}
+	if (freeCount > 0) {
+		return freeList[freeCount - 1];
 	}
 	return CONFIG_SENSOR_TABLE_SIZE;
 }
 
-static bool AddrMatch(const void *p, size_t Index)
+/* Wrap-safe comparison of uptime deadlines. */
+static bool DeadlineBefore(uint32_t A, uint32_t B)
+{
+	return ((int32_t)(A - B) < 0);
+}
+
+static void SchedSwap(size_t A, size_t B)
 {
-	return (memcmp(p, sensorTable[Index].ad.addr.val, sizeof(bt_addr_t)) ==
-		0);
+	uint16_t t = schedHeap[A];
+	schedHeap[A] = schedHeap[B];
+	schedHeap[B] = t;
+	schedPos[schedHeap[A]] = A;
+	schedPos[schedHeap[B]] = B;
 }
 
-static bool AddrStringMatch(const char *str, size_t Index)
+static void SchedSiftUp(size_t Pos)
 {
-	return (strncmp(str, sensorTable[Index].addrString,
-			SENSOR_ADDR_STR_LEN) == 0);
+	while (Pos > 0) {
+		size_t parent = (Pos - 1) / 2;
+		if (!DeadlineBefore(schedDeadline[schedHeap[Pos]],
+				    schedDeadline[schedHeap[parent]])) {
+			break;
+		}
+		SchedSwap(Pos, parent);
+		Pos = parent;
+	}
 }
 
-static bool NameMatch(const char *p, size_t Index)
+static void SchedSiftDown(size_t Pos)
 {
-	return (strncmp(p, sensorTable[Index].name, SENSOR_NAME_MAX_STR_LEN) ==
-		0);
+	while (true) {
+		size_t smallest = Pos;
+		size_t left = (2 * Pos) + 1;
+		size_t right = left + 1;
+		if (left < schedCount &&
+		    DeadlineBefore(schedDeadline[schedHeap[left]],
+				   schedDeadline[schedHeap[smallest]])) {
+			smallest = left;
+		}
+		if (right < schedCount &&
+		    DeadlineBefore(schedDeadline[schedHeap[right]],
+				   schedDeadline[schedHeap[smallest]])) {
+			smallest = right;
+		}
+		if (smallest == Pos) {
+			break;
+		}
+		SchedSwap(Pos, smallest);
+		Pos = smallest;
+	}
 }
 
-static bool RspMatch(const LczSensorRsp_t *p, size_t Index)
+/* Add a node or move an existing node to its new deadline. */
+static void SchedSet(size_t Node, uint32_t Deadline)
 {
-	return (memcmp(p, &sensorTable[Index].rsp, sizeof(LczSensorRsp_t)) ==
-		0);
+	schedDeadline[Node] = Deadline;
+	if (schedPos[Node] == SCHED_NONE) {
+		schedHeap[schedCount] = Node;
+		schedPos[Node] = schedCount;
+		schedCount += 1;
+	}
+	SchedSiftUp(schedPos[Node]);
+	SchedSiftDown(schedPos[Node]);
 }
 
-static bool NewEvent(uint16_t Id, size_t Index)
+static void SchedRemove(size_t Node)
 {
-	if (!sensorTable[Index].validAd) {
-		return true;
-	} else {
-		return (Id != sensorTable[Index].ad.id);
+	size_t pos = schedPos[Node];
+	if (pos == SCHED_NONE) {
+		return;
+	}
+
+	schedPos[Node] = SCHED_NONE;
+	schedCount -= 1;
+	if (pos != schedCount) {
+		uint16_t last = schedHeap[schedCount];
+		schedHeap[pos] = last;
+		schedPos[last] = pos;
+		SchedSiftUp(pos);
+		SchedSiftDown(schedPos[last]);
 	}
 }
 
-static void ShadowMaker(SensorEntry_t *pEntry)
+static void Earliest(bool *pPending, uint32_t *pDeadline, uint32_t Deadline)
 {
-	/* AWS will disconnect if data is sent for devices that have not
-	 * been greenlisted.
-	 */
-	if (!CONFIG_USE_SINGLE_AWS_TOPIC) {
-		if (!pEntry->greenlisted || !pEntry->shadowInitReceived) {
-			return;
-		}
+	if (!*pPending || DeadlineBefore(Deadline, *pDeadline)) {
+		*pDeadline = Deadline;
 	}
+	*pPending = true;
+}
 
-	JsonMsg_t *pMsg =
-		BP_TRY_TO_TAKE(FWK_BUFFER_MSG_SIZE(JsonMsg_t, SHADOW_BUF_SIZE));
-	if (pMsg == NULL) {
+/* Determine when the next cloud action for a sensor is due.  This must be
+ * called when any of the state used by the action handlers changes.
+ */
+static void ScheduleDetail(SensorDetail_t *pDetail, uint32_t NotBefore)
+{
+	size_t node = SCHED_DETAIL_NODE(pDetail - detailPool);
+	SensorEntry_t *pEntry = EntryOf(pDetail);
+	bool pending = false;
+	uint32_t deadline = 0;
+
+	if (!pDetail->inUse) {
+		SchedRemove(node);
 		return;
 	}
 
-	pMsg->header.msgCode = FMC_SENSOR_PUBLISH;
-	pMsg->header.rxId = FWK_ID_CLOUD;
-	pMsg->size = SHADOW_BUF_SIZE;
+	if (pEntry->validAd && pEntry->validRsp &&
+	    (pEntry->greenlisted != pDetail->subscribed)) {
+		Earliest(&pending, &deadline,
+			 DueTime(pDetail->subscriptionDispatchTime));
+	}
 
-	ShadowBuilder_Start(pMsg, SKIP_MEMSET);
-	ShadowBuilder_StartGroup(pMsg, "state");
-	ShadowBuilder_StartGroup(pMsg, "reported");
-	if (CONFIG_USE_SINGLE_AWS_TOPIC) {
-		ShadowTemperatureHandler(pMsg, pEntry);
-		/* Sending RSSI prevents an empty buffer when
-		 * temperature isn't present.
-		 */
-		ShadowBuilder_AddSigned32(pMsg, MangleKey(pEntry->name, "rssi"),
-					  pEntry->rssi);
+	if (pDetail->subscribed && !pDetail->getAcceptedSubscribed &&
+	    !pDetail->shadowInitReceived) {
+		Earliest(&pending, &deadline,
+			 DueTime(pDetail->subscriptionDispatchTime));
+	}
+
+	if (pDetail->configRequest) {
+		Earliest(&pending, &deadline,
+			 DueTime(pDetail->configDispatchTime));
+	}
+
+	if (pDetail->getAcceptedSubscribed && !pDetail->shadowInitReceived) {
+		Earliest(&pending, &deadline, NotBefore);
+	}
+
+	if (pending) {
+		if (DeadlineBefore(deadline, NotBefore)) {
+			deadline = NotBefore;
+		}
+		SchedSet(node, deadline);
+	} else {
+		SchedRemove(node);
+	}
+}
+
+/* Dispatch times in the past are clamped in 64 bits so that an old time
+ * can't look like one in the future once it is compared in 32 bits.
+ */
+static uint32_t DueTime(uint64_t DispatchTime)
+{
+	return (uint32_t)MAX(DispatchTime, (uint64_t)k_uptime_get());
+}
+
+/* Greenlisted sensors are kept.  If the sensor is removed from the greenlist
+ * before it is seen again, then it is removed from the table.
+ */
+static void TimeToLiveExpired(SensorEntry_t *pEntry)
+{
+	if (!pEntry->inUse) {
+		return;
+	}
+
+	if (pEntry->greenlisted) {
+		pEntry->expired = true;
+	} else {
+		RemoveEntry(pEntry);
+	}
+}
+
+static void DetailActionHandler(SensorDetail_t *pDetail, bool *pInitShadow)
+{
+	SubscriptionHandler(pDetail);
+	if (!pDetail->inUse) {
+		/* Detail was freed after unsubscribing */
+		return;
+	}
+	ConfigRequestHandler(pDetail);
+	GetAcceptedSubscriptionHandler(pDetail);
+	/* Limit to one because it is memory intensive. */
+	if (!*pInitShadow) {
+		*pInitShadow = InitShadowHandler(pDetail);
+	}
+
+	ScheduleDetail(pDetail, k_uptime_get_32() + SENSOR_ACTION_RETRY_MS);
+}
+
+/* Config requests that send shadow are delayed.  The delay is because AWS
+ * will disconnect when a sensor is created in Bluegrass.
+ */
+static void ConfigRequestHandler(SensorDetail_t *p)
+{
+	if (p->configRequest && (p->configDispatchTime <= k_uptime_get())) {
+		p->configRequest = false;
+		if (p->rsp.configVersion == 0) {
+			CreateConfigRequest(p);
+		} else if (!p->firstDumpComplete) {
+			CreateDumpRequest(p);
+		}
+	}
+}
+
+static void SubscriptionHandler(SensorDetail_t *pDetail)
+{
+	char *fmt = SENSOR_SUBSCRIPTION_TOPIC_FMT_STR;
+	SensorEntry_t *pEntry = EntryOf(pDetail);
+	/* Waiting until AD and RSP are valid makes things easier for config.
+	 * When subscribing there must be a delay to allow AWS to configure
+	 * permissions.
+	 */
+	if (pEntry->validAd && pEntry->validRsp &&
+	    (pEntry->greenlisted != pDetail->subscribed) &&
+	    (pDetail->subscriptionDispatchTime <= k_uptime_get())) {
+		SubscribeMsg_t *pMsg = BP_TRY_TO_TAKE(sizeof(SubscribeMsg_t));
+		if (pMsg != NULL) {
+			pMsg->header.msgCode = FMC_SUBSCRIBE;
+			pMsg->header.rxId = FWK_ID_CLOUD;
+			pMsg->header.txId = FWK_ID_SENSOR_TASK;
+			pMsg->subscribe = pEntry->greenlisted;
+			pMsg->tableIndex = pDetail->tableIndex;
+			pMsg->length = snprintk(pMsg->topic,
+						CONFIG_AWS_TOPIC_MAX_SIZE, fmt,
+						pDetail->addrString);
+			FRAMEWORK_MSG_SEND(pMsg);
+			/* For now, assume the subscription will work. */
+			pDetail->subscribed = pEntry->greenlisted;
+			if (!CONFIG_USE_SINGLE_AWS_TOPIC &&
+			    !pEntry->greenlisted) {
+				FreeDetail(pEntry);
+			}
+		}
+	}
+}
+
+static void GetAcceptedSubscriptionHandler(SensorDetail_t *pDetail)
+{
+	char *fmt = SENSOR_GET_ACCEPTED_TOPIC_FMT_STR;
+	if (pDetail->subscribed && !pDetail->getAcceptedSubscribed &&
+	    !pDetail->shadowInitReceived &&
+	    (pDetail->subscriptionDispatchTime <= k_uptime_get())) {
+		SubscribeMsg_t *pMsg = BP_TRY_TO_TAKE(sizeof(SubscribeMsg_t));
+		if (pMsg != NULL) {
+			pMsg->header.msgCode = FMC_SUBSCRIBE;
+			pMsg->header.rxId = FWK_ID_CLOUD;
+			pMsg->header.txId = FWK_ID_SENSOR_TASK;
+			pMsg->subscribe = true;
+			pMsg->tableIndex = pDetail->tableIndex;
+			pMsg->length = snprintk(pMsg->topic,
+						CONFIG_AWS_TOPIC_MAX_SIZE, fmt,
+						pDetail->addrString);
+			FRAMEWORK_MSG_SEND(pMsg);
+		}
+	}
+}
+
+/* Request sensor shadow until it is received.  Returns true if a request
+ * was made.
+ */
+static bool InitShadowHandler(SensorDetail_t *pDetail)
+{
+	if (pDetail->getAcceptedSubscribed && !pDetail->shadowInitReceived) {
+		PublishToGetAccepted(pDetail);
+		return true;
+	}
+	return false;
+}
+
+#ifdef CONFIG_SENSOR_TABLE_SNAPSHOT
+static void SnapshotMarkDirty(void)
+{
+	snapshot.dirty = true;
+}
+
+/* Writes are limited by the snapshot interval and skipped when the
+ * contents haven't changed since the last write.
+ */
+static void SnapshotSave(void)
+{
+	size_t size = sizeof(SnapshotHeader_t) +
+		      (greenCount * sizeof(SnapshotRecord_t));
+	uint8_t *pBuf = k_calloc(size, sizeof(uint8_t));
+	snapshot.saveTime = k_uptime_get();
+	if (pBuf == NULL) {
+		LOG_ERR("Unable to allocate sensor table snapshot");
+		return;
+	}
+
+	SnapshotHeader_t *pHeader = (SnapshotHeader_t *)pBuf;
+	SnapshotRecord_t *pRecords =
+		(SnapshotRecord_t *)(pBuf + sizeof(SnapshotHeader_t));
+	size_t count = 0;
+	size_t i;
+	for (i = 0; i < SENSOR_DETAIL_POOL_SIZE && count < greenCount; i++) {
+		SensorDetail_t *p = &detailPool[i];
+		SensorEntry_t *pEntry = EntryOf(p);
+		if (!p->inUse || !pEntry->greenlisted) {
+			continue;
+		}
+		SnapshotRecord_t *r = &pRecords[count++];
+		bt_addr_copy(&r->addr, &pEntry->addr);
+		r->id = pEntry->id;
+		r->flags = pEntry->flags;
+		r->rxEpoch = pEntry->rxEpoch;
+		r->validAd = pEntry->validAd;
+		r->validRsp = pEntry->validRsp;
+		r->firstDumpComplete = p->firstDumpComplete;
+		memcpy(r->name, p->name, SENSOR_NAME_MAX_SIZE);
+		memcpy(&r->ad, &p->ad, sizeof(LczSensorAdEvent_t));
+		memcpy(&r->rsp, &p->rsp, sizeof(LczSensorRsp_t));
+		r->logCount = SensorLog_Read(p->pLog, r->log,
+					     CONFIG_SENSOR_LOG_MAX_SIZE);
+	}
+
+	pHeader->magic = SNAPSHOT_MAGIC;
+	pHeader->version = SNAPSHOT_VERSION;
+	pHeader->count = count;
+	pHeader->recordSize = sizeof(SnapshotRecord_t);
+	pHeader->logSize = CONFIG_SENSOR_LOG_MAX_SIZE;
+	pHeader->crc = crc32_ieee((uint8_t *)pRecords,
+				  count * sizeof(SnapshotRecord_t));
+
+	snapshot.dirty = false;
+	if (snapshot.crcValid && snapshot.crc == pHeader->crc &&
+	    snapshot.count == count) {
+		k_free(pBuf);
+		return;
+	}
+
+	size = sizeof(SnapshotHeader_t) + (count * sizeof(SnapshotRecord_t));
+	int r = fsu_write_abs(SNAPSHOT_FILE_NAME, pBuf, size);
+	if (r < 0) {
+		LOG_ERR("Unable to write sensor table snapshot: %d", r);
+		snapshot.crcValid = false;
+	} else {
+		snapshot.crc = pHeader->crc;
+		snapshot.count = count;
+		snapshot.crcValid = true;
+		snapshot.writes += 1;
+		LOG_DBG("Sensor table snapshot saved (%u sensors)", count);
+	}
+	k_free(pBuf);
+}
+
+static void SnapshotRestore(void)
+{
+	if (fsu_lfs_mount() != 0) {
+		return;
+	}
+
+	ssize_t size = fsu_get_file_size_abs(SNAPSHOT_FILE_NAME);
+	if (size < (ssize_t)sizeof(SnapshotHeader_t)) {
+		return;
+	}
+
+	uint8_t *pBuf = k_malloc(size);
+	if (pBuf == NULL) {
+		return;
+	}
+
+	SnapshotHeader_t *pHeader = (SnapshotHeader_t *)pBuf;
+	SnapshotRecord_t *pRecords =
+		(SnapshotRecord_t *)(pBuf + sizeof(SnapshotHeader_t));
+	do {
+		if (fsu_read_abs(SNAPSHOT_FILE_NAME, pBuf, size) != size) {
+			break;
+		}
+		if (pHeader->magic != SNAPSHOT_MAGIC ||
+		    pHeader->version != SNAPSHOT_VERSION ||
+		    pHeader->recordSize != sizeof(SnapshotRecord_t) ||
+		    pHeader->logSize != CONFIG_SENSOR_LOG_MAX_SIZE) {
+			LOG_WRN("Sensor table snapshot format changed");
+			break;
+		}
+		size_t recordBytes = pHeader->count * sizeof(SnapshotRecord_t);
+		if (size != (ssize_t)(sizeof(SnapshotHeader_t) + recordBytes) ||
+		    pHeader->crc != crc32_ieee((uint8_t *)pRecords,
+					       recordBytes)) {
+			LOG_ERR("Invalid sensor table snapshot");
+			break;
+		}
+
+		size_t i;
+		for (i = 0; i < pHeader->count; i++) {
+			SnapshotRestoreRecord(&pRecords[i]);
+		}
+		snapshot.crc = pHeader->crc;
+		snapshot.count = pHeader->count;
+		snapshot.crcValid = true;
+		LOG_INF("Restored %u sensors from snapshot", greenCount);
+	} while (0);
+
+	k_free(pBuf);
+	snapshot.dirty = false;
+}
+
+/* The restored log is treated as the sensor shadow so that it doesn't have
+ * to be read from the cloud (get accepted).
+ */
+static void SnapshotRestoreRecord(SnapshotRecord_t *pRecord)
+{
+	size_t i = IndexFind(&pRecord->addr);
+	if (i >= CONFIG_SENSOR_TABLE_SIZE) {
+		i = AddByAddress(&pRecord->addr);
+	}
+	if (i >= CONFIG_SENSOR_TABLE_SIZE) {
+		return;
+	}
+
+	SensorEntry_t *pEntry = &sensorTable[i];
+	Greenlist(pEntry, true);
+	SensorDetail_t *p = DetailOf(pEntry);
+	if (!pEntry->greenlisted || p == NULL) {
+		return;
+	}
+
+	pEntry->id = pRecord->id;
+	pEntry->flags = pRecord->flags;
+	pEntry->rxEpoch = pRecord->rxEpoch;
+	pEntry->validAd = pRecord->validAd;
+	pEntry->validRsp = pRecord->validRsp;
+	memcpy(p->name, pRecord->name, SENSOR_NAME_MAX_SIZE);
+	p->name[SENSOR_NAME_MAX_SIZE - 1] = 0;
+	memcpy(&p->ad, &pRecord->ad, sizeof(LczSensorAdEvent_t));
+	memcpy(&p->rsp, &pRecord->rsp, sizeof(LczSensorRsp_t));
+	p->updatedName = true;
+	p->firstDumpComplete = pRecord->firstDumpComplete;
+	p->shadowInitReceived = true;
+
+	size_t j;
+	for (j = 0; j < MIN(pRecord->logCount, CONFIG_SENSOR_LOG_MAX_SIZE);
+	     j++) {
+		SensorLog_Add(p->pLog, &pRecord->log[j]);
+	}
+
+	ScheduleDetail(p, k_uptime_get_32());
+}
+#else
+static void SnapshotMarkDirty(void)
+{
+}
+#endif
+
+static size_t FindOrEvict(void)
+{
+	size_t i = FindFirstFree();
+	if (i >= CONFIG_SENSOR_TABLE_SIZE) {
+		i = EvictEntry();
+	}
+	return i;
+}
+
+#ifdef CONFIG_SENSOR_TABLE_REPLACEMENT_LRU
+static void LruTouch(size_t Index)
+{
+	sensorTable[Index].lastSeen = (uint16_t)(k_uptime_get() / MSEC_PER_SEC);
+	if (lruHead != Index) {
+		LruRemove(Index);
+		LruInsert(Index);
+	}
+}
+
+static void LruInsert(size_t Index)
+{
+	SensorEntry_t *p = &sensorTable[Index];
+	p->lastSeen = (uint16_t)(k_uptime_get() / MSEC_PER_SEC);
+	p->lruPrev = SENSOR_INDEX_EMPTY;
+	p->lruNext = lruHead;
+	if (lruHead != SENSOR_INDEX_EMPTY) {
+		sensorTable[lruHead].lruPrev = Index;
+	} else {
+		lruTail = Index;
+	}
+	lruHead = Index;
+}
+
+static void LruRemove(size_t Index)
+{
+	SensorEntry_t *p = &sensorTable[Index];
+	if (p->lruPrev != SENSOR_INDEX_EMPTY) {
+		sensorTable[p->lruPrev].lruNext = p->lruNext;
+	} else {
+		lruHead = p->lruNext;
+	}
+	if (p->lruNext != SENSOR_INDEX_EMPTY) {
+		sensorTable[p->lruNext].lruPrev = p->lruPrev;
+	} else {
+		lruTail = p->lruPrev;
+	}
+	p->lruPrev = SENSOR_INDEX_EMPTY;
+	p->lruNext = SENSOR_INDEX_EMPTY;
+}
+
+/* Greenlisted sensors and sensors that are being configured are never
+ * evicted.
+ */
+static bool Evictable(SensorEntry_t *pEntry)
+{
+	if (pEntry->greenlisted) {
+		return false;
+	}
+
+	SensorDetail_t *p = DetailOf(pEntry);
+	if (p != NULL) {
+		return (p->pCmd == NULL && p->pSecondCmd == NULL &&
+			!p->configBusy && !p->dumpBusy && !p->subscribed);
+	}
+	return true;
+}
+
+/* Starting at the least recently seen sensor, find the first sensor that can
+ * be evicted.  Sensors last seen in the same second are candidates and
+ * the one with the weakest signal is removed.
+ */
+static size_t EvictEntry(void)
+{
+	size_t victim = CONFIG_SENSOR_TABLE_SIZE;
+	uint16_t i;
+	for (i = lruTail; i != SENSOR_INDEX_EMPTY; i = sensorTable[i].lruPrev) {
+		SensorEntry_t *p = &sensorTable[i];
+		if (victim < CONFIG_SENSOR_TABLE_SIZE &&
+		    p->lastSeen != sensorTable[victim].lastSeen) {
+			break;
+		}
+		if (Evictable(p) && (victim >= CONFIG_SENSOR_TABLE_SIZE ||
+				     p->rssi < sensorTable[victim].rssi)) {
+			victim = i;
+		}
+	}
+
+	if (victim < CONFIG_SENSOR_TABLE_SIZE) {
+		LOG_DBG("Evicting sensor [%u] RSSI: %d", victim,
+			sensorTable[victim].rssi);
+		RemoveEntry(&sensorTable[victim]);
+		evictions += 1;
+		victim = FindFirstFree();
+	}
+	return victim;
+}
+#else
+static void LruTouch(size_t Index)
+{
+	ARG_UNUSED(Index);
+}
+
+static void LruInsert(size_t Index)
+{
+	ARG_UNUSED(Index);
+}
+
+static void LruRemove(size_t Index)
+{
+	ARG_UNUSED(Index);
+}
+
+static size_t EvictEntry(void)
+{
+	return CONFIG_SENSOR_TABLE_SIZE;
+}
+#endif
+
+static size_t IndexFind(const bt_addr_t *pAddr)
+{
+	size_t i = SensorIndex_Find(&addrIndex, pAddr);
+	if (i == SENSOR_INDEX_EMPTY) {
+		return CONFIG_SENSOR_TABLE_SIZE;
+	}
+	FRAMEWORK_DEBUG_ASSERT(sensorTable[i].inUse);
+	return i;
+}
+
+static bool NameMatch(const char *p, SensorDetail_t *pDetail)
+{
+	return (strncmp(p, pDetail->name, SENSOR_NAME_MAX_STR_LEN) == 0);
+}
+
+static bool RspMatch(const LczSensorRsp_t *p, SensorDetail_t *pDetail)
+{
+	return (memcmp(p, &pDetail->rsp, sizeof(LczSensorRsp_t)) == 0);
+}
+
+static bool NewEvent(uint16_t Id, SensorEntry_t *pEntry)
+{
+	if (!pEntry->validAd) {
+		return true;
 	} else {
-		ShadowBtHandler(pMsg, pEntry);
-		ShadowAdHandler(pMsg, pEntry);
-		ShadowRspHandler(pMsg, pEntry);
-		ShadowLogHandler(pMsg, pEntry);
-		ShadowSpecialHandler(pMsg, pEntry);
+		return (Id != pEntry->id);
 	}
+}
+
+static void ShadowMaker(SensorDetail_t *pDetail)
+{
+	/* AWS will disconnect if data is sent for devices that have not
+	 * been greenlisted.
+	 */
+	if (!CONFIG_USE_SINGLE_AWS_TOPIC) {
+		if (!EntryOf(pDetail)->greenlisted ||
+		    !pDetail->shadowInitReceived) {
+			return;
+		}
+	}
+
+	JsonMsg_t *pMsg =
+		BP_TRY_TO_TAKE(FWK_BUFFER_MSG_SIZE(JsonMsg_t, SHADOW_BUF_SIZE));
+	if (pMsg == NULL) {
+		return;
+	}
+
+	pMsg->header.msgCode = FMC_SENSOR_PUBLISH;
+	pMsg->header.rxId = FWK_ID_CLOUD;
+	pMsg->size = SHADOW_BUF_SIZE;
+
+	bool full = ShadowFullRefreshRequired(pDetail);
+
+#ifdef CONFIG_SENSOR_TELEMETRY_CBOR
+	ShadowBuilder_SetEncoding(pMsg, SHADOW_ENCODING_CBOR);
+#endif
+	ShadowBuilder_Start(pMsg, SKIP_MEMSET);
+	ShadowBuilder_StartGroup(pMsg, "state");
+	ShadowBuilder_StartGroup(pMsg, "reported");
+#if CONFIG_USE_SINGLE_AWS_TOPIC
+	ShadowSingleTopicHandler(pMsg, pDetail);
+#else
+	ShadowBtHandler(pMsg, pDetail, full);
+	ShadowAdHandler(pMsg, pDetail, full);
+	ShadowRspHandler(pMsg, pDetail, full);
+	ShadowLogHandler(pMsg, pDetail, full);
+	if (full) {
+		ShadowSpecialHandler(pMsg, pDetail);
+	}
+#endif
 	ShadowBuilder_EndGroup(pMsg);
 	ShadowBuilder_EndGroup(pMsg);
 	ShadowBuilder_Finalize(pMsg);
@@ -914,94 +1952,241 @@ static void ShadowMaker(SensorEntry_t *pEntry)
 	/* The part of the topic that changes must match
 	 * the format of the address field generated by ShadowGatewayMaker.
 	 */
+#ifdef CONFIG_SENSOR_TELEMETRY_CBOR
+	char *fmt = CONFIG_SENSOR_TELEMETRY_TOPIC_FMT_STR;
+#else
 	char *fmt = SENSOR_UPDATE_TOPIC_FMT_STR;
+#endif
 	snprintk(pMsg->topic, CONFIG_AWS_TOPIC_MAX_SIZE, fmt,
-		 pEntry->addrString);
+		 pDetail->addrString);
+
+	pMsg->publishId = ShadowPublished(pDetail, full, pMsg->length);
 
 	FRAMEWORK_MSG_SEND(pMsg);
 }
 
-/**
- * @brief Create unique names for each key so that everything can be
- * sent to a single topic.
+/* The snapshot is only updated when a shadow is acknowledged.  It is
+ * invalidated when the connection is lost so that a shadow sent before then
+ * can't make it valid again.
  */
-static char *MangleKey(const char *pName, const char *pKey)
+static bool ShadowFullRefreshRequired(SensorDetail_t *pDetail)
 {
-#if CONFIG_USE_SINGLE_AWS_TOPIC
-	static char mangled[MANGLED_NAME_MAX_SIZE];
-	memset(mangled, 0, sizeof(mangled));
-	strncat_max(mangled, pName, MANGLED_NAME_MAX_STR_LEN);
-	strncat_max(mangled, "-", MANGLED_NAME_MAX_STR_LEN);
-	strncat_max(mangled, pKey, MANGLED_NAME_MAX_STR_LEN);
-	return mangled;
+#ifdef CONFIG_SENSOR_SHADOW_DELTA
+	ShadowSnapshot_t *p = &pDetail->reported;
+	if (!p->valid || CONFIG_USE_SINGLE_AWS_TOPIC) {
+		return true;
+	}
+
+	/* The event log is only sent with a full shadow.  The refresh count is
+	 * limited to the log size so that an event can't be overwritten
+	 * before it has been reported.
+	 */
+	if (p->publishes >= CONFIG_SENSOR_SHADOW_FULL_REFRESH_PUBLISHES) {
+		return true;
+	}
+
+	int64_t elapsed = k_uptime_get() - p->refreshTime;
+	return (elapsed >=
+		(CONFIG_SENSOR_SHADOW_FULL_REFRESH_SECONDS * MSEC_PER_SEC));
 #else
-	return (char *)pKey;
+	ARG_UNUSED(pDetail);
+	return true;
 #endif
 }
 
-static void ShadowBtHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
+/* Only the last shadow that was sent can be committed.  Deltas are counted
+ * when they are sent so that the event log is refreshed in time even if
+ * acknowledgements are slow.
+ *
+ * @retval id of the publish, 0 if it was committed without waiting for
+ * the acknowledgement
+ */
+static uint32_t ShadowPublished(SensorDetail_t *pDetail, bool Full,
+				size_t Length)
 {
-	ShadowBuilder_AddPair(pMsg, "bluetoothAddress", pEntry->addrString,
-			      SB_IS_STRING);
+	ShadowSnapshot_t *p = &pDetail->sent;
+	*p = pDetail->reported;
+	p->rssi = pDetail->rssi;
+	p->networkId = pDetail->ad.networkId;
+	p->flags = pDetail->ad.flags;
+	p->resetCount = pDetail->ad.resetCount;
+	if (EntryOf(pDetail)->validRsp) {
+		p->rspCrc = RspCrc(pDetail);
+		p->nameCrc = NameCrc(pDetail);
+	}
+
+	if (Full) {
+		p->valid = EntryOf(pDetail)->validAd;
+		p->publishes = 0;
+		p->refreshTime = k_uptime_get();
+		p->fullLength = Length;
+		shadowFullPublishes += 1;
+	} else {
+		size_t saved = (p->fullLength > Length) ?
+				       (p->fullLength - Length) : 0;
+		pDetail->reported.publishes += 1;
+		p->publishes += 1;
+		shadowDeltaPublishes += 1;
+		shadowBytesSaved += saved;
+		LOG_DBG("Sensor %s delta shadow %u bytes (%u saved)",
+			log_strdup(pDetail->addrString), Length, saved);
+	}
+
+#ifdef CONFIG_SENSOR_SHADOW_DELTA
+	/* 0 isn't used so that an id can't match a sensor that isn't waiting */
+	shadowPublishId = MAX(shadowPublishId + 1, 1);
+	pDetail->sentId = shadowPublishId;
+	return pDetail->sentId;
+#else
+	/* Every shadow is full so there is nothing to compare to. */
+	ShadowCommit(pDetail);
+	return 0;
+#endif
+}
 
-	ShadowBuilder_AddSigned32(pMsg, "rssi", pEntry->rssi);
+static void ShadowCommit(SensorDetail_t *pDetail)
+{
+	pDetail->reported = pDetail->sent;
+	pDetail->sentId = 0;
+	SnapshotMarkDirty();
+}
+
+static void ShadowInvalidate(SensorDetail_t *pDetail)
+{
+	pDetail->reported.valid = false;
+	pDetail->sentId = 0;
 }
 
-static void ShadowAdHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
+static uint32_t RspCrc(SensorDetail_t *pDetail)
+{
+	return crc32_ieee((uint8_t *)&pDetail->rsp, sizeof(LczSensorRsp_t));
+}
+
+static uint32_t NameCrc(SensorDetail_t *pDetail)
+{
+	return crc32_ieee((uint8_t *)pDetail->name,
+			  strnlen(pDetail->name, SENSOR_NAME_MAX_SIZE));
+}
+
+#if CONFIG_USE_SINGLE_AWS_TOPIC
+/* Each key is made unique with the name of the sensor so that everything can
+ * be sent to a single topic.  The desired temperature format is degrees
+ * because that is how the BL654 Sensor data is formatted.
+ */
+static void ShadowSingleTopicHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail)
+{
+	SingleTopicKeys_t *pKeys = &pDetail->keys;
+	if (pDetail->updatedName || pKeys->rssi[0] == '\0') {
+		pDetail->updatedName = false;
+#define X(member, key)                                                         \
+	snprintk(pKeys->member, sizeof(pKeys->member), "%s-" key,             \
+		 pDetail->name);
+		BT510_SINGLE_TOPIC_KEY_TABLE(X)
+#undef X
+	}
+
+	switch (pDetail->ad.recordType) {
+#define X(type, value, key) SINGLE_TOPIC_##value(type)
+#define SINGLE_TOPIC_TEMPERATURE(type) case type:
+#define SINGLE_TOPIC_BATTERY(type)
+#define SINGLE_TOPIC_RESET_REASON(type)
+		BT510_RECORD_TABLE(X)
+#undef X
+#undef SINGLE_TOPIC_TEMPERATURE
+#undef SINGLE_TOPIC_BATTERY
+#undef SINGLE_TOPIC_RESET_REASON
+		ShadowBuilder_AddSigned32(pMsg, pKeys->temperature,
+					  GetTemperature(pDetail) / 100);
+		break;
+	default:
+		break;
+	}
+
+	/* Sending RSSI prevents an empty buffer when
+	 * temperature isn't present.
+	 */
+	ShadowBuilder_AddSigned32(pMsg, pKeys->rssi, pDetail->rssi);
+}
+#endif
+
+static void ShadowBtHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail,
+			    bool Full)
+{
+	if (Full) {
+		ShadowBuilder_AddPair(pMsg, "bluetoothAddress",
+				      pDetail->addrString, SB_IS_STRING);
+	}
+
+	if (Full || pDetail->rssi != pDetail->reported.rssi) {
+		ShadowBuilder_AddSigned32(pMsg, "rssi", pDetail->rssi);
+	}
+}
+
+static void ShadowAdHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail,
+			    bool Full)
 {
 	/* If gateway was reset then a sensor may be enabled from AWS
 	 * before an AD or RSP has been received.  The shadow is already valid.
 	 * Don't send bad data.
 	 */
-	if (!pEntry->validAd) {
+	if (!EntryOf(pDetail)->validAd) {
 		return;
 	}
 
-	ShadowBuilder_AddUint32(pMsg, "networkId", pEntry->ad.networkId);
-	ShadowBuilder_AddUint32(pMsg, "flags", pEntry->ad.flags);
-	ShadowBuilder_AddUint32(pMsg, "resetCount", pEntry->ad.resetCount);
+	ShadowSnapshot_t *p = &pDetail->reported;
+	if (Full || pDetail->ad.networkId != p->networkId) {
+		ShadowBuilder_AddUint32(pMsg, "networkId",
+					pDetail->ad.networkId);
+	}
+	if (Full || pDetail->ad.flags != p->flags) {
+		ShadowBuilder_AddUint32(pMsg, "flags", pDetail->ad.flags);
+	}
+	if (Full || pDetail->ad.resetCount != p->resetCount) {
+		ShadowBuilder_AddUint32(pMsg, "resetCount",
+					pDetail->ad.resetCount);
+	}
 
-	ShadowTemperatureHandler(pMsg, pEntry);
-	ShadowEventHandler(pMsg, pEntry);
-	ShadowFlagHandler(pMsg, pEntry);
-	ShadowIg60EventHandler(pMsg, pEntry);
+	/* These belong to the event that caused the publish. */
+	ShadowRecordHandler(pMsg, pDetail);
+	ShadowFlagHandler(pMsg, pDetail, Full);
+	ShadowIg60RecordHandler(pMsg, pDetail);
 }
 
 /**
  * @brief Build JSON for items that are in the Scan Response
  * and don't change that often (when device is added to table).
  */
-static void ShadowRspHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
+static void ShadowRspHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail,
+			     bool Full)
 {
-	if (!pEntry->validRsp) {
+	if (!EntryOf(pDetail)->validRsp) {
 		return;
 	}
 
-	if (pEntry->updatedRsp) {
-		pEntry->updatedRsp = false;
+	ShadowSnapshot_t *p = &pDetail->reported;
+	if (Full || RspCrc(pDetail) != p->rspCrc) {
 		ShadowBuilder_AddUint32(pMsg, "productId",
-					pEntry->rsp.productId);
+					pDetail->rsp.productId);
 		ShadowBuilder_AddVersion(pMsg, "firmwareVersion",
-					 pEntry->rsp.firmwareVersionMajor,
-					 pEntry->rsp.firmwareVersionMinor,
-					 pEntry->rsp.firmwareVersionPatch);
+					 pDetail->rsp.firmwareVersionMajor,
+					 pDetail->rsp.firmwareVersionMinor,
+					 pDetail->rsp.firmwareVersionPatch);
 		ShadowBuilder_AddVersion(pMsg, "bootloaderVersion",
-					 pEntry->rsp.bootloaderVersionMajor,
-					 pEntry->rsp.bootloaderVersionMinor,
-					 pEntry->rsp.bootloaderVersionPatch);
+					 pDetail->rsp.bootloaderVersionMajor,
+					 pDetail->rsp.bootloaderVersionMinor,
+					 pDetail->rsp.bootloaderVersionPatch);
 		ShadowBuilder_AddUint32(pMsg, "configVersion",
-					pEntry->rsp.configVersion);
+					pDetail->rsp.configVersion);
 		ShadowBuilder_AddVersion(pMsg, "hardwareVersion",
 					 ADV_FORMAT_HW_VERSION_GET_MAJOR(
-						 pEntry->rsp.hardwareVersion),
+						 pDetail->rsp.hardwareVersion),
 					 ADV_FORMAT_HW_VERSION_GET_MINOR(
-						 pEntry->rsp.hardwareVersion),
+						 pDetail->rsp.hardwareVersion),
 					 0);
 	}
 
-	if (pEntry->updatedName) {
-		pEntry->updatedName = false;
-		ShadowBuilder_AddPair(pMsg, "sensorName", pEntry->name,
+	if (Full || NameCrc(pDetail) != p->nameCrc) {
+		ShadowBuilder_AddPair(pMsg, "sensorName", pDetail->name,
 				      SB_IS_STRING);
 	}
 }
@@ -1010,197 +2195,140 @@ static void ShadowRspHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
  * Get temperature from advertisement (assumes event contains temperature).
  * retval temperature in hundredths of degree C
  */
-static int32_t GetTemperature(SensorEntry_t *pEntry)
+static int32_t GetTemperature(SensorDetail_t *pDetail)
 {
-	return (int32_t)((int16_t)pEntry->ad.data.u16);
+	return (int32_t)((int16_t)pDetail->ad.data.u16);
 }
 
-static uint32_t GetBattery(SensorEntry_t *pEntry)
+static uint32_t GetBattery(SensorDetail_t *pDetail)
 {
-	return (uint32_t)((uint16_t)pEntry->ad.data.u16);
+	return (uint32_t)((uint16_t)pDetail->ad.data.u16);
 }
 
 static bool LowBatteryAlarm(SensorEntry_t *pEntry)
 {
-	return (GetFlag(pEntry->ad.flags, FLAG_LOW_BATTERY_ALARM) != 0);
+	return (GetFlag(pEntry->flags, FLAG_LOW_BATTERY_ALARM) != 0);
 }
 
-static void ShadowTemperatureHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
+/* The value that belongs to each record type is described by
+ * BT510_RECORD_TABLE.
+ */
+static void ShadowRecordHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail)
 {
-	int32_t temperature = GetTemperature(pEntry);
-	if (CONFIG_USE_SINGLE_AWS_TOPIC) {
-		/* The desired format is degrees when publishing to a single topic
-		 * because that is how the BL654 Sensor data is formatted.
-		 */
-		temperature /= 100;
-	}
-	switch (pEntry->ad.recordType) {
-	case SENSOR_EVENT_TEMPERATURE:
-	case SENSOR_EVENT_ALARM_HIGH_TEMP_1:
-	case SENSOR_EVENT_ALARM_HIGH_TEMP_2:
-	case SENSOR_EVENT_ALARM_HIGH_TEMP_CLEAR:
-	case SENSOR_EVENT_ALARM_LOW_TEMP_1:
-	case SENSOR_EVENT_ALARM_LOW_TEMP_2:
-	case SENSOR_EVENT_ALARM_LOW_TEMP_CLEAR:
-	case SENSOR_EVENT_ALARM_DELTA_TEMP:
-	case SENSOR_EVENT_ALARM_TEMPERATURE_RATE_OF_CHANGE:
-		ShadowBuilder_AddSigned32(
-			pMsg,
-			MangleKey(pEntry->name, CONFIG_USE_SINGLE_AWS_TOPIC ?
-							      "temperature" :
-							      "tempCc"),
-			temperature);
+	switch (pDetail->ad.recordType) {
+#define X(type, value, key)                                                    \
+	case type:                                                             \
+		ShadowAdd##value(pMsg, key, pDetail);                          \
 		break;
+		BT510_RECORD_TABLE(X)
+#undef X
 	default:
 		break;
 	}
 }
 
-static void ShadowEventHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
+static void ShadowIg60RecordHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail)
 {
-	/* Many events are replicated in flags (and not processed here). */
-	switch (pEntry->ad.recordType) {
-	case SENSOR_EVENT_BATTERY_GOOD:
-	case SENSOR_EVENT_BATTERY_BAD:
-		ShadowBuilder_AddUint32(pMsg, "batteryVoltageMv",
-					(uint32_t)pEntry->ad.data.u16);
-		break;
-	case SENSOR_EVENT_RESET:
-		ShadowBuilder_AddPair(pMsg, "resetReason",
-				      lcz_sensor_event_get_reset_reason_string(
-					      pEntry->ad.data.u16),
-				      false);
+	switch (pDetail->ad.recordType) {
+#define X(type, value, key)                                                    \
+	case type:                                                             \
+		ShadowAdd##value(pMsg, key, pDetail);                          \
 		break;
+		BT510_IG60_RECORD_TABLE(X)
+#undef X
 	default:
 		break;
 	}
 }
 
-/* These are additional events that the IG60 generates.
- * The purpose of these is have a persitent value in shadow because
- * the event log is limited.  If the app is closed, then this is one
- * method of preventing lost events.
- * The names are taken from the bt510_cli project and bt510.schema.json.
- */
-static void ShadowIg60EventHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
+static void ShadowAddTEMPERATURE(JsonMsg_t *pMsg, const char *pKey,
+				 SensorDetail_t *pDetail)
 {
-	int32_t t = GetTemperature(pEntry);
-	switch (pEntry->ad.recordType) {
-	case SENSOR_EVENT_ALARM_HIGH_TEMP_1:
-		ShadowBuilder_AddSigned32(
-			pMsg, IG60_GENERATED_EVENT_STR_ALARM_HIGH_TEMP_1, t);
-		break;
-	case SENSOR_EVENT_ALARM_HIGH_TEMP_2:
-		ShadowBuilder_AddSigned32(
-			pMsg, IG60_GENERATED_EVENT_STR_ALARM_HIGH_TEMP_2, t);
-		break;
-	case SENSOR_EVENT_ALARM_HIGH_TEMP_CLEAR:
-		ShadowBuilder_AddSigned32(
-			pMsg, IG60_GENERATED_EVENT_STR_ALARM_HIGH_TEMP_CLEAR,
-			t);
-		break;
-	case SENSOR_EVENT_ALARM_LOW_TEMP_1:
-		ShadowBuilder_AddSigned32(
-			pMsg, IG60_GENERATED_EVENT_STR_ALARM_LOW_TEMP_1, t);
-		break;
-	case SENSOR_EVENT_ALARM_LOW_TEMP_2:
-		ShadowBuilder_AddSigned32(
-			pMsg, IG60_GENERATED_EVENT_STR_ALARM_LOW_TEMP_2, t);
-		break;
-	case SENSOR_EVENT_ALARM_LOW_TEMP_CLEAR:
-		ShadowBuilder_AddSigned32(
-			pMsg, IG60_GENERATED_EVENT_STR_ALARM_LOW_TEMP_CLEAR, t);
-		break;
-	case SENSOR_EVENT_ALARM_DELTA_TEMP:
-		ShadowBuilder_AddSigned32(
-			pMsg, IG60_GENERATED_EVENT_STR_ALARM_DELTA_TEMP, t);
-		break;
-	case SENSOR_EVENT_BATTERY_GOOD:
-		ShadowBuilder_AddUint32(pMsg,
-					IG60_GENERATED_EVENT_STR_BATTERY_GOOD,
-					GetBattery(pEntry));
-		break;
-	case SENSOR_EVENT_BATTERY_BAD:
-		ShadowBuilder_AddUint32(pMsg,
-					IG60_GENERATED_EVENT_STR_BATTERY_BAD,
-					GetBattery(pEntry));
-		break;
-	case SENSOR_EVENT_ADV_ON_BUTTON:
-		ShadowBuilder_AddUint32(
-			pMsg, IG60_GENERATED_EVENT_STR_ADVERTISE_ON_BUTTON,
-			GetBattery(pEntry));
-		break;
-	default:
-		break;
-	}
+	ShadowBuilder_AddSigned32(pMsg, pKey, GetTemperature(pDetail));
 }
 
-static void ShadowFlagHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
+static void ShadowAddBATTERY(JsonMsg_t *pMsg, const char *pKey,
+			     SensorDetail_t *pDetail)
 {
-	uint16_t flags = pEntry->ad.flags;
-	if (flags != pEntry->lastFlags) {
-		ShadowBuilder_AddUint32(pMsg, "rtcSet",
-					GetFlag(flags, FLAG_TIME_WAS_SET));
-		ShadowBuilder_AddUint32(pMsg, "activeMode",
-					GetFlag(flags, FLAG_ACTIVE_MODE));
-		ShadowBuilder_AddUint32(pMsg, "anyAlarm",
-					GetFlag(flags, FLAG_ANY_ALARM));
-		ShadowBuilder_AddUint32(pMsg, "lowBatteryAlarm",
-					GetFlag(flags, FLAG_LOW_BATTERY_ALARM));
-		ShadowBuilder_AddUint32(pMsg, "highTemperatureAlarm",
-					GetFlag(flags, FLAG_HIGH_TEMP_ALARM));
-		ShadowBuilder_AddUint32(pMsg, "lowTemperatureAlarm",
-					GetFlag(flags, FLAG_LOW_TEMP_ALARM));
-		ShadowBuilder_AddUint32(pMsg, "deltaTemperatureAlarm",
-					GetFlag(flags, FLAG_DELTA_TEMP_ALARM));
-		ShadowBuilder_AddUint32(
-			pMsg, "rateOfChangeTemperatureAlarm",
-			GetFlag(flags, FLAG_RATE_OF_CHANGE_TEMP_ALARM));
-		ShadowBuilder_AddUint32(pMsg, "movementAlarm",
-					GetFlag(flags, FLAG_MOVEMENT_ALARM));
-		ShadowBuilder_AddUint32(pMsg, "magnetState",
-					GetFlag(flags, FLAG_MAGNET_STATE));
+	ShadowBuilder_AddUint32(pMsg, pKey, GetBattery(pDetail));
+}
 
-		pEntry->lastFlags = flags;
+static void ShadowAddRESET_REASON(JsonMsg_t *pMsg, const char *pKey,
+				  SensorDetail_t *pDetail)
+{
+	ShadowBuilder_AddPair(
+		pMsg, pKey,
+		lcz_sensor_event_get_reset_reason_string(pDetail->ad.data.u16),
+		false);
+}
+
+static void ShadowFlagHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail,
+			      bool Full)
+{
+	uint16_t flags = pDetail->ad.flags;
+	if (Full || flags != pDetail->reported.flags) {
+#define X(key, flag) ShadowBuilder_AddUint32(pMsg, key, GetFlag(flags, flag));
+		BT510_FLAG_TABLE(X)
+#undef X
 	}
 }
 
-static void ShadowLogHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
+static void ShadowLogHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail,
+			     bool Full)
 {
-	SensorLogEvent_t event = { .epoch = pEntry->ad.epoch,
-				   .data = pEntry->ad.data.u16,
-				   .recordType = pEntry->ad.recordType,
-				   .idLsb = (uint8_t)pEntry->ad.id };
+	SensorLogEvent_t event = { .epoch = pDetail->ad.epoch,
+				   .data = pDetail->ad.data.u16,
+				   .recordType = pDetail->ad.recordType,
+				   .idLsb = (uint8_t)pDetail->ad.id };
 
-	SensorLog_Add(pEntry->pLog, &event);
+	SensorLog_Add(pDetail->pLog, &event);
 
-	SensorLog_GenerateJson(pEntry->pLog, pMsg);
+	if (Full) {
+		SensorLog_GenerateJson(pDetail->pLog, pMsg);
+	}
 }
 
 /* These special items exist on the gateway and not on the sensor */
-static void ShadowSpecialHandler(JsonMsg_t *pMsg, SensorEntry_t *pEntry)
+static void ShadowSpecialHandler(JsonMsg_t *pMsg, SensorDetail_t *pDetail)
 {
 	ShadowBuilder_AddPair(pMsg, "gatewayId",
 			      (char *)attr_get_quasi_static(ATTR_ID_gatewayId),
 			      false);
 
 	ShadowBuilder_AddUint32(pMsg, "eventLogSize",
-				SensorLog_GetSize(pEntry->pLog));
+				SensorLog_GetSize(pDetail->pLog));
 }
 
-static void SensorAddrToString(SensorEntry_t *pEntry)
+static void AddrToString(const bt_addr_t *pAddr, char *pStr)
 {
 #if CONFIG_FWK_ASSERT_ENABLED || CONFIG_FWK_ASSERT_ENABLED_USE_ZEPHYR
 	int count =
 #endif
-		snprintk(pEntry->addrString, SENSOR_ADDR_STR_SIZE,
-			 "%02x%02x%02x%02x%02x%02x", pEntry->ad.addr.val[5],
-			 pEntry->ad.addr.val[4], pEntry->ad.addr.val[3],
-			 pEntry->ad.addr.val[2], pEntry->ad.addr.val[1],
-			 pEntry->ad.addr.val[0]);
+		snprintk(pStr, SENSOR_ADDR_STR_SIZE, "%02x%02x%02x%02x%02x%02x",
+			 pAddr->val[5], pAddr->val[4], pAddr->val[3],
+			 pAddr->val[2], pAddr->val[1], pAddr->val[0]);
 	FRAMEWORK_ASSERT(count == SENSOR_ADDR_STR_LEN);
 }
 
+/* Mark the page that contains a table slot as changed. */
+static void GatewayShadowChanged(size_t TableIndex)
+{
+	if (CONFIG_USE_SINGLE_AWS_TOPIC) {
+		return;
+	}
+
+	if (TableIndex < CONFIG_SENSOR_TABLE_SIZE) {
+		gatewayShadowPages[TableIndex /
+				   CONFIG_SENSOR_GATEWAY_SHADOW_PAGE_SIZE]
+			.dirty = true;
+		gatewayShadow.dirty = true;
+	}
+}
+
+/* The first change is published immediately and changes that follow are
+ * collected until the minimum interval has elapsed.  The acknowledgement of
+ * a greenlist request isn't delayed.
+ */
 static void GatewayShadowMaker(bool GreenlistProcessed)
 {
 	if (CONFIG_USE_SINGLE_AWS_TOPIC) {
@@ -1211,57 +2339,162 @@ static void GatewayShadowMaker(bool GreenlistProcessed)
 		return;
 	}
 
+	gatewayShadow.dirty = true;
+	gatewayShadow.greenlistProcessed |= GreenlistProcessed;
+	if (GreenlistProcessed) {
+		GatewayShadowPublish();
+	} else {
+		SensorTable_GatewayShadowHandler();
+	}
+}
+
+/* At most CONFIG_SENSOR_GATEWAY_SHADOW_PAGES_PER_PUBLISH pages are sent at
+ * once.  The pages that remain are sent after the minimum interval.
+ */
+static void GatewayShadowPublish(void)
+{
+	if (!allowGatewayShadowGeneration) {
+		return;
+	}
+
+	bool desiredNull = gatewayShadow.greenlistProcessed;
+	bool pending = false;
+	size_t sent = 0;
+	size_t page;
+	int r = 0;
+	for (page = 0; page < SENSOR_GATEWAY_SHADOW_PAGES; page++) {
+		if (!gatewayShadowPages[page].dirty) {
+			continue;
+		}
+		if ((r < 0) ||
+		    (sent >= CONFIG_SENSOR_GATEWAY_SHADOW_PAGES_PER_PUBLISH)) {
+			pending = true;
+			continue;
+		}
+		r = GatewayShadowPublishPage(page, desiredNull);
+		if (r < 0) {
+			pending = true;
+		} else {
+			gatewayShadowPages[page].dirty = false;
+		}
+		if (r > 0) {
+			sent += 1;
+			desiredNull = false;
+		}
+	}
+
+	/* The cloud must be told that its request was processed even if
+	 * the sensor list didn't change.
+	 */
+	if (desiredNull && (r >= 0)) {
+		r = GatewayShadowPublishPage(0, true);
+		if (r > 0) {
+			sent += 1;
+			desiredNull = false;
+		}
+	}
+
+	gatewayShadow.greenlistProcessed = desiredNull;
+	gatewayShadow.dirty = pending || desiredNull;
+	if ((sent > 0) || (r < 0)) {
+		/* After a failure, try again after the minimum interval. */
+		gatewayShadow.publishTime = k_uptime_get();
+	}
+}
+
+/* An empty page (other than the first) is set to null so that it is removed
+ * from the shadow.
+ *
+ * @retval 1 if the page was sent, 0 if it hasn't changed since it was last
+ * sent, otherwise a negative error code.
+ */
+static int GatewayShadowPublishPage(size_t Page, bool DesiredNull)
+{
+	GatewayShadowPage_t *pPage = &gatewayShadowPages[Page];
 	JsonMsg_t *pMsg = BP_TRY_TO_TAKE(
 		FWK_BUFFER_MSG_SIZE(JsonMsg_t, SENSOR_GATEWAY_SHADOW_MAX_SIZE));
 	if (pMsg == NULL) {
-		return;
+		return -ENOMEM;
 	}
 	pMsg->header.msgCode = FMC_GATEWAY_OUT;
 	pMsg->header.rxId = FWK_ID_CLOUD;
 	pMsg->size = SENSOR_GATEWAY_SHADOW_MAX_SIZE;
 
+	char key[SENSOR_GATEWAY_SHADOW_PAGE_KEY_SIZE];
+	SensorTable_GatewayShadowPageKey(key, sizeof(key), Page);
+	size_t first = Page * CONFIG_SENSOR_GATEWAY_SHADOW_PAGE_SIZE;
+	size_t last = MIN(first + CONFIG_SENSOR_GATEWAY_SHADOW_PAGE_SIZE,
+			  CONFIG_SENSOR_TABLE_SIZE);
+	size_t entries = 0;
+	size_t i;
+	for (i = first; i < last; i++) {
+		entries += sensorTable[i].inUse ? 1 : 0;
+	}
+
 	ShadowBuilder_Start(pMsg, SKIP_MEMSET);
 	ShadowBuilder_StartGroup(pMsg, "state");
 	/* Setting the desired group to null lets the cloud know
 	 * that its request was processed.
 	 */
-	if (GreenlistProcessed) {
+	if (DesiredNull) {
 		ShadowBuilder_AddNull(pMsg, "desired");
 	}
+	/* The acknowledgement isn't part of the page. */
+	size_t reported = pMsg->length;
 	ShadowBuilder_StartGroup(pMsg, "reported");
 	ShadowBuilder_StartGroup(pMsg, "bt510");
-	ShadowBuilder_StartArray(pMsg, "sensors");
-	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		SensorEntry_t *p = &sensorTable[i];
-		if (p->inUse) {
-			ShadowBuilder_AddSensorTableArrayEntry(pMsg,
-							       p->addrString,
-							       p->rxEpoch,
-							       p->greenlisted);
+	if (SENSOR_GATEWAY_SHADOW_PAGES > 1) {
+		ShadowBuilder_AddUint32(pMsg, "sensorPages",
+					SENSOR_GATEWAY_SHADOW_PAGES);
+	}
+	if ((entries == 0) && (Page > 0)) {
+		ShadowBuilder_AddNull(pMsg, key);
+	} else {
+		ShadowBuilder_StartArray(pMsg, key);
+		char addrString[SENSOR_ADDR_STR_SIZE];
+		for (i = first; i < last; i++) {
+			SensorEntry_t *p = &sensorTable[i];
+			if (p->inUse) {
+				AddrToString(&p->addr, addrString);
+				ShadowBuilder_AddSensorTableArrayEntry(
+					pMsg, addrString, p->rxEpoch,
+					p->greenlisted);
+			}
 		}
+		ShadowBuilder_EndArray(pMsg);
 	}
-	ShadowBuilder_EndArray(pMsg);
 	ShadowBuilder_EndGroup(pMsg);
 	ShadowBuilder_EndGroup(pMsg);
 	ShadowBuilder_EndGroup(pMsg);
 	ShadowBuilder_Finalize(pMsg);
 
+	uint32_t crc = crc32_ieee(pMsg->buffer + reported,
+				  pMsg->length - reported);
+	if (!DesiredNull && pPage->crcValid && crc == pPage->crc) {
+		gatewayShadow.skipped += 1;
+		BufferPool_Free(pMsg);
+		return 0;
+	}
+
+	pPage->crc = crc;
+	pPage->crcValid = true;
+	gatewayShadow.publishes += 1;
 	FRAMEWORK_MSG_SEND(pMsg);
+	return 1;
 }
 
 /* Returns 1 if the value was changed from its current state. */
 static size_t GreenlistByAddress(const char *pAddrString, bool NextState)
 {
-	size_t i;
-	for (i = 0; i < CONFIG_SENSOR_TABLE_SIZE; i++) {
-		if (AddrStringMatch(pAddrString, i)) {
-			if (sensorTable[i].greenlisted != NextState) {
-				Greenlist(&sensorTable[i], NextState);
-				return 1;
-			} else {
-				return 0;
-			}
+	bt_addr_t addr = BtAddrStringToStruct(pAddrString);
+	size_t i = IndexFind(&addr);
+	if (i < CONFIG_SENSOR_TABLE_SIZE) {
+		if (sensorTable[i].greenlisted != NextState) {
+			Greenlist(&sensorTable[i], NextState);
+			GatewayShadowChanged(i);
+			return 1;
+		} else {
+			return 0;
 		}
 	}
 	/* Don't add it to the table if it isn't greenlisted because
@@ -1271,10 +2504,10 @@ static size_t GreenlistByAddress(const char *pAddrString, bool NextState)
 		/* The sensor wasn't found.  If we have just reset then
 	 	 * the shadow may have values that aren't in our table.
 		 */
-		bt_addr_t addr = BtAddrStringToStruct(pAddrString);
 		i = AddByAddress(&addr);
 		if (i < CONFIG_SENSOR_TABLE_SIZE) {
 			Greenlist(&sensorTable[i], true);
+			GatewayShadowChanged(i);
 			return 1;
 		}
 	}
@@ -1283,17 +2516,22 @@ static size_t GreenlistByAddress(const char *pAddrString, bool NextState)
 
 static void Greenlist(SensorEntry_t *pEntry, bool Enable)
 {
+	SensorDetail_t *pDetail = DetailOf(pEntry);
 	if (Enable) {
-		if (greenCount < CONFIG_SENSOR_GREENLIST_SIZE) {
+		if ((pDetail == NULL) && (greenCount < CONFIG_SENSOR_GREENLIST_SIZE)) {
+			pDetail = AllocateDetail(pEntry - sensorTable);
+		}
+		if ((pDetail != NULL) &&
+		    (greenCount < CONFIG_SENSOR_GREENLIST_SIZE)) {
 			pEntry->greenlisted = true;
-			pEntry->subscribed = false;
-			pEntry->getAcceptedSubscribed = false;
-			pEntry->subscriptionDispatchTime =
+			pDetail->subscribed = false;
+			pDetail->getAcceptedSubscribed = false;
+			pDetail->subscriptionDispatchTime =
 				k_uptime_get() +
 				(CONFIG_SENSOR_SUBSCRIPTION_DELAY_SECONDS *
 				 MSEC_PER_SEC);
-			if (pEntry->pLog == NULL) {
-				pEntry->pLog = SensorLog_Allocate(
+			if (pDetail->pLog == NULL) {
+				pDetail->pLog = SensorLog_Allocate(
 					CONFIG_SENSOR_LOG_MAX_SIZE);
 			}
 			greenCount += 1;
@@ -1307,11 +2545,29 @@ static void Greenlist(SensorEntry_t *pEntry, bool Enable)
 		}
 	} else {
 		pEntry->greenlisted = false;
-		FreeEntryBuffers(pEntry);
+		if (pDetail != NULL) {
+			/* Detail is kept until the sensor is unsubscribed. */
+			if (CONFIG_USE_SINGLE_AWS_TOPIC || pDetail->subscribed) {
+				FreeDetailBuffers(pDetail);
+			} else {
+				FreeDetail(pEntry);
+			}
+		}
 		if (greenCount > 0) {
 			greenCount -= 1;
 		}
+		if (pEntry->expired) {
+			pEntry->expired = false;
+			SchedSet(SCHED_TTL_NODE(pEntry - sensorTable),
+				 k_uptime_get_32());
+		}
+	}
+
+	pDetail = DetailOf(pEntry);
+	if (pDetail != NULL) {
+		ScheduleDetail(pDetail, k_uptime_get_32());
 	}
+	SnapshotMarkDirty();
 }
 
 /* If the cloud desires a configuration change, then send a connect request
@@ -1321,34 +2577,38 @@ static void ConnectRequestHandler(size_t Index, bool Coded)
 {
 	FRAMEWORK_DEBUG_ASSERT(Index < CONFIG_SENSOR_TABLE_SIZE);
 	SensorEntry_t *pEntry = &sensorTable[Index];
+	SensorDetail_t *pDetail = DetailOf(pEntry);
+	if (pDetail == NULL) {
+		return;
+	}
 
-	if (pEntry->pCmd != NULL && !pEntry->configBusy) {
+	if (pDetail->pCmd != NULL && !pDetail->configBusy) {
 		if (LowBatteryAlarm(pEntry)) {
 			LOG_WRN("Discarding configuration request (sensor low battery)");
-			FreeCmdBuffers(pEntry);
+			FreeCmdBuffers(pDetail);
 		} else {
-			SensorCmdMsg_t *pMsg = pEntry->pCmd;
+			SensorCmdMsg_t *pMsg = pDetail->pCmd;
 			pMsg->header.msgCode = FMC_CONNECT_REQUEST;
 			pMsg->header.rxId = FWK_ID_SENSOR_TASK;
 			pMsg->tableIndex = Index;
 			pMsg->attempts += 1;
-			memcpy(&pMsg->addr.a.val, pEntry->ad.addr.val,
-			       sizeof(bt_addr_t));
+			bt_addr_copy(&pMsg->addr.a, &pEntry->addr);
 			pMsg->addr.type = BT_ADDR_LE_RANDOM;
 			pMsg->useCodedPhy = Coded;
-			strncpy(pMsg->name, pEntry->name,
+			strncpy(pMsg->name, pDetail->name,
 				SENSOR_NAME_MAX_STR_LEN);
 
 			/* sensor task is now responsible for this message */
-			pEntry->configBusyVersion = pMsg->configVersion;
-			pEntry->configBusy = true;
-			pEntry->pCmd = NULL;
+			pDetail->configBusyVersion = pMsg->configVersion;
+			pDetail->configBusy = true;
+			pDetail->pCmd = NULL;
+			UpdateAdFilter(pDetail);
 			FRAMEWORK_MSG_SEND(pMsg);
 		}
 	}
 }
 
-static void CreateDumpRequest(SensorEntry_t *pEntry)
+static void CreateDumpRequest(SensorDetail_t *pDetail)
 {
 	/* If an empty command is written by cloud, then send dump command. */
 	const char *pCmd;
@@ -1368,10 +2628,10 @@ static void CreateDumpRequest(SensorEntry_t *pEntry)
 		pMsg->size = bufSize;
 		pMsg->length = (bufSize > 0) ? (bufSize - 1) : 0;
 		pMsg->dumpRequest = true;
-		strncpy(pMsg->addrString, pEntry->addrString,
+		strncpy(pMsg->addrString, pDetail->addrString,
 			SENSOR_ADDR_STR_LEN);
 		strcpy(pMsg->cmd, pCmd);
-		pEntry->dumpBusy = true;
+		pDetail->dumpBusy = true;
 		FRAMEWORK_MSG_SEND(pMsg);
 	} else {
 		LOG_ERR("Unable to allocate sensor dump");
@@ -1381,11 +2641,11 @@ static void CreateDumpRequest(SensorEntry_t *pEntry)
 /* The IG60 configures the sensor when its configVersion == 0.
  * Match IG60's behavior to create uniform oob experience.
  */
-static void CreateConfigRequest(SensorEntry_t *pEntry)
+static void CreateConfigRequest(SensorDetail_t *pDetail)
 {
-	FRAMEWORK_DEBUG_ASSERT(pEntry->subscribed);
-	FRAMEWORK_DEBUG_ASSERT(pEntry->validRsp);
-	FRAMEWORK_DEBUG_ASSERT(pEntry->rsp.configVersion == 0);
+	FRAMEWORK_DEBUG_ASSERT(pDetail->subscribed);
+	FRAMEWORK_DEBUG_ASSERT(EntryOf(pDetail)->validRsp);
+	FRAMEWORK_DEBUG_ASSERT(pDetail->rsp.configVersion == 0);
 
 	const char *pCmd = SENSOR_CMD_SET_CONFIG_VERSION_1;
 	size_t bufSize = strlen(pCmd) + 1;
@@ -1400,7 +2660,7 @@ static void CreateConfigRequest(SensorEntry_t *pEntry)
 		pMsg->configVersion = 1;
 		pMsg->dumpRequest = false;
 		pMsg->setEpochRequest = true;
-		strncpy(pMsg->addrString, pEntry->addrString,
+		strncpy(pMsg->addrString, pDetail->addrString,
 			SENSOR_ADDR_STR_LEN);
 		strcpy(pMsg->cmd, pCmd);
 		FRAMEWORK_MSG_SEND(pMsg);
@@ -1432,7 +2692,7 @@ static uint32_t GetFlag(uint16_t Value, uint32_t Mask, uint8_t Position)
 	return (v >> Position);
 }
 
-static void PublishToGetAccepted(SensorEntry_t *pEntry)
+static void PublishToGetAccepted(SensorDetail_t *pDetail)
 {
 	size_t size = sizeof(GET_ACCEPTED_MSG);
 	JsonMsg_t *pMsg = BufferPool_Take(FWK_BUFFER_MSG_SIZE(JsonMsg_t, size));
@@ -1445,7 +2705,7 @@ static void PublishToGetAccepted(SensorEntry_t *pEntry)
 	pMsg->size = size;
 	char *fmt = SENSOR_GET_TOPIC_FMT_STR;
 	snprintk(pMsg->topic, CONFIG_AWS_TOPIC_MAX_SIZE, fmt,
-		 pEntry->addrString);
+		 pDetail->addrString);
 	strcpy(pMsg->buffer, GET_ACCEPTED_MSG);
 	pMsg->length = strlen(pMsg->buffer);
 	FRAMEWORK_MSG_SEND(pMsg);
@@ -31,6 +31,9 @@ LOG_MODULE_REGISTER(sensor_task, CONFIG_SENSOR_TASK_LOG_LEVEL);
 #include "sensor_table.h"
 #include "sensor_task.h"
 #include "single_peripheral.h"
+#ifdef CONFIG_SENSOR_ADV_FILTER
+#include "sensor_adv_filter.h"
+#endif
 
 /******************************************************************************/
 /* Local Constant, Macro and Type Definitions                                 */
@@ -47,15 +50,36 @@ LOG_MODULE_REGISTER(sensor_task, CONFIG_SENSOR_TASK_LOG_LEVEL);
 #define SENSOR_TASK_QUEUE_DEPTH 32
 #endif
 
-/** Limit the amount of space in the queue that can be used for processing
- * advertisements.
+/* Advertisements are passed from the BT RX thread to the sensor task using
+ * a single-producer/single-consumer ring.  The producer only writes the head
+ * and the consumer only writes the tail so no lock is required.  A single
+ * FMC_ADV message wakes the sensor task for a batch of advertisements.
  */
-#ifndef SENSOR_TASK_MAX_OUTSTANDING_ADS
-#define SENSOR_TASK_MAX_OUTSTANDING_ADS (SENSOR_TASK_QUEUE_DEPTH / 2)
-#endif
-
-/* At 1 second there are duplicate requests for shadow information. */
-#define SENSOR_TICK_RATE_SECONDS 3
+#define AD_RING_MASK (CONFIG_SENSOR_AD_RING_SIZE - 1)
+BUILD_ASSERT((CONFIG_SENSOR_AD_RING_SIZE & AD_RING_MASK) == 0,
+	     "Ad ring size must be a power of two");
+BUILD_ASSERT(CONFIG_SENSOR_MAX_AD_SIZE <= UINT8_MAX, "Ad length too large");
+
+/* Addresses of dropped advertisements are passed back so that drops can
+ * be counted per sensor.  If this ring is also full, then the drop is only
+ * counted in the global statistic.
+ */
+#define DROP_RING_SIZE 8
+#define DROP_RING_MASK (DROP_RING_SIZE - 1)
+
+typedef struct AdRecord {
+	bt_addr_le_t addr;
+	int8_t rssi;
+	uint8_t type;
+	uint8_t len;
+	uint8_t data[CONFIG_SENSOR_MAX_AD_SIZE];
+} AdRecord_t;
+
+/* The tick is scheduled for the next sensor table deadline.  While idle it
+ * still runs at this rate so that advertisements are processed if a
+ * wake-up message couldn't be allocated.
+ */
+#define SENSOR_TICK_MAX_IDLE_MS (10 * MSEC_PER_SEC)
 
 #define ENCRYPTION_TIMEOUT_TICKS K_SECONDS(6)
 #define CONNECTION_TIMEOUT_TICKS K_SECONDS(CONFIG_BT_CREATE_CONN_TIMEOUT + 3)
@@ -88,12 +112,19 @@ typedef struct SensorTask {
 	bool bluegrassReady;
 	struct k_timer resetTimer;
 	struct k_timer sensorTick;
+	bool tickArmed;
+	int64_t tickDeadline;
 	uint32_t fifoTicks;
 	int scanUserId;
 	uint32_t configDisconnects;
 	uint32_t adsProcessed;
-	atomic_t adsOutstanding; /* incremented in BT RX thread context */
+	atomic_t adHead; /* written in BT RX thread context */
+	atomic_t adTail; /* written in sensor task context */
+	atomic_t adWakePending;
+	atomic_t dropHead; /* written in BT RX thread context */
+	atomic_t dropTail; /* written in sensor task context */
 	atomic_t adsDropped; /* incremented in BT RX thread context */
+	uint32_t adsDroppedLogged;
 } SensorTaskObj_t;
 
 /* A connection is not created unless 1M is disabled. */
@@ -117,6 +148,11 @@ K_THREAD_STACK_DEFINE(sensorTaskStack, SENSOR_TASK_STACK_DEPTH);
 K_MSGQ_DEFINE(sensorTaskQueue, FWK_QUEUE_ENTRY_SIZE, SENSOR_TASK_QUEUE_DEPTH,
 	      FWK_QUEUE_ALIGNMENT);
 
+#ifdef CONFIG_SCAN_FOR_BT510
+static AdRecord_t adRing[CONFIG_SENSOR_AD_RING_SIZE];
+static bt_addr_t dropRing[DROP_RING_SIZE];
+#endif
+
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
@@ -137,6 +173,7 @@ static FwkMsgHandler_t AwsConnectionMsgHandler;
 static FwkMsgHandler_t AwsDecommissionMsgHandler;
 static FwkMsgHandler_t SubscriptionAckMsgHandler;
 static FwkMsgHandler_t SensorShadowInitMsgHandler;
+static FwkMsgHandler_t SensorPublishAckMsgHandler;
 
 static void RegisterConnectionCallbacks(void);
 static int StartDiscovery(void);
@@ -176,12 +213,15 @@ static void MtuCallback(struct bt_conn *conn, uint8_t err,
 
 static void SendSensorResetTimerCallbackIsr(struct k_timer *timer_id);
 static void SensorTickCallbackIsr(struct k_timer *timer_id);
-static void StartSensorTick(SensorTaskObj_t *pObj);
+static void UpdateSensorTick(SensorTaskObj_t *pObj);
 
 #ifdef CONFIG_SCAN_FOR_BT510
 static void SensorTaskAdvHandler(const bt_addr_le_t *addr, int8_t rssi,
 				 uint8_t type, struct net_buf_simple *ad);
+static void AdDropped(const bt_addr_le_t *addr);
+static void WakeForAds(SensorTaskObj_t *pObj);
 #endif
+static void DrainAdRing(SensorTaskObj_t *pObj);
 
 /******************************************************************************/
 /* Framework Message Dispatcher                                               */
@@ -207,6 +247,7 @@ static FwkMsgHandler_t *SensorTaskMsgDispatcher(FwkMsgCode_t MsgCode)
 	case FMC_AWS_DISCONNECTED:         return AwsConnectionMsgHandler;
 	case FMC_SUBSCRIBE_ACK:            return SubscriptionAckMsgHandler;
 	case FMC_SENSOR_SHADOW_INIT:       return SensorShadowInitMsgHandler;
+	case FMC_SENSOR_PUBLISH_ACK:       return SensorPublishAckMsgHandler;
 	case FMC_AWS_DECOMMISSION:         return AwsDecommissionMsgHandler;
 	default:                           return NULL;
 	}
@@ -216,6 +257,13 @@ static FwkMsgHandler_t *SensorTaskMsgDispatcher(FwkMsgCode_t MsgCode)
 /******************************************************************************/
 /* Global Function Definitions                                                */
 /******************************************************************************/
+void SensorTask_GetAdStats(SensorTaskAdStats_t *pStats)
+{
+	pStats->processed = st.adsProcessed;
+	pStats->dropped = atomic_get(&st.adsDropped);
+	pStats->queued = atomic_get(&st.adHead) - atomic_get(&st.adTail);
+}
+
 void SensorTask_Initialize(void)
 {
 	memset(&st, 0, sizeof(SensorTaskObj_t));
@@ -264,6 +312,7 @@ static void SensorTaskThread(void *pArg1, void *pArg2, void *pArg3)
 
 	while (true) {
 		Framework_MsgReceiver(&pObj->msgTask.rxer);
+		UpdateSensorTick(pObj);
 		uint32_t numUsed =
 			k_msgq_num_used_get(pObj->msgTask.rxer.pQueue);
 		if (numUsed > SENSOR_TASK_QUEUE_DEPTH / 2) {
@@ -276,21 +325,55 @@ static void SensorTaskThread(void *pArg1, void *pArg2, void *pArg3)
 DispatchResult_t AdvertisementMsgHandler(FwkMsgReceiver_t *pMsgRxer,
 					 FwkMsg_t *pMsg)
 {
-	AdvMsg_t *pAdvMsg = (AdvMsg_t *)pMsg;
-	SensorTable_AdvertisementHandler(&pAdvMsg->addr, pAdvMsg->rssi,
-					 pAdvMsg->type, &pAdvMsg->ad);
-
+	UNUSED_PARAMETER(pMsg);
 	SensorTaskObj_t *pObj = FWK_TASK_CONTAINER(SensorTaskObj_t);
-	pObj->adsProcessed += 1;
-	atomic_dec(&pObj->adsOutstanding);
-	/* Attempt to limit prints when busy. */
-	if (atomic_get(&pObj->adsOutstanding) == 0) {
-		if (atomic_get(&pObj->adsDropped) > 0) {
-			atomic_val_t dropped = atomic_clear(&pObj->adsDropped);
-			LOG_WRN("%u advertisements dropped", dropped);
+	DrainAdRing(pObj);
+	return DISPATCH_OK;
+}
+
+/* Process a batch of advertisements.  The wake flag is cleared first so that
+ * an ad added while the batch is being processed generates a new wake-up.
+ */
+static void DrainAdRing(SensorTaskObj_t *pObj)
+{
+#ifdef CONFIG_SCAN_FOR_BT510
+	atomic_clear(&pObj->adWakePending);
+
+	atomic_val_t head = atomic_get(&pObj->adHead);
+	atomic_val_t tail = atomic_get(&pObj->adTail);
+	size_t n = 0;
+	while (tail != head && n < CONFIG_SENSOR_AD_BATCH_SIZE) {
+		AdRecord_t *p = &adRing[tail & AD_RING_MASK];
+		SensorTable_AdvertisementHandler(&p->addr, p->rssi, p->type,
+						 p->data, p->len);
+		tail += 1;
+		n += 1;
+		/* Give the slot back to the producer as soon as possible. */
+		atomic_set(&pObj->adTail, tail);
+	}
+	pObj->adsProcessed += n;
+
+	head = atomic_get(&pObj->dropHead);
+	tail = atomic_get(&pObj->dropTail);
+	while (tail != head) {
+		SensorTable_AdvertisementDropped(&dropRing[tail & DROP_RING_MASK]);
+		tail += 1;
+		atomic_set(&pObj->dropTail, tail);
+	}
+
+	/* Let other messages be processed before the next batch. */
+	if (atomic_get(&pObj->adHead) != atomic_get(&pObj->adTail)) {
+		WakeForAds(pObj);
+	} else {
+		/* Attempt to limit prints when busy. */
+		uint32_t dropped = (uint32_t)atomic_get(&pObj->adsDropped);
+		if (dropped != pObj->adsDroppedLogged) {
+			LOG_WRN("%u advertisements dropped",
+				dropped - pObj->adsDroppedLogged);
+			pObj->adsDroppedLogged = dropped;
 		}
 	}
-	return DISPATCH_OK;
+#endif
 }
 
 static DispatchResult_t GreenlistRequestMsgHandler(FwkMsgReceiver_t *pMsgRxer,
@@ -306,13 +389,13 @@ static DispatchResult_t SensorTickHandler(FwkMsgReceiver_t *pMsgRxer,
 {
 	UNUSED_PARAMETER(pMsg);
 	SensorTaskObj_t *pObj = FWK_TASK_CONTAINER(SensorTaskObj_t);
+	pObj->tickArmed = false;
+	/* Recover if a wake-up message could not be allocated. */
+	DrainAdRing(pObj);
 	if (pObj->bluegrassReady) {
-		SensorTable_TimeToLiveHandler();
-		SensorTable_SubscriptionHandler(); /* sensor shadow  delta */
-		SensorTable_ConfigRequestHandler();
-		SensorTable_GetAcceptedSubscriptionHandler();
-		SensorTable_InitShadowHandler();
-		StartSensorTick(pObj);
+		SensorTable_ScheduledHandler();
+		SensorTable_GatewayShadowHandler();
+		SensorTable_SnapshotHandler();
 	}
 	return DISPATCH_OK;
 }
@@ -429,7 +512,6 @@ static DispatchResult_t AwsConnectionMsgHandler(FwkMsgReceiver_t *pMsgRxer,
 	if (pMsg->header.msgCode == FMC_BLUEGRASS_READY) {
 		pObj->bluegrassReady = true;
 		SensorTable_EnableGatewayShadowGeneration();
-		StartSensorTick(pObj);
 	} else {
 		pObj->bluegrassReady = false;
 		SensorTable_DisableGatewayShadowGeneration();
@@ -447,9 +529,30 @@ static DispatchResult_t AwsDecommissionMsgHandler(FwkMsgReceiver_t *pMsgRxer,
 	return DISPATCH_OK;
 }
 
-static void StartSensorTick(SensorTaskObj_t *pObj)
+/* Called after every message because any message may change the next
+ * sensor table deadline.  The timer is only restarted when the deadline
+ * moves earlier.
+ */
+static void UpdateSensorTick(SensorTaskObj_t *pObj)
 {
-	k_timer_start(&pObj->sensorTick, K_SECONDS(SENSOR_TICK_RATE_SECONDS),
+	if (!pObj->bluegrassReady) {
+		return;
+	}
+
+	int64_t now = k_uptime_get();
+	int64_t deadline = now + SENSOR_TICK_MAX_IDLE_MS;
+	int64_t next;
+	if (SensorTable_GetNextDeadline(&next)) {
+		deadline = MIN(deadline, next);
+	}
+
+	if (pObj->tickArmed && pObj->tickDeadline <= deadline) {
+		return;
+	}
+
+	pObj->tickArmed = true;
+	pObj->tickDeadline = deadline;
+	k_timer_start(&pObj->sensorTick, K_MSEC(MAX(deadline - now, 0)),
 		      K_NO_WAIT);
 }
 
@@ -557,6 +660,14 @@ static DispatchResult_t SensorShadowInitMsgHandler(FwkMsgReceiver_t *pMsgRxer,
 	return DISPATCH_OK;
 }
 
+static DispatchResult_t SensorPublishAckMsgHandler(FwkMsgReceiver_t *pMsgRxer,
+						   FwkMsg_t *pMsg)
+{
+	UNUSED_PARAMETER(pMsgRxer);
+	SensorTable_ShadowAckHandler((SensorPublishAckMsg_t *)pMsg);
+	return DISPATCH_OK;
+}
+
 static void RegisterConnectionCallbacks(void)
 {
 	static struct bt_conn_cb connectionCallbacks = {
@@ -904,33 +1015,69 @@ static void SensorTickCallbackIsr(struct k_timer *timer_id)
 static void SensorTaskAdvHandler(const bt_addr_le_t *addr, int8_t rssi,
 				 uint8_t type, struct net_buf_simple *ad)
 {
-	/* After filtering for BT510 sensors, send a message so we can
+	/* After filtering for BT510 sensors, put the ad into the ring so we can
 	 * process ads in Sensor Task context.
 	 * This prevents the BLE RX task from being blocked.
 	 */
-	if (lcz_sensor_adv_match(ad, true, true) != RESERVED_AD_PROTOCOL_ID) {
-		if (atomic_get(&st.adsOutstanding) >
-		    SENSOR_TASK_MAX_OUTSTANDING_ADS) {
-			atomic_inc(&st.adsDropped);
-			return;
-		}
+	if (lcz_sensor_adv_match(ad, true, true) == RESERVED_AD_PROTOCOL_ID) {
+		return;
+	}
 
-		AdvMsg_t *pMsg = BP_TRY_TO_TAKE(sizeof(AdvMsg_t));
-		if (pMsg == NULL) {
-			return;
-		}
+#ifdef CONFIG_SENSOR_ADV_FILTER
+	if (!SensorAdvFilter_Forward(addr, ad->data, ad->len)) {
+		return;
+	}
+#endif
+
+	atomic_val_t head = atomic_get(&st.adHead);
+	if ((atomic_val_t)(head - atomic_get(&st.adTail)) >=
+	    CONFIG_SENSOR_AD_RING_SIZE) {
+		AdDropped(addr);
+		return;
+	}
+
+	AdRecord_t *p = &adRing[head & AD_RING_MASK];
+	bt_addr_le_copy(&p->addr, addr);
+	p->rssi = rssi;
+	p->type = type;
+	p->len = MIN(CONFIG_SENSOR_MAX_AD_SIZE, ad->len);
+	memcpy(p->data, ad->data, p->len);
+	atomic_set(&st.adHead, head + 1);
+
+	WakeForAds(&st);
+}
 
+static void AdDropped(const bt_addr_le_t *addr)
+{
+	atomic_inc(&st.adsDropped);
+	atomic_val_t head = atomic_get(&st.dropHead);
+	if ((atomic_val_t)(head - atomic_get(&st.dropTail)) < DROP_RING_SIZE) {
+		bt_addr_copy(&dropRing[head & DROP_RING_MASK], &addr->a);
+		atomic_set(&st.dropHead, head + 1);
+	}
+}
+
+/* Only one wake-up message is outstanding at a time.  If it can't be sent,
+ * the next advertisement tries again.
+ */
+static void WakeForAds(SensorTaskObj_t *pObj)
+{
+	FwkMsg_t *pMsg;
+
+	if (!atomic_cas(&pObj->adWakePending, 0, 1)) {
+		return;
+	}
+
+	pMsg = BP_TRY_TO_TAKE(sizeof(FwkMsg_t));
+	if (pMsg != NULL) {
 		pMsg->header.msgCode = FMC_ADV;
+		pMsg->header.txId = FWK_ID_SENSOR_TASK;
 		pMsg->header.rxId = FWK_ID_SENSOR_TASK;
-
-		pMsg->rssi = rssi;
-		pMsg->type = type;
-		pMsg->ad.len = ad->len;
-		memcpy(&pMsg->addr, addr, sizeof(bt_addr_le_t));
-		memcpy(pMsg->ad.data, ad->data,
-		       MIN(CONFIG_SENSOR_MAX_AD_SIZE, ad->len));
-		FRAMEWORK_MSG_SEND(pMsg);
-		atomic_inc(&st.adsOutstanding);
+		if (FRAMEWORK_MSG_SEND(pMsg) == FWK_SUCCESS) {
+			return;
+		}
 	}
+
+	atomic_clear(&pObj->adWakePending);
 }
 #endif
\ No newline at end of file
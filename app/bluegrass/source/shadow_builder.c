@@ -23,9 +23,15 @@ LOG_MODULE_REGISTER(shadow_builder);
 /******************************************************************************/
 /* Local Constant, Macro and Type Definitions                                 */
 /******************************************************************************/
+/* The encoding is validated when the message is started. */
+#define ENCODER(p) (ENCODERS[(p)->encoding])
+
 #define JSON_APPEND_CHAR(c) JsonAppendChar(pJsonMsg, (uint8_t)(c))
 #define JSON_APPEND_STRING(s) JsonAppendString(pJsonMsg, (s), true)
 
+/* Text that doesn't require escaping is copied as a block. */
+#define JSON_APPEND_LITERAL(s) JsonAppend(pJsonMsg, (s), sizeof(s) - 1)
+
 #define JSON_APPEND_VALUE_STRING(s)                                            \
 	do {                                                                   \
 		JSON_APPEND_CHAR('"');                                         \
@@ -35,47 +41,262 @@ LOG_MODULE_REGISTER(shadow_builder);
 
 #define JSON_APPEND_KEY(s)                                                     \
 	do {                                                                   \
-		JSON_APPEND_VALUE_STRING(s);                                   \
-		JSON_APPEND_CHAR(':');                                         \
+		JSON_APPEND_CHAR('"');                                         \
+		JSON_APPEND_STRING(s);                                         \
+		JSON_APPEND_LITERAL("\":");                                    \
 	} while (0)
 
-#define JSON_APPEND_U32(c)                                                     \
-	do {                                                                   \
-		memset(str, 0, MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT);            \
-		ToString_Dec(str, (c));                                        \
-		JSON_APPEND_STRING(str);                                       \
-	} while (0)
+#define ESCAPE_END 1
+#define JSON_APPEND_MEMCPY_THRESHOLD 16
 
-#define JSON_APPEND_HEX8(c)                                                    \
-	do {                                                                   \
-		memset(str, 0, MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT);            \
-		ToString_Hex8(str, (c));                                       \
-		JSON_APPEND_VALUE_STRING(str);                                 \
-	} while (0)
-
-#define JSON_APPEND_HEX16(c)                                                   \
-	do {                                                                   \
-		memset(str, 0, MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT);            \
-		ToString_Hex16(str, (c));                                      \
-		JSON_APPEND_VALUE_STRING(str);                                 \
-	} while (0)
+#define JSON_APPEND_U32(c) JsonAppendU32(pJsonMsg, (c))
+#define JSON_APPEND_S32(c) JsonAppendS32(pJsonMsg, (c))
 
 /******************************************************************************/
 /* Local Data Definitions                                                     */
 /******************************************************************************/
-static char str[MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT];
+/* Character that follows the '\\' when escaping is required.  The end of
+ * the string is marked so that a run can be found with one lookup per
+ * character.
+ */
+static const char ESCAPE[UINT8_MAX + 1] = {
+	['\0'] = ESCAPE_END, ['"'] = '"', ['\\'] = '\\', ['\b'] = 'b',
+	['\f'] = 'f',	     ['\n'] = 'n', ['\r'] = 'r',   ['\t'] = 't',
+};
 
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
+static bool EncodingSupported(uint8_t Encoding);
+static void JsonStart(JsonMsg_t *pJsonMsg, bool ClearBuffer);
+static void JsonFinalize(JsonMsg_t *pJsonMsg);
+static void JsonAddUint32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			  uint32_t Value);
+static void JsonAddSigned32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			    int32_t Value);
+static void JsonAddPair(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			const char *restrict pValue, bool IsNotString);
+static void JsonAddVersion(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			   uint8_t Major, uint8_t Minor, uint8_t Build);
+static void JsonAddNull(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+static void JsonAddTrue(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+static void JsonAddFalse(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+static void JsonStartGroup(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+static void JsonEndGroup(JsonMsg_t *pJsonMsg);
+static void JsonStartArray(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+static void JsonEndArray(JsonMsg_t *pJsonMsg);
+static void JsonAddSensorTableArrayEntry(JsonMsg_t *pJsonMsg,
+					 const char *restrict pAddrStr,
+					 uint32_t Epoch, bool Greenlisted);
+static void JsonAddEventLogEntry(JsonMsg_t *pJsonMsg, SensorLogEvent_t *p);
+static void JsonAddString(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			  const char *restrict pStr);
 static void JsonAppendString(JsonMsg_t *pJsonMsg, const char *restrict pString,
 			     bool EscapeQuoteChar);
 static void JsonAppendChar(JsonMsg_t *pJsonMsg, char Character);
+static size_t JsonFit(JsonMsg_t *pJsonMsg, size_t Length);
+static void JsonAppendShort(JsonMsg_t *pJsonMsg, const char *restrict pData,
+			    size_t Length);
+static void JsonAppend(JsonMsg_t *pJsonMsg, const char *restrict pData,
+		       size_t Length);
+static void JsonAppendU32(JsonMsg_t *pJsonMsg, uint32_t Value);
+static void JsonAppendS32(JsonMsg_t *pJsonMsg, int32_t Value);
+
+/******************************************************************************/
+/* Global Data Definitions                                                    */
+/******************************************************************************/
+const ShadowEncoder_t SHADOW_ENCODER_JSON = {
+	.start = JsonStart,
+	.finalize = JsonFinalize,
+	.addUint32 = JsonAddUint32,
+	.addSigned32 = JsonAddSigned32,
+	.addPair = JsonAddPair,
+	.addVersion = JsonAddVersion,
+	.addNull = JsonAddNull,
+	.addTrue = JsonAddTrue,
+	.addFalse = JsonAddFalse,
+	.startGroup = JsonStartGroup,
+	.endGroup = JsonEndGroup,
+	.startArray = JsonStartArray,
+	.endArray = JsonEndArray,
+	.addSensorTableArrayEntry = JsonAddSensorTableArrayEntry,
+	.addEventLogEntry = JsonAddEventLogEntry,
+	.addString = JsonAddString,
+};
+
+static const ShadowEncoder_t *const ENCODERS[SHADOW_ENCODING_COUNT] = {
+	[SHADOW_ENCODING_JSON] = &SHADOW_ENCODER_JSON,
+#ifdef CONFIG_SHADOW_BUILDER_CBOR
+	[SHADOW_ENCODING_CBOR] = &SHADOW_ENCODER_CBOR,
+#endif
+};
 
 /******************************************************************************/
 /* Global Function Definitions                                                */
 /******************************************************************************/
+void ShadowBuilder_SetEncoding(JsonMsg_t *pJsonMsg, ShadowEncoding_t Encoding)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	if (EncodingSupported(Encoding)) {
+		pJsonMsg->encoding = Encoding;
+	} else {
+		LOG_ERR("Encoding %u not supported", Encoding);
+		pJsonMsg->encoding = SHADOW_ENCODING_JSON;
+	}
+}
+
 void ShadowBuilder_Start(JsonMsg_t *pJsonMsg, bool ClearBuffer)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	if (!EncodingSupported(pJsonMsg->encoding)) {
+		LOG_ERR("Encoding %u not supported", pJsonMsg->encoding);
+		pJsonMsg->encoding = SHADOW_ENCODING_JSON;
+	}
+	ENCODER(pJsonMsg)->start(pJsonMsg, ClearBuffer);
+}
+
+void ShadowBuilder_Finalize(JsonMsg_t *pJsonMsg)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	ENCODER(pJsonMsg)->finalize(pJsonMsg);
+}
+
+void ShadowBuilder_AddUint32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			     uint32_t Value)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	ENCODER(pJsonMsg)->addUint32(pJsonMsg, pKey, Value);
+}
+
+void ShadowBuilder_AddSigned32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			       int32_t Value)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	ENCODER(pJsonMsg)->addSigned32(pJsonMsg, pKey, Value);
+}
+
+void ShadowBuilder_AddPair(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			   const char *restrict pValue, bool IsNotString)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	ENCODER(pJsonMsg)->addPair(pJsonMsg, pKey, pValue, IsNotString);
+}
+
+void ShadowBuilder_AddVersion(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			      uint8_t Major, uint8_t Minor, uint8_t Build)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	ENCODER(pJsonMsg)->addVersion(pJsonMsg, pKey, Major, Minor, Build);
+}
+
+void ShadowBuilder_AddNull(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	ENCODER(pJsonMsg)->addNull(pJsonMsg, pKey);
+}
+
+void ShadowBuilder_AddTrue(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	ENCODER(pJsonMsg)->addTrue(pJsonMsg, pKey);
+}
+
+void ShadowBuilder_AddFalse(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	ENCODER(pJsonMsg)->addFalse(pJsonMsg, pKey);
+}
+
+void ShadowBuilder_StartGroup(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	ENCODER(pJsonMsg)->startGroup(pJsonMsg, pKey);
+}
+
+void ShadowBuilder_EndGroup(JsonMsg_t *pJsonMsg)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	ENCODER(pJsonMsg)->endGroup(pJsonMsg);
+}
+
+void ShadowBuilder_StartArray(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	ENCODER(pJsonMsg)->startArray(pJsonMsg, pKey);
+}
+
+void ShadowBuilder_EndArray(JsonMsg_t *pJsonMsg)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	ENCODER(pJsonMsg)->endArray(pJsonMsg);
+}
+
+void ShadowBuilder_AddSensorTableArrayEntry(JsonMsg_t *pJsonMsg,
+					    const char *restrict pAddrStr,
+					    uint32_t Epoch, bool Greenlisted)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	ENCODER(pJsonMsg)->addSensorTableArrayEntry(pJsonMsg, pAddrStr, Epoch,
+						    Greenlisted);
+}
+
+void ShadowBuilder_AddEventLogEntry(JsonMsg_t *pJsonMsg, SensorLogEvent_t *p)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	ENCODER(pJsonMsg)->addEventLogEntry(pJsonMsg, p);
+}
+
+void ShadowBuilder_AddString(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			     const char *restrict pStr)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	ENCODER(pJsonMsg)->addString(pJsonMsg, pKey, pStr);
+}
+
+size_t ShadowBuilder_FormatEventLogEntry(char *pStr, const SensorLogEvent_t *p)
+{
+	FRAMEWORK_ASSERT(pStr != NULL);
+	FRAMEWORK_ASSERT(p != NULL);
+
+	size_t n = 0;
+	pStr[n++] = '[';
+	pStr[n++] = '"';
+	ToString_Hex8(&pStr[n], p->recordType);
+	n += 2;
+	pStr[n++] = '"';
+	pStr[n++] = ',';
+	n += ToString_Dec(&pStr[n], p->epoch);
+	pStr[n++] = ',';
+	pStr[n++] = '"';
+	ToString_Hex16(&pStr[n], p->data);
+	n += 4;
+	pStr[n++] = '"';
+	pStr[n++] = ']';
+	pStr[n++] = ',';
+	return n;
+}
+
+void ShadowBuilder_AddEventLogEntries(JsonMsg_t *pJsonMsg,
+				      const char *restrict pEntries,
+				      size_t Length)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	FRAMEWORK_ASSERT(pJsonMsg->encoding == SHADOW_ENCODING_JSON);
+	FRAMEWORK_ASSERT(pEntries != NULL);
+
+	JsonAppend(pJsonMsg, pEntries, Length);
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static bool EncodingSupported(uint8_t Encoding)
+{
+	return (Encoding < SHADOW_ENCODING_COUNT) &&
+	       (ENCODERS[Encoding] != NULL);
+}
+
+static void JsonStart(JsonMsg_t *pJsonMsg, bool ClearBuffer)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	FRAMEWORK_ASSERT(pJsonMsg->size != 0);
@@ -86,53 +307,44 @@ void ShadowBuilder_Start(JsonMsg_t *pJsonMsg, bool ClearBuffer)
 	JSON_APPEND_CHAR('{');
 }
 
-void ShadowBuilder_Finalize(JsonMsg_t *pJsonMsg)
+static void JsonFinalize(JsonMsg_t *pJsonMsg)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	FRAMEWORK_ASSERT(pJsonMsg->buffer[pJsonMsg->length - 1] == ',');
 	pJsonMsg->buffer[pJsonMsg->length - 1] = '}';
 }
 
-void ShadowBuilder_AddUint32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
-			     uint32_t Value)
+static void JsonAddUint32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			  uint32_t Value)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	FRAMEWORK_ASSERT(pKey != NULL);
-	FRAMEWORK_ASSERT(strlen(pKey) > 0);
+	FRAMEWORK_ASSERT(pKey[0] != '\0');
 
 	JSON_APPEND_KEY(pKey);
-	memset(str, 0, MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT);
-	ToString_Dec(str, Value);
-	JSON_APPEND_STRING(str);
+	JSON_APPEND_U32(Value);
 	JSON_APPEND_CHAR(',');
 }
 
-void ShadowBuilder_AddSigned32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
-			       int32_t Value)
+static void JsonAddSigned32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			    int32_t Value)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	FRAMEWORK_ASSERT(pKey != NULL);
-	FRAMEWORK_ASSERT(strlen(pKey) > 0);
+	FRAMEWORK_ASSERT(pKey[0] != '\0');
 
 	JSON_APPEND_KEY(pKey);
-	memset(str, 0, MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT);
-	int32_t v = Value;
-	if (Value < 0) {
-		JSON_APPEND_CHAR('-');
-		v *= -1;
-	}
-	ToString_Dec(str, (uint32_t)v);
-	JSON_APPEND_STRING(str);
+	JSON_APPEND_S32(Value);
 	JSON_APPEND_CHAR(',');
 }
 
-void ShadowBuilder_AddPair(JsonMsg_t *pJsonMsg, const char *restrict pKey,
-			   const char *restrict pValue, bool IsNotString)
+static void JsonAddPair(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			const char *restrict pValue, bool IsNotString)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	FRAMEWORK_ASSERT(pKey != NULL);
 	FRAMEWORK_ASSERT(pValue != NULL);
-	FRAMEWORK_ASSERT(strlen(pKey) > 0);
+	FRAMEWORK_ASSERT(pKey[0] != '\0');
 	/* strings are allowed to be empty, but numbers aren't */
 	if (IsNotString) {
 		FRAMEWORK_ASSERT(strlen(pValue) > 0);
@@ -147,68 +359,68 @@ void ShadowBuilder_AddPair(JsonMsg_t *pJsonMsg, const char *restrict pKey,
 	JSON_APPEND_CHAR(',');
 }
 
-void ShadowBuilder_AddVersion(JsonMsg_t *pJsonMsg, const char *restrict pKey,
-			      uint8_t Major, uint8_t Minor, uint8_t Build)
+static void JsonAddVersion(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			   uint8_t Major, uint8_t Minor, uint8_t Build)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	FRAMEWORK_ASSERT(pKey != NULL);
-	FRAMEWORK_ASSERT(strlen(pKey) > 0);
+	FRAMEWORK_ASSERT(pKey[0] != '\0');
 
 	JSON_APPEND_KEY(pKey);
-	JSON_APPEND_CHAR('"');
-	JSON_APPEND_U32(Major);
-	JSON_APPEND_CHAR('.');
-	JSON_APPEND_U32(Minor);
-	JSON_APPEND_CHAR('.');
-	JSON_APPEND_U32(Build);
-	JSON_APPEND_CHAR('"');
-	JSON_APPEND_CHAR(',');
+	char str[sizeof("\"255.255.255\",")];
+	size_t n = 0;
+	str[n++] = '"';
+	n += ToString_Dec(&str[n], Major);
+	str[n++] = '.';
+	n += ToString_Dec(&str[n], Minor);
+	str[n++] = '.';
+	n += ToString_Dec(&str[n], Build);
+	str[n++] = '"';
+	str[n++] = ',';
+	JsonAppendShort(pJsonMsg, str, n);
 }
 
-void ShadowBuilder_AddNull(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+static void JsonAddNull(JsonMsg_t *pJsonMsg, const char *restrict pKey)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	FRAMEWORK_ASSERT(pKey != NULL);
-	FRAMEWORK_ASSERT(strlen(pKey) > 0);
+	FRAMEWORK_ASSERT(pKey[0] != '\0');
 
 	JSON_APPEND_KEY(pKey);
-	JSON_APPEND_STRING("null");
-	JSON_APPEND_CHAR(',');
+	JSON_APPEND_LITERAL("null,");
 }
 
-void ShadowBuilder_AddTrue(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+static void JsonAddTrue(JsonMsg_t *pJsonMsg, const char *restrict pKey)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	FRAMEWORK_ASSERT(pKey != NULL);
-	FRAMEWORK_ASSERT(strlen(pKey) > 0);
+	FRAMEWORK_ASSERT(pKey[0] != '\0');
 
 	JSON_APPEND_KEY(pKey);
-	JSON_APPEND_STRING("true");
-	JSON_APPEND_CHAR(',');
+	JSON_APPEND_LITERAL("true,");
 }
 
-void ShadowBuilder_AddFalse(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+static void JsonAddFalse(JsonMsg_t *pJsonMsg, const char *restrict pKey)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	FRAMEWORK_ASSERT(pKey != NULL);
-	FRAMEWORK_ASSERT(strlen(pKey) > 0);
+	FRAMEWORK_ASSERT(pKey[0] != '\0');
 
 	JSON_APPEND_KEY(pKey);
-	JSON_APPEND_STRING("false");
-	JSON_APPEND_CHAR(',');
+	JSON_APPEND_LITERAL("false,");
 }
 
-void ShadowBuilder_StartGroup(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+static void JsonStartGroup(JsonMsg_t *pJsonMsg, const char *restrict pKey)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	FRAMEWORK_ASSERT(pKey != NULL);
-	FRAMEWORK_ASSERT(strlen(pKey) > 0);
+	FRAMEWORK_ASSERT(pKey[0] != '\0');
 
 	JSON_APPEND_KEY(pKey);
 	JSON_APPEND_CHAR('{');
 }
 
-void ShadowBuilder_EndGroup(JsonMsg_t *pJsonMsg)
+static void JsonEndGroup(JsonMsg_t *pJsonMsg)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	FRAMEWORK_ASSERT(pJsonMsg->buffer[pJsonMsg->length - 1] == ',');
@@ -217,17 +429,17 @@ void ShadowBuilder_EndGroup(JsonMsg_t *pJsonMsg)
 	JSON_APPEND_CHAR(',');
 }
 
-void ShadowBuilder_StartArray(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+static void JsonStartArray(JsonMsg_t *pJsonMsg, const char *restrict pKey)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	FRAMEWORK_ASSERT(pKey != NULL);
-	FRAMEWORK_ASSERT(strlen(pKey) > 0);
+	FRAMEWORK_ASSERT(pKey[0] != '\0');
 
 	JSON_APPEND_KEY(pKey);
 	JSON_APPEND_CHAR('[');
 }
 
-void ShadowBuilder_EndArray(JsonMsg_t *pJsonMsg)
+static void JsonEndArray(JsonMsg_t *pJsonMsg)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	FRAMEWORK_ASSERT(pJsonMsg->buffer[pJsonMsg->length - 1] == ',');
@@ -236,44 +448,41 @@ void ShadowBuilder_EndArray(JsonMsg_t *pJsonMsg)
 	JSON_APPEND_CHAR(',');
 }
 
-void ShadowBuilder_AddSensorTableArrayEntry(JsonMsg_t *pJsonMsg,
-					    const char *restrict pAddrStr,
-					    uint32_t Epoch, bool Greenlisted)
+static void JsonAddSensorTableArrayEntry(JsonMsg_t *pJsonMsg,
+					 const char *restrict pAddrStr,
+					 uint32_t Epoch, bool Greenlisted)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	FRAMEWORK_ASSERT(pAddrStr != NULL);
-	FRAMEWORK_ASSERT(strlen(pAddrStr) > 0);
+	FRAMEWORK_ASSERT(pAddrStr[0] != '\0');
 
-	JSON_APPEND_CHAR('[');
-	JSON_APPEND_VALUE_STRING(pAddrStr);
-	JSON_APPEND_CHAR(',');
+	JSON_APPEND_LITERAL("[\"");
+	JSON_APPEND_STRING(pAddrStr);
+	JSON_APPEND_LITERAL("\",");
 	JSON_APPEND_U32(Epoch);
-	JSON_APPEND_CHAR(',');
-	JSON_APPEND_STRING(Greenlisted ? "true" : "false");
-	JSON_APPEND_CHAR(']');
-	JSON_APPEND_CHAR(',');
+	if (Greenlisted) {
+		JSON_APPEND_LITERAL(",true],");
+	} else {
+		JSON_APPEND_LITERAL(",false],");
+	}
 }
 
-void ShadowBuilder_AddEventLogEntry(JsonMsg_t *pJsonMsg, SensorLogEvent_t *p)
+static void JsonAddEventLogEntry(JsonMsg_t *pJsonMsg, SensorLogEvent_t *p)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 
-	JSON_APPEND_CHAR('[');
-	JSON_APPEND_HEX8(p->recordType);
-	JSON_APPEND_CHAR(',');
-	JSON_APPEND_U32(p->epoch);
-	JSON_APPEND_CHAR(',');
-	JSON_APPEND_HEX16(p->data);
-	JSON_APPEND_CHAR(']');
-	JSON_APPEND_CHAR(',');
+	/* The entry is formatted on the stack and copied as a block. */
+	char str[SENSOR_LOG_ENTRY_JSON_STR_SIZE];
+	size_t n = ShadowBuilder_FormatEventLogEntry(str, p);
+	JsonAppend(pJsonMsg, str, n);
 }
 
-void ShadowBuilder_AddString(JsonMsg_t *pJsonMsg, const char *restrict pKey,
-			     const char *restrict pStr)
+static void JsonAddString(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			  const char *restrict pStr)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
 	FRAMEWORK_ASSERT(pKey != NULL);
-	FRAMEWORK_ASSERT(strlen(pKey) > 0);
+	FRAMEWORK_ASSERT(pKey[0] != '\0');
 	FRAMEWORK_ASSERT(pStr != NULL);
 
 	JSON_APPEND_KEY(pKey);
@@ -281,9 +490,6 @@ void ShadowBuilder_AddString(JsonMsg_t *pJsonMsg, const char *restrict pKey,
 	JSON_APPEND_CHAR(',');
 }
 
-/******************************************************************************/
-/* Local Function Definitions                                                 */
-/******************************************************************************/
 static void JsonAppendChar(JsonMsg_t *pJsonMsg, char Character)
 {
 	FRAMEWORK_ASSERT(pJsonMsg != NULL);
@@ -295,65 +501,106 @@ static void JsonAppendChar(JsonMsg_t *pJsonMsg, char Character)
 	}
 }
 
-static void JsonAppendString(JsonMsg_t *pJsonMsg, const char *restrict pString,
-			     bool EscapeQuoteChar)
+/* Returns how much of Length fits in the message (leaving room for NULL
+ * terminator).
+ */
+static size_t JsonFit(JsonMsg_t *pJsonMsg, size_t Length)
 {
-	FRAMEWORK_ASSERT(pJsonMsg != NULL);
-	if (pJsonMsg == NULL) {
-		return;
+	size_t room = pJsonMsg->size - 1 - pJsonMsg->length;
+	if (Length > room) { /* buffer too small */
+		FRAMEWORK_ASSERT(false);
+		return room;
 	}
+	return Length;
+}
 
-	size_t length = strlen(pString);
-	size_t i = 0;
-	/* Leave room for NULL terminator and an escaped char. */
-	while (i < length && (pJsonMsg->length < (pJsonMsg->size - 2))) {
-		/* Escape character handling */
-		switch (pString[i]) {
-		case '"':
-			if (EscapeQuoteChar) {
-				pJsonMsg->buffer[pJsonMsg->length++] = '\\';
-			}
-			pJsonMsg->buffer[pJsonMsg->length++] = pString[i++];
-			break;
-
-		case '\\':
-			pJsonMsg->buffer[pJsonMsg->length++] = '\\';
-			pJsonMsg->buffer[pJsonMsg->length++] = pString[i++];
-			break;
-
-		case '\b':
-			pJsonMsg->buffer[pJsonMsg->length++] = '\\';
-			pJsonMsg->buffer[pJsonMsg->length++] = 'b';
-			i += 1;
-			break;
+/* Most runs are short (keys and numbers) and a call to memcpy costs more than
+ * the copy.  Data that doesn't fit is truncated.
+ */
+static void JsonAppendShort(JsonMsg_t *pJsonMsg, const char *restrict pData,
+			    size_t Length)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	size_t n = JsonFit(pJsonMsg, Length);
+	char *pDest = &pJsonMsg->buffer[pJsonMsg->length];
+	pJsonMsg->length += n;
+	while (n-- > 0) {
+		*pDest++ = *pData++;
+	}
+}
 
-		case '\f':
-			pJsonMsg->buffer[pJsonMsg->length++] = '\\';
-			pJsonMsg->buffer[pJsonMsg->length++] = 'f';
-			i += 1;
-			break;
+static void JsonAppend(JsonMsg_t *pJsonMsg, const char *restrict pData,
+		       size_t Length)
+{
+	if (Length <= JSON_APPEND_MEMCPY_THRESHOLD) {
+		JsonAppendShort(pJsonMsg, pData, Length);
+	} else {
+		FRAMEWORK_ASSERT(pJsonMsg != NULL);
+		size_t n = JsonFit(pJsonMsg, Length);
+		memcpy(&pJsonMsg->buffer[pJsonMsg->length], pData, n);
+		pJsonMsg->length += n;
+	}
+}
 
-		case '\n':
-			pJsonMsg->buffer[pJsonMsg->length++] = '\\';
-			pJsonMsg->buffer[pJsonMsg->length++] = 'n';
-			i += 1;
-			break;
+/* Numbers are written directly into the message when there is room for the
+ * longest value (and the NUL written by the conversion).
+ */
+static void JsonAppendU32(JsonMsg_t *pJsonMsg, uint32_t Value)
+{
+	if ((pJsonMsg->size - pJsonMsg->length) >=
+	    MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT) {
+		pJsonMsg->length += ToString_Dec(
+			&pJsonMsg->buffer[pJsonMsg->length], Value);
+	} else {
+		char str[MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT];
+		JsonAppendShort(pJsonMsg, str, ToString_Dec(str, Value));
+	}
+}
 
-		case '\r':
-			pJsonMsg->buffer[pJsonMsg->length++] = '\\';
-			pJsonMsg->buffer[pJsonMsg->length++] = 'r';
-			i += 1;
-			break;
+static void JsonAppendS32(JsonMsg_t *pJsonMsg, int32_t Value)
+{
+	if ((pJsonMsg->size - pJsonMsg->length) >=
+	    MAXIMUM_LENGTH_OF_TO_STRING_SIGNED_OUTPUT) {
+		pJsonMsg->length += ToString_Signed(
+			&pJsonMsg->buffer[pJsonMsg->length], Value);
+	} else {
+		char str[MAXIMUM_LENGTH_OF_TO_STRING_SIGNED_OUTPUT];
+		JsonAppendShort(pJsonMsg, str, ToString_Signed(str, Value));
+	}
+}
 
-		case '\t':
-			pJsonMsg->buffer[pJsonMsg->length++] = '\\';
-			pJsonMsg->buffer[pJsonMsg->length++] = 't';
-			i += 1;
-			break;
+static void JsonAppendString(JsonMsg_t *pJsonMsg, const char *restrict pString,
+			     bool EscapeQuoteChar)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	if (pJsonMsg == NULL) {
+		return;
+	}
 
-		default:
-			pJsonMsg->buffer[pJsonMsg->length++] = pString[i++];
+	const char *p = pString;
+	const char *pRun = p;
+	for (;;) {
+		/* Find the end of the run of characters that can be copied. */
+		while (ESCAPE[(uint8_t)*p] == 0) {
+			p += 1;
+		}
+		char escape = ESCAPE[(uint8_t)*p];
+		if (escape == ESCAPE_END) {
 			break;
 		}
+		if ((escape == '"') && !EscapeQuoteChar) {
+			p += 1;
+			continue;
+		}
+		JsonAppend(pJsonMsg, pRun, p - pRun);
+		/* Leave room for NULL terminator and an escaped char. */
+		if (pJsonMsg->length >= (pJsonMsg->size - 2)) {
+			return;
+		}
+		pJsonMsg->buffer[pJsonMsg->length++] = '\\';
+		pJsonMsg->buffer[pJsonMsg->length++] = escape;
+		p += 1;
+		pRun = p;
 	}
+	JsonAppend(pJsonMsg, pRun, p - pRun);
 }
@@ -0,0 +1,288 @@
+/**
+ * @file shadow_builder_cbor.c
+ * @brief CBOR (RFC 7049) encoding for the shadow builder.
+ *
+ * Groups and arrays are encoded as indefinite-length maps and arrays so
+ * that the builder can stream into the buffer without knowing the number
+ * of items in advance (and without a stack of nested encoders).
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+#include <logging/log.h>
+#define LOG_LEVEL LOG_LEVEL_INF
+LOG_MODULE_REGISTER(shadow_builder_cbor);
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <string.h>
+#include <sys/byteorder.h>
+
+#include "FrameworkIncludes.h"
+#include "to_string.h"
+#include "shadow_builder.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define CBOR_MAJOR_UINT 0
+#define CBOR_MAJOR_NEGATIVE 1
+#define CBOR_MAJOR_TEXT 3
+#define CBOR_MAJOR_ARRAY 4
+
+#define CBOR_FALSE 0xF4
+#define CBOR_TRUE 0xF5
+#define CBOR_NULL 0xF6
+#define CBOR_INDEFINITE_ARRAY 0x9F
+#define CBOR_INDEFINITE_MAP 0xBF
+#define CBOR_BREAK 0xFF
+
+#define CBOR_ADDITIONAL_1_BYTE 24
+#define CBOR_ADDITIONAL_2_BYTES 25
+#define CBOR_ADDITIONAL_4_BYTES 26
+
+/* Major type and length/value of the largest head */
+#define CBOR_HEAD_MAX_SIZE 5
+
+/* The log entry and sensor table entry are fixed size arrays */
+#define CBOR_ENTRY_ITEMS 3
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void CborStart(JsonMsg_t *pJsonMsg, bool ClearBuffer);
+static void CborFinalize(JsonMsg_t *pJsonMsg);
+static void CborAddUint32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			  uint32_t Value);
+static void CborAddSigned32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			    int32_t Value);
+static void CborAddPair(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			const char *restrict pValue, bool IsNotString);
+static void CborAddVersion(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			   uint8_t Major, uint8_t Minor, uint8_t Build);
+static void CborAddNull(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+static void CborAddTrue(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+static void CborAddFalse(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+static void CborStartGroup(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+static void CborEndGroup(JsonMsg_t *pJsonMsg);
+static void CborStartArray(JsonMsg_t *pJsonMsg, const char *restrict pKey);
+static void CborEndArray(JsonMsg_t *pJsonMsg);
+static void CborAddSensorTableArrayEntry(JsonMsg_t *pJsonMsg,
+					 const char *restrict pAddrStr,
+					 uint32_t Epoch, bool Greenlisted);
+static void CborAddEventLogEntry(JsonMsg_t *pJsonMsg, SensorLogEvent_t *p);
+static void CborAddString(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			  const char *restrict pStr);
+
+static void CborAppend(JsonMsg_t *pJsonMsg, const void *pData, size_t Length);
+static void CborAppendByte(JsonMsg_t *pJsonMsg, uint8_t Value);
+static void CborAppendHead(JsonMsg_t *pJsonMsg, uint8_t Major, uint32_t Value);
+static void CborAppendText(JsonMsg_t *pJsonMsg, const char *restrict pStr);
+
+/******************************************************************************/
+/* Global Data Definitions                                                    */
+/******************************************************************************/
+const ShadowEncoder_t SHADOW_ENCODER_CBOR = {
+	.start = CborStart,
+	.finalize = CborFinalize,
+	.addUint32 = CborAddUint32,
+	.addSigned32 = CborAddSigned32,
+	.addPair = CborAddPair,
+	.addVersion = CborAddVersion,
+	.addNull = CborAddNull,
+	.addTrue = CborAddTrue,
+	.addFalse = CborAddFalse,
+	.startGroup = CborStartGroup,
+	.endGroup = CborEndGroup,
+	.startArray = CborStartArray,
+	.endArray = CborEndArray,
+	.addSensorTableArrayEntry = CborAddSensorTableArrayEntry,
+	.addEventLogEntry = CborAddEventLogEntry,
+	.addString = CborAddString,
+};
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void CborStart(JsonMsg_t *pJsonMsg, bool ClearBuffer)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	FRAMEWORK_ASSERT(pJsonMsg->size != 0);
+	if (ClearBuffer) {
+		memset(pJsonMsg->buffer, 0, pJsonMsg->size);
+	}
+	pJsonMsg->length = 0;
+	CborAppendByte(pJsonMsg, CBOR_INDEFINITE_MAP);
+}
+
+static void CborFinalize(JsonMsg_t *pJsonMsg)
+{
+	CborAppendByte(pJsonMsg, CBOR_BREAK);
+}
+
+static void CborAddUint32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			  uint32_t Value)
+{
+	CborAppendText(pJsonMsg, pKey);
+	CborAppendHead(pJsonMsg, CBOR_MAJOR_UINT, Value);
+}
+
+static void CborAddSigned32(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			    int32_t Value)
+{
+	CborAppendText(pJsonMsg, pKey);
+	if (Value >= 0) {
+		CborAppendHead(pJsonMsg, CBOR_MAJOR_UINT, (uint32_t)Value);
+	} else {
+		/* -1 - Value can't overflow */
+		CborAppendHead(pJsonMsg, CBOR_MAJOR_NEGATIVE,
+			       ~(uint32_t)Value);
+	}
+}
+
+/* Values that aren't strings (floats) are sent as text because the
+ * builder only has their string form.
+ */
+static void CborAddPair(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			const char *restrict pValue, bool IsNotString)
+{
+	ARG_UNUSED(IsNotString);
+	CborAppendText(pJsonMsg, pKey);
+	CborAppendText(pJsonMsg, pValue);
+}
+
+static void CborAddVersion(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			   uint8_t Major, uint8_t Minor, uint8_t Build)
+{
+	char str[sizeof("255.255.255")];
+	size_t n = 0;
+	n += ToString_Dec(&str[n], Major);
+	str[n++] = '.';
+	n += ToString_Dec(&str[n], Minor);
+	str[n++] = '.';
+	n += ToString_Dec(&str[n], Build);
+
+	CborAppendText(pJsonMsg, pKey);
+	CborAppendHead(pJsonMsg, CBOR_MAJOR_TEXT, n);
+	CborAppend(pJsonMsg, str, n);
+}
+
+static void CborAddNull(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+{
+	CborAppendText(pJsonMsg, pKey);
+	CborAppendByte(pJsonMsg, CBOR_NULL);
+}
+
+static void CborAddTrue(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+{
+	CborAppendText(pJsonMsg, pKey);
+	CborAppendByte(pJsonMsg, CBOR_TRUE);
+}
+
+static void CborAddFalse(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+{
+	CborAppendText(pJsonMsg, pKey);
+	CborAppendByte(pJsonMsg, CBOR_FALSE);
+}
+
+static void CborStartGroup(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+{
+	CborAppendText(pJsonMsg, pKey);
+	CborAppendByte(pJsonMsg, CBOR_INDEFINITE_MAP);
+}
+
+static void CborEndGroup(JsonMsg_t *pJsonMsg)
+{
+	CborAppendByte(pJsonMsg, CBOR_BREAK);
+}
+
+static void CborStartArray(JsonMsg_t *pJsonMsg, const char *restrict pKey)
+{
+	CborAppendText(pJsonMsg, pKey);
+	CborAppendByte(pJsonMsg, CBOR_INDEFINITE_ARRAY);
+}
+
+static void CborEndArray(JsonMsg_t *pJsonMsg)
+{
+	CborAppendByte(pJsonMsg, CBOR_BREAK);
+}
+
+/* ["addr", epoch, true/false] */
+static void CborAddSensorTableArrayEntry(JsonMsg_t *pJsonMsg,
+					 const char *restrict pAddrStr,
+					 uint32_t Epoch, bool Greenlisted)
+{
+	CborAppendHead(pJsonMsg, CBOR_MAJOR_ARRAY, CBOR_ENTRY_ITEMS);
+	CborAppendText(pJsonMsg, pAddrStr);
+	CborAppendHead(pJsonMsg, CBOR_MAJOR_UINT, Epoch);
+	CborAppendByte(pJsonMsg, Greenlisted ? CBOR_TRUE : CBOR_FALSE);
+}
+
+/* [recordType, epoch, data] as integers (JSON uses hex strings) */
+static void CborAddEventLogEntry(JsonMsg_t *pJsonMsg, SensorLogEvent_t *p)
+{
+	CborAppendHead(pJsonMsg, CBOR_MAJOR_ARRAY, CBOR_ENTRY_ITEMS);
+	CborAppendHead(pJsonMsg, CBOR_MAJOR_UINT, p->recordType);
+	CborAppendHead(pJsonMsg, CBOR_MAJOR_UINT, p->epoch);
+	CborAppendHead(pJsonMsg, CBOR_MAJOR_UINT, p->data);
+}
+
+static void CborAddString(JsonMsg_t *pJsonMsg, const char *restrict pKey,
+			  const char *restrict pStr)
+{
+	CborAppendText(pJsonMsg, pKey);
+	CborAppendText(pJsonMsg, pStr);
+}
+
+/* A truncated CBOR message can't be decoded so running out of room is an
+ * error (unlike JSON strings, which are truncated).
+ */
+static void CborAppend(JsonMsg_t *pJsonMsg, const void *pData, size_t Length)
+{
+	FRAMEWORK_ASSERT(pJsonMsg != NULL);
+	if ((pJsonMsg->length + Length) <= pJsonMsg->size) {
+		memcpy(&pJsonMsg->buffer[pJsonMsg->length], pData, Length);
+		pJsonMsg->length += Length;
+	} else { /* buffer too small */
+		FRAMEWORK_ASSERT(false);
+	}
+}
+
+static void CborAppendByte(JsonMsg_t *pJsonMsg, uint8_t Value)
+{
+	CborAppend(pJsonMsg, &Value, sizeof(Value));
+}
+
+/* The shortest form of the head is used (preferred serialization). */
+static void CborAppendHead(JsonMsg_t *pJsonMsg, uint8_t Major, uint32_t Value)
+{
+	uint8_t head[CBOR_HEAD_MAX_SIZE];
+	size_t n = 0;
+	uint8_t mt = Major << 5;
+	if (Value < CBOR_ADDITIONAL_1_BYTE) {
+		head[n++] = mt | Value;
+	} else if (Value <= UINT8_MAX) {
+		head[n++] = mt | CBOR_ADDITIONAL_1_BYTE;
+		head[n++] = Value;
+	} else if (Value <= UINT16_MAX) {
+		head[n++] = mt | CBOR_ADDITIONAL_2_BYTES;
+		sys_put_be16(Value, &head[n]);
+		n += sizeof(uint16_t);
+	} else {
+		head[n++] = mt | CBOR_ADDITIONAL_4_BYTES;
+		sys_put_be32(Value, &head[n]);
+		n += sizeof(uint32_t);
+	}
+	CborAppend(pJsonMsg, head, n);
+}
+
+static void CborAppendText(JsonMsg_t *pJsonMsg, const char *restrict pStr)
+{
+	FRAMEWORK_ASSERT(pStr != NULL);
+	size_t length = strlen(pStr);
+	CborAppendHead(pJsonMsg, CBOR_MAJOR_TEXT, length);
+	CborAppend(pJsonMsg, pStr, length);
+}
@@ -84,6 +84,17 @@ uint8_t ToString_Dec(char *pString, uint32_t Value)
 	return length;
 }
 
+uint8_t ToString_Signed(char *pString, int32_t Value)
+{
+	if (Value >= 0) {
+		return ToString_Dec(pString, (uint32_t)Value);
+	}
+
+	/* Negate as unsigned so that INT32_MIN doesn't overflow. */
+	pString[0] = '-';
+	return 1 + ToString_Dec(&pString[1], 0u - (uint32_t)Value);
+}
+
 void ToString_Hex32(char *pString, uint32_t Value)
 {
 	pString[0] = TO_CHAR((Value >> 28) & 0x0F);
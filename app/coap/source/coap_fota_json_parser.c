@@ -24,6 +24,12 @@ LOG_MODULE_REGISTER(coap_fota_json_parser,
 
 #include "coap_fota_json_parser.h"
 
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+/* Replies are only parsed by the FOTA task. */
+JSMN_JSON_DEFINE(json, CONFIG_COAP_FOTA_JSON_PARSER_TOKENS);
+
 /******************************************************************************/
 /* Global Function Definitions                                                */
 /******************************************************************************/
@@ -31,16 +37,16 @@ int coap_fota_json_parser_get_size(const char *p, const char *name)
 {
 	int result = -1;
 
-	jsmn_start(p);
-	if (jsmn_valid()) {
-		jsmn_find_type("result", JSMN_OBJECT, NEXT_PARENT);
-		int location =
-			jsmn_find_type(name, JSMN_PRIMITIVE, NEXT_PARENT);
+	jsmn_start(&json, p);
+	if (jsmn_valid(&json)) {
+		jsmn_find_type(&json, "result", JSMN_OBJECT, NEXT_PARENT);
+		int location = jsmn_find_type(&json, name, JSMN_PRIMITIVE,
+					      NEXT_PARENT);
 		if (location > 0) {
-			result = jsmn_convert_uint(location);
+			result = jsmn_convert_uint(&json, location);
 		}
 	}
-	jsmn_end();
+	jsmn_end(&json);
 
 	return result;
 }
@@ -59,18 +65,19 @@ int coap_fota_json_parser_get_hash(uint8_t hash[FSU_HASH_SIZE], const char *p,
 	* "protocol-version": 1
 	* }
 	*/
-	jsmn_start(p);
-	if (jsmn_valid()) {
-		jsmn_find_type("result", JSMN_OBJECT, NEXT_PARENT);
-		int location = jsmn_find_type(name, JSMN_STRING, NEXT_PARENT);
+	jsmn_start(&json, p);
+	if (jsmn_valid(&json)) {
+		jsmn_find_type(&json, "result", JSMN_OBJECT, NEXT_PARENT);
+		int location =
+			jsmn_find_type(&json, name, JSMN_STRING, NEXT_PARENT);
 		if (location > 0) {
-			size_t length = hex2bin(jsmn_string(location),
-						jsmn_strlen(location), hash,
-						FSU_HASH_SIZE);
+			size_t length = hex2bin(jsmn_string(&json, location),
+						jsmn_strlen(&json, location),
+						hash, FSU_HASH_SIZE);
 			result = (length == FSU_HASH_SIZE) ? 0 : -1;
 		}
 	}
-	jsmn_end();
+	jsmn_end(&json);
 
 	return result;
 }
@@ -34,6 +34,30 @@ extern "C" {
 
 #define GATEWAY_TOPIC NULL
 
+/* Called from the AWS receive thread when a publish has been acknowledged
+ * (status 0) or has been abandoned (negative error code).  It must not block.
+ */
+typedef void (*aws_publish_callback_t)(int status, void *context);
+
+struct aws_stats {
+	uint32_t consecutive_connection_failures;
+	uint32_t disconnects;
+	uint32_t sends;
+	uint32_t acks;
+	uint32_t success;
+	uint32_t failure;
+	uint32_t consecutive_fails;
+	uint32_t retransmits;
+	uint32_t abandoned;
+	uint32_t window_full;
+	/* PUBACK latency of publishes that weren't retransmitted */
+	int64_t delta;
+	int64_t delta_max;
+	uint32_t tx_payload_bytes;
+	uint32_t rx_payload_bytes;
+	uint32_t rx_dropped;
+};
+
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
 /******************************************************************************/
@@ -44,7 +68,12 @@ bool awsConnected(void);
 bool awsPublished(void);
 int awsDisconnect(void);
 int awsSendData(char *data, uint8_t *topic);
+int awsSendDataLength(char *data, uint32_t len, uint8_t *topic);
+int awsSendDataLengthCallback(char *data, uint32_t len, uint8_t *topic,
+			      aws_publish_callback_t callback, void *context);
 int awsSendBinData(char *data, uint32_t len, uint8_t *topic);
+int awsSendBinDataCallback(char *data, uint32_t len, uint8_t *topic,
+			   aws_publish_callback_t callback, void *context);
 int awsPublishShadowPersistentData(void);
 int awsPublishESSSensorData(float temperature, float humidity,
 			      float pressure);
@@ -56,6 +85,13 @@ int awsGetAcceptedUnsub(void);
 void awsGenerateGatewayTopics(const char *id);
 void awsDisconnectCallback(void);
 char *awsGetGatewayUpdateDeltaTopic(void);
+
+/**
+ * @brief Get the publish, PUBACK and receive statistics.
+ *
+ * @note Values are read without locking and are for diagnostics only.
+ */
+void awsGetStats(struct aws_stats *stats);
 struct mqtt_client *awsGetMqttClient(void);
 
 #ifdef __cplusplus
@@ -2,6 +2,9 @@
  * @file jsmn_json.h
  * @brief Wrap jsmn JSON parser so that it can be used by multiple modules.
  *
+ * Each user owns a context (and its tokens) so that documents can be
+ * parsed concurrently.  A context can't be shared between threads.
+ *
  * Copyright (c) 2020-2021 Laird Connectivity
  *
  * SPDX-License-Identifier: Apache-2.0
@@ -16,6 +19,7 @@ extern "C" {
 /******************************************************************************/
 /* Includes                                                                   */
 /******************************************************************************/
+#include <zephyr/types.h>
 #include <stdbool.h>
 #include <string.h>
 
@@ -44,8 +48,55 @@ extern "C" {
 /* Global Constants, Macros and Type Definitions                              */
 /******************************************************************************/
 /* JSON strings aren't null terminated. */
-#define JSMN_STRNCPY(str, idx)                                                 \
-	strncpy(str, jsmn_string(idx), MIN(jsmn_strlen(idx), sizeof(str) - 1))
+#define JSMN_STRNCPY(ctx, str, idx)                                            \
+	strncpy(str, jsmn_string(ctx, idx),                                    \
+		MIN(jsmn_strlen(ctx, idx), sizeof(str) - 1))
+
+/* Members with these keys are skipped by the tokenizer.
+ * A member of the root object has a depth of 1.
+ * A depth of 0 matches the key at any depth.
+ */
+typedef struct jsmn_json_skip {
+	const char *key;
+	uint8_t depth;
+} jsmn_json_skip_t;
+
+typedef struct jsmn_json {
+	jsmn_parser parser;
+	jsmntok_t *tokens;
+	int max_tokens;
+	int tokens_found;
+	int next_parent;
+	int index;
+	int saved_index;
+	int saved_parent;
+	const char *json;
+	/* Hash table of object keys (token indices) allocated for each document
+	 * when index_keys is set
+	 */
+	bool index_keys;
+	uint16_t *keys;
+	int key_slots;
+	const jsmn_json_skip_t *skip;
+	size_t skip_count;
+} jsmn_json_t;
+
+/* Define a context with its own tokens.  The number of tokens required
+ * depends on the largest document that is parsed by the user.
+ * The key index has two slots per key and is freed by jsmn_end.
+ */
+#define JSMN_JSON_DEFINE_SKIP(name, number_of_tokens, skip_keys,               \
+			      skip_key_count)                                  \
+	BUILD_ASSERT(number_of_tokens <= UINT16_MAX, "Too many tokens");       \
+	static jsmntok_t name##_tokens[number_of_tokens];                      \
+	static jsmn_json_t name = { .tokens = name##_tokens,                   \
+				    .max_tokens = number_of_tokens,            \
+				    .index_keys = true,                        \
+				    .skip = skip_keys,                         \
+				    .skip_count = skip_key_count }
+
+#define JSMN_JSON_DEFINE(name, number_of_tokens)                               \
+	JSMN_JSON_DEFINE_SKIP(name, number_of_tokens, NULL, 0)
 
 /******************************************************************************/
 /* Global Function Prototypes                                                 */
@@ -54,32 +105,34 @@ extern "C" {
 typedef enum parent_type { NO_PARENT = 0, NEXT_PARENT } parent_type_t;
 
 /**
- * @brief Take jsmn mutex.  Tokenize JSON.
+ * @brief Tokenize JSON.  Members that match the skip keys of the context
+ * (and their values) don't generate tokens.  The JSON isn't modified.
  *
  * @note It is assumed any user of this module will call this first.
  *
+ * @param jsmn is the context that holds the tokens
  * @param p is a pointer to JSON
  */
-void jsmn_start(const char *p);
+void jsmn_start(jsmn_json_t *jsmn, const char *p);
 
 /**
- * @brief Release jsmn mutex.
+ * @brief Done with JSON.  The context can be used for another document.
  */
-void jsmn_end(void);
+void jsmn_end(jsmn_json_t *jsmn);
 
 /**
  * @brief Accessor function
  *
  * @retval true if the JSON was tokenized properly.
  */
-bool jsmn_valid(void);
+bool jsmn_valid(jsmn_json_t *jsmn);
 
 /**
  * @brief Accessor function
  *
  * @retval less than or equal to zero on error, otherwise number of tokens.
  */
-int jsmn_tokens_found(void);
+int jsmn_tokens_found(jsmn_json_t *jsmn);
 
 /**
  * @brief This function updates the global index to the next token when an
@@ -93,64 +146,92 @@ int jsmn_tokens_found(void);
  * @retval > 0 then then the location of the data is returned.
  * @retval <= 0, then the item was not found
  */
-int jsmn_find_type(const char *s, jsmntype_t type, parent_type_t parent_type);
+int jsmn_find_type(jsmn_json_t *jsmn, const char *s, jsmntype_t type,
+		   parent_type_t parent_type);
+
+/**
+ * @brief Find a value using a path of keys separated by '.'.  For example,
+ * "state.reported.eventLog".  Each key except the last must be an object.
+ * The search begins at the current index and parent.
+ *
+ * @note Keys are found using an index that is built by jsmn_start.
+ * The cost doesn't depend on the size of the document.
+ *
+ * @retval > 0 then the location of the data is returned.
+ * @retval <= 0, then the item was not found
+ */
+int jsmn_find_path(jsmn_json_t *jsmn, const char *path, jsmntype_t type);
+
+/**
+ * @brief Read an unsigned number that is a member of the root object
+ * without tokenizing the document.  For example, the "version" of a shadow.
+ *
+ * @note The JSON is scanned until the key is found.
+ *
+ * @param p is a pointer to a null terminated JSON string
+ * @param key is the name of the member
+ * @param pValue is set to the value when it is found
+ *
+ * @retval true if a number was found, otherwise false
+ */
+bool jsmn_peek_uint(const char *p, const char *key, uint32_t *pValue);
 
 /**
  * @brief Accessor function
  *
  * @retval the current token index
  */
-int jsmn_index(void);
+int jsmn_index(jsmn_json_t *jsmn);
 
 /**
  * @brief Helper function that resets index and parent
  */
-void jsmn_reset_index(void);
+void jsmn_reset_index(jsmn_json_t *jsmn);
 
 /**
  * @brief Helper function that saves index and parent.
  */
-void jsmn_save_index(void);
+void jsmn_save_index(jsmn_json_t *jsmn);
 
 /**
  * @brief Helper function that restores index and parent from saved values.
  */
-void jsmn_restore_index(void);
+void jsmn_restore_index(jsmn_json_t *jsmn);
 
 /**
  * @brief Converts string to uint
  *
  * @note If the string is larger than a 11 digits, then 0 is returned.
  */
-uint32_t jsmn_convert_uint(int index);
+uint32_t jsmn_convert_uint(jsmn_json_t *jsmn, int index);
 
 /**
  * @brief Converts hex string to uint
  *
  * @note If the string is larger than a 8 digits, then 0 is returned.
  */
-uint32_t jsmn_convert_hex(int index);
+uint32_t jsmn_convert_hex(jsmn_json_t *jsmn, int index);
 
 /**
  * @brief Accessor function
  *
  * @retval The type of the token at the specified index.
  */
-jsmntype_t jsmn_type(int index);
+jsmntype_t jsmn_type(jsmn_json_t *jsmn, int index);
 
 /**
  * @brief Accessor function
  *
  * @retval The size of the token at the specified index.
  */
-int jsmn_size(int index);
+int jsmn_size(jsmn_json_t *jsmn, int index);
 
 /**
  * @brief Accessor function
  *
  * @retval The size of the string at the specified token index.
  */
-int jsmn_strlen(int index);
+int jsmn_strlen(jsmn_json_t *jsmn, int index);
 
 /**
  * @brief Accessor function
@@ -158,7 +239,7 @@ int jsmn_strlen(int index);
  * @retval A pointer to a string the specified token.
  * Undefined if token @ index is not a string.
  */
-const char *jsmn_string(int index);
+const char *jsmn_string(jsmn_json_t *jsmn, int index);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,109 @@
+/**
+ * @file lcz_json_filter.h
+ * @brief Remove members from a JSON document while it is being received.
+ *
+ * The document is written in pieces (as it is read from a socket) and only
+ * what remains after filtering has to fit in the output buffer.  Whitespace
+ * outside of strings is removed.  An object member is removed (including its
+ * value) when its key matches a rule.
+ *
+ * The comma and key of a member are written before the key is matched, so
+ * the buffer also needs room for the comma and quoted key of the longest
+ * rule.
+ *
+ * The filter tracks structure but doesn't validate the JSON.  That is left
+ * to the parser of the output.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __LCZ_JSON_FILTER_H__
+#define __LCZ_JSON_FILTER_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr/types.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+#define LCZ_JSON_FILTER_MAX_DEPTH 32
+
+/* A member of the root object has a depth of 1.
+ * A depth of 0 matches the key at any depth.
+ */
+struct lcz_json_filter_rule {
+	const char *key;
+	uint8_t depth;
+};
+
+struct lcz_json_filter {
+	const struct lcz_json_filter_rule *rules;
+	size_t rule_count;
+	char *dst;
+	size_t size;
+	size_t length;
+	/* Where the output is rewound to when a member is removed */
+	size_t member_start;
+	size_t key_start;
+	/* Bit is set when the container at that depth is an object */
+	uint32_t objects;
+	uint8_t depth;
+	uint32_t skip_nesting;
+	bool in_string;
+	bool escape;
+	bool is_key;
+	bool expect_key;
+	bool member_comma;
+	bool drop_comma;
+	bool skipping;
+	int status;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Prepare a filter for a new document.
+ *
+ * @param filter context
+ * @param dst output buffer.  One byte is reserved for a terminator.
+ * @param size of output buffer
+ * @param rules members to remove (must remain valid until finished)
+ * @param rule_count number of rules
+ */
+void lcz_json_filter_init(struct lcz_json_filter *filter, char *dst,
+			  size_t size, const struct lcz_json_filter_rule *rules,
+			  size_t rule_count);
+
+/**
+ * @brief Filter the next piece of the document.
+ *
+ * @note Once an error occurs the remainder of the document is ignored.
+ *
+ * @retval 0 on success, -ENOMEM if the output buffer is full,
+ * -EINVAL if the document is nested too deeply.
+ */
+int lcz_json_filter_write(struct lcz_json_filter *filter, const char *src,
+			  size_t len);
+
+/**
+ * @brief Null terminate the output.
+ *
+ * @retval length of output or a negative error code
+ */
+int lcz_json_filter_finish(struct lcz_json_filter *filter);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LCZ_JSON_FILTER_H__ */
@@ -0,0 +1,102 @@
+/**
+ * @file lcz_lzss.h
+ * @brief LZSS compression of publish payloads.
+ *
+ * A compressed payload starts with a header so that the receiver can tell
+ * it apart from a plain payload.  Plain payloads are either text (JSON or
+ * logs) or contact tracing entries that start with a protocol version, so
+ * they never start with LCZ_LZSS_MAGIC0.
+ *
+ * Header: magic (2), version (1), uncompressed length (4, big endian).
+ *
+ * The data that follows is a series of groups.  Each group is a flag byte
+ * followed by up to eight items (LSB first).  A set flag is a literal byte.
+ * A clear flag is a two byte reference to previous output: a 12-bit
+ * distance minus one, followed by a 4-bit length minus
+ * LCZ_LZSS_MIN_MATCH.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __LCZ_LZSS_H__
+#define __LCZ_LZSS_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr/types.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+#define LCZ_LZSS_MAGIC0 0xB1
+#define LCZ_LZSS_MAGIC1 0x5A
+#define LCZ_LZSS_VERSION 1
+#define LCZ_LZSS_HEADER_SIZE 7
+
+#define LCZ_LZSS_MIN_MATCH 3
+#define LCZ_LZSS_MAX_MATCH (LCZ_LZSS_MIN_MATCH + 15)
+#define LCZ_LZSS_MAX_DISTANCE 4096
+
+struct lcz_lzss_stats {
+	uint32_t compressed;
+	uint32_t not_smaller;
+	uint32_t bytes_in;
+	uint32_t bytes_out;
+	/* Size of the output as a percentage of the input */
+	uint32_t ratio;
+	uint32_t time_us;
+	uint32_t time_max_us;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Compress a payload (including the header).
+ *
+ * @param src data to compress
+ * @param src_len length of data
+ * @param dst output buffer
+ * @param dst_size size of output buffer
+ *
+ * @retval length of the output, -ENOSPC if the output isn't smaller than
+ * dst_size, otherwise a negative error code.
+ */
+int lcz_lzss_compress(const uint8_t *src, size_t src_len, uint8_t *dst,
+		      size_t dst_size);
+
+#ifdef CONFIG_LCZ_LZSS_DECOMPRESS
+/**
+ * @brief Decompress a payload created by lcz_lzss_compress.
+ *
+ * @retval length of the output, -EINVAL if the payload isn't valid,
+ * -ENOSPC if dst is too small.
+ */
+int lcz_lzss_decompress(const uint8_t *src, size_t src_len, uint8_t *dst,
+			size_t dst_size);
+#endif
+
+/**
+ * @brief Check if a payload starts with the compression header.
+ */
+bool lcz_lzss_is_compressed(const uint8_t *src, size_t src_len);
+
+/**
+ * @brief Get the compression ratio and CPU time statistics.
+ *
+ * @note Values are read without locking and are for diagnostics only.
+ */
+void lcz_lzss_get_stats(struct lcz_lzss_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LCZ_LZSS_H__ */
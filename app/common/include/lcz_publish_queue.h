@@ -0,0 +1,127 @@
+/**
+ * @file lcz_publish_queue.h
+ * @brief Store publishes on the file system while the cloud is unreachable.
+ *
+ * Each publish is a file in the queue directory that is named with its
+ * sequence number.  It is written to a temporary file that is renamed once
+ * it is complete, so a power failure loses at most the publish that was
+ * being written.  The topic and payload are checked with a CRC when they
+ * are read back.
+ *
+ * File: header, topic, payload.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __LCZ_PUBLISH_QUEUE_H__
+#define __LCZ_PUBLISH_QUEUE_H__
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr/types.h>
+#include <stddef.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/******************************************************************************/
+/* Global Constants, Macros and Type Definitions                              */
+/******************************************************************************/
+struct lcz_publish_queue_entry {
+	/* NULL for the default topic */
+	const char *topic;
+	/* Null terminated */
+	const char *data;
+	size_t length;
+	bool binary;
+	uint32_t epoch;
+	/* Private */
+	uint32_t seq;
+	size_t size;
+	void *buffer;
+};
+
+struct lcz_publish_queue_stats {
+	uint32_t depth;
+	uint32_t bytes;
+	/* Seconds, 0 if the queue is empty or the age isn't known */
+	uint32_t oldest_age;
+	uint32_t queued;
+	uint32_t sent;
+	uint32_t dropped_overflow;
+	uint32_t dropped_expired;
+	uint32_t dropped_invalid;
+	uint32_t dropped_failed;
+	uint32_t write_errors;
+};
+
+/******************************************************************************/
+/* Global Function Prototypes                                                 */
+/******************************************************************************/
+/**
+ * @brief Add a publish to the end of the queue.
+ *
+ * @note The queue directory is found (and publishes that were stored before
+ * a reset are counted) the first time the queue is used.
+ *
+ * @param topic NULL for the default topic
+ * @param data payload
+ * @param length of payload
+ * @param binary true if the payload isn't JSON
+ *
+ * @retval 0 on success, -ENOSPC if the queue is full and new publishes are
+ * dropped, -EFBIG if the publish is larger than the queue, otherwise a
+ * file system error
+ */
+int lcz_publish_queue_put(const char *topic, const char *data, size_t length,
+			  bool binary);
+
+/**
+ * @brief Read the oldest publish.  Publishes that have expired or are
+ * invalid are discarded.
+ *
+ * @note The entry must be released.  The publish stays at the head of the
+ * queue until the entry is removed (after it has been acknowledged) or
+ * discarded.
+ *
+ * @retval 0 on success, -ENOENT if the queue is empty, -ENOMEM if there
+ * isn't enough memory to read the publish
+ */
+int lcz_publish_queue_get(struct lcz_publish_queue_entry *entry);
+
+/**
+ * @brief Delete a publish that has been sent and free the entry.
+ */
+void lcz_publish_queue_remove(struct lcz_publish_queue_entry *entry);
+
+/**
+ * @brief Delete a publish that couldn't be sent and free the entry.
+ */
+void lcz_publish_queue_discard(struct lcz_publish_queue_entry *entry);
+
+/**
+ * @brief Free an entry without removing the publish from the queue.
+ *
+ * @note A released entry can still be removed or discarded.
+ */
+void lcz_publish_queue_release(struct lcz_publish_queue_entry *entry);
+
+/**
+ * @retval true if there aren't any publishes in the queue
+ */
+bool lcz_publish_queue_empty(void);
+
+/**
+ * @brief Get queue depth, age of the oldest publish and drop counts.
+ */
+void lcz_publish_queue_get_stats(struct lcz_publish_queue_stats *stats);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LCZ_PUBLISH_QUEUE_H__ */
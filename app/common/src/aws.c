@@ -39,6 +39,7 @@ LOG_MODULE_REGISTER(aws, CONFIG_AWS_LOG_LEVEL);
 
 #ifdef CONFIG_BLUEGRASS
 #include "sensor_gateway_parser.h"
+#include "lcz_json_filter.h"
 #endif
 
 #if defined(CONFIG_BOARD_MG100)
@@ -53,6 +54,10 @@ LOG_MODULE_REGISTER(aws, CONFIG_AWS_LOG_LEVEL);
 #include "sdcard_log.h"
 #endif
 
+#if defined(CONFIG_AWS_PUBLISH_COMPRESSION)
+#include "lcz_lzss.h"
+#endif
+
 #include "aws_json.h"
 #include "aws.h"
 
@@ -71,6 +76,7 @@ LOG_MODULE_REGISTER(aws, CONFIG_AWS_LOG_LEVEL);
 #endif
 
 #define CONVERSION_MAX_STR_LEN 10
+#define AWS_RESERVED_TOPIC_PREFIX "$aws/"
 #define HEX_CHARS_PER_HEX_VALUE 2
 
 struct topics {
@@ -80,6 +86,27 @@ struct topics {
 	uint8_t get_accepted[CONFIG_AWS_TOPIC_MAX_SIZE];
 };
 
+#define PUBACK_TIMEOUT_MS (CONFIG_AWS_PUBACK_TIMEOUT_SECONDS * MSEC_PER_SEC)
+#define WINDOW_TIMEOUT K_SECONDS(CONFIG_AWS_PUBACK_TIMEOUT_SECONDS)
+
+/* A publish that is waiting for PUBACK.  A message id of 0 is a free slot.
+ * The topic and payload of a publish whose producer wants to know the outcome
+ * are retained (in that order) in one allocation so that it can be
+ * retransmitted.  Other publishes are sent from the producer's buffer only.
+ */
+struct inflight {
+	uint16_t message_id;
+	uint8_t retries;
+	bool binary;
+	/* Uptime of the last transmission */
+	int64_t sent;
+	uint8_t *buffer;
+	size_t topic_size;
+	uint32_t length;
+	aws_publish_callback_t callback;
+	void *context;
+};
+
 #if CONFIG_AWS_PUBLISH_WATCHDOG_SECONDS != 0
 BUILD_ASSERT((CONFIG_AWS_PUBLISH_WATCHDOG_SECONDS / 2) >
 		     CONFIG_AWS_HEARTBEAT_SECONDS,
@@ -101,8 +128,19 @@ static uint8_t tx_buffer[CONFIG_MQTT_TX_BUFFER_SIZE];
 
 #ifdef CONFIG_BLUEGRASS
 static uint8_t subscription_buffer[CONFIG_SHADOW_IN_MAX_SIZE];
+
+/* The parsers only use the state.  The metadata mirrors the state with a
+ * timestamp for every value and is often larger than the state.
+ */
+static const struct lcz_json_filter_rule SUBSCRIPTION_FILTER_RULES[] = {
+	{ "metadata", 1 },
+	{ "timestamp", 1 },
+};
 #endif
 
+/* Subscriptions are read from the socket in pieces of this size. */
+static uint8_t subscription_chunk[CONFIG_SHADOW_IN_CHUNK_SIZE];
+
 /* mqtt client id */
 static char mqtt_random_id[AWS_MQTT_ID_MAX_SIZE];
 
@@ -132,20 +170,15 @@ static struct topics topics;
 static struct k_work_delayable publish_watchdog;
 static struct k_work_delayable keep_alive;
 
-static struct {
-	uint32_t consecutive_connection_failures;
-	uint32_t disconnects;
-	uint32_t sends;
-	uint32_t acks;
-	uint32_t success;
-	uint32_t failure;
-	uint32_t consecutive_fails;
-	int64_t time;
-	int64_t delta;
-	int64_t delta_max;
-	uint32_t tx_payload_bytes;
-	uint32_t rx_payload_bytes;
-} aws_stats;
+static struct inflight inflight[CONFIG_AWS_PUBLISH_WINDOW];
+static K_MUTEX_DEFINE(inflight_mutex);
+/* Count of free in-flight slots */
+static struct k_sem window_sem;
+static uint16_t last_message_id;
+static size_t retained_bytes;
+static bool retransmit_inflight;
+
+static struct aws_stats aws_stats;
 
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
@@ -158,15 +191,29 @@ static void mqtt_evt_handler(struct mqtt_client *const client,
 static int subscription_handler(struct mqtt_client *const client,
 				const struct mqtt_evt *evt);
 static void subscription_flush(struct mqtt_client *const client, size_t length);
-static int publish(struct mqtt_client *client, enum mqtt_qos qos, char *data,
-		   uint32_t len, uint8_t *topic, bool binary);
+static int publish(struct mqtt_client *client, uint16_t message_id, bool dup,
+		   char *data, uint32_t len, uint8_t *topic, bool binary);
 static void client_init(struct mqtt_client *client);
 static int try_to_connect(struct mqtt_client *client);
 static void aws_rx_thread(void *arg1, void *arg2, void *arg3);
 static uint16_t rand16_nonzero_get(void);
 static void publish_watchdog_work_handler(struct k_work *work);
 static void keep_alive_work_handler(struct k_work *work);
-static int aws_send_data(bool binary, char *data, uint32_t len, uint8_t *topic);
+static int aws_send_data(bool binary, char *data, uint32_t len, uint8_t *topic,
+			 aws_publish_callback_t callback, void *context);
+static uint16_t inflight_add(char *data, uint32_t len, uint8_t *topic,
+			     bool binary, aws_publish_callback_t callback,
+			     void *context);
+static void inflight_cancel(uint16_t message_id);
+static void inflight_ack(uint16_t message_id);
+static void inflight_service(void);
+static void inflight_disconnected(void);
+static void inflight_free(struct inflight *entry);
+static uint16_t message_id_get(void);
+static k_timeout_t window_timeout(void);
+#ifdef CONFIG_AWS_PUBLISH_COMPRESSION
+static uint8_t *compress_payload(char **data, uint32_t *len, uint8_t *topic);
+#endif
 
 #ifdef CONFIG_NET_L2_ETHERNET
 static char *net_sprint_ll_addr_lower(const uint8_t *ll);
@@ -180,6 +227,11 @@ char *awsGetGatewayUpdateDeltaTopic()
 	return (topics.update);
 }
 
+void awsGetStats(struct aws_stats *stats)
+{
+	memcpy(stats, &aws_stats, sizeof(struct aws_stats));
+}
+
 int awsInit(void)
 {
 	struct shadow_persistent_values *reported =
@@ -187,6 +239,11 @@ int awsInit(void)
 
 	k_sem_init(&connected_sem, 0, 1);
 	k_sem_init(&disconnected_sem, 0, 1);
+	k_sem_init(&window_sem, CONFIG_AWS_PUBLISH_WINDOW,
+		   CONFIG_AWS_PUBLISH_WINDOW);
+
+	/* Message ids aren't reused across a reset */
+	last_message_id = rand16_nonzero_get();
 
 	/* init shadow data */
 	reported->os_version = KERNEL_VERSION_STRING;
@@ -279,23 +336,42 @@ int awsDisconnect(void)
 }
 
 int awsSendData(char *data, uint8_t *topic)
+{
+	return awsSendDataLength(data, strlen(data), topic);
+}
+
+int awsSendDataLength(char *data, uint32_t len, uint8_t *topic)
+{
+	return awsSendDataLengthCallback(data, len, topic, NULL, NULL);
+}
+
+int awsSendDataLengthCallback(char *data, uint32_t len, uint8_t *topic,
+			      aws_publish_callback_t callback, void *context)
 {
 	/* If the topic is NULL, then publish to the gateway (Pinnacle-100) topic.
 	 * Otherwise, publish to a sensor topic. */
 	if (topic == NULL) {
-		return aws_send_data(false, data, 0, topics.update);
+		return aws_send_data(false, data, len, topics.update, callback,
+				     context);
 	} else {
-		return aws_send_data(false, data, 0, topic);
+		return aws_send_data(false, data, len, topic, callback,
+				     context);
 	}
 }
 
 int awsSendBinData(char *data, uint32_t len, uint8_t *topic)
+{
+	return awsSendBinDataCallback(data, len, topic, NULL, NULL);
+}
+
+int awsSendBinDataCallback(char *data, uint32_t len, uint8_t *topic,
+			   aws_publish_callback_t callback, void *context)
 {
 	if (topic == NULL) {
 		/* don't publish binary data to the default topic (device shadow) */
 		return -EOPNOTSUPP;
 	} else {
-		return aws_send_data(true, data, len, topic);
+		return aws_send_data(true, data, len, topic, callback, context);
 	}
 }
 
@@ -327,7 +403,8 @@ int awsGetAcceptedSubscribe(void)
 int awsGetShadow(void)
 {
 	char msg[] = "{\"message\":\"Hello, from Laird Connectivity\"}";
-	int rc = aws_send_data(false, msg, 0, topics.get);
+	int rc = aws_send_data(false, msg, strlen(msg), topics.get, NULL,
+			       NULL);
 	if (rc != 0) {
 		AWS_LOG_ERR("Unable to get shadow");
 	}
@@ -627,15 +704,8 @@ static void mqtt_evt_handler(struct mqtt_client *const client,
 			break;
 		}
 
-		/* Unless a single caller/semaphore is used the delta isn't foolproof. */
 		aws_stats.acks += 1;
-		aws_stats.delta = k_uptime_delta(&aws_stats.time);
-		aws_stats.delta_max = MAX(aws_stats.delta_max, aws_stats.delta);
-
-		AWS_LOG_ACK("PUBACK packet id: %u delta: %d",
-			    evt->param.puback.message_id,
-			    (int32_t)aws_stats.delta);
-
+		inflight_ack(evt->param.puback.message_id);
 		break;
 
 	case MQTT_EVT_PUBLISH:
@@ -666,6 +736,9 @@ static void mqtt_evt_handler(struct mqtt_client *const client,
 /* The timestamps can make the shadow size larger than 4K.
  * This is too large to be allocated by malloc or the buffer pool.
  * Therefore, messages are processed here.
+ *
+ * The payload is filtered as it is read from the socket so that only the
+ * parts used by the parsers have to fit in the subscription buffer.
  */
 static int subscription_handler(struct mqtt_client *const client,
 				const struct mqtt_evt *evt)
@@ -676,32 +749,53 @@ static int subscription_handler(struct mqtt_client *const client,
 	uint32_t length = evt->param.publish.message.payload.len;
 	uint8_t qos = evt->param.publish.message.topic.qos;
 	const uint8_t *topic = evt->param.publish.message.topic.topic.utf8;
-
-	/* Leave room for null to allow easy printing */
-	size_t size = length + 1;
-	if (size > CONFIG_SHADOW_IN_MAX_SIZE) {
-		return 0;
+	struct lcz_json_filter filter;
+	uint32_t total = 0;
+
+	/* The filter leaves room for null to allow easy printing */
+	lcz_json_filter_init(&filter, (char *)subscription_buffer,
+			     sizeof(subscription_buffer),
+			     SUBSCRIPTION_FILTER_RULES,
+			     ARRAY_SIZE(SUBSCRIPTION_FILTER_RULES));
+
+	/* The payload is consumed even if it doesn't fit. */
+	while (total < length) {
+		rc = mqtt_read_publish_payload_blocking(
+			client, subscription_chunk,
+			MIN(length - total, sizeof(subscription_chunk)));
+		if (rc <= 0) {
+			AWS_LOG_ERR("Subscription read error %d", rc);
+			return total;
+		}
+		(void)lcz_json_filter_write(
+			&filter, (const char *)subscription_chunk, rc);
+		total += rc;
 	}
 
 	aws_stats.rx_payload_bytes += length;
 
-	rc = mqtt_read_publish_payload(client, subscription_buffer, length);
-	if (rc == length) {
-		subscription_buffer[length] = 0; /* null terminate */
+	rc = lcz_json_filter_finish(&filter);
+	if (rc < 0) {
+		aws_stats.rx_dropped += 1;
+		AWS_LOG_ERR("Subscription of %u bytes doesn't fit (%d)", length,
+			    rc);
+		return total;
+	}
 
 #ifdef CONFIG_JSON_LOG_MQTT_RX_DATA
-		print_json("MQTT Read data", rc, subscription_buffer);
+	print_json("MQTT Read data", rc, subscription_buffer);
 #endif
 
-		SensorGatewayParser(topic, subscription_buffer);
+	SensorGatewayParser(topic, subscription_buffer);
 
-		if (qos == MQTT_QOS_1_AT_LEAST_ONCE) {
-			struct mqtt_puback_param param = { .message_id = id };
-			(void)mqtt_publish_qos1_ack(client, &param);
-		} else if (qos == MQTT_QOS_2_EXACTLY_ONCE) {
-			AWS_LOG_ERR("QOS 2 not supported");
-		}
+	if (qos == MQTT_QOS_1_AT_LEAST_ONCE) {
+		struct mqtt_puback_param param = { .message_id = id };
+		(void)mqtt_publish_qos1_ack(client, &param);
+	} else if (qos == MQTT_QOS_2_EXACTLY_ONCE) {
+		AWS_LOG_ERR("QOS 2 not supported");
 	}
+
+	rc = total;
 #endif
 	return rc;
 }
@@ -709,28 +803,36 @@ static int subscription_handler(struct mqtt_client *const client,
 static void subscription_flush(struct mqtt_client *const client, size_t length)
 {
 	LOG_ERR("Subscription Flush %u", length);
-	char junk;
-	size_t i;
-	for (i = 0; i < length; i++) {
-		if (mqtt_read_publish_payload(client, &junk, 1) != 1) {
+	int rc;
+
+	while (length > 0) {
+		rc = mqtt_read_publish_payload_blocking(
+			client, subscription_chunk,
+			MIN(length, sizeof(subscription_chunk)));
+		if (rc <= 0) {
 			break;
 		}
+		length -= rc;
 	}
 }
 
-static int publish(struct mqtt_client *client, enum mqtt_qos qos, char *data,
-		   uint32_t len, uint8_t *topic, bool binary)
+static int publish(struct mqtt_client *client, uint16_t message_id, bool dup,
+		   char *data, uint32_t len, uint8_t *topic, bool binary)
 {
 	struct mqtt_publish_param param;
 
 	memset(&param, 0, sizeof(struct mqtt_publish_param));
-	param.message.topic.qos = qos;
+	param.message.topic.qos = MQTT_QOS_1_AT_LEAST_ONCE;
 	param.message.topic.topic.utf8 = topic;
 	param.message.topic.topic.size = strlen(param.message.topic.topic.utf8);
+	/* The MQTT library only encodes the fixed header and topic into the
+	 * tx buffer.  The payload is written to the socket from the caller's
+	 * buffer, so it isn't limited by (or copied into) the tx buffer.
+	 */
 	param.message.payload.data = data;
 	param.message.payload.len = len;
-	param.message_id = rand16_nonzero_get();
-	param.dup_flag = 0U;
+	param.message_id = message_id;
+	param.dup_flag = dup ? 1U : 0U;
 	param.retain_flag = 0U;
 
 #ifdef CONFIG_JSON_LOG_TOPIC
@@ -744,13 +846,6 @@ static int publish(struct mqtt_client *client, enum mqtt_qos qos, char *data,
 	}
 #endif
 
-	/* Does the tx buf size matter? */
-	if (client_ctx.tx_buf_size < len) {
-		AWS_LOG_WRN("len: %u", len);
-	}
-
-	aws_stats.time = k_uptime_get();
-
 	return mqtt_publish(client, &param);
 }
 
@@ -835,6 +930,9 @@ static void aws_rx_thread(void *arg1, void *arg2, void *arg3)
 			wait(SOCKET_POLL_WAIT_TIME_MSECS);
 			/* process MQTT RX data */
 			mqtt_input(&client_ctx);
+			if (!aws_disconnect) {
+				inflight_service();
+			}
 			/* Disconnect (request) flag is set from the disconnect callback
 			 * and from a user request.
 			 */
@@ -844,6 +942,7 @@ static void aws_rx_thread(void *arg1, void *arg2, void *arg3)
 				clear_fds();
 				aws_disconnect = false;
 				aws_connected = false;
+				inflight_disconnected();
 				k_sem_give(&disconnected_sem);
 				awsDisconnectCallback();
 			}
@@ -899,26 +998,39 @@ static void keep_alive_work_handler(struct k_work *work)
 	}
 }
 
-static int aws_send_data(bool binary, char *data, uint32_t len, uint8_t *topic)
+static int aws_send_data(bool binary, char *data, uint32_t len, uint8_t *topic,
+			 aws_publish_callback_t callback, void *context)
 {
 	int rc = -EPERM;
-	uint32_t length;
+	uint16_t message_id;
 
 	if (!aws_connected) {
 		return rc;
 	}
 
-	if (binary) {
-		length = len;
-	} else {
-		length = strlen(data);
+	if (k_sem_take(&window_sem, window_timeout()) != 0) {
+		aws_stats.window_full += 1;
+		AWS_LOG_ERR("Publish window full");
+		return -EBUSY;
 	}
 
+#ifdef CONFIG_AWS_PUBLISH_COMPRESSION
+	uint8_t *compressed = compress_payload(&data, &len, topic);
+	if (compressed != NULL) {
+		binary = true;
+	}
+#endif
+
 	aws_stats.sends += 1;
-	aws_stats.tx_payload_bytes += length;
+	aws_stats.tx_payload_bytes += len;
 
-	rc = publish(&client_ctx, MQTT_QOS_1_AT_LEAST_ONCE, data, length, topic,
-		     binary);
+	message_id = inflight_add(data, len, topic, binary, callback, context);
+	rc = publish(&client_ctx, message_id, false, data, len, topic, binary);
+
+#ifdef CONFIG_AWS_PUBLISH_COMPRESSION
+	/* The payload has been written to the socket. */
+	k_free(compressed);
+#endif
 
 	if (rc == 0) {
 		aws_stats.success += 1;
@@ -929,6 +1041,7 @@ static int aws_send_data(bool binary, char *data, uint32_t len, uint8_t *topic)
 				K_SECONDS(CONFIG_AWS_PUBLISH_WATCHDOG_SECONDS));
 		}
 	} else {
+		inflight_cancel(message_id);
 		aws_stats.failure += 1;
 		aws_stats.consecutive_fails += 1;
 		AWS_LOG_ERR("MQTT publish err %u (%d)", aws_stats.failure, rc);
@@ -937,6 +1050,297 @@ static int aws_send_data(bool binary, char *data, uint32_t len, uint8_t *topic)
 	return rc;
 }
 
+/* The caller has taken a slot from the window.
+ *
+ * @retval message id of the publish
+ */
+static uint16_t inflight_add(char *data, uint32_t len, uint8_t *topic,
+			     bool binary, aws_publish_callback_t callback,
+			     void *context)
+{
+	struct inflight *entry = NULL;
+	size_t topic_size = strlen((char *)topic) + 1;
+	size_t size = topic_size + len;
+	uint16_t message_id;
+	size_t i;
+
+	k_mutex_lock(&inflight_mutex, K_FOREVER);
+	for (i = 0; i < ARRAY_SIZE(inflight) && entry == NULL; i++) {
+		if (inflight[i].message_id == 0) {
+			entry = &inflight[i];
+		}
+	}
+	__ASSERT(entry != NULL, "In-flight table doesn't match window");
+
+	message_id = message_id_get();
+	memset(entry, 0, sizeof(struct inflight));
+	entry->binary = binary;
+	entry->length = len;
+	entry->callback = callback;
+	entry->context = context;
+	if (callback != NULL &&
+	    (retained_bytes + size) <= CONFIG_AWS_PUBLISH_RETAIN_MAX_BYTES) {
+		entry->buffer = k_malloc(size);
+	}
+	if (entry->buffer != NULL) {
+		memcpy(entry->buffer, topic, topic_size);
+		memcpy(entry->buffer + topic_size, data, len);
+		entry->topic_size = topic_size;
+		retained_bytes += size;
+	}
+	entry->sent = k_uptime_get();
+	entry->message_id = message_id;
+	k_mutex_unlock(&inflight_mutex);
+
+	return message_id;
+}
+
+/* The publish couldn't be sent.  The error is returned to the producer. */
+static void inflight_cancel(uint16_t message_id)
+{
+	bool found = false;
+	size_t i;
+
+	k_mutex_lock(&inflight_mutex, K_FOREVER);
+	for (i = 0; i < ARRAY_SIZE(inflight) && !found; i++) {
+		if (inflight[i].message_id == message_id) {
+			inflight_free(&inflight[i]);
+			found = true;
+		}
+	}
+	k_mutex_unlock(&inflight_mutex);
+
+	if (found) {
+		k_sem_give(&window_sem);
+	}
+}
+
+static void inflight_ack(uint16_t message_id)
+{
+	aws_publish_callback_t callback = NULL;
+	void *context = NULL;
+	bool found = false;
+	struct inflight *entry;
+	size_t i;
+
+	k_mutex_lock(&inflight_mutex, K_FOREVER);
+	for (i = 0; i < ARRAY_SIZE(inflight) && !found; i++) {
+		entry = &inflight[i];
+		if (entry->message_id != message_id) {
+			continue;
+		}
+		found = true;
+		/* The latency of a retransmitted publish is ambiguous. */
+		if (entry->retries == 0) {
+			aws_stats.delta = k_uptime_get() - entry->sent;
+			aws_stats.delta_max =
+				MAX(aws_stats.delta_max, aws_stats.delta);
+		}
+		callback = entry->callback;
+		context = entry->context;
+		inflight_free(entry);
+	}
+	k_mutex_unlock(&inflight_mutex);
+
+	if (!found) {
+		AWS_LOG_WRN("PUBACK for unknown packet id: %u", message_id);
+		return;
+	}
+
+	AWS_LOG_ACK("PUBACK packet id: %u delta: %d", message_id,
+		    (int32_t)aws_stats.delta);
+
+	k_sem_give(&window_sem);
+	if (callback != NULL) {
+		callback(0, context);
+	}
+}
+
+/* Publishes that haven't been acknowledged in time (and all of them after a
+ * reconnect) are retransmitted with the DUP flag.  A publish that can't be
+ * retransmitted is reported to the producer as failed.
+ */
+static void inflight_service(void)
+{
+	bool retransmit_all = retransmit_inflight;
+	aws_publish_callback_t callback;
+	void *context;
+	bool abandon;
+	bool resend;
+	bool waiting;
+	struct inflight *entry;
+	struct inflight copy;
+	int64_t now = k_uptime_get();
+	size_t i;
+	int rc;
+
+	retransmit_inflight = false;
+
+	for (i = 0; i < ARRAY_SIZE(inflight); i++) {
+		callback = NULL;
+		context = NULL;
+		abandon = false;
+		resend = false;
+		k_mutex_lock(&inflight_mutex, K_FOREVER);
+		entry = &inflight[i];
+		waiting = (now - entry->sent) < PUBACK_TIMEOUT_MS;
+		if (entry->message_id == 0 || (waiting && !retransmit_all)) {
+			/* Waiting for PUBACK */
+		} else if (entry->buffer == NULL ||
+			   entry->retries >= CONFIG_AWS_PUBLISH_RETRIES) {
+			AWS_LOG_WRN("No PUBACK for packet id: %u",
+				    entry->message_id);
+			aws_stats.abandoned += 1;
+			callback = entry->callback;
+			context = entry->context;
+			inflight_free(entry);
+			abandon = true;
+		} else {
+			entry->retries += 1;
+			entry->sent = now;
+			aws_stats.retransmits += 1;
+			/* The buffer is only freed on this thread */
+			copy = *entry;
+			resend = true;
+		}
+		k_mutex_unlock(&inflight_mutex);
+
+		if (resend) {
+			rc = publish(&client_ctx, copy.message_id, true,
+				     copy.buffer + copy.topic_size, copy.length,
+				     copy.buffer, copy.binary);
+			if (rc != 0) {
+				AWS_LOG_ERR("MQTT retransmit err (%d)", rc);
+			}
+		}
+
+		if (abandon) {
+			k_sem_give(&window_sem);
+			if (callback != NULL) {
+				callback(-ETIMEDOUT, context);
+			}
+		}
+	}
+}
+
+/* Publishes that weren't retained can't be acknowledged after the
+ * connection is closed.  The rest are retransmitted after a reconnect.
+ */
+static void inflight_disconnected(void)
+{
+	aws_publish_callback_t callback;
+	void *context;
+	bool abandon;
+	struct inflight *entry;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(inflight); i++) {
+		callback = NULL;
+		context = NULL;
+		abandon = false;
+		k_mutex_lock(&inflight_mutex, K_FOREVER);
+		entry = &inflight[i];
+		if (entry->message_id != 0 && entry->buffer == NULL) {
+			aws_stats.abandoned += 1;
+			callback = entry->callback;
+			context = entry->context;
+			inflight_free(entry);
+			abandon = true;
+		} else if (entry->message_id != 0) {
+			retransmit_inflight = true;
+		}
+		k_mutex_unlock(&inflight_mutex);
+
+		if (abandon) {
+			k_sem_give(&window_sem);
+			if (callback != NULL) {
+				callback(-ENOTCONN, context);
+			}
+		}
+	}
+}
+
+/* The mutex must be held.  The caller returns the slot to the window. */
+static void inflight_free(struct inflight *entry)
+{
+	if (entry->buffer != NULL) {
+		k_free(entry->buffer);
+		retained_bytes -= (entry->topic_size + entry->length);
+	}
+	memset(entry, 0, sizeof(struct inflight));
+}
+
+/* Message ID of zero is reserved as invalid.  The ID of a publish that is
+ * waiting for PUBACK isn't reused.  The mutex must be held.
+ */
+static uint16_t message_id_get(void)
+{
+	bool used;
+	size_t i;
+
+	do {
+		last_message_id += 1;
+		used = (last_message_id == 0);
+		for (i = 0; i < ARRAY_SIZE(inflight) && !used; i++) {
+			used = (inflight[i].message_id == last_message_id);
+		}
+	} while (used);
+
+	return last_message_id;
+}
+
+/* The receive thread processes PUBACKs and the system workqueue must not be
+ * stalled, so neither waits for a free slot.
+ */
+static k_timeout_t window_timeout(void)
+{
+	k_tid_t thread = k_current_get();
+
+	if (thread == &rxThread || thread == &k_sys_work_q.thread) {
+		return K_NO_WAIT;
+	}
+
+	return WINDOW_TIMEOUT;
+}
+
+#ifdef CONFIG_AWS_PUBLISH_COMPRESSION
+/* AWS reserved topics (shadows) only accept JSON.  The payload is only
+ * replaced if compression makes it smaller.
+ *
+ * @retval buffer that must be freed after publishing, NULL if the payload
+ * wasn't compressed
+ */
+static uint8_t *compress_payload(char **data, uint32_t *len, uint8_t *topic)
+{
+	uint8_t *buf;
+	int n;
+
+	if (*len < CONFIG_AWS_PUBLISH_COMPRESSION_THRESHOLD) {
+		return NULL;
+	}
+
+	if (strncmp((char *)topic, AWS_RESERVED_TOPIC_PREFIX,
+		    strlen(AWS_RESERVED_TOPIC_PREFIX)) == 0) {
+		return NULL;
+	}
+
+	buf = k_malloc(*len);
+	if (buf == NULL) {
+		return NULL;
+	}
+
+	n = lcz_lzss_compress((uint8_t *)*data, *len, buf, *len);
+	if (n < 0) {
+		k_free(buf);
+		return NULL;
+	}
+
+	*data = (char *)buf;
+	*len = n;
+	return buf;
+}
+#endif
+
 #ifdef CONFIG_NET_L2_ETHERNET
 /* Function taken from net_private.h
  * Copyright (c) 2016 Intel Corporation
@@ -0,0 +1,61 @@
+/**
+ * @file aws_shell.c
+ * @brief
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <shell/shell.h>
+#include <init.h>
+
+#include "aws.h"
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static int shell_aws_stats_cmd(const struct shell *shell, size_t argc,
+			       char **argv)
+{
+	struct aws_stats stats;
+
+	awsGetStats(&stats);
+
+	shell_print(shell, "connected: %s", awsConnected() ? "yes" : "no");
+	shell_print(shell, "disconnects: %u", stats.disconnects);
+	shell_print(shell, "consecutive connection failures: %u",
+		    stats.consecutive_connection_failures);
+	shell_print(shell, "sends: %u", stats.sends);
+	shell_print(shell, "success: %u", stats.success);
+	shell_print(shell, "failure: %u", stats.failure);
+	shell_print(shell, "consecutive failures: %u", stats.consecutive_fails);
+	shell_print(shell, "acks: %u", stats.acks);
+	shell_print(shell, "retransmits: %u", stats.retransmits);
+	shell_print(shell, "abandoned: %u", stats.abandoned);
+	shell_print(shell, "window full: %u", stats.window_full);
+	shell_print(shell, "puback delta (ms): %u", (uint32_t)stats.delta);
+	shell_print(shell, "puback max delta (ms): %u",
+		    (uint32_t)stats.delta_max);
+	shell_print(shell, "tx payload bytes: %u", stats.tx_payload_bytes);
+	shell_print(shell, "rx payload bytes: %u", stats.rx_payload_bytes);
+	shell_print(shell, "rx dropped: %u", stats.rx_dropped);
+
+	return 0;
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+SHELL_STATIC_SUBCMD_SET_CREATE(
+	aws_cmds,
+	SHELL_CMD(stats, NULL, "Publish and PUBACK statistics",
+		  shell_aws_stats_cmd),
+	SHELL_SUBCMD_SET_END /* Array terminated. */
+);
+
+SHELL_CMD_REGISTER(aws, &aws_cmds, "AWS commands", NULL);
@@ -16,6 +16,7 @@ LOG_MODULE_REGISTER(jsmn, CONFIG_JSMN_LOG_LEVEL);
 #include <kernel.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <ctype.h>
 #include <string.h>
 
 #define JSMN_PARENT_LINKS
@@ -31,207 +32,592 @@ LOG_MODULE_REGISTER(jsmn, CONFIG_JSMN_LOG_LEVEL);
 
 #define ASSERT_BAD_INDEX() __ASSERT(false, "Invalid Index")
 
-const char EMPTY_STRING[] = "";
+#define EMPTY_KEY_SLOT 0
+#define PATH_SEPARATOR '.'
 
-/******************************************************************************/
-/* Global Data Definitions                                                    */
-/******************************************************************************/
-K_MUTEX_DEFINE(jsmn_mutex);
+#define FNV_OFFSET_BASIS 2166136261U
+#define FNV_PRIME 16777619U
 
-/******************************************************************************/
-/* Local Data Definitions                                                     */
-/******************************************************************************/
-struct jsmn {
-	jsmn_parser parser;
-	jsmntok_t tokens[CONFIG_JSMN_NUMBER_OF_TOKENS];
-	int tokens_found;
-	int next_parent;
-	int index;
-	int saved_index;
-	int saved_parent;
-	const char *json;
+#define MAX_SKIP_DEPTH 32
+
+/* Finds members to skip.  It only tracks enough structure to find keys. */
+struct scan {
+	size_t pos;
+	size_t length;
+	uint32_t objects;
+	uint8_t depth;
+	bool expect_key;
 };
 
-static struct jsmn jsmn;
+const char EMPTY_STRING[] = "";
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int parse(jsmn_json_t *jsmn);
+static bool find_skip(jsmn_json_t *jsmn, struct scan *scan,
+		      size_t *skip_start);
+static bool skip_key(jsmn_json_t *jsmn, struct scan *scan, size_t start);
+static size_t end_of_string(const char *js, size_t pos, size_t length);
+static size_t end_of_value(const char *js, size_t pos, size_t length);
+static bool is_object_key(jsmn_json_t *jsmn, int i);
+static void build_key_index(jsmn_json_t *jsmn);
+static void free_key_index(jsmn_json_t *jsmn);
+static uint32_t key_hash(int parent, const char *s, size_t length);
+static bool key_match(jsmn_json_t *jsmn, int i, const char *s, size_t length,
+		      jsmntype_t type);
+static int find_key(jsmn_json_t *jsmn, int parent, int start, const char *s,
+		    size_t length, jsmntype_t type);
+static int scan_for_key(jsmn_json_t *jsmn, int start, const char *s,
+			size_t length, jsmntype_t type,
+			parent_type_t parent_type);
+static int find(jsmn_json_t *jsmn, const char *s, size_t length,
+		jsmntype_t type, parent_type_t parent_type);
 
 /******************************************************************************/
 /* Global Function Definitions                                                */
 /******************************************************************************/
-void jsmn_start(const char *p)
+void jsmn_start(jsmn_json_t *jsmn, const char *p)
 {
-	k_mutex_lock(&jsmn_mutex, K_FOREVER);
+	jsmn_init(&jsmn->parser);
+	free_key_index(jsmn);
 
-	jsmn_init(&jsmn.parser);
+	jsmn->json = p;
+	jsmn->tokens_found = parse(jsmn);
 
-	/* Strip off metadata from AWS because it is too much to process. */
-	/* This assumes order to the JSON ... */
-	char *ignore = strstr(p, ",\"metadata\":");
-	if (ignore != NULL) {
-		*ignore = '}';
-		*(ignore + 1) = 0;
-	}
-
-	jsmn.json = p;
-	jsmn.tokens_found =
-		jsmn_parse(&jsmn.parser, jsmn.json, strlen(jsmn.json),
-			   jsmn.tokens, CONFIG_JSMN_NUMBER_OF_TOKENS);
-
-	if (jsmn.tokens_found < 0) {
-		LOG_ERR("jsmn status: %d", jsmn.tokens_found);
+	if (jsmn->tokens_found < 0) {
+		LOG_ERR("jsmn status: %d", jsmn->tokens_found);
 	} else {
-		LOG_DBG("jsmn jsmn.tokens required: %d", jsmn.tokens_found);
+		LOG_DBG("jsmn tokens required: %d", jsmn->tokens_found);
+		build_key_index(jsmn);
 	}
 
-	(void)jsmn_reset_index();
+	(void)jsmn_reset_index(jsmn);
 }
 
-void jsmn_end(void)
+void jsmn_end(jsmn_json_t *jsmn)
 {
-	jsmn.json = "";
-	k_mutex_unlock(&jsmn_mutex);
+	jsmn->json = "";
+	free_key_index(jsmn);
 }
 
-/* Check that there were enough jsmn.tokens to parse string.
+/* Check that there were enough tokens to parse string.
  * After parsing the first thing should be the JSON object { }.
  */
-bool jsmn_valid(void)
+bool jsmn_valid(jsmn_json_t *jsmn)
+{
+	return ((jsmn->tokens_found > 0) &&
+		(jsmn->tokens[0].type == JSMN_OBJECT));
+}
+
+int jsmn_tokens_found(jsmn_json_t *jsmn)
 {
-	return ((jsmn.tokens_found > 0) &&
-		(jsmn.tokens[0].type == JSMN_OBJECT));
+	return jsmn->tokens_found;
 }
 
-int jsmn_tokens_found(void)
+int jsmn_find_type(jsmn_json_t *jsmn, const char *s, jsmntype_t type,
+		   parent_type_t parent_type)
 {
-	return jsmn.tokens_found;
+	return find(jsmn, s, strlen(s), type, parent_type);
 }
 
-int jsmn_find_type(const char *s, jsmntype_t type, parent_type_t parent_type)
+int jsmn_find_path(jsmn_json_t *jsmn, const char *path, jsmntype_t type)
 {
+	const char *s = path;
+	const char *end;
 	int location = 0;
-	if (jsmn.index == 0) {
-		return location;
-	}
-
-	/* Analyze a pair of jsmn.tokens of the form <string>, <type> */
-	size_t i = jsmn.index;
-	jsmn.index = 0;
-	for (; ((i + 1) < jsmn.tokens_found); i++) {
-		int length = jsmn.tokens[i].end - jsmn.tokens[i].start;
-		if ((jsmn.tokens[i].type == JSMN_STRING) &&
-		    ((int)strlen(s) == length) &&
-		    (strncmp(jsmn.json + jsmn.tokens[i].start, s, length) ==
-		     0) &&
-		    (jsmn.tokens[i + 1].type == type) &&
-		    ((parent_type == NO_PARENT) ||
-		     (jsmn.tokens[i].parent == jsmn.next_parent))) {
-			LOG_DBG("Found '%s' at index %d with parent %d", s, i,
-				jsmn.tokens[i].parent);
-			jsmn.next_parent = i + 1;
-			jsmn.index = i + 2;
-			break;
+
+	do {
+		end = strchr(s, PATH_SEPARATOR);
+		if (end == NULL) {
+			location = find(jsmn, s, strlen(s), type, NEXT_PARENT);
+		} else {
+			location = find(jsmn, s, end - s, JSMN_OBJECT,
+					NEXT_PARENT);
+			s = end + 1;
 		}
-	}
-	location = jsmn.index - 2 + 1; /* location of the data */
+	} while (end != NULL && location > 0);
+
 	return location;
 }
 
-int jsmn_index(void)
+int jsmn_index(jsmn_json_t *jsmn)
 {
-	return jsmn.index;
+	return jsmn->index;
 }
 
-void jsmn_reset_index(void)
+void jsmn_reset_index(jsmn_json_t *jsmn)
 {
-	jsmn.index = 1;
-	jsmn.next_parent = 0;
+	jsmn->index = 1;
+	jsmn->next_parent = 0;
 }
 
-void jsmn_save_index(void)
+void jsmn_save_index(jsmn_json_t *jsmn)
 {
-	jsmn.saved_index = jsmn.index;
-	jsmn.saved_parent = jsmn.next_parent;
+	jsmn->saved_index = jsmn->index;
+	jsmn->saved_parent = jsmn->next_parent;
 }
 
-void jsmn_restore_index(void)
+void jsmn_restore_index(jsmn_json_t *jsmn)
 {
-	jsmn.index = jsmn.saved_index;
-	jsmn.next_parent = jsmn.saved_parent;
+	jsmn->index = jsmn->saved_index;
+	jsmn->next_parent = jsmn->saved_parent;
+}
+
+bool jsmn_peek_uint(const char *p, const char *key, uint32_t *pValue)
+{
+	const jsmn_json_skip_t member = { key, 1 };
+	jsmn_json_t jsmn = { .json = p, .skip = &member, .skip_count = 1 };
+	struct scan scan = { .length = strlen(p) };
+	char str[MAX_DEC_CONVERSION_STR_SIZE];
+	size_t start;
+	size_t length;
+
+	if (!find_skip(&jsmn, &scan, &start)) {
+		return false;
+	}
+
+	/* The scan position is at the end of the value. */
+	start = end_of_string(p, start, scan.length);
+	while ((start < scan.pos) &&
+	       (p[start] == ':' || isspace((int)p[start]))) {
+		start += 1;
+	}
+
+	length = scan.pos - start;
+	if (length == 0 || length >= sizeof(str) || !isdigit((int)p[start])) {
+		return false;
+	}
+
+	memcpy(str, &p[start], length);
+	str[length] = 0;
+	*pValue = MIN(UINT32_MAX, strtoul(str, NULL, 10));
+	return true;
 }
 
-uint32_t jsmn_convert_uint(int index)
+uint32_t jsmn_convert_uint(jsmn_json_t *jsmn, int index)
 {
-	if (index > jsmn.tokens_found) {
+	if (index > jsmn->tokens_found) {
 		ASSERT_BAD_INDEX();
 		return 0;
 	}
 
 	/* Pieces of the JSON message are not null terminated. */
 	char str[MAX_DEC_CONVERSION_STR_SIZE];
-	size_t length = jsmn_strlen(index);
+	size_t length = jsmn_strlen(jsmn, index);
 	if (length < sizeof(str)) {
 		memset(str, 0, sizeof(str));
-		memcpy(str, jsmn_string(index), length);
+		memcpy(str, jsmn_string(jsmn, index), length);
 		return MIN(UINT32_MAX, strtoul(str, NULL, 10));
 	} else {
 		return 0;
 	}
 }
 
-uint32_t jsmn_convert_hex(int index)
+uint32_t jsmn_convert_hex(jsmn_json_t *jsmn, int index)
 {
-	if (index > jsmn.tokens_found) {
+	if (index > jsmn->tokens_found) {
 		ASSERT_BAD_INDEX();
 		return 0;
 	}
 
 	char str[MAX_HEX_CONVERSION_STR_SIZE];
-	size_t length = jsmn_strlen(index);
+	size_t length = jsmn_strlen(jsmn, index);
 	if (length < sizeof(str)) {
 		memset(str, 0, sizeof(str));
-		memcpy(str, jsmn_string(index), length);
+		memcpy(str, jsmn_string(jsmn, index), length);
 		return strtoul(str, NULL, 16);
 	} else {
 		return 0;
 	}
 }
 
-jsmntype_t jsmn_type(int index)
+jsmntype_t jsmn_type(jsmn_json_t *jsmn, int index)
 {
-	if (index > jsmn.tokens_found) {
+	if (index > jsmn->tokens_found) {
 		ASSERT_BAD_INDEX();
 		return JSMN_UNDEFINED;
 	}
 
-	return jsmn.tokens[index].type;
+	return jsmn->tokens[index].type;
 }
 
-int jsmn_size(int index)
+int jsmn_size(jsmn_json_t *jsmn, int index)
 {
-	if (index > jsmn.tokens_found) {
+	if (index > jsmn->tokens_found) {
 		ASSERT_BAD_INDEX();
 		return 0;
 	}
 
-	return jsmn.tokens[index].size;
+	return jsmn->tokens[index].size;
 }
 
-int jsmn_strlen(int index)
+int jsmn_strlen(jsmn_json_t *jsmn, int index)
 {
-	if (index > jsmn.tokens_found) {
+	if (index > jsmn->tokens_found) {
 		ASSERT_BAD_INDEX();
 		return 0;
 	}
 
-	jsmntok_t *tok = &jsmn.tokens[index];
+	jsmntok_t *tok = &jsmn->tokens[index];
 	return (tok->end - tok->start);
 }
 
-const char *jsmn_string(int index)
+const char *jsmn_string(jsmn_json_t *jsmn, int index)
 {
-	if (index > jsmn.tokens_found) {
+	if (index > jsmn->tokens_found) {
 		ASSERT_BAD_INDEX();
 		return EMPTY_STRING;
 	}
 
-	return &jsmn.json[jsmn.tokens[index].start];
+	return &jsmn->json[jsmn->tokens[index].start];
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/* The jsmn parser can be resumed.  It is run up to the start of each
+ * member that is skipped and then moved past the member's value.
+ * jsmn doesn't check commas, so the one that is left behind is ignored.
+ */
+static int parse(jsmn_json_t *jsmn)
+{
+	struct scan scan = { .length = strlen(jsmn->json) };
+	size_t skip_start;
+	int r;
+
+	while (find_skip(jsmn, &scan, &skip_start)) {
+		r = jsmn_parse(&jsmn->parser, jsmn->json, skip_start,
+			       jsmn->tokens, jsmn->max_tokens);
+		if (r < 0 && r != JSMN_ERROR_PART) {
+			return r;
+		}
+		jsmn->parser.pos = scan.pos;
+	}
+
+	return jsmn_parse(&jsmn->parser, jsmn->json, scan.length,
+			  jsmn->tokens, jsmn->max_tokens);
+}
+
+/* When a member is found, skip_start is set to the start of the key and the
+ * scan position is set to the end of the value.
+ */
+static bool find_skip(jsmn_json_t *jsmn, struct scan *scan,
+		      size_t *skip_start)
+{
+	const char *js = jsmn->json;
+	size_t start;
+	char c;
+
+	if (jsmn->skip_count == 0) {
+		return false;
+	}
+
+	while (scan->pos < scan->length) {
+		c = js[scan->pos];
+		switch (c) {
+		case '"':
+			start = scan->pos;
+			scan->pos = end_of_string(js, scan->pos, scan->length);
+			if (skip_key(jsmn, scan, start)) {
+				*skip_start = start;
+				scan->pos = end_of_value(js, scan->pos,
+							 scan->length);
+				scan->expect_key = false;
+				return true;
+			}
+			break;
+
+		case '{':
+		case '[':
+			if (scan->depth >= MAX_SKIP_DEPTH) {
+				return false;
+			}
+			WRITE_BIT(scan->objects, scan->depth, c == '{');
+			scan->depth += 1;
+			scan->expect_key = (c == '{');
+			scan->pos += 1;
+			break;
+
+		case '}':
+		case ']':
+			if (scan->depth > 0) {
+				scan->depth -= 1;
+			}
+			scan->expect_key = false;
+			scan->pos += 1;
+			break;
+
+		case ',':
+			scan->expect_key =
+				(scan->depth > 0) &&
+				(scan->objects & BIT(scan->depth - 1));
+			scan->pos += 1;
+			break;
+
+		case ':':
+			scan->expect_key = false;
+			scan->pos += 1;
+			break;
+
+		default:
+			scan->pos += 1;
+			break;
+		}
+	}
+
+	return false;
+}
+
+/* The scan position is after the string at start. */
+static bool skip_key(jsmn_json_t *jsmn, struct scan *scan, size_t start)
+{
+	const char *key = &jsmn->json[start + 1];
+	size_t length = scan->pos - start - 2;
+	const jsmn_json_skip_t *skip;
+	size_t i;
+
+	if (!scan->expect_key) {
+		return false;
+	}
+
+	for (i = 0; i < jsmn->skip_count; i++) {
+		skip = &jsmn->skip[i];
+		if ((skip->depth == 0 || skip->depth == scan->depth) &&
+		    (strlen(skip->key) == length) &&
+		    (memcmp(skip->key, key, length) == 0)) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/* @retval position after the closing quote */
+static size_t end_of_string(const char *js, size_t pos, size_t length)
+{
+	for (pos += 1; pos < length; pos++) {
+		if (js[pos] == '\\') {
+			pos += 1;
+		} else if (js[pos] == '"') {
+			return pos + 1;
+		}
+	}
+	return length;
+}
+
+/* @retval position after the value that follows the ':' at or after pos */
+static size_t end_of_value(const char *js, size_t pos, size_t length)
+{
+	size_t nesting = 0;
+
+	while (pos < length && (js[pos] == ':' || isspace((int)js[pos]))) {
+		pos += 1;
+	}
+
+	while (pos < length) {
+		switch (js[pos]) {
+		case '"':
+			pos = end_of_string(js, pos, length);
+			if (nesting == 0) {
+				return pos;
+			}
+			continue;
+
+		case '{':
+		case '[':
+			nesting += 1;
+			break;
+
+		case '}':
+		case ']':
+			if (nesting == 0) {
+				return pos;
+			}
+			nesting -= 1;
+			if (nesting == 0) {
+				return pos + 1;
+			}
+			break;
+
+		case ',':
+			if (nesting == 0) {
+				return pos;
+			}
+			break;
+
+		default:
+			if (nesting == 0 && isspace((int)js[pos])) {
+				return pos;
+			}
+			break;
+		}
+		pos += 1;
+	}
+
+	return length;
+}
+
+static bool is_object_key(jsmn_json_t *jsmn, int i)
+{
+	jsmntok_t *tok = &jsmn->tokens[i];
+
+	return ((tok->type == JSMN_STRING) && (tok->parent >= 0) &&
+		(jsmn->tokens[tok->parent].type == JSMN_OBJECT));
+}
+
+/* Keys are indexed by their object and name.  The value of a key is the
+ * token after it.  The index is sized for the document; when it can't be
+ * allocated keys are found with a linear search.
+ */
+static void build_key_index(jsmn_json_t *jsmn)
+{
+	jsmntok_t *tok;
+	uint32_t slot;
+	int keys = 0;
+	int i;
+
+	if (!jsmn->index_keys) {
+		return;
+	}
+
+	for (i = 1; (i + 1) < jsmn->tokens_found; i++) {
+		if (is_object_key(jsmn, i)) {
+			keys += 1;
+		}
+	}
+
+	if (keys == 0) {
+		return;
+	}
+
+	jsmn->keys = k_malloc(2 * keys * sizeof(jsmn->keys[0]));
+	if (jsmn->keys == NULL) {
+		LOG_WRN("Unable to allocate key index");
+		return;
+	}
+	jsmn->key_slots = 2 * keys;
+
+	memset(jsmn->keys, EMPTY_KEY_SLOT,
+	       jsmn->key_slots * sizeof(jsmn->keys[0]));
+
+	for (i = 1; (i + 1) < jsmn->tokens_found; i++) {
+		if (!is_object_key(jsmn, i)) {
+			continue;
+		}
+
+		tok = &jsmn->tokens[i];
+		slot = key_hash(tok->parent, jsmn->json + tok->start,
+				tok->end - tok->start) %
+		       jsmn->key_slots;
+		while (jsmn->keys[slot] != EMPTY_KEY_SLOT) {
+			slot = (slot + 1) % jsmn->key_slots;
+		}
+		jsmn->keys[slot] = i;
+	}
+}
+
+static void free_key_index(jsmn_json_t *jsmn)
+{
+	k_free(jsmn->keys);
+	jsmn->keys = NULL;
+	jsmn->key_slots = 0;
+}
+
+/* FNV-1a of the parent index followed by the name */
+static uint32_t key_hash(int parent, const char *s, size_t length)
+{
+	uint32_t hash = FNV_OFFSET_BASIS;
+	size_t i;
+
+	for (i = 0; i < sizeof(parent); i++) {
+		hash = (hash ^ ((parent >> (i * 8)) & 0xFF)) * FNV_PRIME;
+	}
+	for (i = 0; i < length; i++) {
+		hash = (hash ^ (uint8_t)s[i]) * FNV_PRIME;
+	}
+	return hash;
+}
+
+/* Check for a pair of tokens of the form <string>, <type> */
+static bool key_match(jsmn_json_t *jsmn, int i, const char *s, size_t length,
+		      jsmntype_t type)
+{
+	jsmntok_t *tok = &jsmn->tokens[i];
+
+	return ((tok->type == JSMN_STRING) &&
+		((size_t)(tok->end - tok->start) == length) &&
+		(strncmp(jsmn->json + tok->start, s, length) == 0) &&
+		(jsmn->tokens[i + 1].type == type));
+}
+
+/* Duplicate keys are allowed.  The first one at or after start is used
+ * (the same one a linear search would find).
+ */
+static int find_key(jsmn_json_t *jsmn, int parent, int start, const char *s,
+		    size_t length, jsmntype_t type)
+{
+	uint32_t slot = key_hash(parent, s, length) % jsmn->key_slots;
+	int found = 0;
+	int i;
+
+	while ((i = jsmn->keys[slot]) != EMPTY_KEY_SLOT) {
+		if ((i >= start) && ((found == 0) || (i < found)) &&
+		    (jsmn->tokens[i].parent == parent) &&
+		    key_match(jsmn, i, s, length, type)) {
+			found = i;
+		}
+		slot = (slot + 1) % jsmn->key_slots;
+	}
+
+	return found;
+}
+
+static int scan_for_key(jsmn_json_t *jsmn, int start, const char *s,
+			size_t length, jsmntype_t type,
+			parent_type_t parent_type)
+{
+	int i;
+
+	for (i = start; ((i + 1) < jsmn->tokens_found); i++) {
+		if (key_match(jsmn, i, s, length, type) &&
+		    ((parent_type == NO_PARENT) ||
+		     (jsmn->tokens[i].parent == jsmn->next_parent))) {
+			return i;
+		}
+	}
+
+	return 0;
+}
+
+/* This function updates the index to the token after the value when
+ * a key is found.  Otherwise, the index is set to zero.
+ */
+static int find(jsmn_json_t *jsmn, const char *s, size_t length,
+		jsmntype_t type, parent_type_t parent_type)
+{
+	int start = jsmn->index;
+	int i;
+
+	if (start == 0) {
+		return 0;
+	}
+
+	if ((parent_type == NEXT_PARENT) && (jsmn->key_slots > 0) &&
+	    (jsmn->tokens[jsmn->next_parent].type == JSMN_OBJECT)) {
+		i = find_key(jsmn, jsmn->next_parent, start, s, length, type);
+	} else {
+		i = scan_for_key(jsmn, start, s, length, type, parent_type);
+	}
+
+	if (i > 0) {
+		LOG_DBG("Found key at index %d with parent %d", i,
+			jsmn->tokens[i].parent);
+		jsmn->next_parent = i + 1;
+		jsmn->index = i + 2;
+	} else {
+		jsmn->index = 0;
+	}
+
+	return jsmn->index - 2 + 1; /* location of the data */
 }
@@ -0,0 +1,261 @@
+/**
+ * @file lcz_json_filter.c
+ * @brief Remove members from a JSON document while it is being received.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <logging/log.h>
+LOG_MODULE_REGISTER(lcz_json_filter, CONFIG_LCZ_JSON_FILTER_LOG_LEVEL);
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <string.h>
+#include <errno.h>
+
+#include "lcz_json_filter.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+BUILD_ASSERT(LCZ_JSON_FILTER_MAX_DEPTH <= 32,
+	     "Object flags don't fit in a word");
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static void filter_char(struct lcz_json_filter *filter, char c);
+static bool skip_char(struct lcz_json_filter *filter, char c);
+static void open_container(struct lcz_json_filter *filter, char c);
+static void end_of_key(struct lcz_json_filter *filter);
+static bool in_object(struct lcz_json_filter *filter);
+static void emit(struct lcz_json_filter *filter, char c);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+void lcz_json_filter_init(struct lcz_json_filter *filter, char *dst,
+			  size_t size, const struct lcz_json_filter_rule *rules,
+			  size_t rule_count)
+{
+	memset(filter, 0, sizeof(struct lcz_json_filter));
+	filter->rules = rules;
+	filter->rule_count = rule_count;
+	filter->dst = dst;
+	filter->size = size;
+	if (dst == NULL || size == 0) {
+		filter->status = -ENOMEM;
+	}
+}
+
+int lcz_json_filter_write(struct lcz_json_filter *filter, const char *src,
+			  size_t len)
+{
+	size_t i;
+
+	for (i = 0; i < len && filter->status == 0; i++) {
+		filter_char(filter, src[i]);
+	}
+
+	return filter->status;
+}
+
+int lcz_json_filter_finish(struct lcz_json_filter *filter)
+{
+	if (filter->status != 0) {
+		LOG_DBG("Filter error %d", filter->status);
+		return filter->status;
+	}
+
+	filter->dst[filter->length] = 0;
+	return (int)filter->length;
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static void filter_char(struct lcz_json_filter *filter, char c)
+{
+	/* The character that ends a removed value is processed normally. */
+	if (filter->skipping && !skip_char(filter, c)) {
+		return;
+	}
+
+	if (filter->in_string) {
+		emit(filter, c);
+		if (filter->escape) {
+			filter->escape = false;
+		} else if (c == '\\') {
+			filter->escape = true;
+		} else if (c == '"') {
+			filter->in_string = false;
+			if (filter->is_key) {
+				end_of_key(filter);
+			}
+		}
+		return;
+	}
+
+	switch (c) {
+	case ' ':
+	case '\t':
+	case '\r':
+	case '\n':
+		break;
+
+	case '"':
+		filter->is_key = in_object(filter) && filter->expect_key;
+		filter->key_start = filter->length;
+		filter->in_string = true;
+		emit(filter, c);
+		break;
+
+	case '{':
+	case '[':
+		open_container(filter, c);
+		break;
+
+	case '}':
+	case ']':
+		emit(filter, c);
+		if (filter->depth > 0) {
+			filter->depth -= 1;
+		}
+		filter->expect_key = false;
+		filter->drop_comma = false;
+		break;
+
+	case ',':
+		/* A removed first member takes the following comma with it. */
+		filter->member_start = filter->length;
+		filter->member_comma = !filter->drop_comma;
+		if (filter->drop_comma) {
+			filter->drop_comma = false;
+		} else {
+			emit(filter, c);
+		}
+		filter->expect_key = in_object(filter);
+		break;
+
+	case ':':
+		filter->expect_key = false;
+		emit(filter, c);
+		break;
+
+	default:
+		emit(filter, c);
+		break;
+	}
+}
+
+/* Removed values are tracked only enough to find where they end. */
+static bool skip_char(struct lcz_json_filter *filter, char c)
+{
+	if (filter->in_string) {
+		if (filter->escape) {
+			filter->escape = false;
+		} else if (c == '\\') {
+			filter->escape = true;
+		} else if (c == '"') {
+			filter->in_string = false;
+		}
+		return false;
+	}
+
+	switch (c) {
+	case '"':
+		filter->in_string = true;
+		return false;
+
+	case '{':
+	case '[':
+		filter->skip_nesting += 1;
+		return false;
+
+	case '}':
+	case ']':
+		if (filter->skip_nesting > 0) {
+			filter->skip_nesting -= 1;
+			return false;
+		}
+		break;
+
+	case ',':
+		if (filter->skip_nesting > 0) {
+			return false;
+		}
+		break;
+
+	default:
+		return false;
+	}
+
+	filter->skipping = false;
+	return true;
+}
+
+static void open_container(struct lcz_json_filter *filter, char c)
+{
+	if (filter->depth >= LCZ_JSON_FILTER_MAX_DEPTH) {
+		LOG_ERR("JSON nested too deeply");
+		filter->status = -EINVAL;
+		return;
+	}
+
+	emit(filter, c);
+	if (c == '{') {
+		filter->objects |= BIT(filter->depth);
+	} else {
+		filter->objects &= ~BIT(filter->depth);
+	}
+	filter->depth += 1;
+	filter->expect_key = (c == '{');
+	filter->member_start = filter->length;
+	filter->member_comma = false;
+	filter->drop_comma = false;
+}
+
+static void end_of_key(struct lcz_json_filter *filter)
+{
+	/* The key has been written to the output (without the quotes). */
+	const char *key = &filter->dst[filter->key_start + 1];
+	size_t length = filter->length - filter->key_start - 2;
+	const struct lcz_json_filter_rule *rule;
+	size_t i;
+
+	if (filter->status != 0) {
+		return;
+	}
+
+	for (i = 0; i < filter->rule_count; i++) {
+		rule = &filter->rules[i];
+		if ((rule->depth == 0 || rule->depth == filter->depth) &&
+		    strlen(rule->key) == length &&
+		    memcmp(rule->key, key, length) == 0) {
+			filter->length = filter->member_start;
+			filter->skipping = true;
+			filter->skip_nesting = 0;
+			filter->drop_comma = !filter->member_comma;
+			break;
+		}
+	}
+}
+
+static bool in_object(struct lcz_json_filter *filter)
+{
+	return (filter->depth > 0) &&
+	       ((filter->objects & BIT(filter->depth - 1)) != 0);
+}
+
+static void emit(struct lcz_json_filter *filter, char c)
+{
+	/* Leave room for the terminator */
+	if ((filter->length + 1) < filter->size) {
+		filter->dst[filter->length++] = c;
+	} else {
+		filter->status = -ENOMEM;
+	}
+}
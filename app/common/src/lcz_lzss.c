@@ -0,0 +1,245 @@
+/**
+ * @file lcz_lzss.c
+ * @brief LZSS compression of publish payloads.
+ *
+ * The whole payload is in memory so the window is the input itself and the
+ * compressor doesn't need any RAM of its own.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <logging/log.h>
+LOG_MODULE_REGISTER(lcz_lzss, CONFIG_LCZ_LZSS_LOG_LEVEL);
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/byteorder.h>
+
+#include "lcz_lzss.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+BUILD_ASSERT(CONFIG_LCZ_LZSS_WINDOW_SIZE <= LCZ_LZSS_MAX_DISTANCE,
+	     "Window is larger than the distance that can be encoded");
+
+#define REFERENCE_SIZE 2
+#define FLAGS_PER_GROUP 8
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static struct lcz_lzss_stats lzss_stats;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static size_t find_match(const uint8_t *src, size_t src_len, size_t pos,
+			 size_t *distance);
+static void update_stats(size_t src_len, int r, uint32_t start);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int lcz_lzss_compress(const uint8_t *src, size_t src_len, uint8_t *dst,
+		      size_t dst_size)
+{
+	uint32_t start = k_cycle_get_32();
+	uint8_t *flags = NULL;
+	uint8_t flag_count = FLAGS_PER_GROUP;
+	size_t out = LCZ_LZSS_HEADER_SIZE;
+	size_t pos = 0;
+	size_t length;
+	size_t distance;
+	int r = -ENOSPC;
+
+	if (src == NULL || dst == NULL || src_len > UINT32_MAX) {
+		return -EINVAL;
+	}
+
+	if (dst_size <= LCZ_LZSS_HEADER_SIZE) {
+		update_stats(src_len, r, start);
+		return r;
+	}
+
+	dst[0] = LCZ_LZSS_MAGIC0;
+	dst[1] = LCZ_LZSS_MAGIC1;
+	dst[2] = LCZ_LZSS_VERSION;
+	sys_put_be32((uint32_t)src_len, &dst[3]);
+
+	while (pos < src_len) {
+		if (flag_count == FLAGS_PER_GROUP) {
+			if (out >= dst_size) {
+				break;
+			}
+			flags = &dst[out++];
+			*flags = 0;
+			flag_count = 0;
+		}
+
+		length = find_match(src, src_len, pos, &distance);
+		if (length >= LCZ_LZSS_MIN_MATCH) {
+			if ((out + REFERENCE_SIZE) > dst_size) {
+				break;
+			}
+			distance -= 1;
+			dst[out++] = (uint8_t)(distance >> 4);
+			dst[out++] = (uint8_t)(((distance & 0xF) << 4) |
+					       (length - LCZ_LZSS_MIN_MATCH));
+			pos += length;
+		} else {
+			if (out >= dst_size) {
+				break;
+			}
+			*flags |= BIT(flag_count);
+			dst[out++] = src[pos++];
+		}
+		flag_count += 1;
+	}
+
+	if (pos == src_len && out < dst_size) {
+		r = (int)out;
+	}
+
+	update_stats(src_len, r, start);
+	return r;
+}
+
+#ifdef CONFIG_LCZ_LZSS_DECOMPRESS
+int lcz_lzss_decompress(const uint8_t *src, size_t src_len, uint8_t *dst,
+			size_t dst_size)
+{
+	uint8_t flags = 0;
+	uint8_t flag_count = FLAGS_PER_GROUP;
+	size_t in = LCZ_LZSS_HEADER_SIZE;
+	size_t out = 0;
+	size_t expected;
+	size_t distance;
+	size_t length;
+
+	if (!lcz_lzss_is_compressed(src, src_len) ||
+	    src[2] != LCZ_LZSS_VERSION) {
+		return -EINVAL;
+	}
+
+	expected = sys_get_be32(&src[3]);
+	if (expected > dst_size) {
+		return -ENOSPC;
+	}
+
+	while (out < expected) {
+		if (flag_count == FLAGS_PER_GROUP) {
+			if (in >= src_len) {
+				return -EINVAL;
+			}
+			flags = src[in++];
+			flag_count = 0;
+		}
+
+		if (flags & BIT(flag_count)) {
+			if (in >= src_len) {
+				return -EINVAL;
+			}
+			dst[out++] = src[in++];
+		} else {
+			if ((in + REFERENCE_SIZE) > src_len) {
+				return -EINVAL;
+			}
+			distance = ((size_t)src[in] << 4) + (src[in + 1] >> 4) +
+				   1;
+			length = (src[in + 1] & 0xF) + LCZ_LZSS_MIN_MATCH;
+			in += REFERENCE_SIZE;
+			if (distance > out || (out + length) > expected) {
+				return -EINVAL;
+			}
+			/* The reference can overlap the output. */
+			while (length--) {
+				dst[out] = dst[out - distance];
+				out += 1;
+			}
+		}
+		flag_count += 1;
+	}
+
+	return (int)out;
+}
+#endif
+
+bool lcz_lzss_is_compressed(const uint8_t *src, size_t src_len)
+{
+	return (src != NULL && src_len >= LCZ_LZSS_HEADER_SIZE &&
+		src[0] == LCZ_LZSS_MAGIC0 && src[1] == LCZ_LZSS_MAGIC1);
+}
+
+void lcz_lzss_get_stats(struct lcz_lzss_stats *stats)
+{
+	if (stats != NULL) {
+		memcpy(stats, &lzss_stats, sizeof(struct lcz_lzss_stats));
+		if (stats->bytes_in > 0) {
+			stats->ratio = (uint32_t)(((uint64_t)stats->bytes_out *
+						   100) /
+						  stats->bytes_in);
+		}
+	}
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/* The search is limited to the window and stops at the first match of the
+ * maximum length.  The nearest match is used when lengths are equal.
+ */
+static size_t find_match(const uint8_t *src, size_t src_len, size_t pos,
+			 size_t *distance)
+{
+	size_t start = (pos > CONFIG_LCZ_LZSS_WINDOW_SIZE) ?
+			       (pos - CONFIG_LCZ_LZSS_WINDOW_SIZE) :
+			       0;
+	size_t limit = MIN(src_len - pos, LCZ_LZSS_MAX_MATCH);
+	size_t best = 0;
+	size_t i;
+	size_t n;
+
+	if (limit < LCZ_LZSS_MIN_MATCH) {
+		return 0;
+	}
+
+	for (i = pos; i-- > start;) {
+		/* Reject quickly on the byte that would make a longer match. */
+		if (src[i + best] != src[pos + best] || src[i] != src[pos]) {
+			continue;
+		}
+		for (n = 1; n < limit && src[i + n] == src[pos + n]; n++) {
+		}
+		if (n > best) {
+			best = n;
+			*distance = pos - i;
+			if (best == limit) {
+				break;
+			}
+		}
+	}
+
+	return best;
+}
+
+static void update_stats(size_t src_len, int r, uint32_t start)
+{
+	uint32_t us = k_cyc_to_us_floor32(k_cycle_get_32() - start);
+
+	lzss_stats.time_us += us;
+	lzss_stats.time_max_us = MAX(lzss_stats.time_max_us, us);
+	if (r > 0) {
+		lzss_stats.compressed += 1;
+		lzss_stats.bytes_in += src_len;
+		lzss_stats.bytes_out += r;
+		LOG_DBG("%u -> %d bytes in %u us", src_len, r, us);
+	} else {
+		lzss_stats.not_smaller += 1;
+	}
+}
@@ -0,0 +1,49 @@
+/**
+ * @file lcz_lzss_shell.c
+ * @brief
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <shell/shell.h>
+#include <init.h>
+
+#include "lcz_lzss.h"
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static int shell_lzss_stats_cmd(const struct shell *shell, size_t argc,
+				char **argv)
+{
+	struct lcz_lzss_stats stats;
+
+	lcz_lzss_get_stats(&stats);
+
+	shell_print(shell, "compressed: %u", stats.compressed);
+	shell_print(shell, "not smaller: %u", stats.not_smaller);
+	shell_print(shell, "bytes in: %u", stats.bytes_in);
+	shell_print(shell, "bytes out: %u", stats.bytes_out);
+	shell_print(shell, "ratio (percent): %u", stats.ratio);
+	shell_print(shell, "time (us): %u", stats.time_us);
+	shell_print(shell, "max time (us): %u", stats.time_max_us);
+
+	return 0;
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+SHELL_STATIC_SUBCMD_SET_CREATE(
+	lzss_cmds,
+	SHELL_CMD(stats, NULL, "Compression statistics", shell_lzss_stats_cmd),
+	SHELL_SUBCMD_SET_END /* Array terminated. */
+);
+
+SHELL_CMD_REGISTER(lzss, &lzss_cmds, "LZSS compression commands", NULL);
@@ -0,0 +1,572 @@
+/**
+ * @file lcz_publish_queue.c
+ * @brief Store publishes on the file system while the cloud is unreachable.
+ *
+ * The sequence numbers of the oldest and next publish are found by listing
+ * the directory, so nothing but the publishes themselves is written.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <logging/log.h>
+LOG_MODULE_REGISTER(lcz_publish_queue, CONFIG_LCZ_PUBLISH_QUEUE_LOG_LEVEL);
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <fs/fs.h>
+#include <sys/crc.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "file_system_utilities.h"
+#include "lcz_qrtc.h"
+#include "lcz_publish_queue.h"
+
+/******************************************************************************/
+/* Local Constant, Macro and Type Definitions                                 */
+/******************************************************************************/
+#define QUEUE_MAGIC 0x51425550 /* "PUBQ" */
+#define QUEUE_VERSION 1
+
+#define FLAG_BINARY BIT(0)
+
+#define LFS_DIR CONFIG_FSU_MOUNT_POINT "/" CONFIG_LCZ_PUBLISH_QUEUE_DIR
+#define SD_CARD_DIR "/SD:/" CONFIG_LCZ_PUBLISH_QUEUE_DIR
+
+/* A publish is named with its sequence number (8 hex digits) */
+#define TEMP_NAME "tmp"
+#define FILE_EXTENSION ".msg"
+#define SEQ_DIGITS 8
+#define MAX_PATH_SIZE 64
+
+#define INIT_RETRY_MS (CONFIG_LCZ_PUBLISH_QUEUE_INIT_RETRY_SECONDS * 1000)
+
+struct entry_header {
+	uint32_t magic;
+	uint8_t version;
+	uint8_t flags;
+	/* A length of 0 is the default topic */
+	uint16_t topic_length;
+	/* 0 if the time wasn't known when the publish was queued */
+	uint32_t epoch;
+	uint32_t length;
+	/* Of the topic and payload */
+	uint32_t crc;
+} __packed;
+
+/******************************************************************************/
+/* Local Data Definitions                                                     */
+/******************************************************************************/
+static K_MUTEX_DEFINE(queue_mutex);
+
+static struct {
+	const char *dir;
+	/* Result and time of the last failure to open the directory */
+	int init_error;
+	int64_t init_time;
+	/* Sequence number of the oldest publish */
+	uint32_t head;
+	/* Sequence number of the next publish */
+	uint32_t tail;
+	uint32_t depth;
+	uint32_t bytes;
+	struct lcz_publish_queue_stats stats;
+} pq;
+
+/******************************************************************************/
+/* Local Function Prototypes                                                  */
+/******************************************************************************/
+static int queue_init(void);
+static int scan(const char *dir);
+static bool parse_name(const char *name, uint32_t *seq);
+static void build_path(char *path, uint32_t seq);
+static bool full(size_t size);
+static void drop_oldest(void);
+static bool delete_entry(uint32_t seq);
+static int write_entry(const struct entry_header *header, const char *topic,
+		       const char *data);
+static int write_all(struct fs_file_t *f, const void *p, size_t length);
+static int read_header(struct fs_file_t *f, uint32_t seq,
+		       struct entry_header *header);
+static int read_entry(uint32_t seq, struct lcz_publish_queue_entry *entry);
+static int read_all(struct fs_file_t *f, void *p, size_t length);
+static uint32_t age(uint32_t epoch);
+static bool expired(uint32_t epoch);
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+int lcz_publish_queue_put(const char *topic, const char *data, size_t length,
+			  bool binary)
+{
+	struct entry_header header;
+	size_t topic_length = (topic == NULL) ? 0 : strlen(topic);
+	size_t size = sizeof(header) + topic_length + length;
+	int r;
+
+	if (size > CONFIG_LCZ_PUBLISH_QUEUE_MAX_BYTES ||
+	    topic_length > UINT16_MAX) {
+		return -EFBIG;
+	}
+
+	header.magic = QUEUE_MAGIC;
+	header.version = QUEUE_VERSION;
+	header.flags = binary ? FLAG_BINARY : 0;
+	header.topic_length = topic_length;
+	header.epoch = lcz_qrtc_get_epoch();
+	header.length = length;
+	header.crc = crc32_ieee_update(crc32_ieee((const uint8_t *)topic,
+						  topic_length),
+				       (const uint8_t *)data, length);
+
+	k_mutex_lock(&queue_mutex, K_FOREVER);
+	r = queue_init();
+
+	if (r == 0 && full(size) &&
+	    IS_ENABLED(CONFIG_LCZ_PUBLISH_QUEUE_DROP_NEWEST)) {
+		pq.stats.dropped_overflow += 1;
+		r = -ENOSPC;
+	}
+
+	while (r == 0 && full(size) && pq.depth > 0) {
+		drop_oldest();
+	}
+
+	if (r == 0) {
+		r = write_entry(&header, topic, data);
+		if (r == 0) {
+			pq.tail += 1;
+			pq.depth += 1;
+			pq.bytes += size;
+			pq.stats.queued += 1;
+		} else {
+			pq.stats.write_errors += 1;
+			LOG_ERR("Unable to queue publish: %d", r);
+		}
+	}
+
+	k_mutex_unlock(&queue_mutex);
+	return r;
+}
+
+int lcz_publish_queue_get(struct lcz_publish_queue_entry *entry)
+{
+	int r = -ENOENT;
+
+	k_mutex_lock(&queue_mutex, K_FOREVER);
+	if (queue_init() == 0) {
+		while (pq.head != pq.tail) {
+			r = read_entry(pq.head, entry);
+			if (r == 0 && expired(entry->epoch)) {
+				lcz_publish_queue_release(entry);
+				pq.stats.dropped_expired += 1;
+				r = -ENOENT;
+			} else if (r == 0 || r == -ENOMEM) {
+				break;
+			} else if (r != -ENOENT) {
+				LOG_WRN("Invalid publish %08x discarded",
+					pq.head);
+				pq.stats.dropped_invalid += 1;
+				r = -ENOENT;
+			}
+			/* Also skips a sequence number that isn't used. */
+			(void)delete_entry(pq.head);
+		}
+	}
+	k_mutex_unlock(&queue_mutex);
+
+	return r;
+}
+
+void lcz_publish_queue_remove(struct lcz_publish_queue_entry *entry)
+{
+	k_mutex_lock(&queue_mutex, K_FOREVER);
+	if (delete_entry(entry->seq)) {
+		pq.stats.sent += 1;
+	}
+	k_mutex_unlock(&queue_mutex);
+
+	lcz_publish_queue_release(entry);
+}
+
+void lcz_publish_queue_discard(struct lcz_publish_queue_entry *entry)
+{
+	k_mutex_lock(&queue_mutex, K_FOREVER);
+	if (delete_entry(entry->seq)) {
+		pq.stats.dropped_failed += 1;
+	}
+	k_mutex_unlock(&queue_mutex);
+
+	lcz_publish_queue_release(entry);
+}
+
+void lcz_publish_queue_release(struct lcz_publish_queue_entry *entry)
+{
+	k_free(entry->buffer);
+	entry->buffer = NULL;
+}
+
+bool lcz_publish_queue_empty(void)
+{
+	bool empty = true;
+
+	k_mutex_lock(&queue_mutex, K_FOREVER);
+	if (queue_init() == 0) {
+		empty = (pq.depth == 0);
+	}
+	k_mutex_unlock(&queue_mutex);
+
+	return empty;
+}
+
+void lcz_publish_queue_get_stats(struct lcz_publish_queue_stats *stats)
+{
+	struct entry_header header;
+	struct fs_file_t f;
+
+	if (stats == NULL) {
+		return;
+	}
+
+	k_mutex_lock(&queue_mutex, K_FOREVER);
+	memcpy(stats, &pq.stats, sizeof(struct lcz_publish_queue_stats));
+	stats->depth = pq.depth;
+	stats->bytes = pq.bytes;
+	stats->oldest_age = 0;
+	if (pq.dir != NULL && pq.depth > 0 &&
+	    read_header(&f, pq.head, &header) == 0) {
+		(void)fs_close(&f);
+		stats->oldest_age = age(header.epoch);
+	}
+	k_mutex_unlock(&queue_mutex);
+}
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+/* The SD card is used if it has been mounted. */
+static int queue_init(void)
+{
+	int r = -ENODEV;
+
+	if (pq.dir != NULL) {
+		return 0;
+	}
+
+	/* The file system isn't checked on every use when it is missing. */
+	if (pq.init_error != 0 &&
+	    (k_uptime_get() - pq.init_time) < INIT_RETRY_MS) {
+		return pq.init_error;
+	}
+
+#ifdef CONFIG_LCZ_PUBLISH_QUEUE_SD_CARD
+	r = scan(SD_CARD_DIR);
+	if (r == 0) {
+		pq.dir = SD_CARD_DIR;
+	}
+#endif
+
+	if (pq.dir == NULL && fsu_lfs_mount() == 0) {
+		r = scan(LFS_DIR);
+		if (r == 0) {
+			pq.dir = LFS_DIR;
+		}
+	}
+
+	if (pq.dir == NULL) {
+		LOG_ERR("Publish queue directory not available: %d", r);
+		pq.init_error = r;
+		pq.init_time = k_uptime_get();
+	} else if (pq.depth > 0) {
+		LOG_INF("%u publishes (%u bytes) queued in %s", pq.depth,
+			pq.bytes, pq.dir);
+	}
+
+	return r;
+}
+
+/* A temporary file is left behind when a write is interrupted. */
+static int scan(const char *dir)
+{
+	char path[MAX_PATH_SIZE];
+	struct fs_dir_t d;
+	struct fs_dirent entry;
+	bool found = false;
+	uint32_t seq;
+	int r;
+
+	r = fs_mkdir(dir);
+	if (r < 0 && r != -EEXIST) {
+		return r;
+	}
+
+	fs_dir_t_init(&d);
+	r = fs_opendir(&d, dir);
+	if (r < 0) {
+		return r;
+	}
+
+	pq.depth = 0;
+	pq.bytes = 0;
+	while (fs_readdir(&d, &entry) == 0 && entry.name[0] != 0) {
+		if (entry.type != FS_DIR_ENTRY_FILE ||
+		    !parse_name(entry.name, &seq)) {
+			continue;
+		}
+		if (!found || seq < pq.head) {
+			pq.head = seq;
+		}
+		if (!found || seq >= pq.tail) {
+			pq.tail = seq + 1;
+		}
+		found = true;
+		pq.depth += 1;
+		pq.bytes += entry.size;
+	}
+	(void)fs_closedir(&d);
+
+	if (!found) {
+		pq.head = 0;
+		pq.tail = 0;
+	}
+
+	snprintk(path, sizeof(path), "%s/" TEMP_NAME, dir);
+	(void)fs_unlink(path);
+
+	return 0;
+}
+
+static bool parse_name(const char *name, uint32_t *seq)
+{
+	char *end;
+
+	*seq = strtoul(name, &end, 16);
+	return ((end - name) == SEQ_DIGITS) &&
+	       (strcmp(end, FILE_EXTENSION) == 0);
+}
+
+static void build_path(char *path, uint32_t seq)
+{
+	snprintk(path, MAX_PATH_SIZE, "%s/%08x" FILE_EXTENSION, pq.dir, seq);
+}
+
+static bool full(size_t size)
+{
+	return (pq.depth >= CONFIG_LCZ_PUBLISH_QUEUE_MAX_MESSAGES) ||
+	       ((pq.bytes + size) > CONFIG_LCZ_PUBLISH_QUEUE_MAX_BYTES);
+}
+
+static void drop_oldest(void)
+{
+	while (pq.head != pq.tail) {
+		if (delete_entry(pq.head)) {
+			pq.stats.dropped_overflow += 1;
+			return;
+		}
+	}
+}
+
+/* @retval true if the publish was deleted, false if it didn't exist */
+static bool delete_entry(uint32_t seq)
+{
+	char path[MAX_PATH_SIZE];
+	struct fs_dirent entry;
+	bool deleted = false;
+
+	build_path(path, seq);
+	if (fs_stat(path, &entry) == 0 && fs_unlink(path) == 0) {
+		pq.depth -= MIN(pq.depth, 1);
+		pq.bytes -= MIN(pq.bytes, entry.size);
+		deleted = true;
+	}
+
+	if (seq == pq.head) {
+		pq.head += 1;
+	}
+
+	/* Publishes are only removed from the head, so the counts can only
+	 * be wrong if the directory was modified.
+	 */
+	if (pq.head == pq.tail) {
+		pq.depth = 0;
+		pq.bytes = 0;
+	}
+
+	return deleted;
+}
+
+/* The publish is renamed once it is complete. */
+static int write_entry(const struct entry_header *header, const char *topic,
+		       const char *data)
+{
+	char temp[MAX_PATH_SIZE];
+	char path[MAX_PATH_SIZE];
+	struct fs_file_t f;
+	int r;
+
+	snprintk(temp, sizeof(temp), "%s/" TEMP_NAME, pq.dir);
+	build_path(path, pq.tail);
+	(void)fs_unlink(temp);
+
+	fs_file_t_init(&f);
+	r = fs_open(&f, temp, FS_O_CREATE | FS_O_WRITE);
+	if (r < 0) {
+		return r;
+	}
+
+	r = write_all(&f, header, sizeof(struct entry_header));
+	if (r == 0) {
+		r = write_all(&f, topic, header->topic_length);
+	}
+	if (r == 0) {
+		r = write_all(&f, data, header->length);
+	}
+	if (fs_close(&f) < 0 && r == 0) {
+		r = -EIO;
+	}
+
+	if (r == 0) {
+		r = fs_rename(temp, path);
+	}
+
+	if (r < 0) {
+		(void)fs_unlink(temp);
+	}
+
+	return r;
+}
+
+static int write_all(struct fs_file_t *f, const void *p, size_t length)
+{
+	ssize_t n;
+
+	if (length == 0) {
+		return 0;
+	}
+
+	n = fs_write(f, p, length);
+	if (n < 0) {
+		return (int)n;
+	}
+
+	return (n == (ssize_t)length) ? 0 : -ENOSPC;
+}
+
+/* The file is left open (at the topic) when the header is valid. */
+static int read_header(struct fs_file_t *f, uint32_t seq,
+		       struct entry_header *header)
+{
+	char path[MAX_PATH_SIZE];
+	int r;
+
+	build_path(path, seq);
+	fs_file_t_init(f);
+	r = fs_open(f, path, FS_O_READ);
+	if (r < 0) {
+		return -ENOENT;
+	}
+
+	r = read_all(f, header, sizeof(struct entry_header));
+	if (r == 0 && (header->magic != QUEUE_MAGIC ||
+		       header->version != QUEUE_VERSION ||
+		       header->length > CONFIG_LCZ_PUBLISH_QUEUE_MAX_BYTES)) {
+		r = -EINVAL;
+	}
+
+	if (r < 0) {
+		(void)fs_close(f);
+	}
+
+	return r;
+}
+
+/* The topic and data are each null terminated. */
+static int read_entry(uint32_t seq, struct lcz_publish_queue_entry *entry)
+{
+	struct entry_header header;
+	struct fs_file_t f;
+	char *buffer;
+	char *data;
+	int r;
+
+	r = read_header(&f, seq, &header);
+	if (r < 0) {
+		return r;
+	}
+
+	buffer = k_malloc(header.topic_length + header.length + 2);
+	if (buffer == NULL) {
+		(void)fs_close(&f);
+		return -ENOMEM;
+	}
+
+	data = buffer + header.topic_length + 1;
+	r = read_all(&f, buffer, header.topic_length);
+	if (r == 0) {
+		r = read_all(&f, data, header.length);
+	}
+	(void)fs_close(&f);
+
+	if (r == 0 &&
+	    header.crc != crc32_ieee_update(crc32_ieee((uint8_t *)buffer,
+						       header.topic_length),
+					    (uint8_t *)data, header.length)) {
+		r = -EINVAL;
+	}
+
+	if (r < 0) {
+		k_free(buffer);
+		return r;
+	}
+
+	buffer[header.topic_length] = 0;
+	data[header.length] = 0;
+
+	entry->topic = (header.topic_length == 0) ? NULL : buffer;
+	entry->data = data;
+	entry->length = header.length;
+	entry->binary = (header.flags & FLAG_BINARY) != 0;
+	entry->epoch = header.epoch;
+	entry->seq = seq;
+	entry->size = sizeof(header) + header.topic_length + header.length;
+	entry->buffer = buffer;
+	return 0;
+}
+
+static int read_all(struct fs_file_t *f, void *p, size_t length)
+{
+	ssize_t n;
+
+	if (length == 0) {
+		return 0;
+	}
+
+	n = fs_read(f, p, length);
+	if (n < 0) {
+		return (int)n;
+	}
+
+	return (n == (ssize_t)length) ? 0 : -EINVAL;
+}
+
+/* @retval seconds since a publish was queued, 0 if it isn't known */
+static uint32_t age(uint32_t epoch)
+{
+	uint32_t now = lcz_qrtc_get_epoch();
+
+	if (epoch == 0 || now <= epoch) {
+		return 0;
+	}
+
+	return now - epoch;
+}
+
+static bool expired(uint32_t epoch)
+{
+	return (CONFIG_LCZ_PUBLISH_QUEUE_RETENTION_SECONDS != 0) &&
+	       (age(epoch) > CONFIG_LCZ_PUBLISH_QUEUE_RETENTION_SECONDS);
+}
@@ -0,0 +1,52 @@
+/**
+ * @file lcz_publish_queue_shell.c
+ * @brief
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+
+/******************************************************************************/
+/* Includes                                                                   */
+/******************************************************************************/
+#include <zephyr.h>
+#include <shell/shell.h>
+#include <init.h>
+
+#include "lcz_publish_queue.h"
+
+/******************************************************************************/
+/* Local Function Definitions                                                 */
+/******************************************************************************/
+static int shell_pq_stats_cmd(const struct shell *shell, size_t argc,
+			      char **argv)
+{
+	struct lcz_publish_queue_stats stats;
+
+	lcz_publish_queue_get_stats(&stats);
+
+	shell_print(shell, "depth: %u", stats.depth);
+	shell_print(shell, "bytes: %u", stats.bytes);
+	shell_print(shell, "oldest age (seconds): %u", stats.oldest_age);
+	shell_print(shell, "queued: %u", stats.queued);
+	shell_print(shell, "sent: %u", stats.sent);
+	shell_print(shell, "dropped (full): %u", stats.dropped_overflow);
+	shell_print(shell, "dropped (expired): %u", stats.dropped_expired);
+	shell_print(shell, "dropped (invalid): %u", stats.dropped_invalid);
+	shell_print(shell, "dropped (failed): %u", stats.dropped_failed);
+	shell_print(shell, "write errors: %u", stats.write_errors);
+
+	return 0;
+}
+
+/******************************************************************************/
+/* Global Function Definitions                                                */
+/******************************************************************************/
+SHELL_STATIC_SUBCMD_SET_CREATE(
+	pq_cmds,
+	SHELL_CMD(stats, NULL, "Publish queue statistics", shell_pq_stats_cmd),
+	SHELL_SUBCMD_SET_END /* Array terminated. */
+);
+
+SHELL_CMD_REGISTER(pq, &pq_cmds, "Publish queue commands", NULL);
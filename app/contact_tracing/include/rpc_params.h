@@ -29,6 +29,9 @@ extern "C" {
 #define CONFIG_RPC_PARAMS_CMD_MAX_SIZE        768
 /* clang-format on */
 
+/* Defined in jsmn_json.h */
+struct jsmn_json;
+
 /* log_get params structure */
 typedef struct rpc_params_log_get_s {
 	char filename[CONFIG_RPC_PARAMS_FILE_NAME_MAX_SIZE];
@@ -55,10 +58,11 @@ typedef struct rpc_params_exec_s {
  * @note This function assumes that the AWS task acknowledges the publish so
  * that it isn't repeatedly sent to the gateway.
  *
+ * @param json is the context of the gateway parser
  * @param get_accepted_topic true when topic contains /accepted
  *
  */
-void rpc_params_gateway_parser(bool get_accepted_topic);
+void rpc_params_gateway_parser(struct jsmn_json *json, bool get_accepted_topic);
 
 /**
  * @brief Get the last rpc method sent via device shadow (if any)
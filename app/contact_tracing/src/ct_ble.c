@@ -86,7 +86,11 @@ enum aws_publish_state {
 	AWS_PUBLISH_STATE_FAIL
 };
 
-#define SEND_TO_AWS_TIMEOUT_TICKS K_SECONDS(5)
+/* Long enough for the AWS task to retransmit and then abandon a publish */
+#define SEND_TO_AWS_TIMEOUT_SECONDS                                            \
+	MAX(5, CONFIG_AWS_PUBACK_TIMEOUT_SECONDS *                             \
+		       (CONFIG_AWS_PUBLISH_RETRIES + 1))
+#define SEND_TO_AWS_TIMEOUT_TICKS K_SECONDS(SEND_TO_AWS_TIMEOUT_SECONDS)
 #define AWS_TOPIC_UP_SUFFIX "/up"
 #define AWS_TOPIC_LOG_SUFFIX "/log"
 
@@ -204,6 +208,8 @@ static void disable_connectable_adv_work_handler(struct k_work *work);
 static void adv_log_filter(const char *msg);
 
 static void aws_work_handler(struct k_work *item);
+static void aws_publish_callback(int status, void *context);
+static void aws_publish_abandon(void);
 
 /******************************************************************************/
 /* Local Data Definitions                                                     */
@@ -255,6 +261,8 @@ static struct k_work_delayable ct_adv_watchdog;
 static struct k_work_delayable disable_connectable_adv_work;
 
 static struct k_sem sending_to_aws_sem;
+/* Identifies the upload that sending_to_aws_sem is held for */
+static atomic_t aws_publish_token;
 
 static struct {
 	struct k_work work;
@@ -1948,6 +1956,7 @@ static void smp_file_download_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 									/* If publish times out, it must have failed. */
 									ct.aws_publish_state =
 										AWS_PUBLISH_STATE_FAIL;
+									aws_publish_abandon();
 								} else {
 									/* Semaphore was taken. Only used to synchronize publish completion and no longer needed. */
 									k_sem_give(&sending_to_aws_sem);
@@ -2272,6 +2281,7 @@ static void smp_file_download_rsp_proc(struct bt_gatt_dfu_smp_c *dfu_smp_c)
 						LOG_ERR("ble->aws pub timeout");
 						/* If publish times out, it must have failed. */
 						ct.aws_publish_state = AWS_PUBLISH_STATE_FAIL;
+						aws_publish_abandon();
 					} else {
 						/* Semaphore was taken. Only used to synchronize publish completion and no longer needed. */
 						k_sem_give(&sending_to_aws_sem);
@@ -2633,7 +2643,7 @@ static void ResetEntryStashInformation(bool giveSemaphore)
 	ct.log_publishing = false;
 
 	if (giveSemaphore) {
-		k_sem_give(&sending_to_aws_sem);
+		aws_publish_abandon();
 	}
 }
 
@@ -2932,16 +2942,47 @@ static void aws_work_handler(struct k_work *item)
 	} else {
 #if defined(CONFIG_CT_AWS_PUBLISH_ENTRIES)
 		/* perform the AWS send in system context */
-		int rc = awsSendBinData(aws_work.buf, aws_work.buf_len,
-					ct.up_topic);
+		atomic_val_t token = atomic_inc(&aws_publish_token) + 1;
+		int rc = awsSendBinDataCallback(aws_work.buf, aws_work.buf_len,
+						ct.up_topic,
+						aws_publish_callback,
+						(void *)token);
 		if (rc != 0) {
 			disconnect_sensor();
 			ct.aws_publish_state = AWS_PUBLISH_STATE_FAIL;
 		} else {
-			ct.aws_publish_state = AWS_PUBLISH_STATE_SUCCESS;
+			/* The entry is stashed until it is acknowledged. */
+			return;
 		}
 #endif
 	}
 
 	k_sem_give(&sending_to_aws_sem);
 }
+
+/* The semaphore is held until the publish is acknowledged (or abandoned).
+ * A callback for an upload that has already timed out is ignored.
+ */
+static void aws_publish_callback(int status, void *context)
+{
+	if ((atomic_val_t)context != atomic_get(&aws_publish_token)) {
+		return;
+	}
+
+	if (ct.aws_publish_state == AWS_PUBLISH_STATE_PENDING) {
+		ct.aws_publish_state = (status == 0) ?
+					       AWS_PUBLISH_STATE_SUCCESS :
+					       AWS_PUBLISH_STATE_FAIL;
+	}
+
+	k_sem_give(&sending_to_aws_sem);
+}
+
+/* Release the semaphore on behalf of the upload in progress.  Its callback
+ * is ignored if it arrives later.
+ */
+static void aws_publish_abandon(void)
+{
+	atomic_inc(&aws_publish_token);
+	k_sem_give(&sending_to_aws_sem);
+}
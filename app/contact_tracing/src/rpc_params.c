@@ -41,29 +41,29 @@ static uint8_t rpc_param_buf[CONFIG_RPC_PARAMS_BUF_MAX_SIZE];
 /******************************************************************************/
 /* Local Function Prototypes                                                  */
 /******************************************************************************/
-static int rpc_params_parse(void);
-static int rpc_parse(int location);
+static int rpc_params_parse(jsmn_json_t *json);
+static int rpc_parse(jsmn_json_t *json, int location);
 
 /******************************************************************************/
 /* Global Function Definitions                                                */
 /******************************************************************************/
-void rpc_params_gateway_parser(bool get_accepted_topic)
+void rpc_params_gateway_parser(jsmn_json_t *json, bool get_accepted_topic)
 {
 	int location;
 
-	jsmn_reset_index();
+	jsmn_reset_index(json);
 
-	jsmn_find_type("state", JSMN_OBJECT, NEXT_PARENT);
+	jsmn_find_type(json, "state", JSMN_OBJECT, NEXT_PARENT);
 	if (get_accepted_topic) {
 		/* get an outstanding command (not the last command ['reported']) */
-		jsmn_find_type("desired", JSMN_OBJECT, NEXT_PARENT);
+		jsmn_find_type(json, "desired", JSMN_OBJECT, NEXT_PARENT);
 	}
-	jsmn_find_type("rpc", JSMN_OBJECT, NEXT_PARENT);
-	jsmn_save_index();
-	location = jsmn_find_type("m", JSMN_STRING, NEXT_PARENT);
-	if (jsmn_index() != 0) {
-		jsmn_restore_index();
-		rpc_parse(location);
+	jsmn_find_type(json, "rpc", JSMN_OBJECT, NEXT_PARENT);
+	jsmn_save_index(json);
+	location = jsmn_find_type(json, "m", JSMN_STRING, NEXT_PARENT);
+	if (jsmn_index(json) != 0) {
+		jsmn_restore_index(json);
+		rpc_parse(json, location);
 	}
 }
 
@@ -90,15 +90,15 @@ void rpc_params_clear_method(void)
  * Parse the RPC params from the module global JSON contents
  * currently being processed.
  */
-static int rpc_params_parse(void)
+static int rpc_params_parse(jsmn_json_t *json)
 {
 	int r = 0;
 	int location = 0;
 
 	memset(rpc_param_buf, 0, sizeof(rpc_param_buf));
 
-	jsmn_find_type("p", JSMN_OBJECT, NEXT_PARENT);
-	jsmn_save_index();
+	jsmn_find_type(json, "p", JSMN_OBJECT, NEXT_PARENT);
+	jsmn_save_index(json);
 
 	do {
 		/* log_get */
@@ -107,11 +107,11 @@ static int rpc_params_parse(void)
 				(rpc_params_log_get_t *)rpc_param_buf;
 
 			/* filename */
-			jsmn_restore_index();
-			location =
-				jsmn_find_type("f", JSMN_STRING, NEXT_PARENT);
+			jsmn_restore_index(json);
+			location = jsmn_find_type(json, "f", JSMN_STRING,
+						  NEXT_PARENT);
 			if (location > 0) {
-				JSMN_STRNCPY(params->filename, location);
+				JSMN_STRNCPY(json, params->filename, location);
 			} else {
 				LOG_ERR("Invalid filename");
 				r = -1;
@@ -119,11 +119,11 @@ static int rpc_params_parse(void)
 			}
 
 			/* whence */
-			jsmn_restore_index();
-			location =
-				jsmn_find_type("w", JSMN_STRING, NEXT_PARENT);
+			jsmn_restore_index(json);
+			location = jsmn_find_type(json, "w", JSMN_STRING,
+						  NEXT_PARENT);
 			if (location > 0) {
-				JSMN_STRNCPY(params->whence, location);
+				JSMN_STRNCPY(json, params->whence, location);
 			} else {
 				LOG_ERR("Invalid whence");
 				r = -1;
@@ -131,11 +131,12 @@ static int rpc_params_parse(void)
 			}
 
 			/* offset */
-			jsmn_restore_index();
-			location = jsmn_find_type("o", JSMN_PRIMITIVE,
+			jsmn_restore_index(json);
+			location = jsmn_find_type(json, "o", JSMN_PRIMITIVE,
 						  NEXT_PARENT);
 			if (location > 0) {
-				params->offset = jsmn_convert_uint(location);
+				params->offset =
+					jsmn_convert_uint(json, location);
 			} else {
 				LOG_ERR("Invalid offset");
 				r = -1;
@@ -143,11 +144,12 @@ static int rpc_params_parse(void)
 			}
 
 			/* length */
-			jsmn_restore_index();
-			location = jsmn_find_type("l", JSMN_PRIMITIVE,
+			jsmn_restore_index(json);
+			location = jsmn_find_type(json, "l", JSMN_PRIMITIVE,
 						  NEXT_PARENT);
 			if (location > 0) {
-				params->length = jsmn_convert_uint(location);
+				params->length =
+					jsmn_convert_uint(json, location);
 			} else {
 				LOG_ERR("Invalid length");
 				r = -1;
@@ -176,10 +178,10 @@ static int rpc_params_parse(void)
 				(rpc_params_exec_t *)rpc_param_buf;
 
 			/* cmd */
-			location =
-				jsmn_find_type("c", JSMN_STRING, NEXT_PARENT);
+			location = jsmn_find_type(json, "c", JSMN_STRING,
+						  NEXT_PARENT);
 			if (location > 0) {
-				JSMN_STRNCPY(params->cmd, location);
+				JSMN_STRNCPY(json, params->cmd, location);
 			} else {
 				LOG_ERR("Unable to find command");
 				r = -1;
@@ -209,15 +211,15 @@ static int rpc_params_parse(void)
  * Parse the RPC method from the module global JSON contents
  * currently being processed.
  */
-static int rpc_parse(int location)
+static int rpc_parse(jsmn_json_t *json, int location)
 {
 	int r = -EPERM;
 
-	if (jsmn_strlen(location) < sizeof(rpc_method)) {
+	if (jsmn_strlen(json, location) < sizeof(rpc_method)) {
 		rpc_params_clear_method();
-		JSMN_STRNCPY(rpc_method, location);
+		JSMN_STRNCPY(json, rpc_method, location);
 		LOG_DBG("rpc.m: %s", log_strdup(rpc_method));
-		r = rpc_params_parse();
+		r = rpc_params_parse(json);
 		if (r < 0) {
 			LOG_ERR("Unable to parse RPC command");
 			rpc_params_clear_method();
@@ -43,6 +43,7 @@ enum FwkMsgCodeEnum {
 	FMC_SUBSCRIBE,
 	FMC_SUBSCRIBE_ACK,
 	FMC_SENSOR_SHADOW_INIT,
+	FMC_SENSOR_PUBLISH_ACK,
 	FMC_AWS_HEARTBEAT,
 	FMC_AWS_DECOMMISSION,
 
@@ -59,6 +60,7 @@ enum FwkMsgCodeEnum {
 	FMC_NETWORK_DISCONNECTED,
 	FMC_CLOUD_CONNECTED,
 	FMC_CLOUD_DISCONNECTED,
+	FMC_PUBLISH_QUEUE_DRAIN,
 
 	/* Last value (DO NOT DELETE) */
 	NUMBER_OF_FRAMEWORK_MSG_CODES
@@ -27,24 +27,12 @@ typedef struct JsonMsg {
 	FwkMsgHeader_t header;
 	size_t size; /** number of bytes */
 	size_t length; /** of the data */
+	uint8_t encoding; /** ShadowEncoding_t (0 is JSON) */
+	uint32_t publishId; /** non-zero if the sender wants the PUBACK */
 	char topic[CONFIG_AWS_TOPIC_MAX_SIZE];
 	char buffer[];
 } JsonMsg_t;
 
-typedef struct Ad {
-	size_t len;
-	uint8_t data[CONFIG_SENSOR_MAX_AD_SIZE];
-} Ad_t;
-
-typedef struct AdvMsg {
-	FwkMsgHeader_t header;
-	bt_addr_le_t addr;
-	int8_t rssi;
-	uint8_t type;
-	Ad_t ad;
-} AdvMsg_t;
-CHECK_FWK_MSG_SIZE(AdvMsg_t);
-
 typedef struct ESSSensorMsg {
 	FwkMsgHeader_t header;
 	float temperatureC; /* xx.xxC format */
@@ -0,0 +1,56 @@
+/**
+ * @file test.h
+ * @brief Checks and timing shared by the host tests.
+ *
+ * A test returns the number of failed checks from main, so ctest reports
+ * any failure.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __HOST_TEST_H__
+#define __HOST_TEST_H__
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+static int test_failures;
+
+#define CHECK(expr)                                                            \
+	do {                                                                   \
+		if (!(expr)) {                                                 \
+			test_failures += 1;                                    \
+			printf("%s:%d: check failed: %s\n", __FILE__,          \
+			       __LINE__, #expr);                               \
+		}                                                              \
+	} while (0)
+
+#define TEST_RESULT()                                                          \
+	(printf("%s\n", (test_failures == 0) ? "PASS" : "FAIL"),               \
+	 (test_failures == 0) ? 0 : 1)
+
+static inline uint64_t test_now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec;
+}
+
+/* xorshift32: deterministic so that a failure can be reproduced.  The
+ * state must not be zero.
+ */
+static inline uint32_t test_rand(uint32_t *state)
+{
+	uint32_t x = *state;
+
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+#endif /* __HOST_TEST_H__ */
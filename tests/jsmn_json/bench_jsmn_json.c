@@ -0,0 +1,204 @@
+/**
+ * @file bench_jsmn_json.c
+ * @brief Time the lookups made by the shadow parsers with and without the
+ * key index.
+ *
+ * Usage: bench_jsmn_json [iterations]
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <zephyr.h>
+#include <string.h>
+
+#define JSMN_PARENT_LINKS
+#define JSMN_HEADER
+#include "jsmn.h"
+#include "jsmn_json.h"
+#include "test.h"
+
+#define MAX_TOKENS 2048
+#define DOCUMENT_MAX_SIZE (16 * 1024)
+
+JSMN_JSON_DEFINE(indexed, MAX_TOKENS);
+
+static jsmntok_t linear_tokens[MAX_TOKENS];
+static jsmn_json_t linear = { .tokens = linear_tokens,
+			      .max_tokens = MAX_TOKENS };
+
+static char doc[DOCUMENT_MAX_SIZE];
+
+/* The values of the first five are strings */
+#define FOTA_STRING_KEYS 5
+
+static const char *const FOTA_KEYS[] = {
+	"desired", "desiredFilename", "downloadHost", "downloadFile",
+	"hash", "switchover", "start", "errorCount"
+};
+
+static const char *const CONFIG_KEYS[] = {
+	"batteryLowThreshold", "battery0", "battery1", "battery2", "battery3",
+	"battery4", "batteryBadThreshold", "odr", "scale",
+	"activationThreshold", "maxLogSizeMB"
+};
+
+/******************************************************************************/
+/* Documents                                                                  */
+/******************************************************************************/
+static size_t sensor_list(size_t n, size_t sensors)
+{
+	size_t i;
+
+	n += sprintf(&doc[n], "\"bt510\":{\"sensors\":[");
+	for (i = 0; i < sensors; i++) {
+		n += sprintf(&doc[n], "%s[\"%012zx\",%zu,true]",
+			     (i > 0) ? "," : "", i, 1600000000 + i);
+	}
+	return n + sprintf(&doc[n], "]}");
+}
+
+static size_t fota_image(size_t n, const char *name)
+{
+	return n + sprintf(&doc[n],
+			   "\"%s\":{\"running\":\"4.0.0\",\"desired\":"
+			   "\"4.0.1\",\"desiredFilename\":\"%s.bin\","
+			   "\"downloadHost\":\"example.com\","
+			   "\"downloadFile\":\"%s.bin\",\"hash\":\"abc\","
+			   "\"switchover\":0,\"start\":0,\"errorCount\":0},",
+			   name, name, name);
+}
+
+/* Reply to a shadow get with desired and reported state */
+static void get_accepted(size_t sensors)
+{
+	size_t n = 0;
+
+	n += sprintf(&doc[n], "{\"state\":{\"desired\":{\"rpc\":{\"m\":"
+			      "\"reboot\"},");
+	n = sensor_list(n, sensors);
+	n += sprintf(&doc[n], "},\"reported\":{");
+	n = fota_image(n, "app");
+	n = fota_image(n, "hl7800");
+	n += sprintf(&doc[n], "\"fwBridge\":\"example.com\","
+			      "\"blockSize\":4096,");
+	n = sensor_list(n, sensors);
+	sprintf(&doc[n], "}},\"version\":56}");
+}
+
+static void gateway_delta(size_t sensors)
+{
+	size_t n = 0;
+	size_t i;
+
+	n += sprintf(&doc[n], "{\"version\":56,\"state\":{");
+	for (i = 0; i < ARRAY_SIZE(CONFIG_KEYS); i++) {
+		n += sprintf(&doc[n], "\"%s\":%zu,", CONFIG_KEYS[i], i);
+	}
+	n = sensor_list(n, sensors);
+	sprintf(&doc[n], "}}");
+}
+
+/******************************************************************************/
+/* Lookups                                                                    */
+/******************************************************************************/
+/* The lookups made by the gateway, FOTA, RPC and local config parsers */
+static int lookups(jsmn_json_t *jsmn, bool is_get_accepted)
+{
+	static const char *const IMAGES[] = { "app", "hl7800" };
+	int sum = 0;
+	size_t i;
+	size_t k;
+
+	jsmn_reset_index(jsmn);
+	jsmn_find_type(jsmn, "state", JSMN_OBJECT, NEXT_PARENT);
+	if (is_get_accepted) {
+		jsmn_find_type(jsmn, "reported", JSMN_OBJECT, NEXT_PARENT);
+	}
+	jsmn_find_type(jsmn, "bt510", JSMN_OBJECT, NEXT_PARENT);
+	sum += jsmn_find_type(jsmn, "sensors", JSMN_ARRAY, NEXT_PARENT);
+
+	for (i = 0; i < ARRAY_SIZE(IMAGES); i++) {
+		jsmn_reset_index(jsmn);
+		jsmn_find_type(jsmn, "state", JSMN_OBJECT, NEXT_PARENT);
+		if (is_get_accepted) {
+			jsmn_find_type(jsmn, "reported", JSMN_OBJECT,
+				       NEXT_PARENT);
+		}
+		jsmn_find_type(jsmn, IMAGES[i], JSMN_OBJECT, NEXT_PARENT);
+		if (jsmn_index(jsmn) == 0) {
+			continue;
+		}
+		jsmn_save_index(jsmn);
+		for (k = 0; k < ARRAY_SIZE(FOTA_KEYS); k++) {
+			jsmntype_t type = (k < FOTA_STRING_KEYS) ?
+						  JSMN_STRING :
+						  JSMN_PRIMITIVE;
+			jsmn_restore_index(jsmn);
+			sum += jsmn_find_type(jsmn, FOTA_KEYS[k], type,
+					      NEXT_PARENT);
+		}
+	}
+
+	jsmn_reset_index(jsmn);
+	sum += jsmn_find_path(jsmn, "state.desired.rpc.m", JSMN_STRING);
+
+	for (k = 0; k < ARRAY_SIZE(CONFIG_KEYS); k++) {
+		jsmn_reset_index(jsmn);
+		jsmn_find_type(jsmn, "state", JSMN_OBJECT, NEXT_PARENT);
+		sum += jsmn_find_type(jsmn, CONFIG_KEYS[k], JSMN_PRIMITIVE,
+				      NEXT_PARENT);
+	}
+	return sum;
+}
+
+static void run(const char *name, bool is_get_accepted,
+		unsigned long iterations)
+{
+	uint64_t start[2] = { 0 };
+	uint64_t find[2] = { 0 };
+	jsmn_json_t *contexts[2] = { &linear, &indexed };
+	int sums[2] = { 0 };
+	unsigned long n;
+	size_t c;
+
+	for (c = 0; c < ARRAY_SIZE(contexts); c++) {
+		for (n = 0; n < iterations; n++) {
+			uint64_t t0 = test_now_ns();
+			jsmn_start(contexts[c], doc);
+			uint64_t t1 = test_now_ns();
+			sums[c] = lookups(contexts[c], is_get_accepted);
+			find[c] += test_now_ns() - t1;
+			start[c] += t1 - t0;
+			jsmn_end(contexts[c]);
+		}
+	}
+
+	printf("%-26s %6d %8.2f %8.2f %8.2f %8.2f\n", name,
+	       jsmn_tokens_found(&indexed),
+	       (double)start[0] / iterations / 1000,
+	       (double)start[1] / iterations / 1000,
+	       (double)find[0] / iterations / 1000,
+	       (double)find[1] / iterations / 1000);
+	CHECK(sums[0] == sums[1]);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long iterations =
+		(argc > 1) ? strtoul(argv[1], NULL, 0) : 5000;
+
+	printf("%-26s %6s %17s %17s\n", "", "", "start (us)",
+	       "lookups (us)");
+	printf("%-26s %6s %8s %8s %8s %8s\n", "document", "tokens", "linear",
+	       "indexed", "linear", "indexed");
+
+	get_accepted(40);
+	run("get/accepted, 40 sensors", true, iterations);
+	get_accepted(100);
+	run("get/accepted, 100 sensors", true, iterations);
+	gateway_delta(100);
+	run("gateway delta, 100 sensors", false, iterations);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,210 @@
+/**
+ * @file test_jsmn_json.c
+ * @brief Compare lookups that use the key index with the linear search on
+ * random documents that contain duplicate keys.
+ *
+ * A context without key slots always uses the linear search, so it is the
+ * reference.
+ *
+ * Usage: test_jsmn_json [documents]
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <zephyr.h>
+#include <string.h>
+
+#define JSMN_PARENT_LINKS
+#define JSMN_HEADER
+#include "jsmn.h"
+#include "jsmn_json.h"
+#include "test.h"
+
+#define MAX_TOKENS 2048
+#define DOCUMENT_MAX_SIZE (32 * 1024)
+#define GENERATOR_MAX_DEPTH 5
+#define OPERATIONS_PER_DOCUMENT 200
+
+JSMN_JSON_DEFINE(indexed, MAX_TOKENS);
+
+static jsmntok_t linear_tokens[MAX_TOKENS];
+static jsmn_json_t linear = { .tokens = linear_tokens,
+			      .max_tokens = MAX_TOKENS };
+
+/* Few keys so that most objects have duplicates and most lookups succeed */
+static const char *const KEYS[] = { "state", "reported", "desired", "a",
+				    "b",     "sensors",	 "version" };
+
+static const jsmntype_t TYPES[] = { JSMN_OBJECT, JSMN_ARRAY, JSMN_STRING,
+				    JSMN_PRIMITIVE };
+
+static char doc[DOCUMENT_MAX_SIZE];
+static size_t doc_len;
+static uint32_t seed = 20;
+
+/******************************************************************************/
+/* Generator                                                                  */
+/******************************************************************************/
+static void emit(const char *s)
+{
+	size_t len = strlen(s);
+
+	assert(doc_len + len < sizeof(doc));
+	memcpy(&doc[doc_len], s, len);
+	doc_len += len;
+	doc[doc_len] = '\0';
+}
+
+static const char *random_key(void)
+{
+	return KEYS[test_rand(&seed) % ARRAY_SIZE(KEYS)];
+}
+
+/* String values can have the same text as keys. */
+static void value(int depth)
+{
+	uint32_t r = test_rand(&seed) % 10;
+	size_t count = test_rand(&seed) % 6;
+	size_t i;
+
+	if (depth < GENERATOR_MAX_DEPTH && r < 4) {
+		emit("{");
+		for (i = 0; i < count; i++) {
+			emit((i > 0) ? ",\"" : "\"");
+			emit(random_key());
+			emit("\":");
+			value(depth + 1);
+		}
+		emit("}");
+	} else if (depth < GENERATOR_MAX_DEPTH && r < 6) {
+		emit("[");
+		for (i = 0; i < count; i++) {
+			if (i > 0) {
+				emit(",");
+			}
+			value(depth + 1);
+		}
+		emit("]");
+	} else if (r < 8) {
+		emit("\"");
+		emit(random_key());
+		emit("\"");
+	} else {
+		emit((r == 8) ? "12" : "true");
+	}
+}
+
+static void generate(void)
+{
+	size_t members = 1 + (test_rand(&seed) % 6);
+	size_t i;
+
+	doc_len = 0;
+	emit("{");
+	for (i = 0; i < members; i++) {
+		emit((i > 0) ? ",\"" : "\"");
+		emit(random_key());
+		emit("\":");
+		value(1);
+	}
+	emit("}");
+}
+
+/******************************************************************************/
+/* Tests                                                                      */
+/******************************************************************************/
+static void check_find(void)
+{
+	const char *key = random_key();
+	jsmntype_t type = TYPES[test_rand(&seed) % ARRAY_SIZE(TYPES)];
+	parent_type_t parent =
+		(test_rand(&seed) % 4) ? NEXT_PARENT : NO_PARENT;
+	int expected;
+	int found;
+
+	/* A failed lookup leaves nothing to search until the index is reset */
+	if (jsmn_index(&linear) == 0) {
+		jsmn_reset_index(&indexed);
+		jsmn_reset_index(&linear);
+	}
+
+	expected = jsmn_find_type(&linear, key, type, parent);
+	found = jsmn_find_type(&indexed, key, type, parent);
+
+	CHECK(found == expected);
+	CHECK(jsmn_index(&indexed) == jsmn_index(&linear));
+	if (found != expected) {
+		printf("%s: find \"%s\" type %d parent %d: %d expected %d\n",
+		       doc, key, type, parent, found, expected);
+	}
+}
+
+static void check_path(void)
+{
+	char path[64] = "";
+	size_t keys = 1 + (test_rand(&seed) % 3);
+	jsmntype_t type = TYPES[test_rand(&seed) % ARRAY_SIZE(TYPES)];
+	size_t i;
+
+	for (i = 0; i < keys; i++) {
+		if (i > 0) {
+			strcat(path, ".");
+		}
+		strcat(path, random_key());
+	}
+	CHECK(jsmn_find_path(&indexed, path, type) ==
+	      jsmn_find_path(&linear, path, type));
+	CHECK(jsmn_index(&indexed) == jsmn_index(&linear));
+}
+
+static void check_document(void)
+{
+	size_t n;
+
+	generate();
+	jsmn_start(&indexed, doc);
+	jsmn_start(&linear, doc);
+	CHECK(jsmn_valid(&indexed));
+	CHECK(jsmn_tokens_found(&indexed) == jsmn_tokens_found(&linear));
+
+	for (n = 0; n < OPERATIONS_PER_DOCUMENT; n++) {
+		switch (test_rand(&seed) % 10) {
+		case 0:
+			jsmn_reset_index(&indexed);
+			jsmn_reset_index(&linear);
+			break;
+		case 1:
+			jsmn_save_index(&indexed);
+			jsmn_save_index(&linear);
+			break;
+		case 2:
+			jsmn_restore_index(&indexed);
+			jsmn_restore_index(&linear);
+			break;
+		case 3:
+			jsmn_reset_index(&indexed);
+			jsmn_reset_index(&linear);
+			check_path();
+			break;
+		default:
+			check_find();
+			break;
+		}
+	}
+
+	jsmn_end(&indexed);
+	jsmn_end(&linear);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 2000;
+	unsigned long n;
+
+	for (n = 0; n < count && test_failures == 0; n++) {
+		check_document();
+	}
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,264 @@
+/**
+ * @file test_lcz_json_filter.c
+ * @brief Compare the streaming JSON filter with a reference on randomized
+ * documents that are written in pieces of random size.
+ *
+ * The generator writes each document twice: as it would be received (with
+ * random whitespace) and as the filter should output it.
+ *
+ * Usage: test_lcz_json_filter [documents]
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <zephyr.h>
+#include <string.h>
+#include <errno.h>
+
+#include "lcz_json_filter.h"
+#include "test.h"
+
+#define DOCUMENT_MAX_SIZE (64 * 1024)
+#define GENERATOR_MAX_DEPTH 6
+#define MAX_CHUNK_SIZE 300
+
+/* The comma and quoted key of a removed member are written before the
+ * member is removed.
+ */
+#define RULE_HEADROOM (sizeof(",\"metadata\"") - 1)
+
+/* The rules used for shadow subscriptions and one that matches anywhere */
+static const struct lcz_json_filter_rule RULES[] = {
+	{ "metadata", 1 },
+	{ "timestamp", 1 },
+	{ "drop", 0 },
+};
+
+struct document {
+	char in[DOCUMENT_MAX_SIZE];
+	size_t in_len;
+	char expected[DOCUMENT_MAX_SIZE];
+	size_t expected_len;
+};
+
+static struct document doc;
+static char out[DOCUMENT_MAX_SIZE];
+static uint32_t seed = 2021;
+
+/******************************************************************************/
+/* Generator                                                                  */
+/******************************************************************************/
+static void emit(const char *s, bool keep)
+{
+	size_t len = strlen(s);
+
+	assert(doc.in_len + len < sizeof(doc.in));
+	memcpy(&doc.in[doc.in_len], s, len);
+	doc.in_len += len;
+	if (keep) {
+		memcpy(&doc.expected[doc.expected_len], s, len);
+		doc.expected_len += len;
+	}
+}
+
+static void whitespace(void)
+{
+	static const char *const WS[] = { "", "", "", " ",
+					  "\n", "\r\n ", "\t" };
+
+	emit(WS[test_rand(&seed) % ARRAY_SIZE(WS)], false);
+}
+
+/* Strings contain the structural characters and escaped quotes */
+static void scalar(bool keep)
+{
+	static const char *const SCALARS[] = {
+		"1",
+		"-2.5e3",
+		"true",
+		"false",
+		"null",
+		"\"s,}]{[\\\" \"",
+		"\"metadata\"",
+		"\"\\\\\"",
+		"\"\xc3\xa9\"",
+		"\"\""
+	};
+
+	emit(SCALARS[test_rand(&seed) % ARRAY_SIZE(SCALARS)], keep);
+}
+
+static bool dropped(const char *key, int depth)
+{
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(RULES); i++) {
+		if (strcmp(key, RULES[i].key) == 0 &&
+		    (RULES[i].depth == 0 || RULES[i].depth == depth)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static void value(int depth, bool keep);
+
+/* Members of this object have a depth of depth + 1 */
+static void object(int depth, bool keep, size_t members)
+{
+	static const char *const KEYS[] = {
+		"metadata", "timestamp", "drop", "state", "reported",
+		"a", "x\\\"y", "version", "dropped"
+	};
+	bool first = true;
+	size_t i;
+
+	emit("{", keep);
+	for (i = 0; i < members; i++) {
+		const char *key = KEYS[test_rand(&seed) % ARRAY_SIZE(KEYS)];
+		bool keep_member = keep && !dropped(key, depth + 1);
+
+		whitespace();
+		if (i > 0) {
+			emit(",", false);
+			whitespace();
+		}
+		/* The comma is only kept if a member before this one was */
+		if (keep_member && !first) {
+			doc.expected[doc.expected_len++] = ',';
+		}
+		emit("\"", keep_member);
+		emit(key, keep_member);
+		emit("\"", keep_member);
+		whitespace();
+		emit(":", keep_member);
+		whitespace();
+		value(depth + 1, keep_member);
+		first = first && !keep_member;
+	}
+	whitespace();
+	emit("}", keep);
+}
+
+static void value(int depth, bool keep)
+{
+	uint32_t r = test_rand(&seed) % 10;
+	size_t count = test_rand(&seed) % 6;
+	size_t i;
+
+	if (depth < GENERATOR_MAX_DEPTH && r < 3) {
+		object(depth, keep, count);
+	} else if (depth < GENERATOR_MAX_DEPTH && r < 5) {
+		emit("[", keep);
+		for (i = 0; i < count; i++) {
+			whitespace();
+			if (i > 0) {
+				emit(",", keep);
+				whitespace();
+			}
+			value(depth + 1, keep);
+		}
+		whitespace();
+		emit("]", keep);
+	} else {
+		scalar(keep);
+	}
+}
+
+static void generate(void)
+{
+	doc.in_len = 0;
+	doc.expected_len = 0;
+	whitespace();
+	object(0, true, test_rand(&seed) % 8);
+	whitespace();
+}
+
+/******************************************************************************/
+/* Tests                                                                      */
+/******************************************************************************/
+static int filter(const char *src, size_t len, size_t size, bool chunked)
+{
+	struct lcz_json_filter f;
+	size_t i = 0;
+
+	lcz_json_filter_init(&f, out, size, RULES, ARRAY_SIZE(RULES));
+	while (i < len) {
+		size_t chunk =
+			chunked ? 1 + (test_rand(&seed) % MAX_CHUNK_SIZE) : len;
+		chunk = MIN(chunk, len - i);
+		lcz_json_filter_write(&f, &src[i], chunk);
+		i += chunk;
+	}
+	return lcz_json_filter_finish(&f);
+}
+
+static void check_random_documents(unsigned long count)
+{
+	unsigned long n;
+
+	for (n = 0; n < count && test_failures == 0; n++) {
+		int r;
+
+		generate();
+		r = filter(doc.in, doc.in_len, sizeof(out), true);
+		CHECK(r == (int)doc.expected_len);
+		CHECK(r < 0 || memcmp(out, doc.expected, r) == 0);
+		if (test_failures != 0) {
+			printf("in:       %.*s\n", (int)doc.in_len, doc.in);
+			printf("out:      %.*s\n", MAX(r, 0), out);
+			printf("expected: %.*s\n", (int)doc.expected_len,
+			       doc.expected);
+			break;
+		}
+
+		/* One byte is reserved for the terminator */
+		CHECK(filter(doc.in, doc.in_len,
+			     doc.expected_len + 1 + RULE_HEADROOM,
+			     true) == (int)doc.expected_len);
+		CHECK(filter(doc.in, doc.in_len, doc.expected_len, true) ==
+		      -ENOMEM);
+	}
+}
+
+/* A get/accepted document keeps only state and version */
+static void check_shadow(void)
+{
+	static const char SHADOW[] =
+		"{\"state\":{\"desired\":{\"a\":1},\"reported\":{\"bt510\":"
+		"{\"sensors\":[[\"aa\",1,true]]}}},\"metadata\":{\"desired\":"
+		"{\"a\":{\"timestamp\":1}},\"reported\":{\"bt510\":"
+		"{\"sensors\":[[{\"timestamp\":1},{\"timestamp\":1},"
+		"{\"timestamp\":1}]]}}},"
+		"\"version\":12,\"timestamp\":1600000000}";
+	static const char FILTERED[] =
+		"{\"state\":{\"desired\":{\"a\":1},\"reported\":{\"bt510\":"
+		"{\"sensors\":[[\"aa\",1,true]]}}},\"version\":12}";
+
+	CHECK(filter(SHADOW, strlen(SHADOW), sizeof(out), false) ==
+	      (int)strlen(FILTERED));
+	CHECK(strcmp(out, FILTERED) == 0);
+}
+
+static void check_depth(void)
+{
+	char deep[2 * (LCZ_JSON_FILTER_MAX_DEPTH + 2)];
+	size_t i;
+
+	for (i = 0; i < sizeof(deep) / 2; i++) {
+		deep[i] = '[';
+		deep[sizeof(deep) - 1 - i] = ']';
+	}
+	CHECK(filter(deep, sizeof(deep), sizeof(out), false) == -EINVAL);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 20000;
+
+	check_shadow();
+	check_depth();
+	check_random_documents(count);
+	return TEST_RESULT();
+}
@@ -0,0 +1,256 @@
+/**
+ * @file test_lcz_lzss.c
+ * @brief Compress a corpus shaped like the payloads the gateway publishes
+ * and check that everything round trips.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <zephyr.h>
+#include <string.h>
+#include <errno.h>
+
+#include "lcz_lzss.h"
+#include "test.h"
+
+#define MAX_PAYLOAD_SIZE 4096
+#define ROUND_TRIPS 2000
+#define FUZZ_ITERATIONS 100000
+
+static uint8_t payload[MAX_PAYLOAD_SIZE];
+static uint8_t compressed[MAX_PAYLOAD_SIZE];
+static uint8_t restored[MAX_PAYLOAD_SIZE];
+static uint32_t seed = 7;
+
+/******************************************************************************/
+/* Corpus                                                                     */
+/******************************************************************************/
+/* BT510 event log shadow with 100 entries */
+static size_t event_log_shadow(void)
+{
+	char *p = (char *)payload;
+	uint32_t epoch = 1617000000;
+	size_t n;
+	int i;
+
+	n = sprintf(p, "{\"state\":{\"reported\":{\"sensorName\":\"BT510\","
+		       "\"rssi\":-71,\"networkId\":65535,\"flags\":33,"
+		       "\"resetCount\":3,\"tempCc\":2345,"
+		       "\"batteryVoltageMv\":3012,\"eventLogSize\":100,"
+		       "\"eventLog\":[");
+	for (i = 0; i < 100; i++) {
+		epoch += 60 + (test_rand(&seed) % 30);
+		n += sprintf(&p[n], "[\"%02X\",%u,\"%04X\"],",
+			     (i % 3) ? 1 : 12, epoch,
+			     2200 + (test_rand(&seed) % 300));
+	}
+	p[n - 1] = ']';
+	n += sprintf(&p[n], "}}}");
+	return n;
+}
+
+/* A log_get chunk read from the SD card */
+static size_t sd_log_chunk(void)
+{
+	static const char *const MODULES[] = { "sensor_task", "aws", "ct_ble",
+					       "lte", "bluegrass" };
+	static const char *const MESSAGES[] = {
+		"Publishing to AWS", "MQTT PUBACK id: %u", "RSSI: -%u dBm",
+		"Entry stored (%u bytes)", "Connected to sensor %02X"
+	};
+	char *p = (char *)payload;
+	uint32_t ms = 0;
+	size_t n = 0;
+
+	while (n < 1984 - 120) {
+		uint32_t k = test_rand(&seed) % ARRAY_SIZE(MODULES);
+		ms += test_rand(&seed) % 5000;
+		n += sprintf(&p[n], "[%02u:%02u:%02u.%03u,000] <inf> %s: ",
+			     ms / 3600000, (ms / 60000) % 60, (ms / 1000) % 60,
+			     ms % 1000, MODULES[k]);
+		n += sprintf(&p[n], MESSAGES[k], test_rand(&seed) % 100);
+		n += sprintf(&p[n], "\r\n");
+	}
+	return n;
+}
+
+/* Contact tracing upload: header followed by byte-packed log entries */
+static size_t contact_tracing_upload(void)
+{
+	uint8_t serials[4][6];
+	uint32_t timestamp = 1617000000;
+	size_t n = 0;
+	size_t i;
+
+	for (i = 0; i < sizeof(serials); i++) {
+		serials[i / 6][i % 6] = (uint8_t)test_rand(&seed);
+	}
+
+	payload[n++] = 2;
+	payload[n++] = 0;
+	for (i = 0; i < 6; i++) {
+		payload[n++] = 0xC0 + i;
+	}
+	memset(&payload[n], 0, 17);
+	n += 17;
+
+	while (n < MAX_PAYLOAD_SIZE - 26) {
+		uint16_t offset = test_rand(&seed) % 3600;
+		payload[n++] = 0xA5;
+		payload[n++] = 1;
+		payload[n++] = 0x10;
+		payload[n++] = 0x0E;
+		memcpy(&payload[n], serials[test_rand(&seed) % 4], 6);
+		n += 6;
+		timestamp += test_rand(&seed) % 20;
+		memcpy(&payload[n], &timestamp, sizeof(timestamp));
+		n += sizeof(timestamp);
+		payload[n++] = 0;
+		payload[n++] = 0;
+		payload[n++] = 0x11;
+		payload[n++] = 0;
+		payload[n++] = 0;
+		memcpy(&payload[n], &offset, sizeof(offset));
+		n += sizeof(offset);
+		payload[n++] = (uint8_t)(-50 - (int)(test_rand(&seed) % 40));
+		payload[n++] = test_rand(&seed) % 2;
+		payload[n++] = (uint8_t)-8;
+	}
+	return n;
+}
+
+/******************************************************************************/
+/* Tests                                                                      */
+/******************************************************************************/
+static int round_trip(size_t len)
+{
+	int c = lcz_lzss_compress(payload, len, compressed, len);
+	if (c < 0) {
+		return c;
+	}
+	CHECK(lcz_lzss_is_compressed(compressed, c));
+	CHECK(lcz_lzss_decompress(compressed, c, restored, sizeof(restored)) ==
+	      (int)len);
+	CHECK(memcmp(restored, payload, len) == 0);
+	return c;
+}
+
+/* The payload must be compressed to no more than max_percent of its size */
+static void check_corpus(const char *name, size_t len, int max_percent)
+{
+	int c = round_trip(len);
+
+	CHECK(c > 0);
+	if (c > 0) {
+		printf("%-24s %5zu -> %5d bytes (%d%%)\n", name, len, c,
+		       (100 * c) / (int)len);
+		CHECK((100 * c) <= (max_percent * (int)len));
+	}
+}
+
+static void check_random(void)
+{
+	size_t i;
+
+	for (i = 0; i < 1024; i++) {
+		payload[i] = (uint8_t)test_rand(&seed);
+	}
+	CHECK(lcz_lzss_compress(payload, 1024, compressed, 1024) == -ENOSPC);
+}
+
+/* Plain payloads must not be mistaken for compressed ones. */
+static void check_plain(void)
+{
+	static const uint8_t JSON[] = "{\"state\":{}}";
+	static const uint8_t CONTACT_TRACING[] = { 2, 0, 0xC0, 0xC1, 0xC2,
+						   0xC3, 0xC4, 0xC5 };
+
+	CHECK(!lcz_lzss_is_compressed(JSON, sizeof(JSON) - 1));
+	CHECK(!lcz_lzss_is_compressed(CONTACT_TRACING,
+				      sizeof(CONTACT_TRACING)));
+}
+
+/* Small alphabets produce long matches and matches that overlap the
+ * position being encoded.
+ */
+static void check_round_trips(void)
+{
+	static const uint8_t ALPHABET[] = { 'a', 'b', 'c', 'a', 'b', 0, 0xFF };
+	size_t k;
+	size_t i;
+
+	for (k = 0; k < ROUND_TRIPS && test_failures == 0; k++) {
+		size_t len = test_rand(&seed) % 3000;
+		size_t symbols = (k % ARRAY_SIZE(ALPHABET)) + 1;
+		int c;
+
+		for (i = 0; i < len; i++) {
+			payload[i] = ALPHABET[test_rand(&seed) % symbols];
+		}
+		c = lcz_lzss_compress(payload, len, compressed,
+				      sizeof(compressed));
+		CHECK(c > 0);
+		CHECK(lcz_lzss_decompress(compressed, c, restored,
+					  sizeof(restored)) == (int)len);
+		CHECK(memcmp(restored, payload, len) == 0);
+	}
+}
+
+/* Corrupt payloads must be rejected without writing past the output. */
+static void check_corrupt(void)
+{
+	static uint8_t guarded[400 + 16];
+	size_t k;
+	size_t i;
+
+	for (k = 0; k < FUZZ_ITERATIONS; k++) {
+		size_t len = 8 + (test_rand(&seed) % 64);
+		int r;
+
+		for (i = 0; i < len; i++) {
+			compressed[i] = (uint8_t)test_rand(&seed);
+		}
+		compressed[0] = 0xB1;
+		compressed[1] = 0x5A;
+		compressed[2] = LCZ_LZSS_VERSION;
+		compressed[3] = 0;
+		compressed[4] = 0;
+		compressed[5] = test_rand(&seed) % 2;
+		compressed[6] = (uint8_t)test_rand(&seed);
+		memset(&guarded[400], 0xEE, 16);
+
+		r = lcz_lzss_decompress(compressed, len, guarded, 400);
+		CHECK(r == -EINVAL || r == -ENOSPC || (r >= 0 && r <= 400));
+		for (i = 400; i < sizeof(guarded); i++) {
+			CHECK(guarded[i] == 0xEE);
+		}
+	}
+}
+
+static void check_stats(void)
+{
+	struct lcz_lzss_stats stats;
+
+	lcz_lzss_get_stats(&stats);
+	printf("stats: compressed %u not smaller %u ratio %u%% "
+	       "max %u us\n",
+	       stats.compressed, stats.not_smaller, stats.ratio,
+	       stats.time_max_us);
+	CHECK(stats.compressed == 3);
+	CHECK(stats.not_smaller == 1);
+	CHECK(stats.ratio > 0 && stats.ratio < 50);
+}
+
+int main(void)
+{
+	check_corpus("event log shadow", event_log_shadow(), 45);
+	check_corpus("sd card log chunk", sd_log_chunk(), 45);
+	check_corpus("contact tracing upload", contact_tracing_upload(), 45);
+	check_random();
+	check_plain();
+	check_stats();
+	check_round_trips();
+	check_corrupt();
+	return TEST_RESULT();
+}
@@ -0,0 +1,100 @@
+/**
+ * @file bench_sensor_index.c
+ * @brief Time address lookups with the index and with the linear scan it
+ * replaced, for several table sizes.
+ *
+ * Usage: bench_sensor_index [lookups]
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <zephyr.h>
+#include <string.h>
+
+#include "sensor_index.h"
+#include "test.h"
+
+#define MAX_TABLE_SIZE 1000
+
+typedef struct {
+	bt_addr_t addr;
+	bool inUse;
+	uint8_t payload[120];
+} Entry_t;
+
+static Entry_t table[MAX_TABLE_SIZE];
+static uint16_t slots[SENSOR_INDEX_SLOTS(MAX_TABLE_SIZE)];
+static SensorIndex_t addrIndex;
+
+static size_t LinearFind(size_t Size, const bt_addr_t *pAddr)
+{
+	size_t i;
+	for (i = 0; i < Size; i++) {
+		if (table[i].inUse &&
+		    memcmp(pAddr, &table[i].addr, sizeof(bt_addr_t)) == 0) {
+			return i;
+		}
+	}
+	return SENSOR_INDEX_EMPTY;
+}
+
+static void Fill(size_t Size, uint32_t *pSeed)
+{
+	size_t i;
+
+	memset(table, 0, sizeof(table));
+	SensorIndex_Initialize(&addrIndex, slots, SENSOR_INDEX_SLOTS(Size),
+			       &table[0].addr, sizeof(Entry_t));
+	for (i = 0; i < Size; i++) {
+		uint32_t r = test_rand(pSeed);
+		memcpy(table[i].addr.val, &r, sizeof(r));
+		table[i].addr.val[4] = (uint8_t)i;
+		table[i].addr.val[5] = 0xC0 | (uint8_t)(i >> 8);
+		table[i].inUse = true;
+		SensorIndex_Insert(&addrIndex, i);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	static const size_t SIZES[] = { 15, 50, 200, 1000 };
+	unsigned long lookups = (argc > 1) ? strtoul(argv[1], NULL, 0) : 100000;
+	uint32_t seed = 7;
+	size_t s;
+
+	printf("%6s %12s %12s\n", "size", "scan ns", "index ns");
+	for (s = 0; s < ARRAY_SIZE(SIZES); s++) {
+		size_t size = SIZES[s];
+		volatile size_t sink = 0;
+		unsigned long n;
+		uint64_t t0, scan, hashed;
+
+		Fill(size, &seed);
+
+		/* Half of the lookups are for sensors that aren't in the table,
+		 * which is the common case for advertisements.
+		 */
+		t0 = test_now_ns();
+		for (n = 0; n < lookups; n++) {
+			bt_addr_t a = table[n % size].addr;
+			a.val[0] ^= (uint8_t)(n & 1);
+			sink += LinearFind(size, &a);
+		}
+		scan = test_now_ns() - t0;
+
+		t0 = test_now_ns();
+		for (n = 0; n < lookups; n++) {
+			bt_addr_t a = table[n % size].addr;
+			a.val[0] ^= (uint8_t)(n & 1);
+			sink += SensorIndex_Find(&addrIndex, &a);
+		}
+		hashed = test_now_ns() - t0;
+
+		printf("%6zu %12.1f %12.1f\n", size, (double)scan / lookups,
+		       (double)hashed / lookups);
+		CHECK(lookups == 0 || sink != 0);
+	}
+
+	return TEST_RESULT();
+}
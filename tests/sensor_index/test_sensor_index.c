@@ -0,0 +1,96 @@
+/**
+ * @file test_sensor_index.c
+ * @brief Compare the address index with a linear search while entries are
+ * randomly added and removed.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <zephyr.h>
+#include <string.h>
+
+#include "sensor_index.h"
+#include "test.h"
+
+#define TABLE_SIZE 200
+#define OPERATIONS 200000
+
+typedef struct {
+	bt_addr_t addr;
+	bool inUse;
+	uint8_t payload[40];
+} Entry_t;
+
+static Entry_t table[TABLE_SIZE];
+static uint16_t slots[SENSOR_INDEX_SLOTS(TABLE_SIZE)];
+static SensorIndex_t addrIndex;
+
+static size_t LinearFind(const bt_addr_t *pAddr)
+{
+	size_t i;
+	for (i = 0; i < TABLE_SIZE; i++) {
+		if (table[i].inUse &&
+		    memcmp(pAddr, &table[i].addr, sizeof(bt_addr_t)) == 0) {
+			return i;
+		}
+	}
+	return SENSOR_INDEX_EMPTY;
+}
+
+/* A small address space forces collisions and repeated lookups. */
+static void RandomAddr(uint32_t *pSeed, bt_addr_t *pAddr)
+{
+	uint32_t r = test_rand(pSeed);
+	memset(pAddr, 0, sizeof(bt_addr_t));
+	pAddr->val[0] = (uint8_t)(r >> 8);
+	pAddr->val[1] = (uint8_t)((r >> 16) & 0x3);
+	pAddr->val[5] = 0xC0;
+}
+
+int main(void)
+{
+	uint32_t seed = 1;
+	size_t n;
+
+	SensorIndex_Initialize(&addrIndex, slots, ARRAY_SIZE(slots),
+			       &table[0].addr, sizeof(Entry_t));
+
+	for (n = 0; n < OPERATIONS; n++) {
+		bt_addr_t addr;
+		RandomAddr(&seed, &addr);
+		size_t expected = LinearFind(&addr);
+		size_t found = SensorIndex_Find(&addrIndex, &addr);
+		CHECK(found == expected);
+		if (found != expected) {
+			break;
+		}
+
+		if (found != SENSOR_INDEX_EMPTY) {
+			if (test_rand(&seed) & 1) {
+				SensorIndex_Remove(&addrIndex, found);
+				table[found].inUse = false;
+			}
+			continue;
+		}
+
+		size_t i;
+		for (i = 0; i < TABLE_SIZE && table[i].inUse; i++) {
+		}
+		if (i < TABLE_SIZE) {
+			table[i].addr = addr;
+			table[i].inUse = true;
+			SensorIndex_Insert(&addrIndex, i);
+		}
+	}
+
+	/* Every entry must still be reachable after all of the removals. */
+	for (n = 0; n < TABLE_SIZE; n++) {
+		if (table[n].inUse) {
+			CHECK(SensorIndex_Find(&addrIndex, &table[n].addr) ==
+			      n);
+		}
+	}
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,42 @@
+/**
+ * @file bench_shadow_builder.c
+ * @brief Time building the sensor and gateway shadows.
+ *
+ * Usage: bench_shadow_builder [iterations]
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include "shadow_document.h"
+#include "test.h"
+
+static void Run(const char *pName, void (*Build)(JsonMsg_t *pMsg),
+		unsigned long Iterations)
+{
+	JsonMsg_t *pMsg = test_json_msg_alloc(4096);
+	unsigned long n;
+	uint64_t t0, ns;
+
+	t0 = test_now_ns();
+	for (n = 0; n < Iterations; n++) {
+		Build(pMsg);
+	}
+	ns = test_now_ns() - t0;
+
+	printf("%-8s %5zu bytes %9.1f ns/msg %8.1f MB/s\n", pName,
+	       pMsg->length, (double)ns / Iterations,
+	       (double)pMsg->length * Iterations * 1000.0 / (ns + 1));
+	CHECK(pMsg->length > 0);
+	free(pMsg);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long iterations =
+		(argc > 1) ? strtoul(argv[1], NULL, 0) : 200000;
+
+	Run("sensor", BuildSensorShadow, iterations);
+	Run("gateway", BuildGatewayShadow, iterations);
+	return TEST_RESULT();
+}
@@ -0,0 +1,85 @@
+/**
+ * @file shadow_document.h
+ * @brief Shadow documents built by the shadow builder tests.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __SHADOW_DOCUMENT_H__
+#define __SHADOW_DOCUMENT_H__
+
+#include "FrameworkIncludes.h"
+#include "sensor_log.h"
+#include "shadow_builder.h"
+
+#define EVENT_LOG_ENTRIES 20
+
+/* A BT510 sensor publish */
+static inline void BuildSensorShadowEntries(JsonMsg_t *pMsg, size_t Entries)
+{
+	size_t i;
+
+	ShadowBuilder_Start(pMsg, SKIP_MEMSET);
+	ShadowBuilder_StartGroup(pMsg, "state");
+	ShadowBuilder_StartGroup(pMsg, "reported");
+	ShadowBuilder_AddSigned32(pMsg, "rssi", -71);
+	ShadowBuilder_AddUint32(pMsg, "networkId", 65535);
+	ShadowBuilder_AddUint32(pMsg, "flags", 0x21);
+	ShadowBuilder_AddUint32(pMsg, "resetCount", 3);
+	ShadowBuilder_AddSigned32(pMsg, "tempCc", 2345);
+	ShadowBuilder_AddUint32(pMsg, "batteryVoltageMv", 3012);
+	ShadowBuilder_AddVersion(pMsg, "firmwareVersion", 1, 12, 255);
+	ShadowBuilder_AddUint32(pMsg, "eventLogSize", Entries);
+	ShadowBuilder_StartArray(pMsg, "eventLog");
+	for (i = 0; i < Entries; i++) {
+		SensorLogEvent_t e = { .epoch = 1617000000 + (i * 60),
+				       .data = 2300 + i,
+				       .recordType = 1 + (i % 12),
+				       .idLsb = i };
+		ShadowBuilder_AddEventLogEntry(pMsg, &e);
+	}
+	ShadowBuilder_EndArray(pMsg);
+	ShadowBuilder_EndGroup(pMsg);
+	ShadowBuilder_EndGroup(pMsg);
+	ShadowBuilder_Finalize(pMsg);
+}
+
+/* A sensor publish with a full event log */
+static inline void BuildSensorShadow(JsonMsg_t *pMsg)
+{
+	BuildSensorShadowEntries(pMsg, EVENT_LOG_ENTRIES);
+}
+
+/* A gateway shadow that uses every builder function, including strings
+ * that must be escaped.
+ */
+static inline void BuildGatewayShadow(JsonMsg_t *pMsg)
+{
+	size_t i;
+
+	ShadowBuilder_Start(pMsg, SKIP_MEMSET);
+	ShadowBuilder_StartGroup(pMsg, "state");
+	ShadowBuilder_AddNull(pMsg, "desired");
+	ShadowBuilder_StartGroup(pMsg, "reported");
+	ShadowBuilder_AddUint32(pMsg, "uptime", 4294967295U);
+	ShadowBuilder_AddSigned32(pMsg, "offset", -2147483647 - 1);
+	ShadowBuilder_AddVersion(pMsg, "firmwareVersion", 4, 0, 0);
+	ShadowBuilder_AddPair(pMsg, "name", "BT510 \"lab\"\\2\n\t",
+			      SB_IS_STRING);
+	ShadowBuilder_AddPair(pMsg, "ratio", "1.5", SB_IS_NOT_STRING);
+	ShadowBuilder_AddTrue(pMsg, "bl654Present");
+	ShadowBuilder_AddFalse(pMsg, "sdCardPresent");
+	ShadowBuilder_AddString(pMsg, "raw", "{\"a\":1}");
+	ShadowBuilder_StartArray(pMsg, "bt510");
+	for (i = 0; i < 3; i++) {
+		ShadowBuilder_AddSensorTableArrayEntry(
+			pMsg, "c13a7e4118a2", 1600000000 + i, (i & 1) != 0);
+	}
+	ShadowBuilder_EndArray(pMsg);
+	ShadowBuilder_EndGroup(pMsg);
+	ShadowBuilder_EndGroup(pMsg);
+	ShadowBuilder_Finalize(pMsg);
+}
+
+#endif /* __SHADOW_DOCUMENT_H__ */
@@ -0,0 +1,66 @@
+/**
+ * @file test_shadow_builder.c
+ * @brief Compare the JSON built by the shadow builder with the output of
+ * the original character-at-a-time builder.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <string.h>
+
+#include "shadow_document.h"
+#include "test.h"
+
+static const char GATEWAY_SHADOW[] =
+	"{\"state\":{\"desired\":null,\"reported\":{\"uptime\":4294967295,"
+	"\"offset\":-2147483648,\"firmwareVersion\":\"4.0.0\",\"name\":\"BT"
+	"510 \\\"lab\\\"\\\\2\\n\\t\",\"ratio\":1.5,\"bl654Present\":true,"
+	"\"sdCardPresent\":false,\"raw\":{\"a\":1},\"bt510\":[[\"c13a7e4118"
+	"a2\",1600000000,false],[\"c13a7e4118a2\",1600000001,true],[\"c13a7"
+	"e4118a2\",1600000002,false]]}}}";
+
+static const char SENSOR_SHADOW[] =
+	"{\"state\":{\"reported\":{\"rssi\":-71,\"networkId\":65535,\"flags"
+	"\":33,\"resetCount\":3,\"tempCc\":2345,\"batteryVoltageMv\":3012,"
+	"\"firmwareVersion\":\"1.12.255\",\"eventLogSize\":20,\"eventLog\":"
+	"[[\"01\",1617000000,\"08FC\"],[\"02\",1617000060,\"08FD\"],[\"03\""
+	",1617000120,\"08FE\"],[\"04\",1617000180,\"08FF\"],[\"05\",1617000"
+	"240,\"0900\"],[\"06\",1617000300,\"0901\"],[\"07\",1617000360,\"09"
+	"02\"],[\"08\",1617000420,\"0903\"],[\"09\",1617000480,\"0904\"],["
+	"\"0A\",1617000540,\"0905\"],[\"0B\",1617000600,\"0906\"],[\"0C\",1"
+	"617000660,\"0907\"],[\"01\",1617000720,\"0908\"],[\"02\",161700078"
+	"0,\"0909\"],[\"03\",1617000840,\"090A\"],[\"04\",1617000900,\"090B"
+	"\"],[\"05\",1617000960,\"090C\"],[\"06\",1617001020,\"090D\"],[\"0"
+	"7\",1617001080,\"090E\"],[\"08\",1617001140,\"090F\"]]}}}";
+
+static void CheckDocument(void (*Build)(JsonMsg_t *pMsg),
+			  const char *pExpected)
+{
+	size_t length = strlen(pExpected);
+	JsonMsg_t *pMsg = test_json_msg_alloc(length + 1);
+
+	/* The builder always keeps room for a terminator, so this is the
+	 * smallest buffer that holds the document.
+	 */
+	Build(pMsg);
+	CHECK(pMsg->length == length);
+	CHECK(memcmp(pMsg->buffer, pExpected, length) == 0);
+	if (pMsg->length != length ||
+	    memcmp(pMsg->buffer, pExpected, length) != 0) {
+		printf("got:      %.*s\nexpected: %s\n", (int)pMsg->length,
+		       pMsg->buffer, pExpected);
+	}
+
+	/* Building into a used message replaces its contents. */
+	Build(pMsg);
+	CHECK(pMsg->length == length);
+	free(pMsg);
+}
+
+int main(void)
+{
+	CheckDocument(BuildGatewayShadow, GATEWAY_SHADOW);
+	CheckDocument(BuildSensorShadow, SENSOR_SHADOW);
+	return TEST_RESULT();
+}
@@ -0,0 +1,298 @@
+/**
+ * @file test_shadow_builder_cbor.c
+ * @brief Decode the CBOR built by the shadow builder and compare the size
+ * of a sensor publish with its JSON encoding.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <string.h>
+#include <inttypes.h>
+
+#include "shadow_document.h"
+#include "test.h"
+
+#define DECODED_MAX_SIZE 4096
+
+/* The CBOR publish must be at least this much smaller than the JSON one */
+#define MINIMUM_REDUCTION_PERCENT 40
+
+typedef struct {
+	const uint8_t *p;
+	const uint8_t *end;
+	char out[DECODED_MAX_SIZE];
+	size_t length;
+} Decoder_t;
+
+/******************************************************************************/
+/* CBOR to JSON                                                               */
+/******************************************************************************/
+/* Only what the encoder produces is accepted.  Heads must use the shortest
+ * form and maps and arrays opened by a group or array must be indefinite.
+ */
+static bool DecodeItem(Decoder_t *d, bool *pBreak);
+
+static void Emit(Decoder_t *d, const char *pStr, size_t Length)
+{
+	assert(d->length + Length < sizeof(d->out));
+	memcpy(&d->out[d->length], pStr, Length);
+	d->length += Length;
+}
+
+static void EmitChar(Decoder_t *d, char c)
+{
+	Emit(d, &c, 1);
+}
+
+static bool DecodeHead(Decoder_t *d, uint8_t *pMajor, uint8_t *pInfo,
+		       uint32_t *pValue)
+{
+	size_t n;
+
+	if (d->p >= d->end) {
+		return false;
+	}
+	*pMajor = *d->p >> 5;
+	*pInfo = *d->p & 0x1F;
+	d->p += 1;
+
+	if (*pInfo < 24) {
+		*pValue = *pInfo;
+		return true;
+	} else if (*pInfo > 26) {
+		return true;
+	}
+
+	n = (size_t)1 << (*pInfo - 24);
+	if ((size_t)(d->end - d->p) < n) {
+		return false;
+	}
+	*pValue = 0;
+	while (n--) {
+		*pValue = (*pValue << 8) | *d->p++;
+	}
+	/* Preferred serialization */
+	return (*pInfo == 24) ? (*pValue >= 24) :
+	       (*pInfo == 25) ? (*pValue > UINT8_MAX) :
+				(*pValue > UINT16_MAX);
+}
+
+static bool DecodeText(Decoder_t *d, uint32_t Length)
+{
+	uint32_t i;
+
+	if ((uint32_t)(d->end - d->p) < Length) {
+		return false;
+	}
+	EmitChar(d, '"');
+	for (i = 0; i < Length; i++) {
+		char c = (char)d->p[i];
+		if (c == '"' || c == '\\') {
+			EmitChar(d, '\\');
+			EmitChar(d, c);
+		} else if (c == '\n') {
+			Emit(d, "\\n", 2);
+		} else if (c == '\t') {
+			Emit(d, "\\t", 2);
+		} else {
+			EmitChar(d, c);
+		}
+	}
+	EmitChar(d, '"');
+	d->p += Length;
+	return true;
+}
+
+static bool DecodeContainer(Decoder_t *d, bool IsMap, bool Indefinite,
+			    uint32_t Items)
+{
+	bool brk = false;
+	uint32_t i;
+
+	EmitChar(d, IsMap ? '{' : '[');
+	for (i = 0; Indefinite || i < Items; i++) {
+		/* The separator is removed if the item is the break. */
+		size_t mark = d->length;
+		if (i > 0) {
+			EmitChar(d, ',');
+		}
+		if (!DecodeItem(d, &brk)) {
+			return false;
+		}
+		if (brk) {
+			if (!Indefinite) {
+				return false;
+			}
+			d->length = mark;
+			break;
+		}
+		if (IsMap) {
+			EmitChar(d, ':');
+			if (!DecodeItem(d, &brk) || brk) {
+				return false;
+			}
+		}
+	}
+	EmitChar(d, IsMap ? '}' : ']');
+	return true;
+}
+
+static bool DecodeItem(Decoder_t *d, bool *pBreak)
+{
+	char str[sizeof("-4294967296")];
+	uint8_t major;
+	uint8_t info;
+	uint32_t value = 0;
+
+	*pBreak = false;
+	if (!DecodeHead(d, &major, &info, &value)) {
+		return false;
+	}
+
+	switch (major) {
+	case 0:
+		Emit(d, str, snprintf(str, sizeof(str), "%" PRIu32, value));
+		return info <= 26;
+	case 1:
+		Emit(d, str,
+		     snprintf(str, sizeof(str), "%" PRId64,
+			      -1 - (int64_t)value));
+		return info <= 26;
+	case 3:
+		return info <= 26 && DecodeText(d, value);
+	case 4:
+		return (info <= 26 || info == 31) &&
+		       DecodeContainer(d, false, info == 31, value);
+	case 5:
+		/* Groups are always indefinite */
+		return info == 31 && DecodeContainer(d, true, true, 0);
+	case 7:
+		if (info == 20) {
+			Emit(d, "false", 5);
+		} else if (info == 21) {
+			Emit(d, "true", 4);
+		} else if (info == 22) {
+			Emit(d, "null", 4);
+		} else if (info == 31) {
+			*pBreak = true;
+		} else {
+			return false;
+		}
+		return true;
+	default:
+		return false;
+	}
+}
+
+/* The decoded document is terminated.  NULL if the message isn't a single
+ * well-formed item.
+ */
+static const char *Decode(Decoder_t *d, const JsonMsg_t *pMsg)
+{
+	bool brk;
+
+	d->p = (const uint8_t *)pMsg->buffer;
+	d->end = d->p + pMsg->length;
+	d->length = 0;
+	if (!DecodeItem(d, &brk) || brk || d->p != d->end) {
+		return NULL;
+	}
+	EmitChar(d, '\0');
+	return d->out;
+}
+
+/******************************************************************************/
+/* Tests                                                                      */
+/******************************************************************************/
+static void CheckDecoded(void (*Build)(JsonMsg_t *pMsg),
+			 const char *pExpected)
+{
+	static Decoder_t decoder;
+	JsonMsg_t *pMsg = test_json_msg_alloc(DECODED_MAX_SIZE);
+	const char *pDecoded;
+
+	ShadowBuilder_SetEncoding(pMsg, SHADOW_ENCODING_CBOR);
+	Build(pMsg);
+	CHECK(pMsg->encoding == SHADOW_ENCODING_CBOR);
+	pDecoded = Decode(&decoder, pMsg);
+	CHECK(pDecoded != NULL);
+	if (pDecoded != NULL && strcmp(pDecoded, pExpected) != 0) {
+		printf("got:      %s\nexpected: %s\n", pDecoded, pExpected);
+		CHECK(false);
+	}
+	free(pMsg);
+}
+
+static void BuildShortSensorShadow(JsonMsg_t *pMsg)
+{
+	BuildSensorShadowEntries(pMsg, 2);
+}
+
+static void CheckSize(void)
+{
+	static Decoder_t decoder;
+	JsonMsg_t *pJson = test_json_msg_alloc(DECODED_MAX_SIZE);
+	JsonMsg_t *pCbor = test_json_msg_alloc(DECODED_MAX_SIZE);
+	unsigned int reduction;
+
+	BuildSensorShadow(pJson);
+	ShadowBuilder_SetEncoding(pCbor, SHADOW_ENCODING_CBOR);
+	BuildSensorShadow(pCbor);
+	CHECK(Decode(&decoder, pCbor) != NULL);
+
+	reduction = 100 - ((100 * pCbor->length) / pJson->length);
+	printf("sensor publish, %d entry event log: JSON %zu CBOR %zu bytes "
+	       "(%u%% smaller)\n",
+	       EVENT_LOG_ENTRIES, pJson->length, pCbor->length, reduction);
+	CHECK(reduction >= MINIMUM_REDUCTION_PERCENT);
+	free(pJson);
+	free(pCbor);
+}
+
+/* An encoding that isn't valid is replaced by JSON when the message is
+ * started.
+ */
+static void CheckInvalidEncoding(void)
+{
+	JsonMsg_t *pJson = test_json_msg_alloc(DECODED_MAX_SIZE);
+	JsonMsg_t *pMsg = test_json_msg_alloc(DECODED_MAX_SIZE);
+
+	BuildGatewayShadow(pJson);
+	pMsg->encoding = SHADOW_ENCODING_COUNT + 1;
+	BuildGatewayShadow(pMsg);
+	CHECK(pMsg->encoding == SHADOW_ENCODING_JSON);
+	CHECK(pMsg->length == pJson->length);
+	CHECK(memcmp(pMsg->buffer, pJson->buffer, pJson->length) == 0);
+	free(pJson);
+	free(pMsg);
+}
+
+int main(void)
+{
+	CheckDecoded(BuildShortSensorShadow,
+		     "{\"state\":{\"reported\":{\"rssi\":-71,"
+		     "\"networkId\":65535,\"flags\":33,\"resetCount\":3,"
+		     "\"tempCc\":2345,"
+		     "\"batteryVoltageMv\":3012,"
+		     "\"firmwareVersion\":\"1.12.255\","
+		     "\"eventLogSize\":2,\"eventLog\":[[1,1617000000,2300],"
+		     "[2,1617000060,2301]]}}}");
+
+	/* Values that aren't strings and raw JSON are sent as text. */
+	CheckDecoded(BuildGatewayShadow,
+		     "{\"state\":{\"desired\":null,\"reported\":{"
+		     "\"uptime\":4294967295,\"offset\":-2147483648,"
+		     "\"firmwareVersion\":\"4.0.0\","
+		     "\"name\":\"BT510 \\\"lab\\\"\\\\2\\n\\t\","
+		     "\"ratio\":\"1.5\","
+		     "\"bl654Present\":true,\"sdCardPresent\":false,"
+		     "\"raw\":\"{\\\"a\\\":1}\",\"bt510\":["
+		     "[\"c13a7e4118a2\",1600000000,false],"
+		     "[\"c13a7e4118a2\",1600000001,true],"
+		     "[\"c13a7e4118a2\",1600000002,false]]}}}");
+
+	CheckSize();
+	CheckInvalidEncoding();
+	return TEST_RESULT();
+}
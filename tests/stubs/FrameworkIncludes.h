@@ -0,0 +1,35 @@
+/**
+ * @file FrameworkIncludes.h
+ * @brief Host replacement for the framework.  Only the message types used
+ * by the shadow builder are provided.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __HOST_FRAMEWORK_INCLUDES_H__
+#define __HOST_FRAMEWORK_INCLUDES_H__
+
+#include <zephyr.h>
+
+#define FRAMEWORK_ASSERT(x) assert(x)
+
+/* Same layout as FrameworkMsgTypes.h without the framework header */
+typedef struct JsonMsg {
+	size_t size; /** number of bytes */
+	size_t length; /** of the data */
+	uint8_t encoding; /** ShadowEncoding_t (0 is JSON) */
+	uint32_t publishId;
+	char buffer[];
+} JsonMsg_t;
+
+/* Zeroed like a buffer pool allocation */
+static inline JsonMsg_t *test_json_msg_alloc(size_t Size)
+{
+	JsonMsg_t *p = calloc(1, sizeof(JsonMsg_t) + Size);
+	assert(p != NULL);
+	p->size = Size;
+	return p;
+}
+
+#endif /* __HOST_FRAMEWORK_INCLUDES_H__ */
@@ -0,0 +1,23 @@
+/**
+ * @file bluetooth.h
+ * @brief Host replacement for the Bluetooth address types.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __HOST_BLUETOOTH_H__
+#define __HOST_BLUETOOTH_H__
+
+#include <zephyr/types.h>
+
+typedef struct {
+	uint8_t val[6];
+} __attribute__((__packed__)) bt_addr_t;
+
+typedef struct {
+	uint8_t type;
+	bt_addr_t a;
+} __attribute__((__packed__)) bt_addr_le_t;
+
+#endif /* __HOST_BLUETOOTH_H__ */
@@ -0,0 +1,18 @@
+/**
+ * @file kernel.h
+ * @brief Host replacement for kernel.h
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __HOST_KERNEL_H__
+#define __HOST_KERNEL_H__
+
+#include <stdlib.h>
+#include <zephyr.h>
+
+#define k_malloc(size) malloc(size)
+#define k_free(ptr) free(ptr)
+
+#endif /* __HOST_KERNEL_H__ */
@@ -0,0 +1,25 @@
+/**
+ * @file log.h
+ * @brief Host replacement for the Zephyr logger.  Messages are discarded.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __HOST_LOGGING_LOG_H__
+#define __HOST_LOGGING_LOG_H__
+
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERR 1
+#define LOG_LEVEL_WRN 2
+#define LOG_LEVEL_INF 3
+#define LOG_LEVEL_DBG 4
+
+#define LOG_MODULE_REGISTER(...) extern int log_unused_module_declaration
+#define LOG_ERR(...) ((void)0)
+#define LOG_WRN(...) ((void)0)
+#define LOG_INF(...) ((void)0)
+#define LOG_DBG(...) ((void)0)
+#define log_strdup(s) (s)
+
+#endif /* __HOST_LOGGING_LOG_H__ */
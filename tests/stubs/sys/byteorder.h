@@ -0,0 +1,46 @@
+/**
+ * @file byteorder.h
+ * @brief Host replacement for sys/byteorder.h
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __HOST_SYS_BYTEORDER_H__
+#define __HOST_SYS_BYTEORDER_H__
+
+#include <zephyr/types.h>
+
+static inline uint16_t sys_get_le16(const uint8_t src[2])
+{
+	return (uint16_t)(src[0] | (src[1] << 8));
+}
+
+static inline uint32_t sys_get_le32(const uint8_t src[4])
+{
+	return sys_get_le16(src) | ((uint32_t)sys_get_le16(&src[2]) << 16);
+}
+
+static inline uint16_t sys_get_be16(const uint8_t src[2])
+{
+	return (uint16_t)((src[0] << 8) | src[1]);
+}
+
+static inline uint32_t sys_get_be32(const uint8_t src[4])
+{
+	return ((uint32_t)sys_get_be16(src) << 16) | sys_get_be16(&src[2]);
+}
+
+static inline void sys_put_be16(uint16_t val, uint8_t dst[2])
+{
+	dst[0] = (uint8_t)(val >> 8);
+	dst[1] = (uint8_t)val;
+}
+
+static inline void sys_put_be32(uint32_t val, uint8_t dst[4])
+{
+	sys_put_be16((uint16_t)(val >> 16), dst);
+	sys_put_be16((uint16_t)val, &dst[2]);
+}
+
+#endif /* __HOST_SYS_BYTEORDER_H__ */
@@ -0,0 +1,48 @@
+/**
+ * @file zephyr.h
+ * @brief Host replacement for the parts of the Zephyr API used by the
+ * modules under test.
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __HOST_ZEPHYR_H__
+#define __HOST_ZEPHYR_H__
+
+#include <zephyr/types.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <time.h>
+
+#define BIT(n) (1UL << (n))
+#define ARRAY_SIZE(array) (sizeof(array) / sizeof((array)[0]))
+#define ARG_UNUSED(x) (void)(x)
+#ifndef MIN
+#define MIN(a, b) (((a) < (b)) ? (a) : (b))
+#endif
+#ifndef MAX
+#define MAX(a, b) (((a) > (b)) ? (a) : (b))
+#endif
+#define WRITE_BIT(var, bit, set)                                               \
+	((var) = (set) ? ((var) | BIT(bit)) : ((var) & ~BIT(bit)))
+#define BUILD_ASSERT(expr, msg) _Static_assert(expr, msg)
+#define __packed __attribute__((__packed__))
+#define __ASSERT(test, ...) assert(test)
+#define __ASSERT_NO_MSG(test) assert(test)
+
+/* The cycle counter runs at 1 GHz */
+static inline uint32_t k_cycle_get_32(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec);
+}
+
+#define k_cyc_to_us_floor32(c) ((uint32_t)(c) / 1000U)
+
+#endif /* __HOST_ZEPHYR_H__ */
@@ -0,0 +1,14 @@
+/**
+ * @file types.h
+ * @brief Host replacement for zephyr/types.h
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#ifndef __HOST_ZEPHYR_TYPES_H__
+#define __HOST_ZEPHYR_TYPES_H__
+
+#include <stdint.h>
+
+#endif /* __HOST_ZEPHYR_TYPES_H__ */
@@ -0,0 +1,61 @@
+/**
+ * @file bench_to_string.c
+ * @brief Time the decimal formatters against snprintf.
+ *
+ * Usage: bench_to_string [values]
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <zephyr.h>
+#include <inttypes.h>
+
+#include "to_string.h"
+#include "test.h"
+
+/* Sensor values are mostly small, so each range is timed separately. */
+static void Run(const char *pName, uint32_t Mask, unsigned long Count)
+{
+	char str[MAXIMUM_LENGTH_OF_TO_STRING_SIGNED_OUTPUT];
+	volatile unsigned long sink = 0;
+	uint32_t seed = 99;
+	unsigned long n;
+	uint64_t t0, dec, sig, ref;
+
+	t0 = test_now_ns();
+	for (n = 0; n < Count; n++) {
+		sink += ToString_Dec(str, test_rand(&seed) & Mask);
+	}
+	dec = test_now_ns() - t0;
+
+	t0 = test_now_ns();
+	for (n = 0; n < Count; n++) {
+		int32_t value = (int32_t)(test_rand(&seed) & Mask);
+		sink += ToString_Signed(str, value);
+	}
+	sig = test_now_ns() - t0;
+
+	t0 = test_now_ns();
+	for (n = 0; n < Count; n++) {
+		sink += snprintf(str, sizeof(str), "%" PRIu32,
+				 test_rand(&seed) & Mask);
+	}
+	ref = test_now_ns() - t0;
+
+	printf("%-8s %10.1f %10.1f %10.1f\n", pName, (double)dec / Count,
+	       (double)sig / Count, (double)ref / Count);
+	CHECK(Count == 0 || sink != 0);
+}
+
+int main(int argc, char *argv[])
+{
+	unsigned long count = (argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000;
+
+	printf("%-8s %10s %10s %10s\n", "range", "Dec ns", "Signed ns",
+	       "printf ns");
+	Run("8-bit", UINT8_MAX, count);
+	Run("16-bit", UINT16_MAX, count);
+	Run("32-bit", UINT32_MAX, count);
+	return TEST_RESULT();
+}
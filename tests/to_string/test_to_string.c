@@ -0,0 +1,109 @@
+/**
+ * @file test_to_string.c
+ * @brief Compare the number formatters with printf.
+ *
+ * Every value from INT16_MIN to UINT16_MAX is checked, along with the
+ * powers of ten, the limits of each type and pseudo-random 32-bit values.
+ *
+ * Usage: test_to_string [random values]
+ *
+ * Copyright (c) 2021 Laird Connectivity
+ *
+ * SPDX-License-Identifier: Apache-2.0
+ */
+#include <zephyr.h>
+#include <string.h>
+#include <inttypes.h>
+
+#include "to_string.h"
+#include "test.h"
+
+static void CheckDec(uint32_t Value)
+{
+	char str[MAXIMUM_LENGTH_OF_TO_STRING_OUTPUT];
+	char expected[sizeof(str)];
+	uint8_t n = ToString_Dec(str, Value);
+
+	snprintf(expected, sizeof(expected), "%" PRIu32, Value);
+	if (strcmp(str, expected) != 0 || n != strlen(expected)) {
+		printf("ToString_Dec(%" PRIu32 ") = \"%s\" (%u)\n", Value, str,
+		       n);
+		CHECK(false);
+	}
+}
+
+static void CheckSigned(int32_t Value)
+{
+	char str[MAXIMUM_LENGTH_OF_TO_STRING_SIGNED_OUTPUT];
+	char expected[sizeof(str)];
+	uint8_t n = ToString_Signed(str, Value);
+
+	snprintf(expected, sizeof(expected), "%" PRId32, Value);
+	if (strcmp(str, expected) != 0 || n != strlen(expected)) {
+		printf("ToString_Signed(%" PRId32 ") = \"%s\" (%u)\n", Value,
+		       str, n);
+		CHECK(false);
+	}
+}
+
+static void CheckHex(uint32_t Value)
+{
+	char str[9];
+	char expected[9];
+
+	ToString_Hex32(str, Value);
+	snprintf(expected, sizeof(expected), "%08" PRIX32, Value);
+	CHECK(strcmp(str, expected) == 0);
+
+	ToString_Hex16(str, (uint16_t)Value);
+	snprintf(expected, sizeof(expected), "%04X", (uint16_t)Value);
+	CHECK(strcmp(str, expected) == 0);
+
+	ToString_Hex8(str, (uint8_t)Value);
+	snprintf(expected, sizeof(expected), "%02X", (uint8_t)Value);
+	CHECK(strcmp(str, expected) == 0);
+}
+
+int main(int argc, char *argv[])
+{
+	static const int32_t EDGES[] = {
+		0, 1, -1, 9, 10, -9, -10, 99, 100, -99, -100,
+		INT8_MIN, INT8_MAX, UINT8_MAX, INT16_MIN, INT16_MAX, UINT16_MAX,
+		INT32_MIN, INT32_MIN + 1, INT32_MAX
+	};
+	unsigned long randoms =
+		(argc > 1) ? strtoul(argv[1], NULL, 0) : 1000000;
+	uint32_t seed = 12345;
+	uint64_t p;
+	int32_t v;
+	size_t i;
+
+	for (i = 0; i < ARRAY_SIZE(EDGES); i++) {
+		CheckSigned(EDGES[i]);
+		CheckDec((uint32_t)EDGES[i]);
+	}
+
+	for (v = INT16_MIN; v <= UINT16_MAX; v++) {
+		CheckSigned(v);
+		CheckDec((uint32_t)v);
+		CheckHex((uint32_t)v);
+	}
+
+	for (p = 1; p <= UINT32_MAX; p *= 10) {
+		CheckDec((uint32_t)p - 1);
+		CheckDec((uint32_t)p);
+		CheckDec((uint32_t)p + 1);
+		CheckSigned((int32_t)p);
+		CheckSigned(-(int32_t)(p - 1));
+	}
+	CheckDec(UINT32_MAX);
+
+	for (i = 0; i < randoms && test_failures == 0; i++) {
+		uint32_t r = test_rand(&seed);
+		CheckDec(r);
+		CheckSigned((int32_t)r);
+		CheckHex(r);
+	}
+
+	return TEST_RESULT();
+}